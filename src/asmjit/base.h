@@ -11,12 +11,16 @@
 // [Dependencies]
 #include "./base/arch.h"
 #include "./base/assembler.h"
+#include "./base/cfg.h"
 #include "./base/codebuilder.h"
+#include "./base/codecache.h"
 #include "./base/codecompiler.h"
 #include "./base/codeemitter.h"
 #include "./base/codeholder.h"
+#include "./base/codetemplate.h"
 #include "./base/constpool.h"
 #include "./base/cpuinfo.h"
+#include "./base/elfwriter.h"
 #include "./base/func.h"
 #include "./base/globals.h"
 #include "./base/inst.h"
@@ -122,6 +122,28 @@ void Assembler::sync() noexcept {
 // [asmjit::Assembler - Code-Buffer]
 // ============================================================================
 
+Error Assembler::section(SectionEntry* section) {
+  if (_lastError) return _lastError;
+
+  if (ASMJIT_UNLIKELY(!section || _code->getSectionById(section->getId()) != section))
+    return setLastError(DebugUtils::errored(kErrorInvalidArgument));
+
+#if !defined(ASMJIT_DISABLE_LOGGING)
+  if (_globalOptions & kOptionLoggingEnabled)
+    _code->_logger->logf(".section %s\n", section->getName());
+#endif // !ASMJIT_DISABLE_LOGGING
+
+  // Update the length of the current section before leaving it.
+  sync();
+
+  uint8_t* p = section->_buffer._data;
+  _section    = section;
+  _bufferData = p;
+  _bufferEnd  = p + section->_buffer._capacity;
+  _bufferPtr  = p + section->_buffer._length;
+  return kErrorOk;
+}
+
 Error Assembler::setOffset(size_t offset) {
   if (_lastError) return _lastError;
 
@@ -216,6 +238,7 @@ Error Assembler::bind(const Label& label) {
 
   Error err = kErrorOk;
   size_t pos = getOffset();
+  uint32_t sectionId = _section->getId();
 
   LabelLink* link = le->_links;
   LabelLink* prev = nullptr;
@@ -227,8 +250,33 @@ Error Assembler::bind(const Label& label) {
     if (relocId != RelocEntry::kInvalidId) {
       // Adjust relocation data.
       RelocEntry* re = _code->_relocations[relocId];
+      re->_targetSectionId = sectionId;
       re->_data += static_cast<uint64_t>(pos);
     }
+    else if (link->sectionId != sectionId) {
+      // The link comes from another section, the displacement is not known
+      // until the sections are placed, so turn it into a relocation.
+      uint8_t* linkData = _code->_sections[link->sectionId]->_buffer._data + offset;
+
+      if (linkData[0] == 4) {
+        RelocEntry* re;
+        Error relocErr = _code->newRelocEntry(&re, RelocEntry::kTypeAbsToRel, 4);
+
+        if (relocErr == kErrorOk) {
+          re->_sourceSectionId = link->sectionId;
+          re->_sourceOffset = static_cast<uint64_t>(offset);
+          re->_targetSectionId = sectionId;
+          re->_data = static_cast<uint64_t>(static_cast<int64_t>(pos) + link->rel + 4);
+          Utils::writeI32u(linkData, 0);
+        }
+        else {
+          err = relocErr;
+        }
+      }
+      else {
+        err = DebugUtils::errored(kErrorInvalidDisplacement);
+      }
+    }
     else {
       // Not using relocId, this means that we are overwriting a real
       // displacement in the CodeBuffer.
@@ -247,13 +295,13 @@ Error Assembler::bind(const Label& label) {
 
     prev = link->prev;
     _code->_unresolvedLabelsCount--;
-    _code->_baseHeap.release(link, sizeof(LabelLink));
+    _code->releaseLabelLink(link);
 
     link = prev;
   }
 
   // Set as bound.
-  le->_sectionId = _section->getId();
+  le->_sectionId = sectionId;
   le->_offset = pos;
   le->_links = nullptr;
   resetInlineComment();
@@ -283,6 +331,48 @@ Error Assembler::embed(const void* data, uint32_t size) {
   return kErrorOk;
 }
 
+//! \internal
+//!
+//! Embed a 32-bit offset of `le` relative to the embedded value itself, used
+//! by position-independent code instead of an absolute address.
+static Error Assembler_embedLabelPIC(Assembler* self, LabelEntry* le) noexcept {
+  CodeHolder* code = self->getCode();
+  SectionEntry* section = self->_section;
+  size_t offset = self->getOffset();
+
+#if !defined(ASMJIT_DISABLE_LOGGING)
+  if (self->_globalOptions & CodeEmitter::kOptionLoggingEnabled)
+    code->_logger->logf(".dd L%u - .\n", Operand::unpackId(le->getId()));
+#endif // !ASMJIT_DISABLE_LOGGING
+
+  if (le->isBound() && le->getSectionId() == section->getId()) {
+    intptr_t rel = static_cast<intptr_t>(le->getOffset()) - static_cast<intptr_t>(offset);
+    Utils::writeI32u(self->_bufferPtr, static_cast<int32_t>(rel));
+  }
+  else if (le->isBound()) {
+    // Label bound in another section, the relocator calculates the offset.
+    RelocEntry* re;
+    Error err = code->newRelocEntry(&re, RelocEntry::kTypeAbsToRel, 4);
+    if (ASMJIT_UNLIKELY(err)) return self->setLastError(err);
+
+    re->_sourceSectionId = section->getId();
+    re->_sourceOffset = static_cast<uint64_t>(offset);
+    re->_targetSectionId = le->getSectionId();
+    re->_data = static_cast<uint64_t>(static_cast<int64_t>(le->getOffset()) + 4);
+    Utils::writeI32u(self->_bufferPtr, 0);
+  }
+  else {
+    // Resolved by `bind()` like a 32-bit displacement of a jump.
+    LabelLink* link = code->newLabelLink(le, section->getId(), offset, 0);
+    if (ASMJIT_UNLIKELY(!link))
+      return self->setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+    Utils::writeU32u(self->_bufferPtr, 0x04040404U);
+  }
+
+  self->_bufferPtr += 4;
+  return kErrorOk;
+}
+
 Error Assembler::embedLabel(const Label& label) {
   if (_lastError) return _lastError;
   ASMJIT_ASSERT(_code != nullptr);
@@ -301,6 +391,9 @@ Error Assembler::embedLabel(const Label& label) {
     if (ASMJIT_UNLIKELY(err)) return setLastError(err);
   }
 
+  if (_code->getCodeInfo().isPIC())
+    return Assembler_embedLabelPIC(this, le);
+
 #if !defined(ASMJIT_DISABLE_LOGGING)
   if (_globalOptions & kOptionLoggingEnabled)
     _code->_logger->logf(gpSize == 4 ? ".dd L%u\n" : ".dq L%u\n", Operand::unpackId(label.getId()));
@@ -330,6 +423,80 @@ Error Assembler::embedLabel(const Label& label) {
   return kErrorOk;
 }
 
+Error Assembler::embedLabelDelta(const Label& label, const Label& base, uint32_t size) {
+  if (_lastError) return _lastError;
+  ASMJIT_ASSERT(_code != nullptr);
+
+  LabelEntry* le = _code->getLabelEntry(label);
+  LabelEntry* be = _code->getLabelEntry(base);
+
+  if (ASMJIT_UNLIKELY(!le || !be))
+    return setLastError(DebugUtils::errored(kErrorInvalidLabel));
+
+  if (ASMJIT_UNLIKELY(size == 0 || size > 8 || !Utils::isPowerOf2(size)))
+    return setLastError(DebugUtils::errored(kErrorInvalidArgument));
+
+  if (ASMJIT_UNLIKELY(!be->isBound() || be->getSectionId() != _section->getId()))
+    return setLastError(DebugUtils::errored(kErrorInvalidLabel));
+
+  if (getRemainingSpace() < size) {
+    Error err = _code->growBuffer(&_section->_buffer, size);
+    if (ASMJIT_UNLIKELY(err)) return setLastError(err);
+  }
+
+#if !defined(ASMJIT_DISABLE_LOGGING)
+  if (_globalOptions & kOptionLoggingEnabled) {
+    static const char sizeNames[] = "db\0dw\0dd\0dq";
+    _code->_logger->logf(".%s L%u - L%u\n",
+      sizeNames + Utils::findFirstBit(size) * 3,
+      Operand::unpackId(label.getId()),
+      Operand::unpackId(base.getId()));
+  }
+#endif // !ASMJIT_DISABLE_LOGGING
+
+  size_t offset = getOffset();
+  intptr_t rel = static_cast<intptr_t>(offset) - static_cast<intptr_t>(be->getOffset());
+
+  if (le->isBound() && le->getSectionId() == _section->getId()) {
+    int64_t value = static_cast<int64_t>(le->getOffset()) - static_cast<int64_t>(be->getOffset());
+
+    switch (size) {
+      case 1: if (!Utils::isInt8(value)) goto InvalidDisplacement; _bufferPtr[0] = static_cast<uint8_t>(value & 0xFF); break;
+      case 2: if (!Utils::isInt16(value)) goto InvalidDisplacement; Utils::writeI16u(_bufferPtr, static_cast<int16_t>(value)); break;
+      case 4: if (!Utils::isInt32(value)) goto InvalidDisplacement; Utils::writeI32u(_bufferPtr, static_cast<int32_t>(value)); break;
+      default: Utils::writeI64u(_bufferPtr, value); break;
+    }
+  }
+  else if (ASMJIT_UNLIKELY(size != 4)) {
+    goto InvalidDisplacement;
+  }
+  else if (le->isBound()) {
+    // Label bound in another section, the relocator calculates the offset.
+    RelocEntry* re;
+    Error err = _code->newRelocEntry(&re, RelocEntry::kTypeAbsToRel, 4);
+    if (ASMJIT_UNLIKELY(err)) return setLastError(err);
+
+    re->_sourceSectionId = _section->getId();
+    re->_sourceOffset = static_cast<uint64_t>(offset);
+    re->_targetSectionId = le->getSectionId();
+    re->_data = static_cast<uint64_t>(static_cast<int64_t>(le->getOffset()) + rel + 4);
+    Utils::writeI32u(_bufferPtr, 0);
+  }
+  else {
+    // Resolved by `bind()` like a 32-bit displacement, adjusted to `base`.
+    LabelLink* link = _code->newLabelLink(le, _section->getId(), offset, rel);
+    if (ASMJIT_UNLIKELY(!link))
+      return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+    Utils::writeU32u(_bufferPtr, 0x04040404U);
+  }
+
+  _bufferPtr += size;
+  return kErrorOk;
+
+InvalidDisplacement:
+  return setLastError(DebugUtils::errored(kErrorInvalidDisplacement));
+}
+
 Error Assembler::embedConstPool(const Label& label, const ConstPool& pool) {
   if (_lastError) return _lastError;
 
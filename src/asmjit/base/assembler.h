@@ -69,6 +69,14 @@ public:
   //! Called by \ref CodeHolder::sync().
   ASMJIT_API virtual void sync() noexcept;
 
+  //! Get the current section.
+  ASMJIT_INLINE SectionEntry* getSection() const noexcept { return _section; }
+  //! Switch the current section to `section`.
+  //!
+  //! The `section` must belong to the attached \ref CodeHolder. Code and data
+  //! emitted after the switch are appended to the end of `section`.
+  ASMJIT_API virtual Error section(SectionEntry* section);
+
   //! Get the capacity of the current CodeBuffer.
   ASMJIT_INLINE size_t getBufferCapacity() const noexcept { return (size_t)(_bufferEnd - _bufferData); }
   //! Get the number of remaining bytes in the current CodeBuffer.
@@ -102,6 +110,7 @@ public:
   ASMJIT_API Error bind(const Label& label) override;
   ASMJIT_API Error embed(const void* data, uint32_t size) override;
   ASMJIT_API Error embedLabel(const Label& label) override;
+  ASMJIT_API Error embedLabelDelta(const Label& label, const Label& base, uint32_t size) override;
   ASMJIT_API Error embedConstPool(const Label& label, const ConstPool& pool) override;
   ASMJIT_API Error comment(const char* s, size_t len = Globals::kInvalidIndex) override;
 
@@ -0,0 +1,56 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Dependencies]
+#include "../base/binwriter_p.h"
+#include "../base/utils.h"
+#include <stdio.h>
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::BinWriter]
+// ============================================================================
+
+Error BinWriter::appendLE(StringBuilder& sb, uint64_t value, uint32_t size) noexcept {
+  char* p = sb.prepare(StringBuilder::kStringOpAppend, size);
+  if (ASMJIT_UNLIKELY(!p))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  switch (size) {
+    case 1: p[0] = static_cast<char>(value & 0xFF); break;
+    case 2: Utils::writeU16uLE(p, static_cast<uint32_t>(value)); break;
+    case 4: Utils::writeU32uLE(p, static_cast<uint32_t>(value)); break;
+    default: Utils::writeU64uLE(p, value); break;
+  }
+
+  return kErrorOk;
+}
+
+Error BinWriter::writeFile(const char* fileName, const StringBuilder& sb) noexcept {
+  FILE* file = ::fopen(fileName, "wb");
+  if (ASMJIT_UNLIKELY(!file))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  size_t written = ::fwrite(sb.getData(), 1, sb.getLength(), file);
+  int closed = ::fclose(file);
+
+  if (ASMJIT_UNLIKELY(written != sb.getLength() || closed != 0))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
@@ -0,0 +1,50 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_BINWRITER_P_H
+#define _ASMJIT_BASE_BINWRITER_P_H
+
+// [Dependencies]
+#include "../asmjit_build.h"
+#include "../base/string.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [asmjit::BinWriter]
+// ============================================================================
+
+//! \internal
+//!
+//! Helpers used by writers of binary formats (\ref ElfWriter, \ref CodeCache),
+//! not part of public API, not exported.
+struct BinWriter {
+  //! Append a little endian `value` of `size` (1, 2, 4, or 8) bytes to `sb`.
+  static Error appendLE(StringBuilder& sb, uint64_t value, uint32_t size) noexcept;
+
+  //! Write content of `sb` to a file `fileName`, which is created or truncated.
+  //!
+  //! Returns `kErrorInvalidArgument` if the file can't be opened and
+  //! `kErrorInvalidState` if it can't be written.
+  static Error writeFile(const char* fileName, const StringBuilder& sb) noexcept;
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // _ASMJIT_BASE_BINWRITER_P_H
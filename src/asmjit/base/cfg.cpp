@@ -0,0 +1,491 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/cfg.h"
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+#include "../base/codecompiler.h"
+#endif // !ASMJIT_DISABLE_COMPILER
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+#include "../x86/x86builder.h"
+#include "../x86/x86compiler.h"
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::CBCfg - Helpers]
+// ============================================================================
+
+//! \internal
+static ASMJIT_INLINE bool CBCfg_isLabel(const CBNode* node) noexcept {
+  uint32_t type = node->getType();
+  return type == CBNode::kNodeLabel || type == CBNode::kNodeFunc;
+}
+
+//! \internal
+//!
+//! Get whether `node` ends a basic block. Conditional edges of a jump table
+//! don't end the block as they all belong to the same indirect jump.
+static ASMJIT_INLINE bool CBCfg_isTerminator(const CBNode* node) noexcept {
+  if (node->hasFlag(CBNode::kFlagIsRet))
+    return true;
+
+  if (!node->isJmpOrJcc())
+    return false;
+
+  return !(node->isJcc() && node->hasFlag(CBNode::kFlagIsEdge));
+}
+
+//! \internal
+static Error CBCfg_addEdge(ZoneHeap* heap, CBBlock* from, CBBlock* to) noexcept {
+  if (from->_successors.contains(to))
+    return kErrorOk;
+
+  ASMJIT_PROPAGATE(from->_successors.append(heap, to));
+  ASMJIT_PROPAGATE(to->_predecessors.append(heap, from));
+  return kErrorOk;
+}
+
+//! \internal
+static ASMJIT_INLINE CBBlock* CBCfg_intersect(CBBlock* a, CBBlock* b) noexcept {
+  while (a != b) {
+    while (a->_poIndex < b->_poIndex) a = a->_idom;
+    while (b->_poIndex < a->_poIndex) b = b->_idom;
+  }
+  return a;
+}
+
+// ============================================================================
+// [asmjit::CBCfg - Build]
+// ============================================================================
+
+Error CBCfg::build(CodeBuilder* cb, CBNode* first, CBNode* stop) noexcept {
+  ZoneHeap* heap = _heap;
+  ASMJIT_ASSERT(_blocks.isEmpty());
+
+  _labelCount = cb->getLabels().getLength();
+  if (_labelCount) {
+    _labelBlocks = heap->allocT<CBBlock*>(_labelCount * sizeof(CBBlock*));
+    if (ASMJIT_UNLIKELY(!_labelBlocks))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    ::memset(_labelBlocks, 0, _labelCount * sizeof(CBBlock*));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Split Nodes Into Blocks]
+  // --------------------------------------------------------------------------
+
+  CBBlock* block = nullptr;
+  CBNode* node;
+
+  bool hasCode = false;
+  bool terminated = false;
+
+  for (node = first; node != stop; node = node->getNext()) {
+    bool isLabel = CBCfg_isLabel(node);
+
+    if (!block || terminated || (isLabel && hasCode)) {
+      uint32_t id = static_cast<uint32_t>(_blocks.getLength());
+      block = heap->allocT<CBBlock>();
+
+      if (ASMJIT_UNLIKELY(!block))
+        return DebugUtils::errored(kErrorNoHeapMemory);
+
+      new(block) CBBlock(id, node);
+      ASMJIT_PROPAGATE(_blocks.append(heap, block));
+
+      if (id == 0)
+        block->orFlags(CBBlock::kFlagIsEntry);
+
+      hasCode = false;
+      terminated = false;
+    }
+
+    block->_last = node;
+
+    if (isLabel) {
+      size_t index = Operand::unpackId(static_cast<CBLabel*>(node)->getId());
+      if (index < _labelCount) _labelBlocks[index] = block;
+
+      if (node->getType() == CBNode::kNodeFunc)
+        block->orFlags(CBBlock::kFlagIsEntry);
+    }
+    else {
+      hasCode = true;
+      terminated = CBCfg_isTerminator(node);
+    }
+  }
+
+  size_t blockCount = _blocks.getLength();
+  if (!blockCount) return kErrorOk;
+
+  // --------------------------------------------------------------------------
+  // [Connect Blocks]
+  // --------------------------------------------------------------------------
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+  CCFunc* func = nullptr;
+#endif // !ASMJIT_DISABLE_COMPILER
+
+  for (size_t i = 0; i < blockCount; i++) {
+    block = _blocks[i];
+    CBBlock* next = i + 1 < blockCount ? _blocks[i + 1] : static_cast<CBBlock*>(nullptr);
+    CBNode* last = block->_last;
+
+    // Add edges of jump tables and track the current function.
+    for (node = block->_first; ; node = node->getNext()) {
+#if !defined(ASMJIT_DISABLE_COMPILER)
+      if (node->getType() == CBNode::kNodeFunc)
+        func = static_cast<CCFunc*>(node);
+#endif // !ASMJIT_DISABLE_COMPILER
+
+      if (node != last && node->isJcc() && node->hasFlag(CBNode::kFlagIsEdge)) {
+        CBLabel* target = static_cast<CBJump*>(node)->getTarget();
+        CBBlock* targetBlock = target ? getBlockByLabel(target->getId()) : static_cast<CBBlock*>(nullptr);
+        if (targetBlock) ASMJIT_PROPAGATE(CBCfg_addEdge(heap, block, targetBlock));
+      }
+
+      if (node == last) break;
+    }
+
+    if (last->isJmpOrJcc()) {
+      CBLabel* target = static_cast<CBJump*>(last)->getTarget();
+      CBBlock* targetBlock = target ? getBlockByLabel(target->getId()) : static_cast<CBBlock*>(nullptr);
+
+      if (targetBlock)
+        ASMJIT_PROPAGATE(CBCfg_addEdge(heap, block, targetBlock));
+      else
+        block->orFlags(CBBlock::kFlagHasIndirect);
+
+      if (last->isJcc() && next)
+        ASMJIT_PROPAGATE(CBCfg_addEdge(heap, block, next));
+    }
+    else if (last->hasFlag(CBNode::kFlagIsRet)) {
+#if !defined(ASMJIT_DISABLE_COMPILER)
+      // Function return continues at the function's exit label.
+      if (last->getType() == CBNode::kNodeFuncExit && func) {
+        CBBlock* exitBlock = getBlockByLabel(func->getExitNode()->getId());
+        if (exitBlock) ASMJIT_PROPAGATE(CBCfg_addEdge(heap, block, exitBlock));
+      }
+#endif // !ASMJIT_DISABLE_COMPILER
+    }
+    else if (next) {
+      ASMJIT_PROPAGATE(CBCfg_addEdge(heap, block, next));
+    }
+
+    if (block->_successors.isEmpty())
+      block->orFlags(CBBlock::kFlagIsExit);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Post-Order]
+  // --------------------------------------------------------------------------
+
+  struct StackItem {
+    CBBlock* block;
+    size_t index;
+  };
+
+  // Each block is pushed at most once, which bounds the stack size. The root
+  // of each DFS tree is tracked as well, only blocks of the same tree are
+  // considered by the dominator analysis.
+  StackItem* stack = heap->allocT<StackItem>(blockCount * sizeof(StackItem));
+  uint32_t* roots = heap->allocT<uint32_t>(blockCount * sizeof(uint32_t));
+
+  if (ASMJIT_UNLIKELY(!stack || !roots))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ZoneVector<CBBlock*> po;
+  ASMJIT_PROPAGATE(po.reserve(heap, blockCount));
+
+  for (size_t i = 0; i < blockCount; i++) {
+    CBBlock* root = _blocks[i];
+    if (!root->isEntry() || root->isReachable()) continue;
+
+    size_t sp = 0;
+    root->orFlags(CBBlock::kFlagIsReachable);
+    roots[root->_id] = root->_id;
+
+    stack[sp].block = root;
+    stack[sp].index = 0;
+    sp++;
+
+    while (sp) {
+      StackItem& top = stack[sp - 1];
+      const ZoneVector<CBBlock*>& successors = top.block->_successors;
+
+      if (top.index < successors.getLength()) {
+        CBBlock* succ = successors[top.index++];
+        if (succ->isReachable()) continue;
+
+        succ->orFlags(CBBlock::kFlagIsReachable);
+        roots[succ->_id] = root->_id;
+
+        stack[sp].block = succ;
+        stack[sp].index = 0;
+        sp++;
+      }
+      else {
+        top.block->_poIndex = static_cast<uint32_t>(po.getLength());
+        po.appendUnsafe(top.block);
+        sp--;
+      }
+    }
+  }
+
+  size_t reachableCount = po.getLength();
+  ASMJIT_PROPAGATE(_rpo.reserve(heap, reachableCount));
+  for (size_t i = reachableCount; i != 0; i--)
+    _rpo.appendUnsafe(po[i - 1]);
+  po.release(heap);
+
+  // --------------------------------------------------------------------------
+  // [Dominators]
+  // --------------------------------------------------------------------------
+
+  // Iterative algorithm by Cooper, Harvey, and Kennedy: "A Simple, Fast
+  // Dominance Algorithm". Roots temporarily dominate themselves.
+  for (size_t i = 0; i < reachableCount; i++) {
+    block = _rpo[i];
+    if (roots[block->_id] == block->_id)
+      block->_idom = block;
+  }
+
+  bool changed;
+  do {
+    changed = false;
+    for (size_t i = 0; i < reachableCount; i++) {
+      block = _rpo[i];
+      if (roots[block->_id] == block->_id) continue;
+
+      CBBlock* newIDom = nullptr;
+      const ZoneVector<CBBlock*>& predecessors = block->_predecessors;
+
+      for (size_t j = 0; j < predecessors.getLength(); j++) {
+        CBBlock* pred = predecessors[j];
+        if (!pred->isReachable() || !pred->_idom || roots[pred->_id] != roots[block->_id])
+          continue;
+        newIDom = newIDom ? CBCfg_intersect(pred, newIDom) : pred;
+      }
+
+      if (block->_idom != newIDom) {
+        block->_idom = newIDom;
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  for (size_t i = 0; i < reachableCount; i++) {
+    block = _rpo[i];
+    if (block->_idom == block)
+      block->_idom = nullptr;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Loops]
+  // --------------------------------------------------------------------------
+
+  // A natural loop is formed by back-edges (edges to a dominator), its body is
+  // found by walking predecessors from their sources up to the header. Outer
+  // headers precede inner ones in RPO, so the innermost header is set last.
+  CBBlock** workList = reinterpret_cast<CBBlock**>(stack);
+  uint32_t* stamps = roots;
+  ::memset(stamps, 0, blockCount * sizeof(uint32_t));
+
+  for (size_t i = 0; i < reachableCount; i++) {
+    CBBlock* header = _rpo[i];
+    uint32_t stamp = header->_id + 1;
+    size_t wl = 0;
+    bool isLoop = false;
+
+    stamps[header->_id] = stamp;
+    const ZoneVector<CBBlock*>& predecessors = header->_predecessors;
+
+    for (size_t j = 0; j < predecessors.getLength(); j++) {
+      CBBlock* pred = predecessors[j];
+      if (!pred->isReachable() || !dominates(header, pred))
+        continue;
+
+      isLoop = true;
+      if (stamps[pred->_id] != stamp) {
+        stamps[pred->_id] = stamp;
+        workList[wl++] = pred;
+      }
+    }
+
+    if (!isLoop) continue;
+
+    header->orFlags(CBBlock::kFlagIsLoopHeader);
+    header->_loopHeader = header;
+    header->_loopDepth++;
+
+    while (wl) {
+      block = workList[--wl];
+      block->_loopHeader = header;
+      block->_loopDepth++;
+
+      const ZoneVector<CBBlock*>& blockPreds = block->_predecessors;
+      for (size_t j = 0; j < blockPreds.getLength(); j++) {
+        CBBlock* pred = blockPreds[j];
+        if (!pred->isReachable() || stamps[pred->_id] == stamp)
+          continue;
+
+        stamps[pred->_id] = stamp;
+        workList[wl++] = pred;
+      }
+    }
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::CBCfg - Dominators]
+// ============================================================================
+
+bool CBCfg::dominates(const CBBlock* a, const CBBlock* b) const noexcept {
+  if (!a->isReachable() || !b->isReachable())
+    return false;
+
+  do {
+    if (a == b) return true;
+    b = b->_idom;
+  } while (b);
+
+  return false;
+}
+
+// ============================================================================
+// [asmjit::CBCfg - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+UNIT(base_cfg) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+
+  INFO("Checking basic blocks and edges of nested loops");
+  {
+    X86Builder cb(&code);
+
+    Label L_Outer = cb.newLabel();
+    Label L_Inner = cb.newLabel();
+    Label L_Skip = cb.newLabel();
+    Label L_Dead = cb.newLabel();
+
+    cb.xor_(x86::eax, x86::eax);                   // #0 (entry)
+    cb.bind(L_Outer);                              // #1
+    cb.mov(x86::ecx, 10);
+    cb.bind(L_Inner);                              // #2
+    cb.dec(x86::ecx);
+    cb.jz(L_Skip);
+    cb.inc(x86::eax);                              // #3
+    cb.jmp(L_Inner);
+    cb.bind(L_Skip);                               // #4
+    cb.cmp(x86::eax, 100);
+    cb.jb(L_Outer);
+    cb.ret();                                      // #5
+    cb.bind(L_Dead);                               // #6
+    cb.nop();
+
+    CBCfg* cfg;
+    EXPECT(cb.getCfg(&cfg) == kErrorOk, "Failed to build the control-flow graph");
+    EXPECT(cfg->getBlocks().getLength() == 7, "Expected 7 blocks, got %u",
+      static_cast<unsigned int>(cfg->getBlocks().getLength()));
+
+    const ZoneVector<CBBlock*>& blocks = cfg->getBlocks();
+    EXPECT(blocks[0]->isEntry() && blocks[0]->getSuccessors().getLength() == 1, "Invalid entry block");
+    EXPECT(blocks[2]->getSuccessors().getLength() == 2 && blocks[2]->getPredecessors().getLength() == 2,
+      "Conditional jump must have two successors");
+    EXPECT(cfg->getBlockByLabel(L_Inner) == blocks[2], "Label isn't mapped to its block");
+    EXPECT(blocks[5]->isExit() && blocks[5]->getFirst()->getType() == CBNode::kNodeInst, "Block after a conditional jump must be exit");
+    EXPECT(!blocks[6]->isReachable(), "Block after a return must be unreachable");
+    EXPECT(cfg->getRPO().getLength() == 6 && cfg->getRPO()[0] == blocks[0], "Invalid reverse post-order");
+
+    INFO("Checking dominators and loop nesting depth");
+    EXPECT(blocks[1]->getIDom() == blocks[0] && blocks[4]->getIDom() == blocks[2] && blocks[3]->getIDom() == blocks[2],
+      "Invalid immediate dominators");
+    EXPECT(cfg->dominates(blocks[1], blocks[4]) && !cfg->dominates(blocks[3], blocks[4]), "Invalid dominance");
+    EXPECT(blocks[1]->isLoopHeader() && blocks[2]->isLoopHeader() && !blocks[4]->isLoopHeader(), "Invalid loop headers");
+    EXPECT(blocks[0]->getLoopDepth() == 0 && blocks[1]->getLoopDepth() == 1 &&
+           blocks[2]->getLoopDepth() == 2 && blocks[3]->getLoopDepth() == 2 &&
+           blocks[4]->getLoopDepth() == 1 && blocks[5]->getLoopDepth() == 0, "Invalid loop depth");
+    EXPECT(blocks[3]->getLoopHeader() == blocks[2] && blocks[4]->getLoopHeader() == blocks[1], "Invalid innermost loop header");
+
+    INFO("Checking that the graph is cached and invalidated by node changes");
+    CBCfg* cached;
+    EXPECT(cb.getCfg(&cached) == kErrorOk && cached == cfg, "The graph must be cached");
+    cb.nop();
+    EXPECT(cb.getCfg(&cached) == kErrorOk && cached->getBlocks().getLength() == 7 &&
+           cached->getBlocks()[6]->getLast() == cb.getLastNode(), "The graph must be rebuilt");
+  }
+
+  INFO("Checking that jump tables and returns are connected");
+  {
+    code.reset(false);
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+    X86Compiler cc(&code);
+
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+    X86Gp x = cc.newInt32("x");
+    cc.setArg(0, x);
+
+    Label L_Cases[3] = { cc.newLabel(), cc.newLabel(), cc.newLabel() };
+    Label L_Default = cc.newLabel();
+
+    cc.jmpTable(x, L_Cases, 3, L_Default);
+    for (uint32_t i = 0; i < 3; i++) {
+      cc.bind(L_Cases[i]);
+      cc.add(x, i);
+      cc.ret(x);
+    }
+    cc.bind(L_Default);
+    cc.ret(x);
+
+    CCFunc* func = cc.getFunc();
+    cc.endFunc();
+
+    CBCfg* cfg;
+    EXPECT(cc.getCfg(&cfg) == kErrorOk, "Failed to build the control-flow graph");
+
+    CBBlock* dispatch = cfg->getBlockByLabel(func->getLabel());
+    CBBlock* exitBlock = cfg->getBlockByLabel(func->getExitLabel());
+
+    EXPECT(dispatch->getSuccessors().getLength() == 2, "Bounds check must have two successors");
+    CBBlock* tableBlock = dispatch->getSuccessors()[1];
+    EXPECT(tableBlock->getSuccessors().getLength() == 3, "Indirect jump must have all targets as successors");
+
+    for (uint32_t i = 0; i < 3; i++) {
+      CBBlock* caseBlock = cfg->getBlockByLabel(L_Cases[i]);
+      EXPECT(caseBlock->getIDom() == tableBlock, "Case #%u must be dominated by the indirect jump", i);
+      EXPECT(caseBlock->getSuccessors().getLength() == 1 && caseBlock->getSuccessors()[0] == exitBlock,
+        "Return of case #%u must continue at the function exit", i);
+    }
+    EXPECT(exitBlock->getIDom() == dispatch && exitBlock->isExit(), "Invalid function exit block");
+  }
+}
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
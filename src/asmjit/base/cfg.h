@@ -0,0 +1,197 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_CFG_H
+#define _ASMJIT_BASE_CFG_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+#include "../base/zone.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [asmjit::CBBlock]
+// ============================================================================
+
+//! Basic block of a \ref CBCfg.
+//!
+//! A basic block is a sequence of nodes `[first, last]` that is only entered
+//! at `first` and only left after `last`. Blocks start at labels and end with
+//! jumps, returns, or before the next label. Jump table edges (nodes having
+//! \ref CBNode::kFlagIsEdge) stay in the block of the indirect jump they
+//! describe and add successors to it.
+class CBBlock {
+public:
+  ASMJIT_NONCOPYABLE(CBBlock)
+
+  //! Basic block flags.
+  ASMJIT_ENUM(Flags) {
+    kFlagIsEntry       = 0x00000001U,    //!< Block is an entry (first block or a function).
+    kFlagIsReachable   = 0x00000002U,    //!< Block is reachable from an entry.
+    kFlagIsLoopHeader  = 0x00000004U,    //!< Block is a target of a back-edge.
+    kFlagIsExit        = 0x00000008U,    //!< Block has no successors (returns or jumps out).
+    kFlagHasIndirect   = 0x00000010U     //!< Block ends with a jump that isn't followed.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_INLINE CBBlock(uint32_t id, CBNode* first) noexcept
+    : _id(id),
+      _flags(0),
+      _loopDepth(0),
+      _poIndex(kInvalidValue),
+      _first(first),
+      _last(first),
+      _idom(nullptr),
+      _loopHeader(nullptr),
+      _predecessors(),
+      _successors() {}
+  ASMJIT_INLINE ~CBBlock() noexcept {}
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the block id (index in \ref CBCfg::getBlocks(), follows node order).
+  ASMJIT_INLINE uint32_t getId() const noexcept { return _id; }
+
+  //! Get block flags.
+  ASMJIT_INLINE uint32_t getFlags() const noexcept { return _flags; }
+  //! Get whether the block has `flag`.
+  ASMJIT_INLINE bool hasFlag(uint32_t flag) const noexcept { return (_flags & flag) != 0; }
+  //! Add block `flags`.
+  ASMJIT_INLINE void orFlags(uint32_t flags) noexcept { _flags |= flags; }
+
+  ASMJIT_INLINE bool isEntry() const noexcept { return hasFlag(kFlagIsEntry); }
+  ASMJIT_INLINE bool isReachable() const noexcept { return hasFlag(kFlagIsReachable); }
+  ASMJIT_INLINE bool isLoopHeader() const noexcept { return hasFlag(kFlagIsLoopHeader); }
+  ASMJIT_INLINE bool isExit() const noexcept { return hasFlag(kFlagIsExit); }
+
+  //! Get the first node of the block.
+  ASMJIT_INLINE CBNode* getFirst() const noexcept { return _first; }
+  //! Get the last node of the block.
+  ASMJIT_INLINE CBNode* getLast() const noexcept { return _last; }
+
+  //! Get the immediate dominator (null for entries and unreachable blocks).
+  ASMJIT_INLINE CBBlock* getIDom() const noexcept { return _idom; }
+  //! Get the header of the innermost loop containing this block (or null).
+  ASMJIT_INLINE CBBlock* getLoopHeader() const noexcept { return _loopHeader; }
+  //! Get the number of loops that contain this block (0 if not in a loop).
+  ASMJIT_INLINE uint32_t getLoopDepth() const noexcept { return _loopDepth; }
+
+  ASMJIT_INLINE const ZoneVector<CBBlock*>& getPredecessors() const noexcept { return _predecessors; }
+  ASMJIT_INLINE const ZoneVector<CBBlock*>& getSuccessors() const noexcept { return _successors; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _id;                          //!< Block id.
+  uint32_t _flags;                       //!< Block flags.
+  uint32_t _loopDepth;                   //!< Loop nesting depth.
+  uint32_t _poIndex;                     //!< Post-order index (kInvalidValue if unreachable).
+
+  CBNode* _first;                        //!< First node.
+  CBNode* _last;                         //!< Last node.
+  CBBlock* _idom;                        //!< Immediate dominator.
+  CBBlock* _loopHeader;                  //!< Innermost loop header.
+
+  ZoneVector<CBBlock*> _predecessors;    //!< Predecessors.
+  ZoneVector<CBBlock*> _successors;      //!< Successors.
+};
+
+// ============================================================================
+// [asmjit::CBCfg]
+// ============================================================================
+
+//! Control-flow graph of \ref CodeBuilder nodes.
+//!
+//! The graph is built by a single pass over nodes and the connection of
+//! `CBJump` nodes with their `CBLabel` targets. It provides basic blocks,
+//! their predecessors and successors, reverse post-order, dominator tree,
+//! and loop nesting depth. Use \ref CodeBuilder::getCfg() to get a graph of
+//! the whole code, which is cached until nodes are added or removed.
+class CBCfg {
+public:
+  ASMJIT_NONCOPYABLE(CBCfg)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_INLINE CBCfg(ZoneHeap* heap) noexcept
+    : _heap(heap),
+      _blocks(),
+      _rpo(),
+      _labelBlocks(nullptr),
+      _labelCount(0) {}
+  ASMJIT_INLINE ~CBCfg() noexcept {}
+
+  // --------------------------------------------------------------------------
+  // [Build]
+  // --------------------------------------------------------------------------
+
+  //! Build the graph of nodes `[first, stop)`.
+  //!
+  //! Blocks are allocated by the heap passed to the constructor, the graph
+  //! must be built only once.
+  ASMJIT_API Error build(CodeBuilder* cb, CBNode* first, CBNode* stop) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get all blocks in node order.
+  ASMJIT_INLINE const ZoneVector<CBBlock*>& getBlocks() const noexcept { return _blocks; }
+  //! Get reachable blocks in reverse post-order (each entry is followed by
+  //! blocks it reaches).
+  ASMJIT_INLINE const ZoneVector<CBBlock*>& getRPO() const noexcept { return _rpo; }
+
+  //! Get the block that starts with a label `id` (or null).
+  ASMJIT_INLINE CBBlock* getBlockByLabel(uint32_t id) const noexcept {
+    size_t index = Operand::unpackId(id);
+    return index < _labelCount ? _labelBlocks[index] : static_cast<CBBlock*>(nullptr);
+  }
+  //! \overload
+  ASMJIT_INLINE CBBlock* getBlockByLabel(const Label& label) const noexcept { return getBlockByLabel(label.getId()); }
+
+  //! Get whether `a` dominates `b` (each block dominates itself).
+  ASMJIT_API bool dominates(const CBBlock* a, const CBBlock* b) const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  ZoneHeap* _heap;                       //!< ZoneHeap used to allocate blocks.
+  ZoneVector<CBBlock*> _blocks;          //!< Blocks in node order.
+  ZoneVector<CBBlock*> _rpo;             //!< Reachable blocks in reverse post-order.
+  CBBlock** _labelBlocks;                //!< Maps label indexes to blocks.
+  size_t _labelCount;                    //!< Count of label indexes in `_labelBlocks`.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_BASE_CFG_H
@@ -12,7 +12,9 @@
 #if !defined(ASMJIT_DISABLE_BUILDER)
 
 // [Dependencies]
+#include "../base/cfg.h"
 #include "../base/codebuilder.h"
+#include "../base/osutils.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -28,14 +30,22 @@ CodeBuilder::CodeBuilder() noexcept
     _cbBaseZone(32768 - Zone::kZoneOverhead),
     _cbDataZone(16384 - Zone::kZoneOverhead),
     _cbPassZone(32768 - Zone::kZoneOverhead),
+    _cbCfgZone(16384 - Zone::kZoneOverhead),
     _cbHeap(&_cbBaseZone),
+    _cbCfgHeap(&_cbCfgZone),
     _cbPasses(),
+    _cbPassRecords(),
     _cbLabels(),
     _firstNode(nullptr),
     _lastNode(nullptr),
     _cursor(nullptr),
+    _cfg(nullptr),
     _position(0),
-    _nodeFlags(0) {}
+    _nodeFlags(0),
+    _funcAlignment(0),
+    _loopAlignment(0),
+    _loopMaxPadding(0),
+    _passStatsEnabled(false) {}
 CodeBuilder::~CodeBuilder() noexcept {}
 
 // ============================================================================
@@ -48,12 +58,15 @@ Error CodeBuilder::onAttach(CodeHolder* code) noexcept {
 
 Error CodeBuilder::onDetach(CodeHolder* code) noexcept {
   _cbPasses.reset();
+  _cbPassRecords.reset();
   _cbLabels.reset();
   _cbHeap.reset(&_cbBaseZone);
+  _cbCfgHeap.reset(&_cbCfgZone);
 
   _cbBaseZone.reset(false);
   _cbDataZone.reset(false);
   _cbPassZone.reset(false);
+  _cbCfgZone.reset(false);
 
   _position = 0;
   _nodeFlags = 0;
@@ -61,10 +74,36 @@ Error CodeBuilder::onDetach(CodeHolder* code) noexcept {
   _firstNode = nullptr;
   _lastNode = nullptr;
   _cursor = nullptr;
+  _cfg = nullptr;
 
   return Base::onDetach(code);
 }
 
+// ============================================================================
+// [asmjit::CodeBuilder - Code Alignment]
+// ============================================================================
+
+static ASMJIT_INLINE bool CodeBuilder_isValidAlignment(uint32_t alignment) noexcept {
+  return alignment == 0 || (Utils::isPowerOf2(alignment) && alignment <= Globals::kMaxAlignment);
+}
+
+Error CodeBuilder::setFuncAlignment(uint32_t alignment) noexcept {
+  if (ASMJIT_UNLIKELY(!CodeBuilder_isValidAlignment(alignment)))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  _funcAlignment = alignment;
+  return kErrorOk;
+}
+
+Error CodeBuilder::setLoopAlignment(uint32_t alignment, uint32_t maxPadding) noexcept {
+  if (ASMJIT_UNLIKELY(!CodeBuilder_isValidAlignment(alignment)))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  _loopAlignment = alignment;
+  _loopMaxPadding = maxPadding;
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::CodeBuilder - Node-Factory]
 // ============================================================================
@@ -141,6 +180,17 @@ CBConstPool* CodeBuilder::newConstPool() noexcept {
   return node;
 }
 
+CBJumpTable* CodeBuilder::newJumpTableNode(uint32_t count) noexcept {
+  CBJump** edges = _cbHeap.allocT<CBJump*>(count * sizeof(CBJump*));
+  if (!edges) return nullptr;
+  ::memset(edges, 0, count * sizeof(CBJump*));
+
+  CBJumpTable* node = newNodeT<CBJumpTable>(edges, count);
+  if (!node || registerLabelNode(node) != kErrorOk)
+    return nullptr;
+  return node;
+}
+
 CBComment* CodeBuilder::newCommentNode(const char* s, size_t len) noexcept {
   if (s) {
     if (len == Globals::kInvalidIndex) len = ::strlen(s);
@@ -242,6 +292,20 @@ Error CodeBuilder::embedLabel(const Label& label) {
   return kErrorOk;
 }
 
+Error CodeBuilder::embedLabelDelta(const Label& label, const Label& base, uint32_t size) {
+  if (_lastError) return _lastError;
+
+  if (ASMJIT_UNLIKELY(size == 0 || size > 8 || !Utils::isPowerOf2(size)))
+    return setLastError(DebugUtils::errored(kErrorInvalidArgument));
+
+  CBLabelData* node = newNodeT<CBLabelData>(label.getId(), base.getId(), size);
+  if (ASMJIT_UNLIKELY(!node))
+    return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+
+  addNode(node);
+  return kErrorOk;
+}
+
 Error CodeBuilder::embedConstPool(const Label& label, const ConstPool& pool) {
   if (_lastError) return _lastError;
 
@@ -280,6 +344,7 @@ CBNode* CodeBuilder::addNode(CBNode* node) noexcept {
   ASMJIT_ASSERT(node->_prev == nullptr);
   ASMJIT_ASSERT(node->_next == nullptr);
 
+  invalidateCfg();
   if (!_cursor) {
     if (!_firstNode) {
       _firstNode = node;
@@ -319,6 +384,7 @@ CBNode* CodeBuilder::addAfter(CBNode* node, CBNode* ref) noexcept {
   CBNode* prev = ref;
   CBNode* next = ref->_next;
 
+  invalidateCfg();
   node->_prev = prev;
   node->_next = next;
 
@@ -340,6 +406,7 @@ CBNode* CodeBuilder::addBefore(CBNode* node, CBNode* ref) noexcept {
   CBNode* prev = ref->_prev;
   CBNode* next = ref;
 
+  invalidateCfg();
   node->_prev = prev;
   node->_next = next;
 
@@ -383,6 +450,7 @@ CBNode* CodeBuilder::removeNode(CBNode* node) noexcept {
   CBNode* prev = node->_prev;
   CBNode* next = node->_next;
 
+  invalidateCfg();
   if (_firstNode == node)
     _firstNode = next;
   else
@@ -412,6 +480,7 @@ void CodeBuilder::removeNodes(CBNode* first, CBNode* last) noexcept {
   CBNode* prev = first->_prev;
   CBNode* next = last->_next;
 
+  invalidateCfg();
   if (_firstNode == first)
     _firstNode = next;
   else
@@ -446,6 +515,36 @@ CBNode* CodeBuilder::setCursor(CBNode* node) noexcept {
   return old;
 }
 
+// ============================================================================
+// [asmjit::CodeBuilder - Control-Flow Graph]
+// ============================================================================
+
+Error CodeBuilder::getCfg(CBCfg** pOut) noexcept {
+  if (!_cfg) {
+    _cbCfgHeap.reset(&_cbCfgZone);
+    _cbCfgZone.reset(false);
+
+    CBCfg* cfg = _cbCfgHeap.allocT<CBCfg>();
+    if (ASMJIT_UNLIKELY(!cfg)) {
+      *pOut = nullptr;
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    }
+
+    new(cfg) CBCfg(&_cbCfgHeap);
+    Error err = cfg->build(this, _firstNode, nullptr);
+
+    if (ASMJIT_UNLIKELY(err)) {
+      *pOut = nullptr;
+      return err;
+    }
+
+    _cfg = cfg;
+  }
+
+  *pOut = _cfg;
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::CodeBuilder - Passes]
 // ============================================================================
@@ -461,6 +560,10 @@ ASMJIT_FAVOR_SIZE CBPass* CodeBuilder::getPassByName(const char* name) const noe
 }
 
 ASMJIT_FAVOR_SIZE Error CodeBuilder::addPass(CBPass* pass) noexcept {
+  return insertPass(_cbPasses.getLength(), pass);
+}
+
+ASMJIT_FAVOR_SIZE Error CodeBuilder::insertPass(size_t index, CBPass* pass) noexcept {
   if (ASMJIT_UNLIKELY(pass == nullptr)) {
     // Since this is directly called by `addPassT()` we treat `null` argument
     // as out-of-memory condition. Otherwise it would be API misuse.
@@ -473,7 +576,10 @@ ASMJIT_FAVOR_SIZE Error CodeBuilder::addPass(CBPass* pass) noexcept {
     return DebugUtils::errored(kErrorInvalidState);
   }
 
-  ASMJIT_PROPAGATE(_cbPasses.append(&_cbHeap, pass));
+  if (ASMJIT_UNLIKELY(index > _cbPasses.getLength()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_PROPAGATE(_cbPasses.insert(&_cbHeap, index, pass));
   pass->_cb = this;
   return kErrorOk;
 }
@@ -497,6 +603,184 @@ ASMJIT_FAVOR_SIZE Error CodeBuilder::deletePass(CBPass* pass) noexcept {
   return kErrorOk;
 }
 
+Error CodeBuilder::setPassEnabled(const char* name, bool enabled) noexcept {
+  CBPass* pass = getPassByName(name);
+  if (ASMJIT_UNLIKELY(!pass))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  pass->setEnabled(enabled);
+  return kErrorOk;
+}
+
+Error CodeBuilder::setPassOptions(const char* options) noexcept {
+  const char* p = options;
+  char name[64];
+
+  for (;;) {
+    while (*p == ',' || *p == ' ')
+      p++;
+    if (!*p) break;
+
+    bool enabled = true;
+    if (*p == '+' || *p == '-')
+      enabled = *p++ == '+';
+
+    size_t len = 0;
+    while (p[len] && p[len] != ',' && p[len] != ' ')
+      len++;
+
+    if (ASMJIT_UNLIKELY(len == 0 || len >= ASMJIT_ARRAY_SIZE(name)))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    ::memcpy(name, p, len);
+    name[len] = '\0';
+    p += len;
+
+    CBPass* pass = getPassByName(name);
+    if (!pass) {
+      if (!enabled)
+        continue;
+
+      pass = _newPassByName(name);
+      if (ASMJIT_UNLIKELY(!pass))
+        return DebugUtils::errored(kErrorInvalidArgument);
+
+      Error err = addPass(pass);
+      if (ASMJIT_UNLIKELY(err)) {
+        pass->~CBPass();
+        return err;
+      }
+    }
+
+    pass->setEnabled(enabled);
+  }
+
+  return kErrorOk;
+}
+
+CBPass* CodeBuilder::_newPassByName(const char* name) noexcept {
+  ASMJIT_UNUSED(name);
+  return nullptr;
+}
+
+//! \internal
+//!
+//! Order enabled passes of `cb` by their dependencies. Passes that don't depend
+//! on each other keep the order they are in the list of passes.
+static Error CodeBuilder_orderPasses(CodeBuilder* cb, ZoneVector<CBPass*>& order) noexcept {
+  const ZoneVector<CBPass*>& passes = cb->getPasses();
+  size_t count = passes.getLength();
+
+  ASMJIT_PROPAGATE(order.reserve(&cb->_cbHeap, count));
+  for (size_t i = 0; i < count; i++)
+    if (passes[i]->isEnabled())
+      order.appendUnsafe(passes[i]);
+
+  // Selection of the first pass that doesn't have to run after any of the
+  // remaining ones, there are only few passes so quadratic time is fine.
+  size_t length = order.getLength();
+  for (size_t i = 0; i < length; i++) {
+    size_t ready = length;
+
+    for (size_t j = i; j < length && ready == length; j++) {
+      ready = j;
+      for (size_t k = i; k < length; k++) {
+        if (k != j && order[k]->mustRunBefore(order[j])) {
+          ready = length;
+          break;
+        }
+      }
+    }
+
+    if (ASMJIT_UNLIKELY(ready == length))
+      return DebugUtils::errored(kErrorInvalidState);
+
+    CBPass* pass = order[ready];
+    while (ready > i) {
+      order[ready] = order[ready - 1];
+      ready--;
+    }
+    order[i] = pass;
+  }
+
+  return kErrorOk;
+}
+
+Error CodeBuilder::runPasses() noexcept {
+  ZoneVector<CBPass*> order;
+  Error err = CodeBuilder_orderPasses(this, order);
+
+  for (size_t i = 0, len = order.getLength(); i < len && !err; i++) {
+    CBPass* pass = order[i];
+
+    if (!_passStatsEnabled) {
+      err = pass->process(&_cbPassZone);
+      _cbPassZone.reset();
+      continue;
+    }
+
+    // Counters maintained by passes are stored as a difference, so the record
+    // only contains what the pass did during this run.
+    CBPassStats& stats = pass->_stats;
+    CBPassStats prev = stats;
+    uint32_t nodesIn = countNodes(_firstNode);
+
+    uint64_t startTime = OSUtils::getNanoTickCount();
+    err = pass->process(&_cbPassZone);
+    uint64_t endTime = OSUtils::getNanoTickCount();
+
+    stats._time += endTime - startTime;
+    stats._zoneSize += _cbPassZone.getUsedSize();
+    stats._runCount++;
+    stats._nodesIn += nodesIn;
+    stats._nodesOut += countNodes(_firstNode);
+    _cbPassZone.reset();
+
+    CBPassStats record;
+    record._time = stats._time - prev._time;
+    record._zoneSize = stats._zoneSize - prev._zoneSize;
+    record._runCount = 1;
+    record._nodesIn = nodesIn;
+    record._nodesOut = stats._nodesOut - prev._nodesOut;
+    record._spillCount = stats._spillCount - prev._spillCount;
+    record._moveCount = stats._moveCount - prev._moveCount;
+
+    if (!err)
+      err = addPassRecord(pass, nullptr, record);
+  }
+
+  _cbPassZone.reset();
+  order.release(&_cbHeap);
+  return err;
+}
+
+// ============================================================================
+// [asmjit::CodeBuilder - Pass Statistics]
+// ============================================================================
+
+Error CodeBuilder::addPassRecord(CBPass* pass, CBNode* func, const CBPassStats& stats) noexcept {
+  CBPassRecord record;
+  record.pass = pass;
+  record.func = func;
+  record.stats = stats;
+  return _cbPassRecords.append(&_cbHeap, record);
+}
+
+void CodeBuilder::resetPassStats() noexcept {
+  for (size_t i = 0, len = _cbPasses.getLength(); i < len; i++)
+    _cbPasses[i]->_stats.reset();
+  _cbPassRecords.release(&_cbHeap);
+}
+
+uint32_t CodeBuilder::countNodes(const CBNode* first, const CBNode* last) noexcept {
+  uint32_t count = 0;
+  for (const CBNode* node = first; node; node = node->getNext()) {
+    count++;
+    if (node == last) break;
+  }
+  return count;
+}
+
 // ============================================================================
 // [asmjit::CodeBuilder - Serialization]
 // ============================================================================
@@ -505,7 +789,32 @@ Error CodeBuilder::serialize(CodeEmitter* dst) {
   Error err = kErrorOk;
   CBNode* node_ = getFirstNode();
 
+  // Code alignment is only possible if the destination can tell the current
+  // offset, otherwise the padding budget of loop headers can't be checked.
+  Assembler* dstAsm = dst->isAssembler() ? static_cast<Assembler*>(dst) : nullptr;
+  CBCfg* cfg = nullptr;
+
+  if (_loopAlignment > 1 && dstAsm)
+    ASMJIT_PROPAGATE(getCfg(&cfg));
+
   do {
+    // Apply the code alignment policy before the node is serialized.
+    if (dstAsm) {
+      uint32_t nodeType = node_->getType();
+      if (nodeType == CBNode::kNodeFunc && _funcAlignment > 1) {
+        err = dst->align(kAlignCode, _funcAlignment);
+      }
+      else if (nodeType == CBNode::kNodeLabel && cfg) {
+        CBBlock* block = cfg->getBlockByLabel(static_cast<CBLabel*>(node_)->getId());
+        if (block && block->isLoopHeader() && block->getFirst() == node_) {
+          size_t padding = Utils::alignDiff<size_t>(dstAsm->getOffset(), _loopAlignment);
+          if (padding <= _loopMaxPadding)
+            err = dst->align(kAlignCode, _loopAlignment);
+        }
+      }
+      if (ASMJIT_UNLIKELY(err)) break;
+    }
+
     dst->setInlineComment(node_->getInlineComment());
 
     switch (node_->getType()) {
@@ -530,7 +839,32 @@ Error CodeBuilder::serialize(CodeEmitter* dst) {
 
       case CBNode::kNodeLabelData: {
         CBLabelData* node = static_cast<CBLabelData*>(node_);
-        err = dst->embedLabel(node->getLabel());
+        if (node->hasBase())
+          err = dst->embedLabelDelta(node->getLabel(), node->getBase(), node->getSize());
+        else
+          err = dst->embedLabel(node->getLabel());
+        break;
+      }
+
+      case CBNode::kNodeJumpTable: {
+        CBJumpTable* node = static_cast<CBJumpTable*>(node_);
+        Label base = node->getLabel();
+
+        err = dst->align(kAlignData, 4);
+        if (!err) err = dst->bind(base);
+
+        for (uint32_t i = 0, count = node->getCount(); i < count && !err; i++) {
+          // Use the last operand of the edge as it's the label that passes
+          // can redirect (the target of the edge node may be different).
+          CBJump* edge = node->getEdge(i);
+          if (ASMJIT_UNLIKELY(!edge || !edge->getOpCount())) {
+            err = DebugUtils::errored(kErrorInvalidState);
+            break;
+          }
+
+          const Operand& target = edge->getOpArray()[edge->getOpCount() - 1];
+          err = dst->embedLabelDelta(static_cast<const Label&>(target), base, 4);
+        }
         break;
       }
 
@@ -542,6 +876,10 @@ Error CodeBuilder::serialize(CodeEmitter* dst) {
 
       case CBNode::kNodeInst:
       case CBNode::kNodeFuncCall: {
+        // Edges only describe control flow of an indirect jump.
+        if (node_->hasFlag(CBNode::kFlagIsEdge))
+          break;
+
         CBInst* node = node_->as<CBInst>();
         dst->setOptions(node->getOptions());
         dst->setExtraReg(node->getExtraReg());
@@ -572,9 +910,40 @@ Error CodeBuilder::serialize(CodeEmitter* dst) {
 
 CBPass::CBPass(const char* name) noexcept
   : _cb(nullptr),
-    _name(name) {}
+    _name(name),
+    _enabled(true),
+    _afterCount(0),
+    _beforeCount(0) { _stats.reset(); }
 CBPass::~CBPass() noexcept {}
 
+Error CBPass::runAfter(const char* name) noexcept {
+  if (ASMJIT_UNLIKELY(_afterCount >= kMaxDependencies))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  _after[_afterCount++] = name;
+  return kErrorOk;
+}
+
+Error CBPass::runBefore(const char* name) noexcept {
+  if (ASMJIT_UNLIKELY(_beforeCount >= kMaxDependencies))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  _before[_beforeCount++] = name;
+  return kErrorOk;
+}
+
+bool CBPass::mustRunBefore(const CBPass* other) const noexcept {
+  for (uint32_t i = 0; i < _beforeCount; i++)
+    if (::strcmp(_before[i], other->_name) == 0)
+      return true;
+
+  for (uint32_t i = 0; i < other->_afterCount; i++)
+    if (::strcmp(other->_after[i], _name) == 0)
+      return true;
+
+  return false;
+}
+
 } // asmjit namespace
 
 // [Api-End]
@@ -33,11 +33,13 @@ class CBNode;
 class CBPass;
 
 class CBAlign;
+class CBCfg;
 class CBComment;
 class CBConstPool;
 class CBData;
 class CBInst;
 class CBJump;
+class CBJumpTable;
 class CBLabel;
 class CBLabelData;
 class CBSentinel;
@@ -45,6 +47,73 @@ class CBSentinel;
 //! \addtogroup asmjit_base
 //! \{
 
+// ============================================================================
+// [asmjit::CBPassStats]
+// ============================================================================
+
+//! Statistics of a \ref CBPass.
+//!
+//! Time, zone size, and node counts are only collected when pass statistics
+//! are enabled by \ref CodeBuilder::setPassStatsEnabled(), counts of inserted
+//! spills and moves are maintained by passes that insert them (the register
+//! allocator) all the time.
+struct CBPassStats {
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_INLINE void reset() noexcept { ::memset(this, 0, sizeof(*this)); }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get wall time spent in the pass, in nanoseconds.
+  ASMJIT_INLINE uint64_t getTime() const noexcept { return _time; }
+  //! Get count of bytes allocated from the zone passed to `CBPass::process()`.
+  ASMJIT_INLINE size_t getZoneSize() const noexcept { return _zoneSize; }
+  //! Get count of runs of the pass (or count of processed functions).
+  ASMJIT_INLINE uint32_t getRunCount() const noexcept { return _runCount; }
+  //! Get count of nodes before the pass ran.
+  ASMJIT_INLINE uint32_t getNodesIn() const noexcept { return _nodesIn; }
+  //! Get count of nodes after the pass ran.
+  ASMJIT_INLINE uint32_t getNodesOut() const noexcept { return _nodesOut; }
+  //! Get count of inserted spill loads and stores.
+  ASMJIT_INLINE uint32_t getSpillCount() const noexcept { return _spillCount; }
+  //! Get count of inserted register moves (and swaps).
+  ASMJIT_INLINE uint32_t getMoveCount() const noexcept { return _moveCount; }
+
+  //! Add all statistics of `other` to this one.
+  ASMJIT_INLINE void add(const CBPassStats& other) noexcept {
+    _time += other._time;
+    _zoneSize += other._zoneSize;
+    _runCount += other._runCount;
+    _nodesIn += other._nodesIn;
+    _nodesOut += other._nodesOut;
+    _spillCount += other._spillCount;
+    _moveCount += other._moveCount;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint64_t _time;                        //!< Wall time in nanoseconds.
+  size_t _zoneSize;                      //!< Bytes allocated from the pass zone.
+  uint32_t _runCount;                    //!< Count of runs.
+  uint32_t _nodesIn;                     //!< Count of nodes before the pass.
+  uint32_t _nodesOut;                    //!< Count of nodes after the pass.
+  uint32_t _spillCount;                  //!< Count of inserted spill loads and stores.
+  uint32_t _moveCount;                   //!< Count of inserted register moves.
+};
+
+//! Statistics of a single run of a \ref CBPass (or of a single function).
+struct CBPassRecord {
+  CBPass* pass;                          //!< Pass.
+  CBNode* func;                          //!< Function node (or null if the record covers all code).
+  CBPassStats stats;                     //!< Statistics.
+};
+
 // ============================================================================
 // [asmjit::CodeBuilder]
 // ============================================================================
@@ -88,6 +157,33 @@ public:
   //! Get the last node.
   ASMJIT_INLINE CBNode* getLastNode() const noexcept { return _lastNode; }
 
+  // --------------------------------------------------------------------------
+  // [Code Alignment]
+  // --------------------------------------------------------------------------
+
+  //! Get alignment of function entries applied by `serialize()` (0 if disabled).
+  ASMJIT_INLINE uint32_t getFuncAlignment() const noexcept { return _funcAlignment; }
+  //! Get alignment of loop headers applied by `serialize()` (0 if disabled).
+  ASMJIT_INLINE uint32_t getLoopAlignment() const noexcept { return _loopAlignment; }
+  //! Get the maximum number of padding bytes that can be used to align a loop header.
+  ASMJIT_INLINE uint32_t getLoopMaxPadding() const noexcept { return _loopMaxPadding; }
+
+  //! Align each function entry (`kNodeFunc`) to `alignment` bytes when the
+  //! code is serialized. Pass zero to disable the function alignment.
+  ASMJIT_API Error setFuncAlignment(uint32_t alignment) noexcept;
+
+  //! Align each loop header to `alignment` bytes when the code is serialized.
+  //!
+  //! A loop header is the first label of a basic block that is a target of a
+  //! back-edge in the control-flow graph, see \ref CBCfg. Alignment
+  //! is only performed if it requires at most `maxPadding` bytes of padding,
+  //! otherwise the label is left as is - the padding would be executed each
+  //! time the loop is entered, so it's not worth it if it's too long. The
+  //! padding is emitted by `align(kAlignCode, ...)`, which uses multi-byte NOPs
+  //! if `CodeEmitter::kHintOptimizedAlign` is enabled. Pass zero `alignment`
+  //! to disable the loop alignment.
+  ASMJIT_API Error setLoopAlignment(uint32_t alignment, uint32_t maxPadding) noexcept;
+
   // --------------------------------------------------------------------------
   // [Node-Management]
   // --------------------------------------------------------------------------
@@ -122,6 +218,11 @@ public:
   ASMJIT_API CBData* newDataNode(const void* data, uint32_t size) noexcept;
   //! Create a new \ref CBConstPool node.
   ASMJIT_API CBConstPool* newConstPool() noexcept;
+  //! Create a new \ref CBJumpTable node having `count` entries.
+  //!
+  //! The entries are initially null and must be filled by edges (jumps that
+  //! have \ref CBNode::kFlagIsEdge set) before the node is serialized.
+  ASMJIT_API CBJumpTable* newJumpTableNode(uint32_t count) noexcept;
   //! Create a new \ref CBComment node.
   ASMJIT_API CBComment* newCommentNode(const char* s, size_t len) noexcept;
 
@@ -135,6 +236,7 @@ public:
   ASMJIT_API virtual Error align(uint32_t mode, uint32_t alignment) override;
   ASMJIT_API virtual Error embed(const void* data, uint32_t size) override;
   ASMJIT_API virtual Error embedLabel(const Label& label) override;
+  ASMJIT_API virtual Error embedLabelDelta(const Label& label, const Label& base, uint32_t size) override;
   ASMJIT_API virtual Error embedConstPool(const Label& label, const ConstPool& pool) override;
   ASMJIT_API virtual Error comment(const char* s, size_t len = Globals::kInvalidIndex) override;
 
@@ -163,6 +265,19 @@ public:
   //! Set the current node to `node` and return the previous one.
   ASMJIT_API CBNode* setCursor(CBNode* node) noexcept;
 
+  // --------------------------------------------------------------------------
+  // [Control-Flow Graph]
+  // --------------------------------------------------------------------------
+
+  //! Get the control-flow graph of all nodes, see \ref CBCfg.
+  //!
+  //! The graph is cached and built again only if a node was added or removed
+  //! since it was built, a previously returned graph is invalid after that.
+  //! Passes that change targets of existing jumps must call `invalidateCfg()`.
+  ASMJIT_API Error getCfg(CBCfg** pOut) noexcept;
+  //! Invalidate the cached control-flow graph.
+  ASMJIT_INLINE void invalidateCfg() noexcept { _cfg = nullptr; }
+
   // --------------------------------------------------------------------------
   // [Passes]
   // --------------------------------------------------------------------------
@@ -185,9 +300,72 @@ public:
   ASMJIT_API CBPass* getPassByName(const char* name) const noexcept;
   //! Add `pass` to the list of passes.
   ASMJIT_API Error addPass(CBPass* pass) noexcept;
+  //! Insert `pass` at `index` of the list of passes.
+  //!
+  //! Passes run in the order they are in the list. \ref CodeCompiler adds its
+  //! register allocator when attached, use `insertPass(0, pass)` to run a pass
+  //! before it (on virtual registers).
+  ASMJIT_API Error insertPass(size_t index, CBPass* pass) noexcept;
   //! Remove `pass` from the list of passes and delete it.
   ASMJIT_API Error deletePass(CBPass* pass) noexcept;
 
+  //! Enable or disable a pass of the given `name`.
+  //!
+  //! A disabled pass stays in the list of passes, but it's not run by
+  //! `runPasses()`. Returns `kErrorInvalidArgument` if there is no such pass.
+  ASMJIT_API Error setPassEnabled(const char* name, bool enabled) noexcept;
+
+  //! Enable and disable passes by names listed in `options`.
+  //!
+  //! The `options` is a list of pass names separated by commas or spaces, each
+  //! name can be prefixed by `+` (the default) to enable the pass or by `-` to
+  //! disable it. A pass that is enabled, but not in the list of passes yet, is
+  //! created by `_newPassByName()` and added, for example "X86Cse,X86Licm" adds
+  //! these passes to \ref X86Compiler and "-X86Peephole" disables a peephole
+  //! optimizer that was added before. The position of an added pass is given
+  //! by its dependencies, see \ref CBPass::runAfter(). Returns
+  //! `kErrorInvalidArgument` if a name is not known.
+  ASMJIT_API Error setPassOptions(const char* options) noexcept;
+
+  //! Create a pass of the given `name` (only used by `setPassOptions()`).
+  //!
+  //! Returns null if the builder doesn't know such pass or if the allocation
+  //! failed. Builders that provide passes override this function.
+  ASMJIT_API virtual CBPass* _newPassByName(const char* name) noexcept;
+
+  //! Run all enabled passes (called by `finalize()`).
+  //!
+  //! Passes run in the order they are in the list of passes, unless their
+  //! dependencies require otherwise - a pass runs after all enabled passes it
+  //! must run after and before all enabled passes it must run before. Returns
+  //! `kErrorInvalidState` if the dependencies are cyclic.
+  ASMJIT_API Error runPasses() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Pass Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the time, zone size, and node counts of passes are collected.
+  ASMJIT_INLINE bool isPassStatsEnabled() const noexcept { return _passStatsEnabled; }
+  //! Enable or disable collecting of pass statistics, see \ref CBPassStats.
+  //!
+  //! When enabled, each pass accumulates its statistics (see `CBPass::getStats()`)
+  //! and each run of a pass is recorded (see `getPassRecords()`), passes that
+  //! process functions one by one (the register allocator) also record each
+  //! function.
+  ASMJIT_INLINE void setPassStatsEnabled(bool enabled) noexcept { _passStatsEnabled = enabled; }
+
+  //! Get records of pass runs collected since the last `resetPassStats()`.
+  ASMJIT_INLINE const ZoneVector<CBPassRecord>& getPassRecords() const noexcept { return _cbPassRecords; }
+  //! Add a record of a pass run, used by passes that record each function.
+  ASMJIT_API Error addPassRecord(CBPass* pass, CBNode* func, const CBPassStats& stats) noexcept;
+  //! Reset statistics of all passes and remove all records.
+  ASMJIT_API void resetPassStats() noexcept;
+
+  //! Get count of nodes from `first` to `last` (inclusive), or to the end if
+  //! `last` is null.
+  static ASMJIT_API uint32_t countNodes(const CBNode* first, const CBNode* last = nullptr) noexcept;
+
   // --------------------------------------------------------------------------
   // [Serialization]
   // --------------------------------------------------------------------------
@@ -201,17 +379,26 @@ public:
   Zone _cbBaseZone;                      //!< Base zone used to allocate nodes and `CBPass`.
   Zone _cbDataZone;                      //!< Data zone used to allocate data and names.
   Zone _cbPassZone;                      //!< Zone passed to `CBPass::process()`.
+  Zone _cbCfgZone;                       //!< Zone used by the cached control-flow graph.
   ZoneHeap _cbHeap;                      //!< ZoneHeap that uses `_cbBaseZone`.
+  ZoneHeap _cbCfgHeap;                   //!< ZoneHeap that uses `_cbCfgZone`.
 
   ZoneVector<CBPass*> _cbPasses;         //!< Array of `CBPass` objects.
+  ZoneVector<CBPassRecord> _cbPassRecords; //!< Records of pass runs (if statistics are enabled).
   ZoneVector<CBLabel*> _cbLabels;        //!< Maps label indexes to `CBLabel` nodes.
 
   CBNode* _firstNode;                    //!< First node of the current section.
   CBNode* _lastNode;                     //!< Last node of the current section.
   CBNode* _cursor;                       //!< Current node (cursor).
+  CBCfg* _cfg;                           //!< Cached control-flow graph (or null).
 
   uint32_t _position;                    //!< Flow-id assigned to each new node.
   uint32_t _nodeFlags;                   //!< Flags assigned to each new node.
+
+  uint32_t _funcAlignment;               //!< Alignment of function entries (0 if disabled).
+  uint32_t _loopAlignment;               //!< Alignment of loop headers (0 if disabled).
+  uint32_t _loopMaxPadding;              //!< Maximum padding used to align a loop header.
+  bool _passStatsEnabled;                //!< Collect statistics of passes.
 };
 
 // ============================================================================
@@ -250,12 +437,44 @@ public:
   ASMJIT_INLINE const CodeBuilder* cb() const noexcept { return _cb; }
   ASMJIT_INLINE const char* getName() const noexcept { return _name; }
 
+  //! Get whether the pass is run by \ref CodeBuilder::runPasses().
+  ASMJIT_INLINE bool isEnabled() const noexcept { return _enabled; }
+  //! Enable or disable the pass.
+  ASMJIT_INLINE void setEnabled(bool enabled) noexcept { _enabled = enabled; }
+
+  //! Get statistics accumulated over all runs, see \ref CBPassStats.
+  ASMJIT_INLINE const CBPassStats& getStats() const noexcept { return _stats; }
+
+  // --------------------------------------------------------------------------
+  // [Dependencies]
+  // --------------------------------------------------------------------------
+
+  //! Maximum count of dependencies of a single pass.
+  ASMJIT_ENUM(Limits) {
+    kMaxDependencies = 4
+  };
+
+  //! Run this pass after the pass named `name` (if it's added and enabled).
+  ASMJIT_API Error runAfter(const char* name) noexcept;
+  //! Run this pass before the pass named `name` (if it's added and enabled).
+  ASMJIT_API Error runBefore(const char* name) noexcept;
+
+  //! Get whether this pass must run before `other` because of dependencies of
+  //! any of them.
+  ASMJIT_API bool mustRunBefore(const CBPass* other) const noexcept;
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
   CodeBuilder* _cb;                      //!< CodeBuilder this pass is assigned to.
   const char* _name;                     //!< Name of the pass.
+  bool _enabled;                         //!< Pass is run by `CodeBuilder::runPasses()`.
+  uint8_t _afterCount;                   //!< Count of passes this pass runs after.
+  uint8_t _beforeCount;                  //!< Count of passes this pass runs before.
+  const char* _after[kMaxDependencies];  //!< Names of passes this pass runs after.
+  const char* _before[kMaxDependencies]; //!< Names of passes this pass runs before.
+  CBPassStats _stats;                    //!< Accumulated statistics.
 };
 
 // ============================================================================
@@ -290,6 +509,7 @@ public:
     kNodeConstPool  = 6,                 //!< Node is \ref CBConstPool.
     kNodeComment    = 7,                 //!< Node is \ref CBComment.
     kNodeSentinel   = 8,                 //!< Node is \ref CBSentinel.
+    kNodeJumpTable  = 9,                 //!< Node is \ref CBJumpTable.
 
     // [CodeCompiler]
     kNodeFunc       = 16,                //!< Node is \ref CCFunc (considered as \ref CBLabel by \ref CodeBuilder).
@@ -325,14 +545,21 @@ public:
 
     //! If the `CBNode` will return from a function.
     //!
-    //! This flag is used by both `CBSentinel` and `CCFuncRet`.
+    //! This flag is used by `CBSentinel`, `CCFuncRet`, and by `ret` emitted
+    //! by `X86Builder`.
     kFlagIsRet = 0x0080,
 
     //! Whether the instruction is special.
     kFlagIsSpecial = 0x0100,
 
     //! Whether the instruction is an FPU instruction.
-    kFlagIsFp = 0x0200
+    kFlagIsFp = 0x0200,
+
+    //! If the `CBJump` is an edge of a jump table.
+    //!
+    //! Edges describe the control flow of an indirect jump to passes that
+    //! analyze it, they are never serialized.
+    kFlagIsEdge = 0x0400
   };
 
   // --------------------------------------------------------------------------
@@ -789,9 +1016,11 @@ public:
   // --------------------------------------------------------------------------
 
   //! Create a new `CBLabelData` instance.
-  ASMJIT_INLINE CBLabelData(CodeBuilder* cb, uint32_t id = kInvalidValue) noexcept
+  ASMJIT_INLINE CBLabelData(CodeBuilder* cb, uint32_t id = kInvalidValue, uint32_t baseId = kInvalidValue, uint32_t size = 0) noexcept
     : CBNode(cb, kNodeLabelData),
-      _id(id) {}
+      _id(id),
+      _baseId(baseId),
+      _size(size) {}
 
   //! Destroy the `CBLabelData` instance (NEVER CALLED).
   ASMJIT_INLINE ~CBLabelData() noexcept {}
@@ -805,11 +1034,22 @@ public:
   //! Get the label as `Label` operand.
   ASMJIT_INLINE Label getLabel() const noexcept { return Label(_id); }
 
+  //! Get whether the data is a difference between the label and a base label.
+  ASMJIT_INLINE bool hasBase() const noexcept { return _baseId != kInvalidValue; }
+  //! Get the base label id (or `kInvalidValue`).
+  ASMJIT_INLINE uint32_t getBaseId() const noexcept { return _baseId; }
+  //! Get the base label as `Label` operand.
+  ASMJIT_INLINE Label getBase() const noexcept { return Label(_baseId); }
+  //! Get the size of the difference in bytes (only valid if it has a base).
+  ASMJIT_INLINE uint32_t getSize() const noexcept { return _size; }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
-  uint32_t _id;
+  uint32_t _id;                          //!< Label id.
+  uint32_t _baseId;                      //!< Base label id (label difference).
+  uint32_t _size;                        //!< Size of the label difference.
 };
 
 // ============================================================================
@@ -858,6 +1098,61 @@ public:
   ConstPool _constPool;
 };
 
+// ============================================================================
+// [asmjit::CBJumpTable]
+// ============================================================================
+
+//! Jump table (CodeBuilder).
+//!
+//! Table of 32-bit entries, each entry is a difference between the target of
+//! an edge and the table itself, so the table doesn't need relocations and can
+//! be used by position-independent code. The node is a label as well, which
+//! is bound to the first entry.
+class CBJumpTable : public CBLabel {
+public:
+  ASMJIT_NONCOPYABLE(CBJumpTable)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `CBJumpTable` instance.
+  ASMJIT_INLINE CBJumpTable(CodeBuilder* cb, CBJump** edges, uint32_t count) noexcept
+    : CBLabel(cb, kInvalidValue),
+      _edges(edges),
+      _count(count) { _type = kNodeJumpTable; }
+
+  //! Destroy the `CBJumpTable` instance (NEVER CALLED).
+  ASMJIT_INLINE ~CBJumpTable() noexcept {}
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get the number of entries.
+  ASMJIT_INLINE uint32_t getCount() const noexcept { return _count; }
+  //! Get the size of the table in bytes.
+  ASMJIT_INLINE uint32_t getSize() const noexcept { return _count * 4; }
+
+  //! Get the edge of the entry `i`.
+  ASMJIT_INLINE CBJump* getEdge(uint32_t i) const noexcept {
+    ASMJIT_ASSERT(i < _count);
+    return _edges[i];
+  }
+  //! Set the edge of the entry `i`.
+  ASMJIT_INLINE void setEdge(uint32_t i, CBJump* edge) noexcept {
+    ASMJIT_ASSERT(i < _count);
+    _edges[i] = edge;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  CBJump** _edges;                       //!< Edges, one per entry.
+  uint32_t _count;                       //!< Number of entries.
+};
+
 // ============================================================================
 // [asmjit::CBComment]
 // ============================================================================
@@ -0,0 +1,735 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Dependencies]
+#include "../base/binwriter_p.h"
+#include "../base/codecache.h"
+#include "../base/utils.h"
+#include <stdio.h>
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86)
+#include "../x86/x86assembler.h"
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::CodeCache - Format]
+// ============================================================================
+
+// The blob starts with a header, which is followed by a payload protected by
+// a checksum. All values are stored in little endian:
+//
+//   Header   - u32 magic, u32 version, u64 key, u64 checksum, u64 payloadSize.
+//   CodeInfo - u8 archType, u8 archSubType, u8 stackAlignment, u8 cdeclCallConv,
+//              u8 stdCallConv, u8 fastCallConv, u16 flags.
+//   Features - u32[4] bits of required CPU features.
+//   Counts   - u32 sections, u32 labels, u32 relocations, u32 imports.
+//   Sections - u32 flags, u32 alignment, u32 virtualSize, u32 physicalSize,
+//              u32 nameLength, name, data.
+//   Labels   - u32 type, u32 parentId, u32 sectionId, u64 offset,
+//              u32 nameLength, name.
+//   Relocs   - u32 type, u32 size, u32 sourceSectionId, u32 targetSectionId,
+//              u64 sourceOffset, u64 data.
+//   Imports  - u32 labelId, u32 sectionId, u64 offset, u64 rel.
+
+//! \internal
+ASMJIT_ENUM(CodeCacheConstants) {
+  kCodeCacheHeaderSize  = 32,
+  kCodeCacheFeatureWords = CpuFeatures::kMaxFeatures / 32,
+  kCodeCacheStubSize    = 14             // `jmp [rip]` followed by `dq address`.
+};
+
+// ============================================================================
+// [asmjit::CodeCacheResolver - Construction / Destruction]
+// ============================================================================
+
+CodeCacheResolver::CodeCacheResolver() noexcept {}
+CodeCacheResolver::~CodeCacheResolver() noexcept {}
+
+// ============================================================================
+// [asmjit::CodeCache - Hash]
+// ============================================================================
+
+uint64_t CodeCache::hash(const void* data, size_t size, uint64_t seed) noexcept {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  uint64_t h = seed;
+
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * ASMJIT_UINT64_C(0x100000001B3);
+
+  return h;
+}
+
+// ============================================================================
+// [asmjit::CodeCache - Save]
+// ============================================================================
+
+static Error CodeCache_appendName(StringBuilder& sb, const char* name, size_t nameLength) noexcept {
+  ASMJIT_PROPAGATE(BinWriter::appendLE(sb, nameLength, 4));
+  return sb.appendString(name, nameLength);
+}
+
+//! \internal
+//!
+//! Get whether the label `le` can be imported (global, named, and not bound).
+static ASMJIT_INLINE bool CodeCache_isImport(const LabelEntry* le) noexcept {
+  return !le->isBound() && le->hasName() && le->getType() == Label::kTypeGlobal;
+}
+
+static Error CodeCache_saveInternal(StringBuilder& dst, CodeHolder* code, uint64_t key, const CpuFeatures& features) noexcept {
+  const CodeInfo& codeInfo = code->getCodeInfo();
+  const ZoneVector<SectionEntry*>& sections = code->getSections();
+  const ZoneVector<RelocEntry*>& relocations = code->getRelocEntries();
+
+  size_t i;
+  size_t numLabels = code->getLabelsCount();
+  uint32_t numRelocs = 0;
+  uint32_t numImports = 0;
+
+  // Relocations to absolute addresses are only valid in the current process.
+  for (i = 0; i < relocations.getLength(); i++) {
+    const RelocEntry* re = relocations[i];
+    switch (re->getType()) {
+      case RelocEntry::kTypeNone:
+        continue;
+
+      case RelocEntry::kTypeRelToAbs:
+        break;
+
+      case RelocEntry::kTypeAbsToRel:
+        if (re->getTargetSectionId() != SectionEntry::kInvalidId)
+          break;
+        ASMJIT_FALLTHROUGH;
+
+      default:
+        return DebugUtils::errored(kErrorInvalidRelocEntry);
+    }
+    numRelocs++;
+  }
+
+  // Only rel32 references to global named labels can be imported, all other
+  // labels must be bound.
+  for (i = 0; i < numLabels; i++) {
+    const LabelEntry* le = code->getLabelEntryAt(i);
+    if (le->isBound())
+      continue;
+
+    for (const LabelLink* link = le->_links; link; link = link->prev) {
+      if (ASMJIT_UNLIKELY(!CodeCache_isImport(le) || link->relocId != RelocEntry::kInvalidId))
+        return DebugUtils::errored(kErrorInvalidLabel);
+
+      const SectionEntry* section = code->getSectionById(link->sectionId);
+      if (ASMJIT_UNLIKELY(!section || link->offset + 4 > section->getPhysicalSize() ||
+                          section->getBuffer().getData()[link->offset] != 4))
+        return DebugUtils::errored(kErrorInvalidDisplacement);
+
+      numImports++;
+    }
+  }
+
+  StringBuilder payload;
+
+  // CodeInfo.
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getArchType(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getArchSubType(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getStackAlignment(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getCdeclCallConv(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getStdCallConv(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getFastCallConv(), 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, codeInfo.getFlags(), 2));
+
+  // Required CPU features.
+  for (i = 0; i < kCodeCacheFeatureWords; i++) {
+    uint32_t bits = 0;
+    for (uint32_t bit = 0; bit < 32; bit++)
+      if (features.has(static_cast<uint32_t>(i) * 32 + bit))
+        bits |= 1U << bit;
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, bits, 4));
+  }
+
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, sections.getLength(), 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, numLabels, 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, numRelocs, 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(payload, numImports, 4));
+
+  for (i = 0; i < sections.getLength(); i++) {
+    const SectionEntry* section = sections[i];
+    const CodeBuffer& buffer = section->getBuffer();
+
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, section->getFlags(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, section->getAlignment(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, section->getVirtualSize(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, buffer.getLength(), 4));
+    ASMJIT_PROPAGATE(CodeCache_appendName(payload, section->getName(), ::strlen(section->getName())));
+    ASMJIT_PROPAGATE(payload.appendString(reinterpret_cast<const char*>(buffer.getData()), buffer.getLength()));
+  }
+
+  for (i = 0; i < numLabels; i++) {
+    const LabelEntry* le = code->getLabelEntryAt(i);
+
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, le->getType(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, le->getParentId(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, le->getSectionId(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, static_cast<uint64_t>(static_cast<int64_t>(le->getOffset())), 8));
+    ASMJIT_PROPAGATE(CodeCache_appendName(payload, le->getName(), le->getNameLength()));
+  }
+
+  for (i = 0; i < relocations.getLength(); i++) {
+    const RelocEntry* re = relocations[i];
+    if (re->getType() == RelocEntry::kTypeNone)
+      continue;
+
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getType(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getSize(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getSourceSectionId(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getTargetSectionId(), 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getSourceOffset(), 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(payload, re->getData(), 8));
+  }
+
+  for (i = 0; i < numLabels; i++) {
+    const LabelEntry* le = code->getLabelEntryAt(i);
+    if (le->isBound())
+      continue;
+
+    for (const LabelLink* link = le->_links; link; link = link->prev) {
+      ASMJIT_PROPAGATE(BinWriter::appendLE(payload, le->getId(), 4));
+      ASMJIT_PROPAGATE(BinWriter::appendLE(payload, link->sectionId, 4));
+      ASMJIT_PROPAGATE(BinWriter::appendLE(payload, link->offset, 8));
+      ASMJIT_PROPAGATE(BinWriter::appendLE(payload, static_cast<uint64_t>(static_cast<int64_t>(link->rel)), 8));
+    }
+  }
+
+  dst.clear();
+  ASMJIT_PROPAGATE(dst.reserve(kCodeCacheHeaderSize + payload.getLength()));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(dst, CodeCache::kMagic, 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(dst, CodeCache::kVersion, 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(dst, key, 8));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(dst, CodeCache::hash(payload.getData(), payload.getLength()), 8));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(dst, payload.getLength(), 8));
+  return dst.appendString(payload.getData(), payload.getLength());
+}
+
+Error CodeCache::save(StringBuilder& dst, CodeHolder* code, uint64_t key, const CpuFeatures& features) noexcept {
+  if (ASMJIT_UNLIKELY(!code->isInitialized()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  code->sync();
+  return CodeCache_saveInternal(dst, code, key, features);
+}
+
+Error CodeCache::saveFile(const char* fileName, CodeHolder* code, uint64_t key, const CpuFeatures& features) noexcept {
+  StringBuilder sb;
+  ASMJIT_PROPAGATE(save(sb, code, key, features));
+
+  return BinWriter::writeFile(fileName, sb);
+}
+
+// ============================================================================
+// [asmjit::CodeCache - Load]
+// ============================================================================
+
+//! \internal
+//!
+//! Bounds-checked reader of a blob, once it runs out of data all reads return
+//! zero and `isValid()` returns false.
+class CodeCacheReader {
+public:
+  ASMJIT_INLINE CodeCacheReader(const uint8_t* data, size_t size) noexcept
+    : _ptr(data),
+      _end(data + size),
+      _valid(true) {}
+
+  ASMJIT_INLINE bool isValid() const noexcept { return _valid; }
+
+  ASMJIT_INLINE const uint8_t* readData(size_t size) noexcept {
+    if (ASMJIT_UNLIKELY(!_valid || size > (size_t)(_end - _ptr))) {
+      _valid = false;
+      return nullptr;
+    }
+
+    const uint8_t* p = _ptr;
+    _ptr += size;
+    return p;
+  }
+
+  ASMJIT_INLINE uint32_t readU8() noexcept {
+    const uint8_t* p = readData(1);
+    return p ? uint32_t(p[0]) : uint32_t(0);
+  }
+
+  ASMJIT_INLINE uint32_t readU16() noexcept {
+    const uint8_t* p = readData(2);
+    return p ? Utils::readU16uLE(p) : uint32_t(0);
+  }
+
+  ASMJIT_INLINE uint32_t readU32() noexcept {
+    const uint8_t* p = readData(4);
+    return p ? Utils::readU32uLE(p) : uint32_t(0);
+  }
+
+  ASMJIT_INLINE uint64_t readU64() noexcept {
+    const uint8_t* p = readData(8);
+    return p ? Utils::readU64uLE(p) : uint64_t(0);
+  }
+
+  const uint8_t* _ptr;
+  const uint8_t* _end;
+  bool _valid;
+};
+
+//! \internal
+//!
+//! Get whether the rel32 field at `offset` of `section` is the displacement of
+//! a `call`, `jmp`, or `jcc` instruction, which can be redirected to a stub.
+static ASMJIT_INLINE bool CodeCache_isBranchField(const SectionEntry* section, uint64_t offset, int64_t rel) noexcept {
+  const uint8_t* data = section->getBuffer().getData();
+  size_t length = section->getPhysicalSize();
+
+  if (rel != -4 || offset < 2 || offset + 4 > length)
+    return false;
+
+  // RIP-relative memory operands are preceded by a ModR/M byte (mod == 00 and
+  // rm == 101), which never collides with these opcodes.
+  uint32_t op0 = data[offset - 2];
+  uint32_t op1 = data[offset - 1];
+  return op1 == 0xE8 || op1 == 0xE9 || (op0 == 0x0F && (op1 & 0xF0) == 0x80);
+}
+
+//! \internal
+//!
+//! Get the offset of a `jmp [rip]` stub jumping to `address`, the stub is
+//! appended to `section` if there is no such stub after `stubsStart` yet.
+static Error CodeCache_addStub(CodeHolder* code, SectionEntry* section, size_t stubsStart, uint64_t address, size_t& stubOffset) noexcept {
+  CodeBuffer& buffer = section->getBuffer();
+  size_t end = buffer.getLength();
+
+  // Stubs are shared by all branches to the same import.
+  for (stubOffset = stubsStart; stubOffset < end; stubOffset += kCodeCacheStubSize)
+    if (Utils::readU64u(buffer.getData() + stubOffset + 6) == address)
+      return kErrorOk;
+
+  ASMJIT_PROPAGATE(code->growBuffer(&buffer, kCodeCacheStubSize));
+  uint8_t* p = buffer._data + end;
+
+  p[0] = 0xFF;                           // JMP [RIP + 0].
+  p[1] = 0x25;
+  Utils::writeU32u(p + 2, 0);
+  Utils::writeU64u(p + 6, address);
+
+  buffer._length = end + kCodeCacheStubSize;
+  stubOffset = end;
+  return kErrorOk;
+}
+
+static Error CodeCache_loadInternal(CodeHolder* code, CodeCacheReader& reader, CodeCacheResolver* resolver) noexcept {
+  uint32_t i;
+
+  // CodeInfo.
+  CodeInfo codeInfo;
+  uint32_t archType = reader.readU8();
+  uint32_t archSubType = reader.readU8();
+
+  codeInfo.init(archType, archSubType);
+  codeInfo.setStackAlignment(static_cast<uint8_t>(reader.readU8()));
+  codeInfo.setCdeclCallConv(reader.readU8());
+  codeInfo.setStdCallConv(reader.readU8());
+  codeInfo.setFastCallConv(reader.readU8());
+  codeInfo.addFlags(reader.readU16());
+
+  if (ASMJIT_UNLIKELY(!reader.isValid() || codeInfo.getArchType() != archType || archType == ArchInfo::kTypeNone))
+    return DebugUtils::errored(kErrorInvalidArch);
+
+  // Required CPU features, all of them must be provided by the host.
+  CpuFeatures features;
+  for (i = 0; i < kCodeCacheFeatureWords; i++) {
+    uint32_t bits = reader.readU32();
+    for (uint32_t bit = 0; bit < 32; bit++)
+      if (bits & (1U << bit))
+        features.add(i * 32 + bit);
+  }
+
+  if (ASMJIT_UNLIKELY(!CpuInfo::getHost().getFeatures().hasAll(features)))
+    return DebugUtils::errored(kErrorFeatureNotEnabled);
+
+  uint32_t numSections = reader.readU32();
+  uint32_t numLabels = reader.readU32();
+  uint32_t numRelocs = reader.readU32();
+  uint32_t numImports = reader.readU32();
+
+  if (ASMJIT_UNLIKELY(!reader.isValid() || numSections == 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_PROPAGATE(code->init(codeInfo));
+
+  for (i = 0; i < numSections; i++) {
+    uint32_t flags = reader.readU32();
+    uint32_t alignment = reader.readU32();
+    uint32_t virtualSize = reader.readU32();
+    uint32_t physicalSize = reader.readU32();
+    uint32_t nameLength = reader.readU32();
+
+    const char* name = reinterpret_cast<const char*>(reader.readData(nameLength));
+    const uint8_t* data = reader.readData(physicalSize);
+
+    if (ASMJIT_UNLIKELY(!reader.isValid()))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    // The first section always exists, it's created by `CodeHolder::init()`.
+    SectionEntry* section;
+    if (i == 0) {
+      section = code->getSectionEntry(0);
+      if (ASMJIT_UNLIKELY(alignment && !Utils::isPowerOf2(alignment)))
+        return DebugUtils::errored(kErrorInvalidArgument);
+
+      section->clearFlags(section->getFlags());
+      section->addFlags(flags);
+      section->setAlignment(alignment);
+    }
+    else {
+      ASMJIT_PROPAGATE(code->newSection(&section, name, nameLength, flags, alignment));
+    }
+
+    section->setVirtualSize(virtualSize);
+    if (physicalSize) {
+      CodeBuffer& buffer = section->getBuffer();
+      ASMJIT_PROPAGATE(code->reserveBuffer(&buffer, physicalSize));
+
+      ::memcpy(buffer._data, data, physicalSize);
+      buffer._length = physicalSize;
+    }
+  }
+
+  for (i = 0; i < numLabels; i++) {
+    uint32_t type = reader.readU32();
+    uint32_t parentId = reader.readU32();
+    uint32_t sectionId = reader.readU32();
+    intptr_t offset = static_cast<intptr_t>(static_cast<int64_t>(reader.readU64()));
+    uint32_t nameLength = reader.readU32();
+    const char* name = reinterpret_cast<const char*>(reader.readData(nameLength));
+
+    if (ASMJIT_UNLIKELY(!reader.isValid()))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    // Labels are restored in order, so they get the same ids they had.
+    uint32_t id;
+    if (nameLength)
+      ASMJIT_PROPAGATE(code->newNamedLabelId(id, name, nameLength, type, parentId));
+    else
+      ASMJIT_PROPAGATE(code->newLabelId(id));
+
+    if (sectionId != SectionEntry::kInvalidId) {
+      if (ASMJIT_UNLIKELY(sectionId >= numSections))
+        return DebugUtils::errored(kErrorInvalidLabel);
+
+      LabelEntry* le = code->getLabelEntry(id);
+      le->_sectionId = sectionId;
+      le->_offset = offset;
+    }
+  }
+
+  for (i = 0; i < numRelocs; i++) {
+    uint32_t type = reader.readU32();
+    uint32_t size = reader.readU32();
+
+    RelocEntry* re;
+    ASMJIT_PROPAGATE(code->newRelocEntry(&re, type, size));
+
+    re->_sourceSectionId = reader.readU32();
+    re->_targetSectionId = reader.readU32();
+    re->_sourceOffset = reader.readU64();
+    re->_data = reader.readU64();
+  }
+
+  // Imports become relocations to the absolute addresses provided by the
+  // resolver, the displacement `rel` is relative to the end of the field.
+  //
+  // A 64-bit helper can be anywhere in the address space, so branches to it
+  // are redirected to `jmp [rip]` stubs appended to the first section, which
+  // are always within rel32 range. Other references (like `lea`) can't be
+  // redirected, their relocation fails if the helper is out of range.
+  SectionEntry* stubSection = code->getSectionEntry(0);
+  size_t stubsStart = stubSection->getPhysicalSize();
+  bool useStubs = archType == ArchInfo::kTypeX64 &&
+                  stubSection->isText() &&
+                  stubSection->getVirtualSize() <= stubsStart;
+
+  for (i = 0; i < numImports; i++) {
+    uint32_t labelId = reader.readU32();
+    uint32_t sectionId = reader.readU32();
+    uint64_t offset = reader.readU64();
+    int64_t rel = static_cast<int64_t>(reader.readU64());
+
+    if (ASMJIT_UNLIKELY(!reader.isValid() || !code->isLabelValid(labelId) || sectionId >= numSections))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    const void* address = resolver ? resolver->resolve(code->getLabelEntry(labelId)->getName()) : nullptr;
+    if (ASMJIT_UNLIKELY(!address))
+      return DebugUtils::errored(kErrorInvalidLabel);
+
+    RelocEntry* re;
+    ASMJIT_PROPAGATE(code->newRelocEntry(&re, RelocEntry::kTypeAbsToRel, 4));
+
+    re->_sourceSectionId = sectionId;
+    re->_sourceOffset = offset;
+
+    if (useStubs && CodeCache_isBranchField(code->getSectionEntry(sectionId), offset, rel)) {
+      size_t stubOffset;
+      ASMJIT_PROPAGATE(CodeCache_addStub(code, stubSection, stubsStart, static_cast<uint64_t>((uintptr_t)address), stubOffset));
+
+      re->_targetSectionId = 0;
+      re->_data = static_cast<uint64_t>(stubOffset);
+    }
+    else {
+      re->_data = static_cast<uint64_t>((uintptr_t)address) + static_cast<uint64_t>(rel + 4);
+    }
+  }
+
+  if (ASMJIT_UNLIKELY(!reader.isValid()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  return kErrorOk;
+}
+
+Error CodeCache::load(CodeHolder* code, const void* data, size_t size, uint64_t key, CodeCacheResolver* resolver) noexcept {
+  if (ASMJIT_UNLIKELY(code->isInitialized()))
+    return DebugUtils::errored(kErrorAlreadyInitialized);
+
+  CodeCacheReader reader(static_cast<const uint8_t*>(data), size);
+  uint32_t magic = reader.readU32();
+  uint32_t version = reader.readU32();
+  uint64_t blobKey = reader.readU64();
+  uint64_t checksum = reader.readU64();
+  uint64_t payloadSize = reader.readU64();
+
+  if (ASMJIT_UNLIKELY(!reader.isValid() || magic != kMagic || version != kVersion || blobKey != key))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  if (ASMJIT_UNLIKELY(payloadSize != size - kCodeCacheHeaderSize))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  const uint8_t* payload = static_cast<const uint8_t*>(data) + kCodeCacheHeaderSize;
+  if (ASMJIT_UNLIKELY(hash(payload, static_cast<size_t>(payloadSize)) != checksum))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  Error err = CodeCache_loadInternal(code, reader, resolver);
+  if (ASMJIT_UNLIKELY(err)) {
+    code->reset(true);
+    return err;
+  }
+
+  return kErrorOk;
+}
+
+Error CodeCache::loadFile(CodeHolder* code, const char* fileName, uint64_t key, CodeCacheResolver* resolver) noexcept {
+  FILE* file = ::fopen(fileName, "rb");
+  if (ASMJIT_UNLIKELY(!file))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  StringBuilder sb;
+  Error err = kErrorOk;
+
+  for (;;) {
+    char* p = sb.prepare(StringBuilder::kStringOpAppend, 4096);
+    if (ASMJIT_UNLIKELY(!p)) {
+      err = DebugUtils::errored(kErrorNoHeapMemory);
+      break;
+    }
+
+    size_t n = ::fread(p, 1, 4096, file);
+    sb._length -= 4096 - n;
+    sb._data[sb._length] = '\0';
+
+    if (n < 4096) {
+      if (::ferror(file))
+        err = DebugUtils::errored(kErrorInvalidState);
+      break;
+    }
+  }
+
+  ::fclose(file);
+  ASMJIT_PROPAGATE(err);
+
+  return load(code, sb.getData(), sb.getLength(), key, resolver);
+}
+
+// ============================================================================
+// [asmjit::CodeCache - Install]
+// ============================================================================
+
+Error CodeCache::_install(JitRuntime* runtime, void** dst, const void* data, size_t size, uint64_t key, CodeCacheResolver* resolver) noexcept {
+  *dst = nullptr;
+
+  CodeHolder code;
+  ASMJIT_PROPAGATE(load(&code, data, size, key, resolver));
+
+  if (ASMJIT_UNLIKELY(code.getArchType() != runtime->getArchType()))
+    return DebugUtils::errored(kErrorInvalidArch);
+
+  // Imports are the only relocations to absolute addresses.
+  const ZoneVector<RelocEntry*>& relocations = code.getRelocEntries();
+  for (size_t i = 0; i < relocations.getLength(); i++) {
+    const RelocEntry* re = relocations[i];
+    if (re->getType() == RelocEntry::kTypeAbsToRel && re->getTargetSectionId() == SectionEntry::kInvalidId)
+      runtime->addHelperAddress(reinterpret_cast<const void*>((uintptr_t)re->getData()));
+  }
+
+  return runtime->_add(dst, &code);
+}
+
+// ============================================================================
+// [asmjit::CodeCache - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86)
+static int CodeCache_testHelper(int x) { return x * 2; }
+
+class CodeCacheTestResolver : public CodeCacheResolver {
+public:
+  virtual const void* resolve(const char* name) noexcept {
+    if (::strcmp(name, "asmjit_cache_helper") == 0)
+      return reinterpret_cast<const void*>(&CodeCache_testHelper);
+    return nullptr;
+  }
+};
+
+UNIT(base_codecache) {
+  JitRuntime rt;
+  CodeHolder code;
+  code.init(rt.getCodeInfo());
+
+  SectionEntry* rodata;
+  code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 8);
+
+  X86Assembler a(&code);
+  Label L_Func = a.newNamedLabel("asmjit_cache_func");
+  Label L_Helper = a.newNamedLabel("asmjit_cache_helper");
+  Label L_Data = a.newLabel();
+
+  // int func(int x) { return helper(x) + data[1]; }, the argument is passed
+  // on the stack in 32-bit mode and in a register in 64-bit mode.
+  a.bind(L_Func);
+  if (a.is32Bit()) {
+    a.push(x86::dword_ptr(x86::esp, 4));
+    a.call(L_Helper);
+    a.add(x86::esp, 4);
+    a.lea(x86::ecx, x86::ptr(L_Data));
+    a.add(x86::eax, x86::dword_ptr(x86::ecx, 4));
+  }
+  else {
+    a.push(x86::rbx);
+#if ASMJIT_OS_WINDOWS
+    a.sub(x86::rsp, 32);
+    a.call(L_Helper);
+    a.add(x86::rsp, 32);
+#else
+    a.call(L_Helper);
+#endif
+    a.add(x86::eax, x86::dword_ptr(L_Data, 4));
+    a.pop(x86::rbx);
+  }
+  a.ret();
+
+  a.section(rodata);
+  a.bind(L_Data);
+  a.dint32(1);
+  a.dint32(100);
+
+  const char keyData[] = "int func(int x) { return helper(x) + 100; }";
+  uint64_t key = CodeCache::hash(keyData, sizeof(keyData) - 1);
+  const CpuFeatures& hostFeatures = CpuInfo::getHost().getFeatures();
+
+  StringBuilder blob;
+  INFO("Checking CodeCache::save()");
+  EXPECT(CodeCache::save(blob, &code, key, hostFeatures) == kErrorOk, "Failed to save the code");
+  EXPECT(Utils::readU32uLE(blob.getData()) == CodeCache::kMagic, "Invalid blob signature");
+
+  INFO("Checking CodeCache::load()");
+  {
+    CodeHolder loaded;
+    CodeCacheTestResolver resolver;
+
+    EXPECT(CodeCache::load(&loaded, blob.getData(), blob.getLength(), key, &resolver) == kErrorOk,
+      "Failed to load the code");
+    EXPECT(loaded.getSections().getLength() == 2 && ::strcmp(loaded.getSectionEntry(1)->getName(), ".rodata") == 0,
+      "Sections were not restored properly");
+    // In 64-bit mode the call to the helper goes through a stub appended to
+    // the code, so the helper can be anywhere in the address space.
+    size_t codeSize = code.getSectionEntry(0)->getPhysicalSize();
+    size_t stubsSize = a.is64Bit() ? size_t(kCodeCacheStubSize) : size_t(0);
+
+    EXPECT(loaded.getSectionEntry(0)->getPhysicalSize() == codeSize + stubsSize &&
+           ::memcmp(loaded.getSectionEntry(0)->getBuffer().getData(), code.getSectionEntry(0)->getBuffer().getData(), codeSize) == 0,
+      "Code was not restored properly");
+    EXPECT(loaded.hasRelocType(RelocEntry::kTypeAbsToRel) && !loaded.hasRelocType(RelocEntry::kTypeTrampoline),
+      "Imports were not restored properly");
+
+    if (a.is64Bit()) {
+      const uint8_t* stub = loaded.getSectionEntry(0)->getBuffer().getData() + codeSize;
+      EXPECT(stub[0] == 0xFF && stub[1] == 0x25 && Utils::readU64u(stub + 6) == (uint64_t)(uintptr_t)&CodeCache_testHelper,
+        "Call to the helper doesn't go through a stub");
+    }
+    EXPECT(loaded.getLabelIdByName("asmjit_cache_func") == L_Func.getId() && loaded.isLabelBound(L_Func),
+      "Labels were not restored properly");
+  }
+
+  INFO("Checking that invalid blobs are refused");
+  {
+    CodeHolder loaded;
+    CodeCacheTestResolver resolver;
+
+    EXPECT(CodeCache::load(&loaded, blob.getData(), blob.getLength(), key + 1, &resolver) == kErrorInvalidArgument,
+      "Blob saved with a different key must be refused");
+    EXPECT(CodeCache::load(&loaded, blob.getData(), blob.getLength() - 1, key, &resolver) == kErrorInvalidArgument,
+      "Truncated blob must be refused");
+
+    StringBuilder corrupted;
+    corrupted.setString(blob.getData(), blob.getLength());
+    corrupted.getData()[blob.getLength() - 1] ^= 0x01;
+    EXPECT(CodeCache::load(&loaded, corrupted.getData(), corrupted.getLength(), key, &resolver) == kErrorInvalidArgument,
+      "Corrupted blob must be refused");
+
+    EXPECT(CodeCache::load(&loaded, blob.getData(), blob.getLength(), key) == kErrorInvalidLabel,
+      "Blob with unresolved imports must be refused");
+    EXPECT(!loaded.isInitialized(), "CodeHolder must be reset if loading failed");
+
+    CpuFeatures all;
+    for (uint32_t i = 0; i < CpuFeatures::kMaxFeatures; i++)
+      all.add(i);
+
+    StringBuilder unsupported;
+    EXPECT(CodeCache::save(unsupported, &code, key, all) == kErrorOk, "Failed to save the code");
+    EXPECT(CodeCache::load(&loaded, unsupported.getData(), unsupported.getLength(), key, &resolver) == kErrorFeatureNotEnabled,
+      "Blob requiring CPU features not provided by the host must be refused");
+  }
+
+  INFO("Checking CodeCache::install()");
+  {
+    typedef int (*Func)(int);
+    Func func;
+    CodeCacheTestResolver resolver;
+
+    EXPECT(CodeCache::install(&rt, &func, blob.getData(), blob.getLength(), key, &resolver) == kErrorOk,
+      "Failed to install the code");
+
+    int result = func(21);
+    EXPECT(result == 142, "Installed code returned %d (expected 142)", result);
+    rt.release(func);
+  }
+}
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
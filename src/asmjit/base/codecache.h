@@ -0,0 +1,152 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_CODECACHE_H
+#define _ASMJIT_BASE_CODECACHE_H
+
+// [Dependencies]
+#include "../base/codeholder.h"
+#include "../base/cpuinfo.h"
+#include "../base/runtime.h"
+#include "../base/string.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [asmjit::CodeCacheResolver]
+// ============================================================================
+
+//! Resolves imports of a cached code.
+//!
+//! Global named labels that were referenced, but never bound, are stored as
+//! imports. They must be resolved to absolute addresses when the cached code
+//! is loaded, as these addresses are generally different in each process.
+class ASMJIT_VIRTAPI CodeCacheResolver {
+public:
+  ASMJIT_NONCOPYABLE(CodeCacheResolver)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `CodeCacheResolver` instance.
+  ASMJIT_API CodeCacheResolver() noexcept;
+  //! Destroy the `CodeCacheResolver` instance.
+  ASMJIT_API virtual ~CodeCacheResolver() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get the address of an import `name` or null if it's not known.
+  virtual const void* resolve(const char* name) noexcept = 0;
+};
+
+// ============================================================================
+// [asmjit::CodeCache]
+// ============================================================================
+
+//! Code cache.
+//!
+//! Serializes a finalized \ref CodeHolder into a compact binary blob that can
+//! be stored on disk and loaded later, possibly by a different process. The
+//! blob contains the machine code and data of all sections, relocations,
+//! labels, \ref CodeInfo, and CPU features required to run the code. Loading
+//! the blob doesn't encode anything, the code is only relocated when added to
+//! a \ref Runtime, which makes it much cheaper than generating the code again.
+//!
+//! Each blob is identified by a `key`, which should be a hash of everything
+//! that was used to generate the code (see \ref hash()). The loader refuses
+//! blobs that were saved with a different key, that are corrupted, or that
+//! require CPU features that the host doesn't have.
+//!
+//! The blob only contains relocations that are relative to the code itself.
+//! Relocations to absolute addresses (jumps and calls to immediates including
+//! trampolines) are refused by `save()`. Use global named labels that are not
+//! bound instead, these are stored as imports and resolved at load time by a
+//! \ref CodeCacheResolver.
+class CodeCache {
+public:
+  ASMJIT_ENUM(Constants) {
+    kMagic   = 0x43434A41U,              //!< Blob signature ("AJCC").
+    kVersion = 1                         //!< Blob version.
+  };
+
+  //! Seed used by \ref hash() by default.
+  static const uint64_t kHashSeed = ASMJIT_UINT64_C(0xCBF29CE484222325);
+
+  // --------------------------------------------------------------------------
+  // [Hash]
+  // --------------------------------------------------------------------------
+
+  //! Hash `size` bytes of `data` (FNV-1a), can be chained through `seed`.
+  ASMJIT_API static uint64_t hash(const void* data, size_t size, uint64_t seed = kHashSeed) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Save]
+  // --------------------------------------------------------------------------
+
+  //! Serialize `code` into `dst` (the content of `dst` is replaced).
+  //!
+  //! The code must be finalized, `features` describe CPU features that are
+  //! required to run it (\ref CpuInfo::getHost() features can be used if the
+  //! code was generated for the host).
+  ASMJIT_API static Error save(StringBuilder& dst, CodeHolder* code, uint64_t key, const CpuFeatures& features) noexcept;
+
+  //! Serialize `code` into a file `fileName`.
+  ASMJIT_API static Error saveFile(const char* fileName, CodeHolder* code, uint64_t key, const CpuFeatures& features) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Load]
+  // --------------------------------------------------------------------------
+
+  //! Restore a blob of `size` bytes at `data` into `code`.
+  //!
+  //! The `code` is initialized by this function, it must not be initialized
+  //! before. Imports are resolved by `resolver`, which is only required if
+  //! the blob has any. In 64-bit mode jumps and calls to imports go through
+  //! stubs appended to the first section, so they reach imports at any address.
+  //! Other references to imports are relocated directly and fail to relocate
+  //! with `kErrorInvalidDisplacement` if the import is out of rel32 range.
+  ASMJIT_API static Error load(CodeHolder* code, const void* data, size_t size, uint64_t key, CodeCacheResolver* resolver = nullptr) noexcept;
+
+  //! Restore a blob stored in a file `fileName` into `code`.
+  ASMJIT_API static Error loadFile(CodeHolder* code, const char* fileName, uint64_t key, CodeCacheResolver* resolver = nullptr) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Install]
+  // --------------------------------------------------------------------------
+
+  //! Load a blob of `size` bytes at `data` and add it to `runtime`.
+  //!
+  //! Addresses of imports referenced by other instructions than jumps and
+  //! calls are registered by \ref JitRuntime::addHelperAddress(), so the code
+  //! is allocated close to them.
+  template<typename Func>
+  static ASMJIT_INLINE Error install(JitRuntime* runtime, Func* dst, const void* data, size_t size, uint64_t key, CodeCacheResolver* resolver = nullptr) noexcept {
+    return _install(runtime, Internal::ptr_cast<void**, Func*>(dst), data, size, key, resolver);
+  }
+
+  //! \internal
+  ASMJIT_API static Error _install(JitRuntime* runtime, void** dst, const void* data, size_t size, uint64_t key, CodeCacheResolver* resolver) noexcept;
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // _ASMJIT_BASE_CODECACHE_H
@@ -51,6 +51,13 @@ bool CCFuncCall::_setRet(uint32_t i, const Operand_& op) noexcept {
   return true;
 }
 
+// ============================================================================
+// [asmjit::CCExecutor - Construction / Destruction]
+// ============================================================================
+
+CCExecutor::CCExecutor() noexcept {}
+CCExecutor::~CCExecutor() noexcept {}
+
 // ============================================================================
 // [asmjit::CodeCompiler - Construction / Destruction]
 // ============================================================================
@@ -61,11 +68,14 @@ CodeCompiler::CodeCompiler() noexcept
     _vRegZone(4096 - Zone::kZoneOverhead),
     _vRegArray(),
     _localConstPool(nullptr),
-    _globalConstPool(nullptr) {
+    _globalConstPool(nullptr),
+    _executor(nullptr),
+    _master(nullptr),
+    _workers() {
 
   _type = kTypeCompiler;
 }
-CodeCompiler::~CodeCompiler() noexcept {}
+CodeCompiler::~CodeCompiler() noexcept { _releaseWorkers(); }
 
 // ============================================================================
 // [asmjit::CodeCompiler - Events]
@@ -76,6 +86,7 @@ Error CodeCompiler::onAttach(CodeHolder* code) noexcept {
 }
 
 Error CodeCompiler::onDetach(CodeHolder* code) noexcept {
+  _releaseWorkers();
   _func = nullptr;
 
   _localConstPool = nullptr;
@@ -87,6 +98,64 @@ Error CodeCompiler::onDetach(CodeHolder* code) noexcept {
   return Base::onDetach(code);
 }
 
+// ============================================================================
+// [asmjit::CodeCompiler - Workers]
+// ============================================================================
+
+CodeCompiler* CodeCompiler::_newWorker() noexcept {
+  return nullptr;
+}
+
+Error CodeCompiler::_prepareWorkers(uint32_t count) noexcept {
+  ASMJIT_ASSERT(_code != nullptr);
+  ASMJIT_ASSERT(!isWorker());
+
+  ASMJIT_PROPAGATE(_workers.willGrow(&_cbHeap, count));
+  while (_workers.getLength() < count) {
+    CodeCompiler* worker = _newWorker();
+    if (ASMJIT_UNLIKELY(!worker))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+
+    Error err = _code->attach(worker);
+    if (ASMJIT_UNLIKELY(err)) {
+      worker->~CodeCompiler();
+      Internal::releaseMemory(worker);
+      return err;
+    }
+
+    worker->_master = this;
+    _workers.appendUnsafe(worker);
+  }
+
+  // Workers don't own virtual registers and labels of this compiler, they only
+  // see them. Anything a worker creates is only used by the function it is
+  // compiling, except label ids, which are allocated by `CodeHolder`.
+  for (uint32_t i = 0; i < count; i++) {
+    CodeCompiler* worker = _workers[i];
+    worker->resetLastError();
+    worker->setPassStatsEnabled(isPassStatsEnabled());
+
+    worker->_vRegArray.clear();
+    ASMJIT_PROPAGATE(worker->_vRegArray.reserve(&worker->_cbHeap, _vRegArray.getLength()));
+    worker->_vRegArray.concatUnsafe(_vRegArray);
+
+    worker->_cbLabels.clear();
+    ASMJIT_PROPAGATE(worker->_cbLabels.reserve(&worker->_cbHeap, _cbLabels.getLength()));
+    worker->_cbLabels.concatUnsafe(_cbLabels);
+  }
+
+  return kErrorOk;
+}
+
+void CodeCompiler::_releaseWorkers() noexcept {
+  for (size_t i = 0, len = _workers.getLength(); i < len; i++) {
+    CodeCompiler* worker = _workers[i];
+    worker->~CodeCompiler();
+    Internal::releaseMemory(worker);
+  }
+  _workers.reset();
+}
+
 // ============================================================================
 // [asmjit::CodeCompiler - Node-Factory]
 // ============================================================================
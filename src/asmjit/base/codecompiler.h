@@ -17,6 +17,7 @@
 #include "../base/constpool.h"
 #include "../base/func.h"
 #include "../base/operand.h"
+#include "../base/osutils.h"
 #include "../base/utils.h"
 #include "../base/zone.h"
 
@@ -537,6 +538,46 @@ public:
   uint32_t _args;                        //!< Affected arguments bit-array.
 };
 
+// ============================================================================
+// [asmjit::CCExecutor]
+// ============================================================================
+
+//! Executor of tasks that \ref CodeCompiler can run concurrently.
+//!
+//! AsmJit doesn't create threads, an executor is a hook that connects the
+//! compiler to a thread-pool provided by the user. When an executor is set by
+//! `CodeCompiler::setExecutor()` and its concurrency is greater than one the
+//! register allocator processes functions concurrently by using worker
+//! compilers, each having its own `Zone` and `ZoneHeap`. Functions are then
+//! serialized into the shared \ref CodeHolder in the order they were added.
+class ASMJIT_VIRTAPI CCExecutor {
+public:
+  ASMJIT_NONCOPYABLE(CCExecutor)
+
+  //! Task function, called once per `index` with the data passed to `run()`.
+  typedef void (ASMJIT_CDECL* TaskFunc)(void* data, uint32_t index);
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `CCExecutor` instance.
+  ASMJIT_API CCExecutor() noexcept;
+  //! Destroy the `CCExecutor` instance.
+  ASMJIT_API virtual ~CCExecutor() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get the maximum number of tasks that can run concurrently.
+  virtual uint32_t getConcurrency() const noexcept = 0;
+
+  //! Call `func(data, index)` for each `index` in range [0, count) and return
+  //! after all calls returned. Calls can run concurrently and in any order.
+  virtual void run(TaskFunc func, void* data, uint32_t count) noexcept = 0;
+};
+
 // ============================================================================
 // [asmjit::CodeCompiler]
 // ============================================================================
@@ -713,6 +754,45 @@ public:
   //! NOTE: Only new name will appear in the logger.
   ASMJIT_API void rename(Reg& reg, const char* fmt, ...);
 
+  // --------------------------------------------------------------------------
+  // [Executor]
+  // --------------------------------------------------------------------------
+
+  //! Get the executor used to compile functions concurrently (or null).
+  ASMJIT_INLINE CCExecutor* getExecutor() const noexcept { return _executor; }
+  //! Set the executor used to compile functions concurrently, null to disable.
+  //!
+  //! Functions compiled concurrently must not share virtual registers and must
+  //! not jump into each other (calls are fine). The \ref ErrorHandler can be
+  //! called from any thread used by the executor.
+  ASMJIT_INLINE void setExecutor(CCExecutor* executor) noexcept { _executor = executor; }
+
+  // --------------------------------------------------------------------------
+  // [Workers]
+  // --------------------------------------------------------------------------
+
+  //! Get whether this compiler is a worker of another compiler.
+  ASMJIT_INLINE bool isWorker() const noexcept { return _master != nullptr; }
+  //! Get the compiler this worker belongs to (or null).
+  ASMJIT_INLINE CodeCompiler* getMaster() const noexcept { return _master; }
+
+  //! \internal
+  //!
+  //! Create a new compiler of the same type, not attached to any \ref CodeHolder.
+  //! Returns null if workers are not supported or on out of memory condition.
+  ASMJIT_API virtual CodeCompiler* _newWorker() noexcept;
+
+  //! \internal
+  //!
+  //! Prepare `count` workers attached to the same \ref CodeHolder that see all
+  //! virtual registers and labels of this compiler. Workers own nodes they add
+  //! into the code, thus they are kept until this compiler is detached.
+  ASMJIT_API Error _prepareWorkers(uint32_t count) noexcept;
+  //! \internal
+  //!
+  //! Destroy all workers.
+  ASMJIT_API void _releaseWorkers() noexcept;
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -724,6 +804,11 @@ public:
 
   CBConstPool* _localConstPool;          //!< Local constant pool, flushed at the end of each function.
   CBConstPool* _globalConstPool;         //!< Global constant pool, flushed at the end of the compilation.
+
+  CCExecutor* _executor;                 //!< Executor used to compile functions concurrently (or null).
+  CodeCompiler* _master;                 //!< Compiler this worker belongs to (or null).
+  ZoneVector<CodeCompiler*> _workers;    //!< Workers used by a concurrent compilation.
+  Lock _workerLock;                      //!< Serializes access of workers to the shared `CodeHolder`.
 };
 
 //! \}
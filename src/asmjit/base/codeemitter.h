@@ -77,7 +77,79 @@ public:
     //! This feature is disabled by default, because the only processor that
     //! used to take into consideration prediction hints was P4. Newer processors
     //! implement heuristics for branch prediction that ignores any static hints.
-    kHintPredictedJumps = 0x00000002U
+    kHintPredictedJumps = 0x00000002U,
+
+    //! Avoid jumps crossing or ending at 32-byte boundaries.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! Skylake-derived processors with the JCC erratum microcode update don't
+    //! cache jumps (including calls and returns) that cross or end at 32-byte
+    //! boundary in the decoded ICache, which makes such jumps much slower.
+    //! In addition, `cmp|test|add|sub|and|inc|dec + jcc` pairs are not macro
+    //! fused if they are split by such boundary. If this hint is enabled the
+    //! assembler inserts NOPs before the jump or the whole fusible pair so it
+    //! starts at the next 32-byte boundary when necessary. The code buffer
+    //! must be placed at 32-byte aligned address, which is always the case
+    //! for code added to `JitRuntime`.
+    kHintAvoidJccErratum = 0x00000004U,
+
+    //! Select the shortest semantically equivalent encoding.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! The assembler encodes instructions mostly literally. If this hint is
+    //! enabled it rewrites instructions that have a shorter equivalent, for
+    //! example `and rax, 0xFF` is encoded as `and eax, 0xFF`, `xor rax, rax`
+    //! as `xor eax, eax`, and commutative AVX instructions swap their source
+    //! operands if that allows to use 2-byte VEX prefix instead of 3-byte one.
+    kHintCompactEncoding = 0x00000008U,
+
+    //! Insert `vzeroupper` automatically where the upper part of vector
+    //! registers may be dirty.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! Executing legacy SSE instructions while the upper part of YMM or ZMM
+    //! registers is dirty causes a costly state transition. If this hint is
+    //! enabled the compiler tracks which paths of a function use 256-bit or
+    //! 512-bit registers and emits `vzeroupper` before calls and in the epilog
+    //! of functions that can reach them in dirty state, unless the signature
+    //! passes such vectors in registers.
+    kHintAvxCleanup = 0x00000010U,
+
+    //! Encode legacy SSE instructions by using their VEX (AVX) counterparts.
+    //!
+    //! Default `false`.
+    //!
+    //! X86/X64 Specific
+    //! ----------------
+    //!
+    //! Only use this hint if the generated code targets AVX capable CPUs. The
+    //! assembler translates SSE instructions that have an AVX equivalent, for
+    //! example `addps xmm0, xmm1` is encoded as `vaddps xmm0, xmm0, xmm1`, so
+    //! the code never mixes legacy SSE and VEX encoded instructions.
+    kHintSseToAvx = 0x00000020U,
+
+    //! Remove instructions whose results are never used (CodeCompiler).
+    //!
+    //! Default `false`.
+    //!
+    //! The register allocator removes instructions that only write virtual
+    //! registers which are dead after them (and status flags that are not read
+    //! before they are overwritten) before registers are allocated. Removal
+    //! repeats until no more instructions die. Instructions that access memory,
+    //! use fixed or physical registers, or have side effects are never removed.
+    kHintDeadCodeElimination = 0x00000040U
   };
 
   //! CodeEmitter options that are merged with instruction options.
@@ -213,6 +285,14 @@ public:
   //! Embed absolute label address as data (4 or 8 bytes).
   virtual Error embedLabel(const Label& label) = 0;
 
+  //! Embed a difference `label - base` as data of the given `size` (1, 2, 4,
+  //! or 8 bytes), `base` must be bound in the current section.
+  //!
+  //! The value doesn't depend on where the code is placed so it doesn't need
+  //! a relocation if both labels are in the same section. If `label` is not
+  //! bound yet only 4-byte values are supported.
+  virtual Error embedLabelDelta(const Label& label, const Label& base, uint32_t size) = 0;
+
   //! Embed a constant pool into the code-buffer in the following steps:
   //!   1. Align by using kAlignData to the minimum `pool` alignment.
   //!   2. Bind `label` so it's bound to an aligned location.
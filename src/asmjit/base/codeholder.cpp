@@ -40,6 +40,18 @@ static void CodeHolder_setGlobalOption(CodeHolder* self, uint32_t clear, uint32_
   }
 }
 
+static void CodeHolder_setGlobalHint(CodeHolder* self, uint32_t clear, uint32_t add) noexcept {
+  // Modify global hints of `CodeHolder` itself.
+  self->_globalHints = (self->_globalHints & ~clear) | add;
+
+  // Modify all global hints of all `CodeEmitter`s attached.
+  CodeEmitter* emitter = self->_emitters;
+  while (emitter) {
+    emitter->_globalHints = (emitter->_globalHints & ~clear) | add;
+    emitter = emitter->_nextEmitter;
+  }
+}
+
 static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexcept {
   // Detach all `CodeEmitter`s.
   while (self->_emitters)
@@ -47,13 +59,15 @@ static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexc
 
   // Reset everything into its construction state.
   self->_codeInfo.reset();
-  self->_globalHints = 0;
+  self->_globalHints = CodeEmitter::kHintOptimizedAlign;
   self->_globalOptions = 0;
   self->_logger = nullptr;
   self->_errorHandler = nullptr;
 
+  self->_labelsCount = 0;
   self->_unresolvedLabelsCount = 0;
   self->_trampolinesSize = 0;
+  self->_relocTypes = 0;
 
   // Reset all sections.
   size_t numSections = self->_sections.getLength();
@@ -69,8 +83,11 @@ static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexc
   ZoneHeap* heap = &self->_baseHeap;
 
   self->_namedLabels.reset(heap);
+  self->_trampolines.reset(heap);
   self->_relocations.reset();
-  self->_labels.reset();
+  self->_patchSites.reset();
+  self->_labelBlocks.reset();
+  self->_labelLinkPool = nullptr;
   self->_sections.reset();
 
   heap->reset(&self->_baseZone);
@@ -83,18 +100,22 @@ static void CodeHolder_resetInternal(CodeHolder* self, bool releaseMemory) noexc
 
 CodeHolder::CodeHolder() noexcept
   : _codeInfo(),
-    _globalHints(0),
+    _globalHints(CodeEmitter::kHintOptimizedAlign),
     _globalOptions(0),
     _emitters(nullptr),
     _cgAsm(nullptr),
     _logger(nullptr),
     _errorHandler(nullptr),
+    _labelsCount(0),
     _unresolvedLabelsCount(0),
     _trampolinesSize(0),
+    _relocTypes(0),
     _baseZone(16384 - Zone::kZoneOverhead),
     _dataZone(16384 - Zone::kZoneOverhead),
     _baseHeap(&_baseZone),
-    _namedLabels(&_baseHeap) {}
+    _labelLinkPool(nullptr),
+    _namedLabels(&_baseHeap),
+    _trampolines(&_baseHeap) {}
 
 CodeHolder::~CodeHolder() noexcept {
   CodeHolder_resetInternal(this, true);
@@ -236,12 +257,74 @@ void CodeHolder::sync() noexcept {
 // [asmjit::CodeHolder - Result Information]
 // ============================================================================
 
+//! \internal
+//!
+//! Assign offsets to all sections. Executable sections are placed into the
+//! text region (followed by trampolines) and all other sections are placed
+//! into the data region, each section aligned to its own alignment.
+static void CodeHolder_layoutSections(const CodeHolder* self, size_t& textSize, size_t& dataSize, uint32_t& dataAlignment) noexcept {
+  size_t textOffset = 0;
+  size_t dataOffset = 0;
+  dataAlignment = 1;
+
+  size_t numSections = self->_sections.getLength();
+  for (size_t i = 0; i < numSections; i++) {
+    SectionEntry* section = self->_sections[i];
+    uint32_t alignment = section->getAlignment();
+    if (alignment == 0) alignment = 1;
+
+    if (section->isText()) {
+      textOffset = Utils::alignTo<size_t>(textOffset, alignment);
+      section->_offset = textOffset;
+      textOffset += section->getRealSize();
+    }
+    else {
+      dataOffset = Utils::alignTo<size_t>(dataOffset, alignment);
+      section->_offset = dataOffset;
+      dataOffset += section->getRealSize();
+      if (alignment > dataAlignment) dataAlignment = alignment;
+    }
+  }
+
+  textSize = textOffset + self->getTrampolinesSize();
+  dataSize = dataOffset;
+}
+
 size_t CodeHolder::getCodeSize() const noexcept {
   // Reflect all changes first.
   const_cast<CodeHolder*>(this)->sync();
 
-  // TODO: Support sections.
-  return _sections[0]->_buffer._length + getTrampolinesSize();
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+
+  if (dataSize == 0) return textSize;
+  return Utils::alignTo<size_t>(textSize, dataAlignment) + dataSize;
+}
+
+size_t CodeHolder::getTextSize() const noexcept {
+  const_cast<CodeHolder*>(this)->sync();
+
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+  return textSize;
+}
+
+size_t CodeHolder::getDataSize() const noexcept {
+  const_cast<CodeHolder*>(this)->sync();
+
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+  return dataSize;
+}
+
+uint32_t CodeHolder::getDataAlignment() const noexcept {
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+  return dataAlignment;
 }
 
 // ============================================================================
@@ -263,10 +346,75 @@ Error CodeHolder::setErrorHandler(ErrorHandler* handler) noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::CodeHolder - Global Hints]
+// ============================================================================
+
+void CodeHolder::addGlobalHints(uint32_t hints) noexcept {
+  CodeHolder_setGlobalHint(this, 0, hints);
+}
+
+void CodeHolder::clearGlobalHints(uint32_t hints) noexcept {
+  CodeHolder_setGlobalHint(this, hints, 0);
+}
+
 // ============================================================================
 // [asmjit::CodeHolder - Sections]
 // ============================================================================
 
+SectionEntry* CodeHolder::getSectionByName(const char* name, size_t nameLength) const noexcept {
+  if (nameLength == Globals::kInvalidIndex)
+    nameLength = ::strlen(name);
+
+  if (nameLength == 0 || nameLength > SectionEntry::kMaxNameLength)
+    return nullptr;
+
+  size_t numSections = _sections.getLength();
+  for (size_t i = 0; i < numSections; i++) {
+    SectionEntry* section = _sections[i];
+    if (::memcmp(section->_name, name, nameLength) == 0 && section->_name[nameLength] == '\0')
+      return section;
+  }
+
+  return nullptr;
+}
+
+Error CodeHolder::newSection(SectionEntry** sectionOut, const char* name, size_t nameLength, uint32_t flags, uint32_t alignment) noexcept {
+  *sectionOut = nullptr;
+
+  if (nameLength == Globals::kInvalidIndex)
+    nameLength = ::strlen(name);
+
+  if (ASMJIT_UNLIKELY(nameLength == 0 || nameLength > SectionEntry::kMaxNameLength))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  if (ASMJIT_UNLIKELY(alignment != 0 && !Utils::isPowerOf2(alignment)))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // Section names must be unique.
+  if (ASMJIT_UNLIKELY(getSectionByName(name, nameLength) != nullptr))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  size_t index = _sections.getLength();
+  if (ASMJIT_UNLIKELY(index >= size_t(SectionEntry::kInvalidId)))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_PROPAGATE(_sections.willGrow(&_baseHeap));
+  SectionEntry* se = _baseZone.allocZeroedT<SectionEntry>();
+
+  if (ASMJIT_UNLIKELY(!se))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  se->_id = static_cast<uint32_t>(index);
+  se->_flags = flags;
+  se->_alignment = alignment;
+  ::memcpy(se->_name, name, nameLength);
+  _sections.appendUnsafe(se);
+
+  *sectionOut = se;
+  return kErrorOk;
+}
+
 static Error CodeHolder_reserveInternal(CodeHolder* self, CodeBuffer* cb, size_t n) noexcept {
   uint8_t* oldData = cb->_data;
   uint8_t* newData;
@@ -407,9 +555,44 @@ static uint32_t CodeHolder_hashNameAndFixLen(const char* name, size_t& nameLengt
 
 } // anonymous namespace
 
+//! \internal
+//!
+//! Allocate a new `LabelEntry` at the end of the label table. Entries are
+//! allocated in blocks aligned to a cache line, which are never released
+//! individually (only by resetting the CodeHolder).
+static LabelEntry* CodeHolder_newLabelEntry(CodeHolder* self) noexcept {
+  size_t index = self->_labelsCount;
+  size_t blockIndex = index >> CodeHolder::kLabelBlockShift;
+  if (blockIndex == self->_labelBlocks.getLength()) {
+    if (ASMJIT_UNLIKELY(self->_labelBlocks.willGrow(&self->_baseHeap) != kErrorOk))
+      return nullptr;
+
+    void* p = self->_baseZone.alloc(CodeHolder::kLabelBlockSize * sizeof(LabelEntry) + 63);
+    if (ASMJIT_UNLIKELY(!p))
+      return nullptr;
+
+    self->_labelBlocks.appendUnsafe(static_cast<LabelEntry*>(Utils::alignTo<void*>(p, 64)));
+  }
+
+  LabelEntry* le = self->_labelBlocks[blockIndex] + (index & (CodeHolder::kLabelBlockSize - 1));
+  ::memset(le, 0, sizeof(LabelEntry));
+
+  le->_setId(Operand::packId(static_cast<uint32_t>(index)));
+  le->_sectionId = SectionEntry::kInvalidId;
+
+  self->_labelsCount++;
+  return le;
+}
+
 LabelLink* CodeHolder::newLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel) noexcept {
-  LabelLink* link = _baseHeap.allocT<LabelLink>();
-  if (ASMJIT_UNLIKELY(!link)) return nullptr;
+  LabelLink* link = _labelLinkPool;
+  if (link) {
+    _labelLinkPool = link->prev;
+  }
+  else {
+    link = _baseZone.allocT<LabelLink>();
+    if (ASMJIT_UNLIKELY(!link)) return nullptr;
+  }
 
   link->prev = le->_links;
   le->_links = link;
@@ -426,24 +609,14 @@ LabelLink* CodeHolder::newLabelLink(LabelEntry* le, uint32_t sectionId, size_t o
 Error CodeHolder::newLabelId(uint32_t& idOut) noexcept {
   idOut = 0;
 
-  size_t index = _labels.getLength();
-  if (ASMJIT_LIKELY(index >= Operand::kPackedIdCount))
+  if (ASMJIT_UNLIKELY(_labelsCount >= Operand::kPackedIdCount))
     return DebugUtils::errored(kErrorLabelIndexOverflow);
 
-  ASMJIT_PROPAGATE(_labels.willGrow(&_baseHeap));
-  LabelEntry* le = _baseHeap.allocZeroedT<LabelEntry>();
-
+  LabelEntry* le = CodeHolder_newLabelEntry(this);
   if (ASMJIT_UNLIKELY(!le))
-    return DebugUtils::errored(kErrorNoHeapMemory);;
-
-  uint32_t id = Operand::packId(static_cast<uint32_t>(index));
-  le->_setId(id);
-  le->_parentId = 0;
-  le->_sectionId = SectionEntry::kInvalidId;
-  le->_offset = 0;
+    return DebugUtils::errored(kErrorNoHeapMemory);
 
-  _labels.appendUnsafe(le);
-  idOut = id;
+  idOut = le->getId();
   return kErrorOk;
 }
 
@@ -459,7 +632,7 @@ Error CodeHolder::newNamedLabelId(uint32_t& idOut, const char* name, size_t name
 
   switch (type) {
     case Label::kTypeLocal:
-      if (ASMJIT_UNLIKELY(Operand::unpackId(parentId) >= _labels.getLength()))
+      if (ASMJIT_UNLIKELY(Operand::unpackId(parentId) >= _labelsCount))
         return DebugUtils::errored(kErrorInvalidParentLabel);
 
       hVal ^= parentId;
@@ -482,41 +655,33 @@ Error CodeHolder::newNamedLabelId(uint32_t& idOut, const char* name, size_t name
   if (ASMJIT_UNLIKELY(le))
     return DebugUtils::errored(kErrorLabelAlreadyDefined);
 
-  Error err = kErrorOk;
-  size_t index = _labels.getLength();
-
-  if (ASMJIT_UNLIKELY(index >= Operand::kPackedIdCount))
+  if (ASMJIT_UNLIKELY(_labelsCount >= Operand::kPackedIdCount))
     return DebugUtils::errored(kErrorLabelIndexOverflow);
 
-  ASMJIT_PROPAGATE(_labels.willGrow(&_baseHeap));
-  le = _baseHeap.allocZeroedT<LabelEntry>();
+  // Duplicate the name first, the label entry cannot be freed once created.
+  char* nameExternal = nullptr;
+  if (nameLength > size_t(SmallString<LabelEntry::kNameBytes>::kMaxEmbeddedLength)) {
+    nameExternal = static_cast<char*>(_dataZone.dup(name, nameLength, true));
+    if (ASMJIT_UNLIKELY(!nameExternal))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+  }
 
+  le = CodeHolder_newLabelEntry(this);
   if (ASMJIT_UNLIKELY(!le))
-    return  DebugUtils::errored(kErrorNoHeapMemory);
+    return DebugUtils::errored(kErrorNoHeapMemory);
 
-  uint32_t id = Operand::packId(static_cast<uint32_t>(index));
   le->_hVal = hVal;
-  le->_setId(id);
   le->_type = static_cast<uint8_t>(type);
-  le->_parentId = 0;
-  le->_sectionId = SectionEntry::kInvalidId;
-  le->_offset = 0;
 
-  if (le->_name.mustEmbed(nameLength)) {
-    le->_name.setEmbedded(name, nameLength);
-  }
-  else {
-    char* nameExternal = static_cast<char*>(_dataZone.dup(name, nameLength, true));
-    if (ASMJIT_UNLIKELY(!nameExternal))
-      return DebugUtils::errored(kErrorNoHeapMemory);
+  if (nameExternal)
     le->_name.setExternal(nameExternal, nameLength);
-  }
+  else
+    le->_name.setEmbedded(name, nameLength);
 
-  _labels.appendUnsafe(le);
   _namedLabels.put(le);
 
-  idOut = id;
-  return err;
+  idOut = le->getId();
+  return kErrorOk;
 }
 
 uint32_t CodeHolder::getLabelIdByName(const char* name, size_t nameLength, uint32_t parentId) noexcept {
@@ -537,6 +702,10 @@ static ASMJIT_INLINE uint32_t x86EncodeMod(uint32_t m, uint32_t o, uint32_t rm)
 }
 
 Error CodeHolder::newRelocEntry(RelocEntry** dst, uint32_t type, uint32_t size) noexcept {
+  // Position-independent code can't contain absolute addresses.
+  if (ASMJIT_UNLIKELY(_codeInfo.isPIC() && (type == RelocEntry::kTypeAbsToAbs || type == RelocEntry::kTypeRelToAbs)))
+    return DebugUtils::errored(kErrorNotPositionIndependent);
+
   ASMJIT_PROPAGATE(_relocations.willGrow(&_baseHeap));
 
   size_t index = _relocations.getLength();
@@ -553,39 +722,150 @@ Error CodeHolder::newRelocEntry(RelocEntry** dst, uint32_t type, uint32_t size)
   re->_sourceSectionId = SectionEntry::kInvalidId;
   re->_targetSectionId = SectionEntry::kInvalidId;
   _relocations.appendUnsafe(re);
+  _relocTypes |= 1U << type;
 
   *dst = re;
   return kErrorOk;
 }
 
-// TODO: Support multiple sections, this only relocates the first.
-// TODO: This should go to Runtime as it's responsible for relocating the
-//       code, CodeHolder should just hold it.
-size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
+class TrampolineByAddress {
+public:
+  ASMJIT_INLINE TrampolineByAddress(uint64_t address) noexcept
+    : address(address),
+      hVal(static_cast<uint32_t>(address ^ (address >> 32)) * 0x9E3779B1U) {}
+
+  ASMJIT_INLINE bool matches(const TrampolineEntry* entry) const noexcept {
+    return entry->getAddress() == address;
+  }
+
+  uint64_t address;
+  uint32_t hVal;
+};
+
+Error CodeHolder::addTrampoline(RelocEntry* re) noexcept {
+  re->_type = RelocEntry::kTypeTrampoline;
+  _relocTypes |= 1U << RelocEntry::kTypeTrampoline;
+
+  TrampolineByAddress key(re->getData());
+  if (_trampolines.get(key))
+    return kErrorOk;
+
+  TrampolineEntry* te = _baseHeap.allocT<TrampolineEntry>();
+  if (ASMJIT_UNLIKELY(!te))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  te->_hashNext = nullptr;
+  te->_hVal = key.hVal;
+  te->_address = key.address;
+  te->_relocId = re->getId();
+
+  _trampolines.put(te);
+  _trampolinesSize += 8;
+  return kErrorOk;
+}
+
+void CodeHolder::_removeTrampoline(RelocEntry* re) noexcept {
+  TrampolineEntry* te = _trampolines.get(TrampolineByAddress(re->getData()));
+  if (!te || te->getRelocId() != re->getId())
+    return;
+
+  _trampolines.del(te);
+  _baseHeap.release(te, sizeof(TrampolineEntry));
+  _trampolinesSize -= 8;
+}
+
+Error CodeHolder::addPatchSite(uint32_t labelId) noexcept {
+  if (ASMJIT_UNLIKELY(!isLabelValid(labelId)))
+    return DebugUtils::errored(kErrorInvalidLabel);
+
+  if (ASMJIT_UNLIKELY(_sections.isEmpty()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  ASMJIT_PROPAGATE(_patchSites.append(&_baseHeap, labelId));
+
   SectionEntry* section = _sections[0];
-  ASMJIT_ASSERT(section != nullptr);
+  if (section->getAlignment() < 8)
+    section->setAlignment(8);
+  return kErrorOk;
+}
 
-  uint8_t* dst = static_cast<uint8_t*>(_dst);
-  if (baseAddress == Globals::kNoBaseAddress)
-    baseAddress = static_cast<uint64_t>((uintptr_t)dst);
+//! \internal
+//!
+//! Get a pointer to the section `section` in either `textDst` or `dataDst`.
+static ASMJIT_INLINE uint8_t* CodeHolder_getSectionPtr(const SectionEntry* section, uint8_t* textDst, uint8_t* dataDst) noexcept {
+  return (section->isText() ? textDst : dataDst) + section->getOffset();
+}
+
+//! \internal
+//!
+//! Get the address of the section `section` after relocation.
+static ASMJIT_INLINE uint64_t CodeHolder_getSectionAddress(const SectionEntry* section, uint64_t textAddress, uint64_t dataAddress) noexcept {
+  return (section->isText() ? textAddress : dataAddress) + static_cast<uint64_t>(section->getOffset());
+}
+
+//! \internal
+//!
+//! Copy all sections and process all relocations, section offsets must have
+//! been already calculated by `CodeHolder_layoutSections()`.
+static Error CodeHolder_relocateInternal(const CodeHolder* self,
+  uint8_t* textDst, uint64_t textAddress,
+  uint8_t* dataDst, uint64_t dataAddress, size_t& sizeOut) noexcept {
+
+  sizeOut = 0;
 
 #if !defined(ASMJIT_DISABLE_LOGGING)
-  Logger* logger = getLogger();
+  Logger* logger = self->getLogger();
 #endif // ASMJIT_DISABLE_LOGGING
 
-  size_t minCodeSize = section->getBuffer().getLength(); // Minimum code size.
-  size_t maxCodeSize = getCodeSize();                    // Includes all possible trampolines.
+  size_t numSections = self->_sections.getLength();
+  size_t numRelocs = self->_relocations.getLength();
+
+  // Fast path - a single executable section without relocations (the most
+  // common case of small functions) is just copied.
+  if (numSections == 1 && numRelocs == 0) {
+    const SectionEntry* section = self->_sections[0];
+    size_t length = section->getPhysicalSize();
+
+    if (section->isText() && section->getRealSize() == length) {
+      ::memcpy(textDst, section->_buffer._data, length);
+      sizeOut = length;
+      return kErrorOk;
+    }
+  }
+
+  // Copy all sections, the gaps between them and the virtual part of each
+  // section are zero initialized. Extra code for trampolines is generated
+  // on-the-fly by the relocator (this code doesn't exist at the moment).
+  size_t textEnd = 0;
+  size_t dataEnd = 0;
+
+  for (size_t i = 0; i < numSections; i++) {
+    const SectionEntry* section = self->_sections[i];
+
+    size_t& end = section->isText() ? textEnd : dataEnd;
+    uint8_t* p = CodeHolder_getSectionPtr(section, textDst, dataDst);
+
+    size_t offset = section->getOffset();
+    size_t physicalSize = section->getPhysicalSize();
+    size_t realSize = section->getRealSize();
 
-  // We will copy the exact size of the generated code. Extra code for trampolines
-  // is generated on-the-fly by the relocator (this code doesn't exist at the moment).
-  ::memcpy(dst, section->_buffer._data, minCodeSize);
+    if (offset > end)
+      ::memset(p - (offset - end), 0, offset - end);
 
-  // Trampoline offset from the beginning of dst/baseAddress.
-  size_t trampOffset = minCodeSize;
+    if (physicalSize)
+      ::memcpy(p, section->_buffer._data, physicalSize);
+
+    if (realSize > physicalSize)
+      ::memset(p + physicalSize, 0, realSize - physicalSize);
+
+    end = offset + realSize;
+  }
+
+  // Trampoline offset from the beginning of textDst/textAddress.
+  size_t trampOffset = textEnd;
 
   // Relocate all recorded locations.
-  size_t numRelocs = _relocations.getLength();
-  const RelocEntry* const* reArray = _relocations.getData();
+  const RelocEntry* const* reArray = self->_relocations.getData();
 
   for (size_t i = 0; i < numRelocs; i++) {
     const RelocEntry* re = reArray[i];
@@ -594,16 +874,37 @@ size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
     if (re->getType() == RelocEntry::kTypeNone)
       continue;
 
+    // Relocations created without a source section refer to the first one.
+    uint32_t sourceSectionId = re->getSourceSectionId();
+    if (sourceSectionId == SectionEntry::kInvalidId)
+      sourceSectionId = 0;
+
+    const SectionEntry* sourceSection = self->getSectionById(sourceSectionId);
+    if (ASMJIT_UNLIKELY(!sourceSection))
+      return DebugUtils::errored(kErrorInvalidRelocEntry);
+
+    // Relocations without a target section are relative to the source section.
+    const SectionEntry* targetSection = sourceSection;
+    if (re->getTargetSectionId() != SectionEntry::kInvalidId) {
+      targetSection = self->getSectionById(re->getTargetSectionId());
+      if (ASMJIT_UNLIKELY(!targetSection))
+        return DebugUtils::errored(kErrorInvalidRelocEntry);
+    }
+
     uint64_t ptr = re->getData();
     size_t codeOffset = static_cast<size_t>(re->getSourceOffset());
 
     // Make sure that the `RelocEntry` is correct, we don't want to write
-    // out of bounds in `dst`.
-    if (ASMJIT_UNLIKELY(codeOffset + re->getSize() > maxCodeSize))
+    // out of bounds of the source section.
+    if (ASMJIT_UNLIKELY(codeOffset + re->getSize() > sourceSection->getPhysicalSize()))
       return DebugUtils::errored(kErrorInvalidRelocEntry);
 
+    uint8_t* dst = CodeHolder_getSectionPtr(sourceSection, textDst, dataDst);
+    uint64_t sourceAddress = CodeHolder_getSectionAddress(sourceSection, textAddress, dataAddress) + re->getSourceOffset();
+
     // Whether to use trampoline, can be only used if relocation type is `kRelocTrampoline`.
     bool useTrampoline = false;
+    size_t slotOffset = 0;
 
     switch (re->getType()) {
       case RelocEntry::kTypeAbsToAbs: {
@@ -611,22 +912,37 @@ size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
       }
 
       case RelocEntry::kTypeRelToAbs: {
-        ptr += baseAddress;
+        ptr += CodeHolder_getSectionAddress(targetSection, textAddress, dataAddress);
         break;
       }
 
       case RelocEntry::kTypeAbsToRel: {
-        ptr -= baseAddress + re->getSourceOffset() + re->getSize();
+        if (re->getTargetSectionId() != SectionEntry::kInvalidId)
+          ptr += CodeHolder_getSectionAddress(targetSection, textAddress, dataAddress);
+        ptr -= sourceAddress + re->getSize();
+
+        // The target must be reachable, a truncated displacement would
+        // silently address something else.
+        if (ASMJIT_UNLIKELY(re->getSize() == 4 && !Utils::isInt32(static_cast<int64_t>(ptr))))
+          return DebugUtils::errored(kErrorInvalidDisplacement);
+        if (ASMJIT_UNLIKELY(re->getSize() == 1 && !Utils::isInt8(static_cast<int64_t>(ptr))))
+          return DebugUtils::errored(kErrorInvalidDisplacement);
         break;
       }
 
       case RelocEntry::kTypeTrampoline: {
-        if (re->getSize() != 4)
+        if (re->getSize() != 4 || !sourceSection->isText())
           return DebugUtils::errored(kErrorInvalidRelocEntry);
 
-        ptr -= baseAddress + re->getSourceOffset() + re->getSize();
+        ptr -= sourceAddress + re->getSize();
         if (!Utils::isInt32(static_cast<int64_t>(ptr))) {
-          ptr = (uint64_t)trampOffset - re->getSourceOffset() - re->getSize();
+          // Trampolines are shared by all jumps and calls to the same target,
+          // so find an existing slot first or use a new one at `trampOffset`.
+          slotOffset = textEnd;
+          while (slotOffset < trampOffset && Utils::readU64u(textDst + slotOffset) != re->getData())
+            slotOffset += 8;
+
+          ptr = textAddress + (uint64_t)slotOffset - sourceAddress - re->getSize();
           useTrampoline = true;
         }
         break;
@@ -676,19 +992,79 @@ size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
       dst[codeOffset - 2] = static_cast<uint8_t>(byte0);
       dst[codeOffset - 1] = static_cast<uint8_t>(byte1);
 
-      // Store absolute address and advance the trampoline pointer.
-      Utils::writeU64u(dst + trampOffset, re->getData());
-      trampOffset += 8;
+      // Store absolute address and advance the trampoline pointer if this
+      // is a new slot.
+      if (slotOffset == trampOffset) {
+        Utils::writeU64u(textDst + trampOffset, re->getData());
+        trampOffset += 8;
 
 #if !defined(ASMJIT_DISABLE_LOGGING)
-      if (logger)
-        logger->logf("[reloc] dq 0x%016llX ; Trampoline\n", re->getData());
+        if (logger)
+          logger->logf("[reloc] dq 0x%016llX ; Trampoline\n", re->getData());
 #endif // !ASMJIT_DISABLE_LOGGING
+      }
     }
   }
 
-  // If there are no trampolines this is the same as `minCodeSize`.
-  return trampOffset;
+  // If there are no trampolines this is the same as the size of all
+  // executable sections.
+  sizeOut = trampOffset;
+  return kErrorOk;
+}
+
+// TODO: This should go to Runtime as it's responsible for relocating the
+//       code, CodeHolder should just hold it.
+size_t CodeHolder::relocate(void* _dst, uint64_t baseAddress) const noexcept {
+  uint8_t* dst = static_cast<uint8_t*>(_dst);
+  if (baseAddress == Globals::kNoBaseAddress)
+    baseAddress = static_cast<uint64_t>((uintptr_t)dst);
+
+  // Reflect all changes first.
+  const_cast<CodeHolder*>(this)->sync();
+
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+
+  // Data sections are placed after the text region (including the space
+  // reserved for trampolines, which is not shrinkable in this case).
+  size_t dataOffset = Utils::alignTo<size_t>(textSize, dataAlignment);
+  size_t textUsed;
+
+  if (CodeHolder_relocateInternal(this, dst, baseAddress, dst + dataOffset, baseAddress + dataOffset, textUsed) != kErrorOk)
+    return 0;
+
+  if (dataSize == 0 || textUsed > dataOffset)
+    return textUsed;
+
+  ::memset(dst + textUsed, 0, dataOffset - textUsed);
+  return dataOffset + dataSize;
+}
+
+size_t CodeHolder::relocate(void* textDst, uint64_t textAddress, void* dataDst, uint64_t dataAddress) const noexcept {
+  size_t textUsed;
+  if (_relocate(textDst, textAddress, dataDst, dataAddress, textUsed) != kErrorOk)
+    return 0;
+  return textUsed;
+}
+
+Error CodeHolder::_relocate(void* textDst, uint64_t textAddress, void* dataDst, uint64_t dataAddress, size_t& textUsed) const noexcept {
+  if (textAddress == Globals::kNoBaseAddress)
+    textAddress = static_cast<uint64_t>((uintptr_t)textDst);
+
+  if (dataAddress == Globals::kNoBaseAddress)
+    dataAddress = static_cast<uint64_t>((uintptr_t)dataDst);
+
+  // Reflect all changes first.
+  const_cast<CodeHolder*>(this)->sync();
+
+  size_t textSize, dataSize;
+  uint32_t dataAlignment;
+  CodeHolder_layoutSections(this, textSize, dataSize, dataAlignment);
+
+  return CodeHolder_relocateInternal(this,
+    static_cast<uint8_t*>(textDst), textAddress,
+    static_cast<uint8_t*>(dataDst), dataAddress, textUsed);
 }
 
 } // asmjit namespace
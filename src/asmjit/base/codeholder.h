@@ -103,6 +103,18 @@ public:
 //! code generation mode (or optimization level), and base address.
 class CodeInfo {
 public:
+  //! Code flags.
+  ASMJIT_ENUM(Flags) {
+    //! Generate position-independent code.
+    //!
+    //! The code never references its own absolute address and can be placed
+    //! anywhere without relocating it. Labels and constant pools are addressed
+    //! RIP-relative, `embedLabel()` emits 32-bit offsets relative to the entry
+    //! itself, and all constructs that need absolute addresses (including jumps
+    //! and calls to absolute targets) fail with `kErrorNotPositionIndependent`.
+    kFlagPIC = 0x00000001U
+  };
+
   // --------------------------------------------------------------------------
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
@@ -113,12 +125,16 @@ public:
       _cdeclCallConv(CallConv::kIdNone),
       _stdCallConv(CallConv::kIdNone),
       _fastCallConv(CallConv::kIdNone),
+      _flags(0),
+      _reserved(0),
       _baseAddress(Globals::kNoBaseAddress) {}
   ASMJIT_INLINE CodeInfo(const CodeInfo& other) noexcept { init(other); }
 
   explicit ASMJIT_INLINE CodeInfo(uint32_t archType, uint32_t archMode = 0, uint64_t baseAddress = Globals::kNoBaseAddress) noexcept
     : _archInfo(archType, archMode),
       _packedMiscInfo(0),
+      _flags(0),
+      _reserved(0),
       _baseAddress(baseAddress) {}
 
   // --------------------------------------------------------------------------
@@ -132,12 +148,16 @@ public:
   ASMJIT_INLINE void init(const CodeInfo& other) noexcept {
     _archInfo = other._archInfo;
     _packedMiscInfo = other._packedMiscInfo;
+    _flags = other._flags;
+    _reserved = 0;
     _baseAddress = other._baseAddress;
   }
 
   ASMJIT_INLINE void init(uint32_t archType, uint32_t archMode = 0, uint64_t baseAddress = Globals::kNoBaseAddress) noexcept {
     _archInfo.init(archType, archMode);
     _packedMiscInfo = 0;
+    _flags = 0;
+    _reserved = 0;
     _baseAddress = baseAddress;
   }
 
@@ -147,6 +167,8 @@ public:
     _cdeclCallConv = CallConv::kIdNone;
     _stdCallConv = CallConv::kIdNone;
     _fastCallConv = CallConv::kIdNone;
+    _flags = 0;
+    _reserved = 0;
     _baseAddress = Globals::kNoBaseAddress;
   }
 
@@ -184,6 +206,22 @@ public:
   ASMJIT_INLINE uint32_t getFastCallConv() const noexcept { return _fastCallConv; }
   ASMJIT_INLINE void setFastCallConv(uint32_t cc) noexcept { _fastCallConv = static_cast<uint8_t>(cc); }
 
+  // --------------------------------------------------------------------------
+  // [Flags]
+  // --------------------------------------------------------------------------
+
+  //! Get code flags, see \ref Flags.
+  ASMJIT_INLINE uint32_t getFlags() const noexcept { return _flags; }
+  //! Get if the code has the given `flag` set, see \ref Flags.
+  ASMJIT_INLINE bool hasFlag(uint32_t flag) const noexcept { return (_flags & flag) != 0; }
+  //! Add `flags`, see \ref Flags.
+  ASMJIT_INLINE void addFlags(uint32_t flags) noexcept { _flags |= flags; }
+  //! Clear `flags`, see \ref Flags.
+  ASMJIT_INLINE void clearFlags(uint32_t flags) noexcept { _flags &= ~flags; }
+
+  //! Get if the code is position independent, see \ref kFlagPIC.
+  ASMJIT_INLINE bool isPIC() const noexcept { return hasFlag(kFlagPIC); }
+
   // --------------------------------------------------------------------------
   // [Addressing Information]
   // --------------------------------------------------------------------------
@@ -217,6 +255,8 @@ public:
     uint32_t _packedMiscInfo;            //!< \internal
   };
 
+  uint32_t _flags;                       //!< Code flags, see \ref Flags.
+  uint32_t _reserved;                    //!< \internal
   uint64_t _baseAddress;                 //!< Base address.
 };
 
@@ -262,6 +302,10 @@ public:
     kInvalidId       = 0xFFFFFFFFU       //!< Invalid section id.
   };
 
+  ASMJIT_ENUM(Limits) {
+    kMaxNameLength   = 35                //!< Maximum length of a section name.
+  };
+
   //! Section flags.
   ASMJIT_ENUM(Flags) {
     kFlagExec        = 0x00000001U,      //!< Executable (.text sections).
@@ -293,11 +337,25 @@ public:
   ASMJIT_INLINE uint32_t getAlignment() const noexcept { return _alignment; }
   ASMJIT_INLINE void setAlignment(uint32_t alignment) noexcept { _alignment = alignment; }
 
+  //! Get if the section is placed in the code region (executable sections).
+  ASMJIT_INLINE bool isText() const noexcept { return hasFlag(kFlagExec); }
+
   ASMJIT_INLINE size_t getPhysicalSize() const noexcept { return _buffer.getLength(); }
 
   ASMJIT_INLINE size_t getVirtualSize() const noexcept { return _virtualSize; }
   ASMJIT_INLINE void setVirtualSize(uint32_t size) noexcept { _virtualSize = size; }
 
+  //! Get the size the section occupies after relocation, which is the greater
+  //! of its physical and virtual size (the rest is zero initialized).
+  ASMJIT_INLINE size_t getRealSize() const noexcept {
+    size_t length = _buffer.getLength();
+    return length > _virtualSize ? length : static_cast<size_t>(_virtualSize);
+  }
+
+  //! Get the offset of the section relative to the start of its region (text
+  //! or data), only valid after `CodeHolder::getCodeSize()` or `relocate()`.
+  ASMJIT_INLINE size_t getOffset() const noexcept { return _offset; }
+
   ASMJIT_INLINE CodeBuffer& getBuffer() noexcept { return _buffer; }
   ASMJIT_INLINE const CodeBuffer& getBuffer() const noexcept { return _buffer; }
 
@@ -309,6 +367,7 @@ public:
   uint32_t _flags;                       //!< Section flags.
   uint32_t _alignment;                   //!< Section alignment requirements (0 if no requirements).
   uint32_t _virtualSize;                 //!< Virtual size of the section (zero initialized mostly).
+  size_t _offset;                        //!< Offset of the section in its region, calculated by the layout.
   union {
     char _name[36];                      //!< Section name (max 35 characters, PE allows max 8).
     uint32_t _nameAsU32[36 / 4];         //!< Section name as `uint32_t[]` (only optimization).
@@ -402,9 +461,10 @@ public:
   // [Members]
   // ------------------------------------------------------------------------
 
-  // Let's round the size of `LabelEntry` to 64 bytes (as ZoneHeap has 32
-  // bytes granularity anyway). This gives `_name` the remaining space, which
-  // is roughly 16 bytes on 64-bit and 28 bytes on 32-bit architectures.
+  // Let's round the size of `LabelEntry` to 64 bytes, which is a cache line.
+  // Entries are stored in blocks aligned to 64 bytes, so each label occupies
+  // exactly one cache line. This gives `_name` the remaining space, which is
+  // roughly 16 bytes on 64-bit and 28 bytes on 32-bit architectures.
   enum { kNameBytes = 64 - (sizeof(ZoneHashNode) + 16 + sizeof(intptr_t) + sizeof(LabelLink*)) };
 
   uint8_t _type;                         //!< Label type, see Label::Type.
@@ -466,6 +526,34 @@ struct RelocEntry {
   uint64_t _data;                        //!< Relocation data (target offset, target address, etc).
 };
 
+// ============================================================================
+// [asmjit::TrampolineEntry]
+// ============================================================================
+
+//! Trampoline entry.
+//!
+//! Represents a unique absolute address targeted by jumps and calls that may
+//! require a trampoline (see `RelocEntry::kTypeTrampoline`). All of them share
+//! a single trampoline, so it's enough to reserve space for each unique target.
+class TrampolineEntry : public ZoneHashNode {
+public:
+  // ------------------------------------------------------------------------
+  // [Accessors]
+  // ------------------------------------------------------------------------
+
+  //! Get the absolute target address.
+  ASMJIT_INLINE uint64_t getAddress() const noexcept { return _address; }
+  //! Get the id of the first relocation entry that targeted the address.
+  ASMJIT_INLINE uint32_t getRelocId() const noexcept { return _relocId; }
+
+  // ------------------------------------------------------------------------
+  // [Members]
+  // ------------------------------------------------------------------------
+
+  uint64_t _address;                     //!< Absolute target address.
+  uint32_t _relocId;                     //!< Id of the first relocation entry.
+};
+
 // ============================================================================
 // [asmjit::CodeHolder]
 // ============================================================================
@@ -482,6 +570,13 @@ class CodeHolder {
 public:
   ASMJIT_NONCOPYABLE(CodeHolder)
 
+  //! Label entries are allocated in blocks of `kLabelBlockSize` entries, which
+  //! keeps them dense in memory and makes the lookup of a label by id cheap.
+  ASMJIT_ENUM(LabelBlock) {
+    kLabelBlockShift = 6,
+    kLabelBlockSize  = 1 << kLabelBlockShift
+  };
+
   // --------------------------------------------------------------------------
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
@@ -550,19 +645,42 @@ public:
   //! Get global options, internally propagated to all `CodeEmitter`s attached.
   ASMJIT_INLINE uint32_t getGlobalOptions() const noexcept { return _globalOptions; }
 
+  //! Get if the global hint `hint` is enabled, see \ref CodeEmitter::Hints.
+  ASMJIT_INLINE bool hasGlobalHint(uint32_t hint) const noexcept { return (_globalHints & hint) != 0; }
+  //! Enable global `hints` and propagate them to all `CodeEmitter`s attached.
+  ASMJIT_API void addGlobalHints(uint32_t hints) noexcept;
+  //! Disable global `hints` and propagate them to all `CodeEmitter`s attached.
+  ASMJIT_API void clearGlobalHints(uint32_t hints) noexcept;
+
   // --------------------------------------------------------------------------
   // [Result Information]
   // --------------------------------------------------------------------------
 
   //! Get the size code & data of all sections.
+  //!
+  //! This is the size required by `relocate(dst, baseAddress)`, which places
+  //! all executable sections (and trampolines) first and all remaining data
+  //! sections after them.
   ASMJIT_API size_t getCodeSize() const noexcept;
 
+  //! Get the size of all executable sections including all possible trampolines.
+  ASMJIT_API size_t getTextSize() const noexcept;
+  //! Get the size of all non-executable sections (`.rodata`, `.data`, `.bss`).
+  ASMJIT_API size_t getDataSize() const noexcept;
+  //! Get the alignment required by the data region (at least 1).
+  ASMJIT_API uint32_t getDataAlignment() const noexcept;
+
   //! Get size of all possible trampolines.
   //!
   //! Trampolines are needed to successfully generate relative jumps to absolute
   //! addresses. This value is only non-zero if jmp of call instructions were
   //! used with immediate operand (this means jumping or calling an absolute
   //! address directly).
+  //!
+  //! Space is reserved for each unique target address as the relocator shares
+  //! a single trampoline between all jumps and calls to the same address. The
+  //! relocator doesn't use trampolines for targets within a 32-bit displacement
+  //! so the size used can be smaller.
   ASMJIT_INLINE size_t getTrampolinesSize() const noexcept { return _trampolinesSize; }
 
   // --------------------------------------------------------------------------
@@ -599,6 +717,24 @@ public:
   //! Get a section entry of the given index.
   ASMJIT_INLINE SectionEntry* getSectionEntry(size_t index) const noexcept { return _sections[index]; }
 
+  //! Get a section entry of the given `id` or null if the id is not valid.
+  ASMJIT_INLINE SectionEntry* getSectionById(uint32_t id) const noexcept {
+    return id < _sections.getLength() ? _sections[id] : static_cast<SectionEntry*>(nullptr);
+  }
+
+  //! Get a section entry by `name` or null if there is no such section.
+  ASMJIT_API SectionEntry* getSectionByName(const char* name, size_t nameLength = Globals::kInvalidIndex) const noexcept;
+
+  //! Create a new section called `name` having the given `flags` and `alignment`.
+  //!
+  //! Sections that don't have `SectionEntry::kFlagExec` are placed after all
+  //! executable sections by `relocate()` and `JitRuntime` places them into
+  //! non-executable memory. Sections having `SectionEntry::kFlagZero` may
+  //! be empty and only specify their virtual size.
+  //!
+  //! Returns `Error`, does not report error to \ref ErrorHandler.
+  ASMJIT_API Error newSection(SectionEntry** sectionOut, const char* name, size_t nameLength = Globals::kInvalidIndex, uint32_t flags = 0, uint32_t alignment = 1) noexcept;
+
   ASMJIT_API Error growBuffer(CodeBuffer* cb, size_t n) noexcept;
   ASMJIT_API Error reserveBuffer(CodeBuffer* cb, size_t n) noexcept;
 
@@ -624,11 +760,15 @@ public:
   //! Returns `null` if the allocation failed.
   ASMJIT_API LabelLink* newLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel) noexcept;
 
-  //! Get array of `LabelEntry*` records.
-  ASMJIT_INLINE const ZoneVector<LabelEntry*>& getLabelEntries() const noexcept { return _labels; }
+  //! Release a label-link that is no longer used, it will be reused by
+  //! `newLabelLink()`.
+  ASMJIT_INLINE void releaseLabelLink(LabelLink* link) noexcept {
+    link->prev = _labelLinkPool;
+    _labelLinkPool = link;
+  }
 
   //! Get number of labels created.
-  ASMJIT_INLINE size_t getLabelsCount() const noexcept { return _labels.getLength(); }
+  ASMJIT_INLINE size_t getLabelsCount() const noexcept { return _labelsCount; }
 
   //! Get number of label references, which are unresolved at the moment.
   ASMJIT_INLINE size_t getUnresolvedLabelsCount() const noexcept { return _unresolvedLabelsCount; }
@@ -640,7 +780,7 @@ public:
   //! Get if the label having `id` is valid (i.e. created by `newLabelId()`).
   ASMJIT_INLINE bool isLabelValid(uint32_t labelId) const noexcept {
     size_t index = Operand::unpackId(labelId);
-    return index < _labels.getLength();
+    return index < _labelsCount;
   }
 
   //! Get if the `label` is already bound.
@@ -652,7 +792,7 @@ public:
   //! \overload
   ASMJIT_INLINE bool isLabelBound(uint32_t id) const noexcept {
     size_t index = Operand::unpackId(id);
-    return index < _labels.getLength() && _labels[index]->isBound();
+    return index < _labelsCount && getLabelEntryAt(index)->isBound();
   }
 
   //! Get a `label` offset or -1 if the label is not yet bound.
@@ -662,7 +802,7 @@ public:
   //! \overload
   ASMJIT_INLINE intptr_t getLabelOffset(uint32_t id) const noexcept {
     ASMJIT_ASSERT(isLabelValid(id));
-    return _labels[Operand::unpackId(id)]->getOffset();
+    return getLabelEntryAt(Operand::unpackId(id))->getOffset();
   }
 
   //! Get information about the given `label`.
@@ -672,7 +812,16 @@ public:
   //! Get information about a label having the given `id`.
   ASMJIT_INLINE LabelEntry* getLabelEntry(uint32_t id) const noexcept {
     size_t index = static_cast<size_t>(Operand::unpackId(id));
-    return index < _labels.getLength() ? _labels[index] : static_cast<LabelEntry*>(nullptr);
+    return index < _labelsCount ? getLabelEntryAt(index) : static_cast<LabelEntry*>(nullptr);
+  }
+
+  //! Get a label entry at `index` (index of the label, not its id).
+  //!
+  //! Together with `getLabelsCount()` this iterates all labels, entries are
+  //! stored in blocks of `kLabelBlockSize`.
+  ASMJIT_INLINE LabelEntry* getLabelEntryAt(size_t index) const noexcept {
+    ASMJIT_ASSERT(index < _labelsCount);
+    return _labelBlocks[index >> kLabelBlockShift] + (index & (kLabelBlockSize - 1));
   }
 
   // --------------------------------------------------------------------------
@@ -686,11 +835,45 @@ public:
 
   //! Get if the code contains relocations.
   ASMJIT_INLINE bool hasRelocations() const noexcept { return !_relocations.isEmpty(); }
+
+  //! Get if the code contains a relocation of the given `type`.
+  //!
+  //! Relocation types are tracked when relocation entries are created, it's
+  //! possible that an entry of the type was deleted afterwards.
+  ASMJIT_INLINE bool hasRelocType(uint32_t type) const noexcept { return (_relocTypes & (1U << type)) != 0; }
+
+  //! Turn `re` into a `RelocEntry::kTypeTrampoline` relocation.
+  //!
+  //! Reserves space for a trampoline if there is no trampoline of the same
+  //! target address yet, see \ref getTrampolinesSize().
+  ASMJIT_API Error addTrampoline(RelocEntry* re) noexcept;
+
+  //! \internal
+  //!
+  //! Remove a trampoline relocation `re` which is about to be deleted.
+  ASMJIT_API void _removeTrampoline(RelocEntry* re) noexcept;
   //! Get array of `RelocEntry*` records.
   ASMJIT_INLINE const ZoneVector<RelocEntry*>& getRelocEntries() const noexcept { return _relocations; }
 
   ASMJIT_INLINE RelocEntry* getRelocEntry(uint32_t id) const noexcept { return _relocations[id]; }
 
+  // --------------------------------------------------------------------------
+  // [Patch Sites]
+  // --------------------------------------------------------------------------
+
+  //! Record a patch site bound to a label `labelId`.
+  //!
+  //! Patch sites are instructions that can be atomically rewritten after the
+  //! code was relocated, see \ref JitRuntime::patchSite(). Each site must not
+  //! cross an 8-byte boundary, so the alignment of the first section is raised
+  //! to at least 8 bytes by this function.
+  ASMJIT_API Error addPatchSite(uint32_t labelId) noexcept;
+
+  //! Get count of patch sites.
+  ASMJIT_INLINE size_t getPatchSitesCount() const noexcept { return _patchSites.getLength(); }
+  //! Get array of label ids of all patch sites.
+  ASMJIT_INLINE const ZoneVector<uint32_t>& getPatchSites() const noexcept { return _patchSites; }
+
   //! Relocate the code to `baseAddress` and copy it to `dst`.
   //!
   //! \param dst Contains the location where the relocated code should be
@@ -707,8 +890,29 @@ public:
   //!
   //! A given buffer will be overwritten, to get the number of bytes required,
   //! use `getCodeSize()`.
+  //!
+  //! Returns zero if the code can't be relocated, for example if a relative
+  //! displacement doesn't fit into its field.
   ASMJIT_API size_t relocate(void* dst, uint64_t baseAddress = Globals::kNoBaseAddress) const noexcept;
 
+  //! Relocate the code into two separate regions - executable sections go to
+  //! `textDst` (relocated to `textAddress`) and all other sections go to
+  //! `dataDst` (relocated to `dataAddress`).
+  //!
+  //! The regions must be at least `getTextSize()` and `getDataSize()` bytes
+  //! long. Returns the number of bytes used by the text region, see the other
+  //! `relocate()` overload for more details.
+  ASMJIT_API size_t relocate(void* textDst, uint64_t textAddress, void* dataDst, uint64_t dataAddress) const noexcept;
+
+  //! \internal
+  //!
+  //! Same as `relocate(textDst, textAddress, dataDst, dataAddress)`, but
+  //! returns the reason of a failure, for example `kErrorInvalidDisplacement`
+  //! if a RIP-relative reference from text to data (or to an absolute target)
+  //! is out of the +-2GB range. The number of bytes used by the text region
+  //! is stored to `textUsed`.
+  ASMJIT_API Error _relocate(void* textDst, uint64_t textAddress, void* dataDst, uint64_t dataAddress, size_t& textUsed) const noexcept;
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -724,17 +928,22 @@ public:
   Logger* _logger;                       //!< Attached \ref Logger, used by all consumers.
   ErrorHandler* _errorHandler;           //!< Attached \ref ErrorHandler.
 
+  uint32_t _labelsCount;                 //!< Count of labels created.
   uint32_t _unresolvedLabelsCount;       //!< Count of label references which were not resolved.
   uint32_t _trampolinesSize;             //!< Size of all possible trampolines.
+  uint32_t _relocTypes;                  //!< Mask of all relocation types used (`1 << RelocEntry::Type`).
 
   Zone _baseZone;                        //!< Base zone (used to allocate core structures).
   Zone _dataZone;                        //!< Data zone (used to allocate extra data like label names).
   ZoneHeap _baseHeap;                    //!< Zone allocator, used to manage internal containers.
 
   ZoneVector<SectionEntry*> _sections;   //!< Section entries.
-  ZoneVector<LabelEntry*> _labels;       //!< Label entries (each label is stored here).
+  ZoneVector<LabelEntry*> _labelBlocks;  //!< Blocks of `kLabelBlockSize` label entries.
+  LabelLink* _labelLinkPool;             //!< Pool of label-links released by `releaseLabelLink()`.
   ZoneVector<RelocEntry*> _relocations;  //!< Relocation entries.
+  ZoneVector<uint32_t> _patchSites;      //!< Label ids of patch sites.
   ZoneHash<LabelEntry> _namedLabels;     //!< Label name -> LabelEntry (only named labels).
+  ZoneHash<TrampolineEntry> _trampolines;//!< Target address -> TrampolineEntry.
 };
 
 //! \}
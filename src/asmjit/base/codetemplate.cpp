@@ -0,0 +1,905 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codetemplate.h"
+#include "../base/utils.h"
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+#include "../base/codecompiler.h"
+#endif // !ASMJIT_DISABLE_COMPILER
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+#include "../x86/x86builder.h"
+#include "../x86/x86compiler.h"
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::CBTemplate - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Maximum index of a parameter or local (limited by `Fixup::slot`).
+static const uint32_t CBTemplate_kMaxSlot = 0x00FFFFFFU;
+
+//! \internal
+//!
+//! State of `CBTemplate::record()`.
+struct CBTemplate_RecordState {
+  uint8_t* data;                         //!< Recorded nodes.
+  CodeHolder* code;                      //!< CodeHolder of the source builder.
+#if !defined(ASMJIT_DISABLE_COMPILER)
+  CodeCompiler* cc;                      //!< Source compiler (or null).
+#endif // !ASMJIT_DISABLE_COMPILER
+
+  uint32_t* labelMap;                    //!< Maps label indexes to slots.
+  size_t labelMapSize;                   //!< Size of `labelMap`.
+  uint32_t* regMap;                      //!< Maps virtual register indexes to slots.
+  size_t regMapSize;                     //!< Size of `regMap`.
+};
+
+//! \internal
+//!
+//! Get the size of `node`, or zero if it can't be recorded.
+static uint32_t CBTemplate_getNodeSize(const CBNode* node) noexcept {
+  switch (node->getType()) {
+    case CBNode::kNodeInst:
+      // Edges belong to their jump table, which can't be recorded.
+      if (node->hasFlag(CBNode::kFlagIsEdge))
+        return 0;
+      return node->isJmpOrJcc() ? static_cast<uint32_t>(sizeof(CBJump))
+                                : static_cast<uint32_t>(sizeof(CBInst));
+
+    case CBNode::kNodeData   : return static_cast<uint32_t>(sizeof(CBData));
+    case CBNode::kNodeAlign  : return static_cast<uint32_t>(sizeof(CBAlign));
+    case CBNode::kNodeLabel  : return static_cast<uint32_t>(sizeof(CBLabel));
+    case CBNode::kNodeComment: return static_cast<uint32_t>(sizeof(CBComment));
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+    case CBNode::kNodeFuncExit: return static_cast<uint32_t>(sizeof(CCFuncRet));
+    case CBNode::kNodeHint    : return static_cast<uint32_t>(sizeof(CCHint));
+#endif // !ASMJIT_DISABLE_COMPILER
+
+    default:
+      return 0;
+  }
+}
+
+static ASMJIT_INLINE size_t CBTemplate_alignOffset(size_t offset) noexcept {
+  return Utils::alignTo<size_t>(offset, sizeof(void*));
+}
+
+static ASMJIT_INLINE uint32_t CBTemplate_offsetOf(const CBTemplate_RecordState& s, const void* p) noexcept {
+  return static_cast<uint32_t>(static_cast<const uint8_t*>(p) - s.data);
+}
+
+static void CBTemplate_resetData(CBTemplate* self) noexcept {
+  if (self->_data)
+    self->_heap.release(self->_data, self->_dataSize);
+
+  self->_data = nullptr;
+  self->_dataSize = 0;
+  self->_archType = ArchInfo::kTypeNone;
+  self->_code = nullptr;
+
+  self->_nodes.clear();
+  self->_jumps.clear();
+  self->_localLabels.clear();
+  self->_relocs.clear();
+  self->_fixups.clear();
+  self->_localRegs.clear();
+}
+
+static Error CBTemplate_addFixup(CBTemplate* self, uint32_t offset, uint32_t kind, uint32_t slot) noexcept {
+  CBTemplate::Fixup fixup;
+  fixup.offset = offset;
+  fixup.kind = kind;
+  fixup.slot = slot;
+  return self->_fixups.append(&self->_heap, fixup);
+}
+
+//! \internal
+//!
+//! Store `target` offset to a pointer `field` and remember to relocate it.
+static Error CBTemplate_addReloc(CBTemplate* self, CBTemplate_RecordState& s, void* field, size_t target) noexcept {
+  *static_cast<uintptr_t*>(field) = static_cast<uintptr_t>(target);
+  return self->_relocs.append(&self->_heap, CBTemplate_offsetOf(s, field));
+}
+
+static Error CBTemplate_mapReg(CBTemplate* self, CBTemplate_RecordState& s, uint32_t id, uint32_t& slotOut) noexcept {
+  size_t index = Operand::unpackId(id);
+  if (ASMJIT_UNLIKELY(index >= s.regMapSize))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  uint32_t slot = s.regMap[index];
+  if (slot == kInvalidValue) {
+#if !defined(ASMJIT_DISABLE_COMPILER)
+    // Not a parameter - each instance gets a new virtual register.
+    size_t count = self->_regParams.getLength() + self->_localRegs.getLength();
+    if (ASMJIT_UNLIKELY(count > CBTemplate_kMaxSlot))
+      return DebugUtils::errored(kErrorInvalidState);
+
+    VirtReg* vreg = s.cc->getVirtRegById(id);
+    CBTemplate::LocalReg local;
+
+    local.typeId = vreg->getTypeId();
+    local.signature = vreg->_regInfo.getSignature();
+    local.size = vreg->getSize();
+    local.alignment = vreg->_alignment;
+    local.priority = vreg->_priority;
+    local.isStack = vreg->_isStack;
+    local.reserved = 0;
+    local.name = nullptr;
+
+    const char* name = vreg->getName();
+    if (name && name[0] != '\0') {
+      local.name = static_cast<const char*>(self->_zone.dup(name, ::strlen(name), true));
+      if (ASMJIT_UNLIKELY(!local.name))
+        return DebugUtils::errored(kErrorNoHeapMemory);
+    }
+
+    ASMJIT_PROPAGATE(self->_localRegs.append(&self->_heap, local));
+    slot = static_cast<uint32_t>(count);
+    s.regMap[index] = slot;
+#else
+    ASMJIT_UNUSED(self);
+    return DebugUtils::errored(kErrorInvalidState);
+#endif // !ASMJIT_DISABLE_COMPILER
+  }
+
+  slotOut = slot;
+  return kErrorOk;
+}
+
+static Error CBTemplate_recordReg(CBTemplate* self, CBTemplate_RecordState& s, uint32_t* field) noexcept {
+  uint32_t slot;
+  ASMJIT_PROPAGATE(CBTemplate_mapReg(self, s, *field, slot));
+  return CBTemplate_addFixup(self, CBTemplate_offsetOf(s, field), CBTemplate::kFixupReg, slot);
+}
+
+static Error CBTemplate_recordLabel(CBTemplate* self, CBTemplate_RecordState& s, uint32_t* field) noexcept {
+  size_t index = Operand::unpackId(*field);
+  if (ASMJIT_UNLIKELY(index >= s.labelMapSize))
+    return DebugUtils::errored(kErrorInvalidLabel);
+
+  uint32_t slot = s.labelMap[index];
+  if (slot == kInvalidValue) {
+    // Neither a parameter nor bound in the range, the label is kept.
+    self->_code = s.code;
+    return kErrorOk;
+  }
+
+  return CBTemplate_addFixup(self, CBTemplate_offsetOf(s, field), CBTemplate::kFixupLabel, slot);
+}
+
+static Error CBTemplate_recordOp(CBTemplate* self, CBTemplate_RecordState& s, Operand_* op) noexcept {
+  if (op->isReg()) {
+    if (Operand::isPackedId(op->_reg.id))
+      ASMJIT_PROPAGATE(CBTemplate_recordReg(self, s, &op->_reg.id));
+  }
+  else if (op->isMem()) {
+    const Mem* mem = static_cast<const Mem*>(op);
+
+    if (mem->hasBaseLabel())
+      ASMJIT_PROPAGATE(CBTemplate_recordLabel(self, s, &op->_mem.base));
+    else if (mem->hasBaseReg() && Operand::isPackedId(mem->getBaseId()))
+      ASMJIT_PROPAGATE(CBTemplate_recordReg(self, s, &op->_mem.base));
+
+    if (mem->hasIndexReg() && Operand::isPackedId(mem->getIndexId()))
+      ASMJIT_PROPAGATE(CBTemplate_recordReg(self, s, &op->_mem.index));
+  }
+  else if (op->isLabel()) {
+    ASMJIT_PROPAGATE(CBTemplate_recordLabel(self, s, &op->_label.id));
+  }
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Copy nodes `[first, last]` to `s.data` and record everything `instantiate()`
+//! has to patch. The layout must match the size computed by `record()`.
+static Error CBTemplate_recordNodes(CBTemplate* self, CBTemplate_RecordState& s, CBNode* first, CBNode* last) noexcept {
+  uint8_t* data = s.data;
+  size_t offset = 0;
+  size_t prevOffset = 0;
+  size_t immCount = self->_immParams.getLength();
+  size_t immFound = 0;
+
+  CBNode* node = first;
+  for (;;) {
+    uint32_t nodeSize = CBTemplate_getNodeSize(node);
+    size_t nodeOffset = CBTemplate_alignOffset(offset);
+
+    CBNode* copy = reinterpret_cast<CBNode*>(data + nodeOffset);
+    ::memcpy(copy, node, nodeSize);
+    offset = nodeOffset + nodeSize;
+
+    copy->_prev = nullptr;
+    copy->_next = nullptr;
+    copy->_passData = nullptr;
+
+    if (node != first) {
+      CBNode* prev = reinterpret_cast<CBNode*>(data + prevOffset);
+      ASMJIT_PROPAGATE(CBTemplate_addReloc(self, s, &copy->_prev, prevOffset));
+      ASMJIT_PROPAGATE(CBTemplate_addReloc(self, s, &prev->_next, nodeOffset));
+    }
+    ASMJIT_PROPAGATE(self->_nodes.append(&self->_heap, static_cast<uint32_t>(nodeOffset)));
+
+    switch (node->getType()) {
+      case CBNode::kNodeInst: {
+        CBInst* inst = copy->as<CBInst>();
+        uint32_t opCount = inst->getOpCount();
+
+        Operand* opArray = reinterpret_cast<Operand*>(data + offset);
+        if (opCount)
+          ::memcpy(opArray, node->as<CBInst>()->getOpArray(), opCount * sizeof(Operand));
+
+        ASMJIT_PROPAGATE(CBTemplate_addReloc(self, s, &inst->_opArray, offset));
+        offset += opCount * sizeof(Operand);
+
+        for (uint32_t i = 0; i < opCount; i++)
+          ASMJIT_PROPAGATE(CBTemplate_recordOp(self, s, &opArray[i]));
+
+        RegOnly& extraReg = inst->getExtraReg();
+        if (extraReg.isValid() && extraReg.isVirtReg())
+          ASMJIT_PROPAGATE(CBTemplate_recordReg(self, s, &extraReg._id));
+
+        for (size_t i = 0; i < immCount; i++) {
+          const CBTemplate::ImmParam& param = self->_immParams[i];
+          if (param.node != node) continue;
+
+          Operand& op = opArray[param.opIndex];
+          uint32_t kind = op.isImm() ? CBTemplate::kFixupImm : CBTemplate::kFixupDisp;
+          ASMJIT_PROPAGATE(CBTemplate_addFixup(self, CBTemplate_offsetOf(s, &op), kind, static_cast<uint32_t>(i)));
+          immFound++;
+        }
+
+        if (inst->isJmpOrJcc()) {
+          // Only jumps linked to their targets are linked again.
+          CBJump* jump = inst->as<CBJump>();
+          if (jump->_target)
+            ASMJIT_PROPAGATE(self->_jumps.append(&self->_heap, static_cast<uint32_t>(nodeOffset)));
+
+          jump->_target = nullptr;
+          jump->_jumpNext = nullptr;
+        }
+        break;
+      }
+
+      case CBNode::kNodeData: {
+        CBData* dataNode = copy->as<CBData>();
+        uint32_t size = dataNode->getSize();
+
+        if (size > CBData::kInlineBufferSize) {
+          ::memcpy(data + offset, node->as<CBData>()->getData(), size);
+          ASMJIT_PROPAGATE(CBTemplate_addReloc(self, s, &dataNode->_externalPtr, offset));
+          offset += size;
+        }
+        break;
+      }
+
+      case CBNode::kNodeLabel: {
+        CBLabel* label = copy->as<CBLabel>();
+        label->_numRefs = 0;
+        label->_from = nullptr;
+        ASMJIT_PROPAGATE(self->_localLabels.append(&self->_heap, static_cast<uint32_t>(nodeOffset)));
+        break;
+      }
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+      case CBNode::kNodeFuncExit: {
+        CCFuncRet* ret = copy->as<CCFuncRet>();
+        ASMJIT_PROPAGATE(CBTemplate_recordOp(self, s, &ret->_ret[0]));
+        ASMJIT_PROPAGATE(CBTemplate_recordOp(self, s, &ret->_ret[1]));
+        break;
+      }
+
+      case CBNode::kNodeHint: {
+        CCHint* hint = copy->as<CCHint>();
+        if (hint->_vreg) {
+          uint32_t slot;
+          ASMJIT_PROPAGATE(CBTemplate_mapReg(self, s, hint->_vreg->getId(), slot));
+          ASMJIT_PROPAGATE(CBTemplate_addFixup(self, CBTemplate_offsetOf(s, &hint->_vreg), CBTemplate::kFixupVirtReg, slot));
+        }
+        break;
+      }
+#endif // !ASMJIT_DISABLE_COMPILER
+    }
+
+    // Inline comments (and text of `CBComment`) are copied as well, the
+    // source builder can be destroyed before the template is instantiated.
+    if (node->_inlineComment) {
+      size_t len = ::strlen(node->_inlineComment) + 1;
+      ::memcpy(data + offset, node->_inlineComment, len);
+      ASMJIT_PROPAGATE(CBTemplate_addReloc(self, s, &copy->_inlineComment, offset));
+      offset += len;
+    }
+
+    prevOffset = nodeOffset;
+    if (node == last) break;
+    node = node->getNext();
+  }
+
+  // All immediate parameters must reference a node in the range.
+  if (ASMJIT_UNLIKELY(immFound != immCount))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_ASSERT(offset == self->_dataSize);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::CBTemplate - Construction / Destruction]
+// ============================================================================
+
+CBTemplate::CBTemplate() noexcept
+  : _zone(8192 - Zone::kZoneOverhead),
+    _heap(&_zone),
+    _data(nullptr),
+    _dataSize(0),
+    _archType(ArchInfo::kTypeNone),
+    _code(nullptr) {}
+CBTemplate::~CBTemplate() noexcept {}
+
+// ============================================================================
+// [asmjit::CBTemplate - Reset]
+// ============================================================================
+
+void CBTemplate::reset(bool releaseMemory) noexcept {
+  _regParams.reset();
+  _labelParams.reset();
+  _immParams.reset();
+
+  _nodes.reset();
+  _jumps.reset();
+  _localLabels.reset();
+  _relocs.reset();
+  _fixups.reset();
+  _localRegs.reset();
+
+  _heap.reset(&_zone);
+  _zone.reset(releaseMemory);
+
+  _data = nullptr;
+  _dataSize = 0;
+  _archType = ArchInfo::kTypeNone;
+  _code = nullptr;
+}
+
+// ============================================================================
+// [asmjit::CBTemplate - Parameters]
+// ============================================================================
+
+Error CBTemplate::addRegParam(const Reg& reg) noexcept {
+  if (ASMJIT_UNLIKELY(_data))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  if (ASMJIT_UNLIKELY(!reg.isVirtReg()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  return _regParams.append(&_heap, reg);
+}
+
+Error CBTemplate::addLabelParam(const Label& label) noexcept {
+  if (ASMJIT_UNLIKELY(_data))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  if (ASMJIT_UNLIKELY(!label.isValid()))
+    return DebugUtils::errored(kErrorInvalidLabel);
+
+  return _labelParams.append(&_heap, label.getId());
+}
+
+Error CBTemplate::addImmParam(CBNode* node, uint32_t opIndex) noexcept {
+  if (ASMJIT_UNLIKELY(_data))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  if (ASMJIT_UNLIKELY(node->getType() != CBNode::kNodeInst || opIndex >= node->as<CBInst>()->getOpCount()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  const Operand& op = node->as<CBInst>()->getOpArray()[opIndex];
+  if (ASMJIT_UNLIKELY(!op.isImm() && !op.isMem()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ImmParam param;
+  param.node = node;
+  param.opIndex = opIndex;
+  return _immParams.append(&_heap, param);
+}
+
+// ============================================================================
+// [asmjit::CBTemplate - Record]
+// ============================================================================
+
+Error CBTemplate::record(CodeBuilder* cb, CBNode* first, CBNode* last) noexcept {
+  CBTemplate_resetData(this);
+
+  CodeHolder* code = cb->getCode();
+  if (ASMJIT_UNLIKELY(!code))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!first || !last))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  Zone tmpZone(8192 - Zone::kZoneOverhead);
+  CBTemplate_RecordState s;
+
+  s.data = nullptr;
+  s.code = code;
+  s.regMap = nullptr;
+  s.regMapSize = 0;
+
+#if !defined(ASMJIT_DISABLE_COMPILER)
+  s.cc = cb->isCodeCompiler() ? static_cast<CodeCompiler*>(cb) : static_cast<CodeCompiler*>(nullptr);
+  if (s.cc)
+    s.regMapSize = s.cc->_vRegArray.getLength();
+#endif // !ASMJIT_DISABLE_COMPILER
+
+  s.labelMap = nullptr;
+  s.labelMapSize = code->getLabelsCount();
+
+  if (s.labelMapSize) {
+    s.labelMap = tmpZone.allocT<uint32_t>(s.labelMapSize * sizeof(uint32_t));
+    if (ASMJIT_UNLIKELY(!s.labelMap))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    ::memset(s.labelMap, 0xFF, s.labelMapSize * sizeof(uint32_t));
+  }
+
+  if (s.regMapSize) {
+    s.regMap = tmpZone.allocT<uint32_t>(s.regMapSize * sizeof(uint32_t));
+    if (ASMJIT_UNLIKELY(!s.regMap))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    ::memset(s.regMap, 0xFF, s.regMapSize * sizeof(uint32_t));
+  }
+
+  // Parameters occupy the first slots, each one can only be declared once.
+  size_t i;
+  size_t regParamCount = _regParams.getLength();
+  size_t labelParamCount = _labelParams.getLength();
+
+  for (i = 0; i < regParamCount; i++) {
+    size_t index = Operand::unpackId(_regParams[i]._reg.id);
+    if (ASMJIT_UNLIKELY(index >= s.regMapSize || s.regMap[index] != kInvalidValue))
+      return DebugUtils::errored(kErrorInvalidArgument);
+    s.regMap[index] = static_cast<uint32_t>(i);
+  }
+
+  for (i = 0; i < labelParamCount; i++) {
+    size_t index = Operand::unpackId(_labelParams[i]);
+    if (ASMJIT_UNLIKELY(index >= s.labelMapSize || s.labelMap[index] != kInvalidValue))
+      return DebugUtils::errored(kErrorInvalidArgument);
+    s.labelMap[index] = static_cast<uint32_t>(i);
+  }
+
+  // Validate the range, compute its size, and map labels bound in it, which
+  // must be done before any jump to them is recorded.
+  size_t dataSize = 0;
+  size_t localLabelCount = 0;
+
+  CBNode* node = first;
+  for (;;) {
+    uint32_t nodeSize = CBTemplate_getNodeSize(node);
+    if (ASMJIT_UNLIKELY(!nodeSize))
+      return DebugUtils::errored(kErrorInvalidArgument);
+
+    dataSize = CBTemplate_alignOffset(dataSize) + nodeSize;
+    switch (node->getType()) {
+      case CBNode::kNodeInst:
+        dataSize += node->as<CBInst>()->getOpCount() * sizeof(Operand);
+        break;
+
+      case CBNode::kNodeData: {
+        uint32_t size = node->as<CBData>()->getSize();
+        if (size > CBData::kInlineBufferSize)
+          dataSize += size;
+        break;
+      }
+
+      case CBNode::kNodeLabel: {
+        size_t index = Operand::unpackId(node->as<CBLabel>()->getId());
+        if (ASMJIT_UNLIKELY(index >= s.labelMapSize || s.labelMap[index] != kInvalidValue))
+          return DebugUtils::errored(kErrorInvalidArgument);
+
+        size_t slot = labelParamCount + localLabelCount++;
+        if (ASMJIT_UNLIKELY(slot > CBTemplate_kMaxSlot))
+          return DebugUtils::errored(kErrorInvalidState);
+        s.labelMap[index] = static_cast<uint32_t>(slot);
+        break;
+      }
+    }
+
+    if (node->_inlineComment)
+      dataSize += ::strlen(node->_inlineComment) + 1;
+
+    if (node == last) break;
+    node = node->getNext();
+
+    // `last` doesn't follow `first`.
+    if (ASMJIT_UNLIKELY(!node))
+      return DebugUtils::errored(kErrorInvalidArgument);
+  }
+
+  if (ASMJIT_UNLIKELY(dataSize > ~static_cast<uint32_t>(0)))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  s.data = static_cast<uint8_t*>(_heap.alloc(dataSize));
+  if (ASMJIT_UNLIKELY(!s.data))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  // Padding is copied by `instantiate()`, don't leave it uninitialized.
+  ::memset(s.data, 0, dataSize);
+  _data = s.data;
+  _dataSize = static_cast<uint32_t>(dataSize);
+
+  Error err = CBTemplate_recordNodes(this, s, first, last);
+  if (ASMJIT_UNLIKELY(err)) {
+    CBTemplate_resetData(this);
+    return err;
+  }
+
+  _archType = cb->getArchType();
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::CBTemplate - Instantiate]
+// ============================================================================
+
+static Error CBTemplate_instantiateNodes(const CBTemplate* self, CodeBuilder* cb, uint32_t* regIds, uint32_t* labelIds, const Reg* regs, const Label* labels, const int64_t* imms) noexcept {
+  size_t i;
+  size_t regParamCount = self->_regParams.getLength();
+  size_t labelParamCount = self->_labelParams.getLength();
+
+  size_t localRegCount = self->_localRegs.getLength();
+  size_t localLabelCount = self->_localLabels.getLength();
+
+  for (i = 0; i < regParamCount; i++) {
+    const Reg& reg = regs[i];
+    if (ASMJIT_UNLIKELY(!reg.isReg() || reg.getType() != static_cast<const Reg&>(self->_regParams[i]).getType()))
+      return DebugUtils::errored(kErrorInvalidArgument);
+    regIds[i] = reg.getId();
+  }
+
+  if (localRegCount) {
+#if !defined(ASMJIT_DISABLE_COMPILER)
+    if (ASMJIT_UNLIKELY(!cb->isCodeCompiler()))
+      return DebugUtils::errored(kErrorInvalidState);
+
+    CodeCompiler* cc = static_cast<CodeCompiler*>(cb);
+    for (i = 0; i < localRegCount; i++) {
+      const CBTemplate::LocalReg& local = self->_localRegs[i];
+
+      VirtReg* vreg = cc->newVirtReg(local.typeId, local.signature, local.name);
+      if (ASMJIT_UNLIKELY(!vreg))
+        return DebugUtils::errored(kErrorNoHeapMemory);
+
+      vreg->_size = local.size;
+      vreg->_alignment = local.alignment;
+      vreg->_priority = local.priority;
+      vreg->_isStack = local.isStack;
+      regIds[regParamCount + i] = vreg->getId();
+    }
+#else
+    return DebugUtils::errored(kErrorInvalidState);
+#endif // !ASMJIT_DISABLE_COMPILER
+  }
+
+  for (i = 0; i < labelParamCount; i++) {
+    if (ASMJIT_UNLIKELY(!cb->isLabelValid(labels[i])))
+      return DebugUtils::errored(kErrorInvalidLabel);
+    labelIds[i] = labels[i].getId();
+  }
+
+  // Copy all nodes at once and relocate pointers between them.
+  uint8_t* data = static_cast<uint8_t*>(cb->_cbHeap.alloc(self->_dataSize));
+  if (ASMJIT_UNLIKELY(!data))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ::memcpy(data, self->_data, self->_dataSize);
+
+  const uint32_t* relocs = self->_relocs.getData();
+  size_t relocCount = self->_relocs.getLength();
+
+  for (i = 0; i < relocCount; i++)
+    *reinterpret_cast<uintptr_t*>(data + relocs[i]) += reinterpret_cast<uintptr_t>(data);
+
+  for (i = 0; i < localLabelCount; i++) {
+    CBLabel* label = reinterpret_cast<CBLabel*>(data + self->_localLabels[i]);
+    ASMJIT_PROPAGATE(cb->registerLabelNode(label));
+    labelIds[labelParamCount + i] = label->getId();
+  }
+
+  const CBTemplate::Fixup* fixups = self->_fixups.getData();
+  size_t fixupCount = self->_fixups.getLength();
+
+  for (i = 0; i < fixupCount; i++) {
+    const CBTemplate::Fixup& fixup = fixups[i];
+    uint8_t* p = data + fixup.offset;
+
+    switch (fixup.kind) {
+      case CBTemplate::kFixupReg:
+        *reinterpret_cast<uint32_t*>(p) = regIds[fixup.slot];
+        break;
+
+      case CBTemplate::kFixupLabel:
+        *reinterpret_cast<uint32_t*>(p) = labelIds[fixup.slot];
+        break;
+
+      case CBTemplate::kFixupImm:
+        reinterpret_cast<Imm*>(p)->setInt64(imms[fixup.slot]);
+        break;
+
+      case CBTemplate::kFixupDisp:
+        reinterpret_cast<Mem*>(p)->setOffset(imms[fixup.slot]);
+        break;
+
+      case CBTemplate::kFixupVirtReg: {
+#if !defined(ASMJIT_DISABLE_COMPILER)
+        // Hints are only valid if the register stays virtual.
+        uint32_t id = regIds[fixup.slot];
+        if (ASMJIT_UNLIKELY(!cb->isCodeCompiler() || !Operand::isPackedId(id)))
+          return DebugUtils::errored(kErrorInvalidArgument);
+        *reinterpret_cast<VirtReg**>(p) = static_cast<CodeCompiler*>(cb)->getVirtRegById(id);
+#endif // !ASMJIT_DISABLE_COMPILER
+        break;
+      }
+    }
+  }
+
+  const uint32_t* nodes = self->_nodes.getData();
+  size_t nodeCount = self->_nodes.getLength();
+
+  uint32_t position = cb->_position;
+  for (i = 0; i < nodeCount; i++)
+    reinterpret_cast<CBNode*>(data + nodes[i])->_position = position;
+
+  // Link jumps to their targets, like `CodeBuilder` does when they are emitted.
+  for (i = 0; i < self->_jumps.getLength(); i++) {
+    CBJump* jump = reinterpret_cast<CBJump*>(data + self->_jumps[i]);
+    CBLabel* target;
+
+    ASMJIT_PROPAGATE(cb->getCBLabel(&target, jump->getOpArray()[0].getId()));
+    jump->_target = target;
+    jump->_jumpNext = target->_from;
+    target->_from = jump;
+    target->addNumRefs();
+  }
+
+  // Same as `addNode()`, but the whole list is inserted at once.
+  CBNode* first = reinterpret_cast<CBNode*>(data + nodes[0]);
+  CBNode* last = reinterpret_cast<CBNode*>(data + nodes[nodeCount - 1]);
+
+  CBNode* prev = cb->_cursor;
+  CBNode* next = prev ? prev->_next : cb->_firstNode;
+
+  first->_prev = prev;
+  last->_next = next;
+
+  if (prev)
+    prev->_next = first;
+  else
+    cb->_firstNode = first;
+
+  if (next)
+    next->_prev = last;
+  else
+    cb->_lastNode = last;
+
+  cb->_cursor = last;
+  cb->invalidateCfg();
+  return kErrorOk;
+}
+
+Error CBTemplate::instantiate(CodeBuilder* cb, const Reg* regs, const Label* labels, const int64_t* imms) const noexcept {
+  if (ASMJIT_UNLIKELY(cb->_lastError))
+    return cb->_lastError;
+
+  if (ASMJIT_UNLIKELY(!_data))
+    return cb->setLastError(DebugUtils::errored(kErrorInvalidState));
+
+  if (ASMJIT_UNLIKELY(cb->getArchType() != _archType))
+    return cb->setLastError(DebugUtils::errored(kErrorInvalidArch));
+
+  // Kept labels are only valid in the CodeHolder they were created by.
+  if (ASMJIT_UNLIKELY(_code && cb->getCode() != _code))
+    return cb->setLastError(DebugUtils::errored(kErrorInvalidLabel));
+
+  size_t regCount = _regParams.getLength() + _localRegs.getLength();
+  size_t labelCount = _labelParams.getLength() + _localLabels.getLength();
+  size_t idCount = regCount + labelCount;
+
+  uint32_t idsStorage[64];
+  uint32_t* ids = idsStorage;
+
+  if (idCount > ASMJIT_ARRAY_SIZE(idsStorage)) {
+    ids = static_cast<uint32_t*>(cb->_cbHeap.alloc(idCount * sizeof(uint32_t)));
+    if (ASMJIT_UNLIKELY(!ids))
+      return cb->setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+  }
+
+  Error err = CBTemplate_instantiateNodes(this, cb, ids, ids + regCount, regs, labels, imms);
+
+  if (ids != idsStorage)
+    cb->_cbHeap.release(ids, idCount * sizeof(uint32_t));
+
+  if (ASMJIT_UNLIKELY(err))
+    return cb->setLastError(err);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::CBTemplate - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+UNIT(base_codetemplate) {
+  CodeInfo ci(ArchInfo::kTypeX64);
+  ci.setCdeclCallConv(CallConv::kIdX86SysV64);
+
+  CodeHolder code;
+  code.init(ci);
+
+  INFO("Checking instantiation of a range of X86Builder nodes");
+  {
+    X86Builder cb(&code);
+
+    Label L_Exit = cb.newLabel();
+    Label L_Other = cb.newLabel();
+    Label L_Loop = cb.newLabel();
+
+    cb.mov(x86::eax, 1);
+    CBNode* first = cb.getCursor();
+    cb.bind(L_Loop);
+    cb.add(x86::dword_ptr(x86::rdi, 8), x86::eax);
+    CBNode* store = cb.getCursor();
+    cb.dec(x86::eax);
+    cb.jnz(L_Loop);
+    cb.jmp(L_Exit);
+    cb.comment("end");
+    CBNode* last = cb.getCursor();
+
+    CBTemplate t;
+    EXPECT(t.addLabelParam(L_Exit) == kErrorOk, "Failed to add a label parameter");
+    EXPECT(t.addImmParam(first, 1) == kErrorOk, "Failed to add an immediate parameter");
+    EXPECT(t.addImmParam(store, 0) == kErrorOk, "Failed to add a displacement parameter");
+    EXPECT(t.addImmParam(store, 1) == DebugUtils::errored(kErrorInvalidArgument),
+      "A register can't be an immediate parameter");
+
+    EXPECT(t.record(&cb, first, last) == kErrorOk, "Failed to record nodes");
+    EXPECT(t.getNodeCount() == 7, "Expected 7 nodes, got %u", unsigned(t.getNodeCount()));
+    EXPECT(t.getLocalLabelCount() == 1, "Expected 1 local label, got %u", unsigned(t.getLocalLabelCount()));
+    EXPECT(t.addLabelParam(L_Other) == DebugUtils::errored(kErrorInvalidState),
+      "Parameters can't be added after record()");
+
+    Label labels[1] = { L_Other };
+    int64_t imms[2] = { 5, 16 };
+    EXPECT(t.instantiate(&cb, nullptr, labels, imms) == kErrorOk, "Failed to instantiate the template");
+
+    CBInst* mov = last->getNext()->as<CBInst>();
+    EXPECT(mov->getOpArray()[1].as<Imm>().getInt64() == 5, "Immediate parameter wasn't replaced");
+
+    CBLabel* label = mov->getNext()->as<CBLabel>();
+    EXPECT(label->getType() == CBNode::kNodeLabel && label->getId() != L_Loop.getId(),
+      "Local label must be a new label");
+
+    CBInst* add = label->getNext()->as<CBInst>();
+    EXPECT(add->getOpArray()[0].as<Mem>().getOffsetLo32() == 16, "Displacement parameter wasn't replaced");
+    EXPECT(add->getOpArray() != store->as<CBInst>()->getOpArray(), "Operands must be copied");
+
+    CBJump* jnz = add->getNext()->getNext()->as<CBJump>();
+    EXPECT(jnz->getTarget() == label && label->getNumRefs() == 1, "Jump to a local label isn't linked");
+    EXPECT(jnz->getOpArray()[0].getId() == label->getId(), "Jump must reference the local label");
+
+    CBJump* jmp = jnz->getNext()->as<CBJump>();
+    EXPECT(jmp->getOpArray()[0].getId() == L_Other.getId(), "Label parameter wasn't replaced");
+    EXPECT(jmp->getTarget() && jmp->getTarget()->getId() == L_Other.getId(), "Jump to a label parameter isn't linked");
+
+    CBNode* comment = jmp->getNext();
+    EXPECT(comment->getType() == CBNode::kNodeComment && ::strcmp(comment->getInlineComment(), "end") == 0,
+      "Comment wasn't copied");
+    EXPECT(comment->getInlineComment() != last->getInlineComment(), "Comment must be copied");
+    EXPECT(cb.getCursor() == comment && cb.getLastNode() == comment, "Cursor must follow the instance");
+
+    cb.bind(L_Exit);
+    cb.bind(L_Other);
+    cb.ret();
+    EXPECT(cb.finalize() == kErrorOk, "Failed to finalize X86Builder");
+  }
+
+  INFO("Checking instantiation of a range of X86Compiler nodes into another CodeHolder");
+  {
+    X86Compiler cc(&code);
+    CBTemplate t;
+
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+    X86Gp a = cc.newI32("a");
+    X86Gp tmp = cc.newI32("tmp");
+    cc.setArg(0, a);
+
+    CBNode* prev = cc.getCursor();
+    cc.mov(tmp, a);
+    cc.imul(tmp, tmp);
+    cc.add(a, tmp);
+    CBNode* last = cc.getCursor();
+
+    cc.ret(a);
+    cc.endFunc();
+
+    EXPECT(t.record(&cc, cc.getFirstNode(), last) == DebugUtils::errored(kErrorInvalidArgument),
+      "Functions can't be recorded");
+
+    EXPECT(t.addRegParam(a) == kErrorOk, "Failed to add a register parameter");
+    EXPECT(t.addRegParam(x86::eax) == DebugUtils::errored(kErrorInvalidArgument),
+      "Physical register can't be a parameter");
+    EXPECT(t.record(&cc, prev->getNext(), last) == kErrorOk, "Failed to record nodes");
+    EXPECT(t.getLocalRegCount() == 1, "Expected 1 local register, got %u", unsigned(t.getLocalRegCount()));
+
+    CodeHolder code2;
+    code2.init(ci);
+
+    X86Compiler cc2(&code2);
+    cc2.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+    X86Gp x = cc2.newI32("x");
+    cc2.setArg(0, x);
+
+    size_t vRegCount = cc2._vRegArray.getLength();
+    Reg regs[1] = { x };
+
+    EXPECT(t.instantiate(&cc2, regs, nullptr, nullptr) == kErrorOk, "Failed to instantiate the template");
+    EXPECT(t.instantiate(&cc2, regs, nullptr, nullptr) == kErrorOk, "Failed to instantiate the template");
+    EXPECT(cc2._vRegArray.getLength() == vRegCount + 2, "Each instance must create its local registers");
+
+    CBInst* add = cc2.getCursor()->as<CBInst>();
+    EXPECT(add->getOpArray()[0].getId() == x.getId(), "Register parameter wasn't replaced");
+    EXPECT(add->getOpArray()[1].getId() == Operand::packId(static_cast<uint32_t>(vRegCount + 1)),
+      "Local register wasn't replaced");
+
+    cc2.ret(x);
+    cc2.endFunc();
+    EXPECT(cc2.finalize() == kErrorOk, "Failed to finalize X86Compiler");
+  }
+
+  INFO("Checking that kept labels can't leave their CodeHolder");
+  {
+    X86Builder cb(&code);
+    CBTemplate t;
+
+    Label L = cb.newLabel();
+    cb.jmp(L);
+    EXPECT(t.record(&cb, cb.getCursor(), cb.getCursor()) == kErrorOk, "Failed to record nodes");
+
+    CodeHolder code2;
+    code2.init(ci);
+
+    X86Builder cb2(&code2);
+    EXPECT(t.instantiate(&cb2, nullptr, nullptr, nullptr) == DebugUtils::errored(kErrorInvalidLabel),
+      "Kept label must be rejected by another CodeHolder");
+    EXPECT(t.instantiate(&cb, nullptr, nullptr, nullptr) == kErrorOk, "Failed to instantiate the template");
+    EXPECT(cb.getCursor()->as<CBJump>()->getTarget()->getNumRefs() == 2, "Expected 2 jumps to the kept label");
+  }
+}
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
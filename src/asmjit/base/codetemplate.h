@@ -0,0 +1,210 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_CODETEMPLATE_H
+#define _ASMJIT_BASE_CODETEMPLATE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+#include "../base/zone.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [asmjit::CBTemplate]
+// ============================================================================
+
+//! Template of \ref CodeBuilder nodes.
+//!
+//! A template records a range of nodes `[first, last]` once and then inserts
+//! copies of them into any builder (or compiler) of the same architecture by
+//! `instantiate()`, which is much cheaper than emitting the same code again -
+//! all nodes are copied from a single block of memory and only operands that
+//! differ between instances are patched. The following operands differ:
+//!
+//!   - Virtual registers declared by `addRegParam()` are replaced by registers
+//!     passed to `instantiate()` in the order they were declared. All other
+//!     virtual registers are local, each instance gets new ones of the same
+//!     type (like temporaries of an inlined function).
+//!   - Labels declared by `addLabelParam()` are replaced by labels passed to
+//!     `instantiate()`. Labels bound in the range are local, each instance gets
+//!     new ones. Other labels are kept, which is only possible if the instance
+//!     is inserted into a builder attached to the same \ref CodeHolder.
+//!   - Immediates and memory displacements declared by `addImmParam()` are
+//!     replaced by values passed to `instantiate()`.
+//!
+//! Only instructions, jumps, labels, alignment, data, comments, hints, and
+//! returns (\ref CCFuncRet) can be recorded. Functions, function calls,
+//! constant pools, jump tables, and jumps that are their edges can't.
+//!
+//! Parameters must be declared before `record()` is called. Nodes referenced
+//! by `addImmParam()` are only used by `record()`, the recorded range can be
+//! removed from the source builder (or the builder destroyed) after that.
+class CBTemplate {
+public:
+  ASMJIT_NONCOPYABLE(CBTemplate)
+
+  //! \internal
+  //!
+  //! Kind of a \ref Fixup.
+  ASMJIT_ENUM(FixupKind) {
+    kFixupReg            = 0,            //!< 32-bit register id.
+    kFixupLabel          = 1,            //!< 32-bit label id.
+    kFixupImm            = 2,            //!< Value of an `Imm` operand.
+    kFixupDisp           = 3,            //!< Displacement of a `Mem` operand.
+    kFixupVirtReg        = 4             //!< Pointer to `VirtReg` (used by `CCHint`).
+  };
+
+  //! \internal
+  //!
+  //! Field of recorded nodes that is patched by `instantiate()`.
+  struct Fixup {
+    uint32_t offset;                     //!< Offset of the field in recorded nodes.
+    uint32_t kind : 8;                   //!< Fixup kind, see \ref FixupKind.
+    uint32_t slot : 24;                  //!< Index of a parameter or local.
+  };
+
+  //! \internal
+  //!
+  //! Immediate parameter declared by `addImmParam()`.
+  struct ImmParam {
+    CBNode* node;                        //!< Instruction node.
+    uint32_t opIndex;                    //!< Index of the operand.
+  };
+
+  //! \internal
+  //!
+  //! Local virtual register, created by each `instantiate()`.
+  struct LocalReg {
+    uint32_t typeId;                     //!< Type-id.
+    uint32_t signature;                  //!< Register signature.
+    uint32_t size;                       //!< Virtual size.
+    uint8_t alignment;                   //!< Alignment.
+    uint8_t priority;                    //!< Allocation priority.
+    uint8_t isStack;                     //!< Only used as a stack.
+    uint8_t reserved;                    //!< \internal
+    const char* name;                    //!< Name (or null).
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API CBTemplate() noexcept;
+  ASMJIT_API ~CBTemplate() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  //! Reset the template, removes all parameters and recorded nodes.
+  ASMJIT_API void reset(bool releaseMemory = false) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get whether nodes were recorded.
+  ASMJIT_INLINE bool isRecorded() const noexcept { return _data != nullptr; }
+  //! Get architecture of recorded nodes.
+  ASMJIT_INLINE uint32_t getArchType() const noexcept { return _archType; }
+
+  //! Get count of recorded nodes.
+  ASMJIT_INLINE size_t getNodeCount() const noexcept { return _nodes.getLength(); }
+  //! Get size of recorded nodes (in bytes), allocated by each instance.
+  ASMJIT_INLINE uint32_t getDataSize() const noexcept { return _dataSize; }
+
+  //! Get count of register parameters.
+  ASMJIT_INLINE size_t getRegParamCount() const noexcept { return _regParams.getLength(); }
+  //! Get count of label parameters.
+  ASMJIT_INLINE size_t getLabelParamCount() const noexcept { return _labelParams.getLength(); }
+  //! Get count of immediate parameters.
+  ASMJIT_INLINE size_t getImmParamCount() const noexcept { return _immParams.getLength(); }
+
+  //! Get count of local virtual registers.
+  ASMJIT_INLINE size_t getLocalRegCount() const noexcept { return _localRegs.getLength(); }
+  //! Get count of local labels.
+  ASMJIT_INLINE size_t getLocalLabelCount() const noexcept { return _localLabels.getLength(); }
+
+  // --------------------------------------------------------------------------
+  // [Parameters]
+  // --------------------------------------------------------------------------
+
+  //! Declare a virtual register `reg` as a parameter.
+  ASMJIT_API Error addRegParam(const Reg& reg) noexcept;
+  //! Declare `label` as a parameter.
+  ASMJIT_API Error addLabelParam(const Label& label) noexcept;
+  //! Declare an operand `opIndex` of an instruction `node` as a parameter.
+  //!
+  //! The operand must be either an immediate, which value is replaced, or a
+  //! memory operand, which displacement is replaced.
+  ASMJIT_API Error addImmParam(CBNode* node, uint32_t opIndex) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Record / Instantiate]
+  // --------------------------------------------------------------------------
+
+  //! Record nodes `[first, last]` of `cb`.
+  //!
+  //! Returns `kErrorInvalidArgument` if the range contains a node that can't
+  //! be recorded, a parameter is bound in the range, or an immediate parameter
+  //! doesn't reference an immediate or memory operand of a node in the range.
+  ASMJIT_API Error record(CodeBuilder* cb, CBNode* first, CBNode* last) noexcept;
+
+  //! Insert a copy of recorded nodes after the cursor of `cb` and move the
+  //! cursor to the last of them.
+  //!
+  //! Arrays `regs`, `labels`, and `imms` provide values of parameters in the
+  //! order they were declared, each one must have as many items as there are
+  //! parameters of its kind (and can be null if there are none). Registers
+  //! must be of the same type as the ones they replace. The template isn't
+  //! changed, so it can be instantiated into different builders concurrently.
+  ASMJIT_API Error instantiate(CodeBuilder* cb, const Reg* regs, const Label* labels, const int64_t* imms) const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Zone _zone;                            //!< Zone used to allocate recorded nodes and arrays.
+  ZoneHeap _heap;                        //!< ZoneHeap that uses `_zone`.
+
+  uint8_t* _data;                        //!< Recorded nodes (or null).
+  uint32_t _dataSize;                    //!< Size of recorded nodes.
+  uint32_t _archType;                    //!< Architecture of recorded nodes.
+  CodeHolder* _code;                     //!< CodeHolder of kept labels (or null if there are none).
+
+  ZoneVector<Operand_> _regParams;       //!< Register parameters.
+  ZoneVector<uint32_t> _labelParams;     //!< Label parameters.
+  ZoneVector<ImmParam> _immParams;       //!< Immediate parameters.
+
+  ZoneVector<uint32_t> _nodes;           //!< Offsets of recorded nodes.
+  ZoneVector<uint32_t> _jumps;           //!< Offsets of recorded jumps.
+  ZoneVector<uint32_t> _localLabels;     //!< Offsets of recorded labels.
+  ZoneVector<uint32_t> _relocs;          //!< Offsets of pointers to recorded data.
+  ZoneVector<Fixup> _fixups;             //!< Fields patched by `instantiate()`.
+  ZoneVector<LocalReg> _localRegs;       //!< Local virtual registers.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_BASE_CODETEMPLATE_H
@@ -0,0 +1,644 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Dependencies]
+#include "../base/binwriter_p.h"
+#include "../base/elfwriter.h"
+#include "../base/utils.h"
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86)
+#include "../base/osutils.h"
+#include "../x86/x86assembler.h"
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::ElfWriter - Constants]
+// ============================================================================
+
+//! \internal
+//!
+//! ELF64 constants used by the writer.
+ASMJIT_ENUM(ElfConstants) {
+  kElfHeaderSize         = 64,
+  kElfSectionHeaderSize  = 64,
+  kElfSymbolSize         = 24,
+  kElfRelaSize           = 24,
+
+  kElfMachineX86_64      = 62,
+
+  kElfShtProgBits        = 1,
+  kElfShtSymTab          = 2,
+  kElfShtStrTab          = 3,
+  kElfShtRela            = 4,
+  kElfShtNoBits          = 8,
+
+  kElfShfWrite           = 0x01,
+  kElfShfAlloc           = 0x02,
+  kElfShfExecInstr       = 0x04,
+  kElfShfInfoLink        = 0x40,
+
+  kElfStbLocal           = 0,
+  kElfStbGlobal          = 1,
+
+  kElfSttNoType          = 0,
+  kElfSttObject          = 1,
+  kElfSttFunc            = 2,
+  kElfSttSection         = 3,
+
+  kElfRX86_64_64         = 1,
+  kElfRX86_64_PC32       = 2,
+  kElfRX86_64_PLT32      = 4,
+  kElfRX86_64_32         = 10
+};
+
+//! \internal
+//!
+//! ELF section header (only used to collect data before it's serialized).
+struct ElfSectionHeader {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t alignment;
+  uint64_t entrySize;
+};
+
+// ============================================================================
+// [asmjit::ElfWriter - Helpers]
+// ============================================================================
+
+static Error ElfWriter_alignTo(StringBuilder& sb, uint64_t alignment) noexcept {
+  size_t length = sb.getLength();
+  size_t padding = Utils::alignDiff<size_t>(length, static_cast<size_t>(alignment));
+  return padding ? sb.appendChars('\0', padding) : kErrorOk;
+}
+
+static Error ElfWriter_appendName(StringBuilder& strtab, uint32_t& offset, const char* name, size_t nameLength = Globals::kInvalidIndex) noexcept {
+  offset = static_cast<uint32_t>(strtab.getLength());
+  ASMJIT_PROPAGATE(strtab.appendString(name, nameLength));
+  return strtab.appendChar('\0');
+}
+
+static Error ElfWriter_appendSymbol(StringBuilder& symtab, uint32_t name, uint32_t bind, uint32_t type, uint32_t sectionIndex, uint64_t value) noexcept {
+  ASMJIT_PROPAGATE(BinWriter::appendLE(symtab, name, 4));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(symtab, (bind << 4) | type, 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(symtab, 0, 1));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(symtab, sectionIndex, 2));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(symtab, value, 8));
+  return BinWriter::appendLE(symtab, 0, 8);
+}
+
+static Error ElfWriter_appendRela(StringBuilder& rela, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend) noexcept {
+  ASMJIT_PROPAGATE(BinWriter::appendLE(rela, offset, 8));
+  ASMJIT_PROPAGATE(BinWriter::appendLE(rela, (static_cast<uint64_t>(symbol) << 32) | type, 8));
+  return BinWriter::appendLE(rela, static_cast<uint64_t>(addend), 8);
+}
+
+//! \internal
+//!
+//! Get whether the 32-bit displacement at `p` belongs to a jump or call, in
+//! that case it's relocated through PLT so it can target shared libraries.
+static ASMJIT_INLINE bool ElfWriter_isBranchDisplacement(const uint8_t* p, size_t offset) noexcept {
+  uint32_t b1 = offset >= 1 ? p[offset - 1] : 0;
+  uint32_t b0 = offset >= 2 ? p[offset - 2] : 0;
+  return b1 == 0xE8 || b1 == 0xE9 || (b0 == 0x0F && (b1 & 0xF0) == 0x80);
+}
+
+//! \internal
+//!
+//! Serialize relocations of a section `sectionId` into `rela`. Fields patched
+//! by the linker are cleared in `data` (section content in the output).
+static Error ElfWriter_buildRelocations(
+  StringBuilder& rela, uint8_t* data,
+  const CodeHolder* code, uint32_t sectionId,
+  const uint32_t* labelSymbols, const uint32_t* relocSymbols) noexcept {
+
+  // Relocation entries.
+  const ZoneVector<RelocEntry*>& relocations = code->getRelocEntries();
+  for (size_t i = 0; i < relocations.getLength(); i++) {
+    const RelocEntry* re = relocations[i];
+    if (re->getType() == RelocEntry::kTypeNone)
+      continue;
+
+    uint32_t sourceSectionId = re->getSourceSectionId();
+    if (sourceSectionId == SectionEntry::kInvalidId)
+      sourceSectionId = 0;
+
+    if (sourceSectionId != sectionId)
+      continue;
+
+    uint32_t targetSectionId = re->getTargetSectionId();
+    if (targetSectionId == SectionEntry::kInvalidId)
+      targetSectionId = sourceSectionId;
+
+    uint64_t offset = re->getSourceOffset();
+    uint32_t size = re->getSize();
+
+    if (ASMJIT_UNLIKELY(offset + size > code->getSectionEntry(sectionId)->getPhysicalSize() || (size != 4 && size != 8)))
+      return DebugUtils::errored(kErrorInvalidRelocEntry);
+
+    // Relocations of labels that were not bound refer to their symbols,
+    // others refer to the symbol of the target section (index + 1).
+    uint32_t symbol = relocSymbols[i] ? relocSymbols[i] : targetSectionId + 1;
+
+    switch (re->getType()) {
+      case RelocEntry::kTypeAbsToAbs: {
+        if (size == 4)
+          Utils::writeU32uLE(data + offset, static_cast<uint32_t>(re->getData()));
+        else
+          Utils::writeU64uLE(data + offset, re->getData());
+        continue;
+      }
+
+      case RelocEntry::kTypeRelToAbs: {
+        ASMJIT_PROPAGATE(ElfWriter_appendRela(rela, offset, symbol,
+          size == 8 ? kElfRX86_64_64 : kElfRX86_64_32, static_cast<int64_t>(re->getData())));
+        break;
+      }
+
+      case RelocEntry::kTypeAbsToRel: {
+        // Only relative references to sections are portable, absolute
+        // addresses are only valid in the process that generated the code.
+        if (ASMJIT_UNLIKELY(re->getTargetSectionId() == SectionEntry::kInvalidId || size != 4))
+          return DebugUtils::errored(kErrorInvalidRelocEntry);
+
+        ASMJIT_PROPAGATE(ElfWriter_appendRela(rela, offset, symbol,
+          kElfRX86_64_PC32, static_cast<int64_t>(re->getData()) - static_cast<int64_t>(size)));
+        break;
+      }
+
+      default:
+        return DebugUtils::errored(kErrorInvalidRelocEntry);
+    }
+
+    ::memset(data + offset, 0, size);
+  }
+
+  // References to labels that were not bound (relative displacements).
+  size_t numLabels = code->getLabelsCount();
+  const uint8_t* buffer = code->getSectionEntry(sectionId)->getBuffer().getData();
+
+  for (size_t i = 0; i < numLabels; i++) {
+    const LabelEntry* le = code->getLabelEntryAt(i);
+    if (le->isBound())
+      continue;
+
+    for (const LabelLink* link = le->_links; link; link = link->prev) {
+      if (link->sectionId != sectionId || link->relocId != RelocEntry::kInvalidId)
+        continue;
+
+      if (ASMJIT_UNLIKELY(!labelSymbols[i]))
+        return DebugUtils::errored(kErrorInvalidLabel);
+
+      if (ASMJIT_UNLIKELY(buffer[link->offset] != 4))
+        return DebugUtils::errored(kErrorInvalidDisplacement);
+
+      uint32_t type = ElfWriter_isBranchDisplacement(buffer, link->offset) ? kElfRX86_64_PLT32 : kElfRX86_64_PC32;
+      ASMJIT_PROPAGATE(ElfWriter_appendRela(rela, link->offset, labelSymbols[i], type, link->rel));
+      ::memset(data + link->offset, 0, 4);
+    }
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::ElfWriter - Write]
+// ============================================================================
+
+static Error ElfWriter_writeInternal(
+  StringBuilder& dst, CodeHolder* code,
+  uint32_t* labelSymbols, uint32_t* relocSymbols, ElfSectionHeader* headers) noexcept {
+
+  const ZoneVector<SectionEntry*>& sections = code->getSections();
+
+  uint32_t numSections = static_cast<uint32_t>(sections.getLength());
+  size_t numLabels = code->getLabelsCount();
+
+  StringBuilder strtab;
+  StringBuilder shstrtab;
+  StringBuilder symtab;
+  StringBuilder rela;
+
+  ASMJIT_PROPAGATE(strtab.appendChar('\0'));
+  ASMJIT_PROPAGATE(shstrtab.appendChar('\0'));
+
+  // --------------------------------------------------------------------------
+  // [Symbols]
+  // --------------------------------------------------------------------------
+
+  // The first symbol is null, followed by a symbol of each section.
+  ASMJIT_PROPAGATE(ElfWriter_appendSymbol(symtab, 0, kElfStbLocal, kElfSttNoType, 0, 0));
+  for (uint32_t i = 0; i < numSections; i++)
+    ASMJIT_PROPAGATE(ElfWriter_appendSymbol(symtab, 0, kElfStbLocal, kElfSttSection, i + 1, 0));
+
+  // Local symbols must precede global symbols.
+  uint32_t numSymbols = numSections + 1;
+  uint32_t firstGlobal = 0;
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < numLabels; i++) {
+      const LabelEntry* le = code->getLabelEntryAt(i);
+      if (!le->hasName())
+        continue;
+
+      uint32_t isGlobal = le->getType() == Label::kTypeGlobal;
+      if (isGlobal != pass || (!isGlobal && !le->isBound()))
+        continue;
+
+      uint32_t name;
+      ASMJIT_PROPAGATE(ElfWriter_appendName(strtab, name, le->getName(), le->getNameLength()));
+
+      uint32_t bind = isGlobal ? kElfStbGlobal : kElfStbLocal;
+      if (le->isBound()) {
+        const SectionEntry* section = sections[le->getSectionId()];
+        uint32_t type = section->isText() ? kElfSttFunc : kElfSttObject;
+        ASMJIT_PROPAGATE(ElfWriter_appendSymbol(symtab, name, bind, type, le->getSectionId() + 1, le->getOffset()));
+      }
+      else {
+        ASMJIT_PROPAGATE(ElfWriter_appendSymbol(symtab, name, bind, kElfSttNoType, 0, 0));
+      }
+
+      labelSymbols[i] = numSymbols++;
+    }
+
+    if (pass == 0)
+      firstGlobal = numSymbols;
+  }
+
+  // Relocation entries created for labels that were not bound refer to them.
+  for (size_t i = 0; i < numLabels; i++) {
+    const LabelEntry* le = code->getLabelEntryAt(i);
+    if (le->isBound())
+      continue;
+
+    for (const LabelLink* link = le->_links; link; link = link->prev) {
+      if (link->relocId == RelocEntry::kInvalidId)
+        continue;
+
+      if (ASMJIT_UNLIKELY(!labelSymbols[i]))
+        return DebugUtils::errored(kErrorInvalidLabel);
+      relocSymbols[link->relocId] = labelSymbols[i];
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [Header & Sections]
+  // --------------------------------------------------------------------------
+
+  dst.clear();
+  ASMJIT_PROPAGATE(dst.appendChars('\0', kElfHeaderSize));
+
+  uint32_t headerIndex = 1;
+  uint32_t numRelaSections = 0;
+
+  for (uint32_t i = 0; i < numSections; i++) {
+    const SectionEntry* section = sections[i];
+    ElfSectionHeader& sh = headers[headerIndex++];
+
+    uint64_t alignment = section->getAlignment() ? section->getAlignment() : 1;
+    uint64_t flags = 0;
+
+    if (!section->hasFlag(SectionEntry::kFlagInfo)) {
+      flags = kElfShfAlloc;
+      if (section->isText())
+        flags |= kElfShfExecInstr;
+      else if (!section->hasFlag(SectionEntry::kFlagConst))
+        flags |= kElfShfWrite;
+    }
+
+    ASMJIT_PROPAGATE(ElfWriter_appendName(shstrtab, sh.name, section->getName()));
+    sh.flags = flags;
+    sh.alignment = alignment;
+    sh.size = section->getRealSize();
+
+    if (section->hasFlag(SectionEntry::kFlagZero) && section->getPhysicalSize() == 0) {
+      sh.type = kElfShtNoBits;
+      sh.offset = dst.getLength();
+      continue;
+    }
+
+    ASMJIT_PROPAGATE(ElfWriter_alignTo(dst, alignment));
+    sh.type = kElfShtProgBits;
+    sh.offset = dst.getLength();
+
+    size_t physicalSize = section->getPhysicalSize();
+    ASMJIT_PROPAGATE(dst.appendString(reinterpret_cast<const char*>(section->getBuffer().getData()), physicalSize));
+    ASMJIT_PROPAGATE(dst.appendChars('\0', static_cast<size_t>(sh.size) - physicalSize));
+
+    // Collect relocations and clear the fields that will be patched.
+    size_t relaStart = rela.getLength();
+    ASMJIT_PROPAGATE(ElfWriter_buildRelocations(rela,
+      reinterpret_cast<uint8_t*>(dst.getData()) + sh.offset, code, i, labelSymbols, relocSymbols));
+
+    // Relocation sections follow the sections, use `offset` and `info` to
+    // remember the range and the section it belongs to.
+    if (rela.getLength() != relaStart) {
+      ElfSectionHeader& rh = headers[1 + numSections + numRelaSections++];
+      rh.offset = relaStart;
+      rh.size = rela.getLength() - relaStart;
+      rh.info = i + 1;
+    }
+  }
+
+  uint32_t symtabIndex = 1 + numSections + numRelaSections;
+  uint32_t strtabIndex = symtabIndex + 1;
+  uint32_t shstrtabIndex = symtabIndex + 2;
+  uint32_t noteIndex = symtabIndex + 3;
+  uint32_t numHeaders = noteIndex + 1;
+
+  // Relocation sections.
+  ASMJIT_PROPAGATE(ElfWriter_alignTo(dst, 8));
+  uint64_t relaOffset = dst.getLength();
+  ASMJIT_PROPAGATE(dst.appendString(rela.getData(), rela.getLength()));
+
+  for (uint32_t i = 0; i < numRelaSections; i++) {
+    ElfSectionHeader& rh = headers[1 + numSections + i];
+    const char* name = sections[rh.info - 1]->getName();
+
+    rh.name = static_cast<uint32_t>(shstrtab.getLength());
+    ASMJIT_PROPAGATE(shstrtab.appendString(".rela", 5));
+    ASMJIT_PROPAGATE(shstrtab.appendString(name));
+    ASMJIT_PROPAGATE(shstrtab.appendChar('\0'));
+
+    rh.type = kElfShtRela;
+    rh.flags = kElfShfInfoLink;
+    rh.offset += relaOffset;
+    rh.link = symtabIndex;
+    rh.alignment = 8;
+    rh.entrySize = kElfRelaSize;
+  }
+
+  // Symbol table.
+  ElfSectionHeader& symtabHeader = headers[symtabIndex];
+  ASMJIT_PROPAGATE(ElfWriter_appendName(shstrtab, symtabHeader.name, ".symtab"));
+  symtabHeader.type = kElfShtSymTab;
+  symtabHeader.offset = dst.getLength();
+  symtabHeader.size = symtab.getLength();
+  symtabHeader.link = strtabIndex;
+  symtabHeader.info = firstGlobal;
+  symtabHeader.alignment = 8;
+  symtabHeader.entrySize = kElfSymbolSize;
+  ASMJIT_PROPAGATE(dst.appendString(symtab.getData(), symtab.getLength()));
+
+  // String table.
+  ElfSectionHeader& strtabHeader = headers[strtabIndex];
+  ASMJIT_PROPAGATE(ElfWriter_appendName(shstrtab, strtabHeader.name, ".strtab"));
+  strtabHeader.type = kElfShtStrTab;
+  strtabHeader.offset = dst.getLength();
+  strtabHeader.size = strtab.getLength();
+  strtabHeader.alignment = 1;
+  ASMJIT_PROPAGATE(dst.appendString(strtab.getData(), strtab.getLength()));
+
+  // Marks the stack as non-executable, otherwise linkers assume it must be.
+  ElfSectionHeader& noteHeader = headers[noteIndex];
+  ASMJIT_PROPAGATE(ElfWriter_appendName(shstrtab, noteHeader.name, ".note.GNU-stack"));
+  noteHeader.type = kElfShtProgBits;
+  noteHeader.offset = dst.getLength();
+  noteHeader.alignment = 1;
+
+  // Section names (must be the last as it contains names of all sections).
+  ElfSectionHeader& shstrtabHeader = headers[shstrtabIndex];
+  ASMJIT_PROPAGATE(ElfWriter_appendName(shstrtab, shstrtabHeader.name, ".shstrtab"));
+  shstrtabHeader.type = kElfShtStrTab;
+  shstrtabHeader.offset = dst.getLength();
+  shstrtabHeader.size = shstrtab.getLength();
+  shstrtabHeader.alignment = 1;
+  ASMJIT_PROPAGATE(dst.appendString(shstrtab.getData(), shstrtab.getLength()));
+
+  // Section headers.
+  ASMJIT_PROPAGATE(ElfWriter_alignTo(dst, 8));
+  uint64_t headersOffset = dst.getLength();
+
+  for (uint32_t i = 0; i < numHeaders; i++) {
+    const ElfSectionHeader& sh = headers[i];
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.name, 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.type, 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.flags, 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, 0, 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.offset, 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.size, 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.link, 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.info, 4));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.alignment, 8));
+    ASMJIT_PROPAGATE(BinWriter::appendLE(dst, sh.entrySize, 8));
+  }
+
+  // ELF header.
+  uint8_t* p = reinterpret_cast<uint8_t*>(dst.getData());
+  p[0] = 0x7F;
+  p[1] = 'E';
+  p[2] = 'L';
+  p[3] = 'F';
+  p[4] = 2;                                       // ELFCLASS64.
+  p[5] = 1;                                       // ELFDATA2LSB.
+  p[6] = 1;                                       // EV_CURRENT.
+  Utils::writeU16uLE(p + 16, 1);                  // ET_REL.
+  Utils::writeU16uLE(p + 18, kElfMachineX86_64);  // Machine.
+  Utils::writeU32uLE(p + 20, 1);                  // Version.
+  Utils::writeU64uLE(p + 40, headersOffset);      // Section headers offset.
+  Utils::writeU16uLE(p + 52, kElfHeaderSize);     // ELF header size.
+  Utils::writeU16uLE(p + 58, kElfSectionHeaderSize);
+  Utils::writeU16uLE(p + 60, numHeaders);
+  Utils::writeU16uLE(p + 62, shstrtabIndex);
+
+  return kErrorOk;
+}
+
+Error ElfWriter::write(StringBuilder& dst, CodeHolder* code) noexcept {
+  if (ASMJIT_UNLIKELY(code->getArchType() != ArchInfo::kTypeX64))
+    return DebugUtils::errored(kErrorInvalidArch);
+
+  // Reflect all changes first.
+  code->sync();
+
+  size_t numSections = code->getSections().getLength();
+  size_t numLabels = code->getLabelsCount();
+  size_t numRelocs = code->getRelocEntries().getLength();
+
+  // Symbol indexes of labels and relocation entries (zero if there is none)
+  // and headers of all sections (each section can have a relocation section
+  // plus null section, `.symtab`, `.strtab`, `.shstrtab`, `.note.GNU-stack`).
+  size_t numHeaders = numSections * 2 + 5;
+  size_t symbolsSize = (numLabels + numRelocs) * sizeof(uint32_t);
+  size_t headersSize = numHeaders * sizeof(ElfSectionHeader);
+
+  uint8_t* buffer = static_cast<uint8_t*>(Internal::allocMemory(headersSize + symbolsSize));
+  if (ASMJIT_UNLIKELY(!buffer))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  ::memset(buffer, 0, headersSize + symbolsSize);
+
+  ElfSectionHeader* headers = reinterpret_cast<ElfSectionHeader*>(buffer);
+  uint32_t* labelSymbols = reinterpret_cast<uint32_t*>(buffer + headersSize);
+  uint32_t* relocSymbols = labelSymbols + numLabels;
+
+  Error err = ElfWriter_writeInternal(dst, code, labelSymbols, relocSymbols, headers);
+  Internal::releaseMemory(buffer);
+  return err;
+}
+
+Error ElfWriter::writeFile(const char* fileName, CodeHolder* code) noexcept {
+  StringBuilder sb;
+  ASMJIT_PROPAGATE(write(sb, code));
+
+  return BinWriter::writeFile(fileName, sb);
+}
+
+// ============================================================================
+// [asmjit::ElfWriter - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86)
+static int ElfWriter_testHelper(int x) { return x * 2; }
+
+UNIT(base_elfwriter) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+
+  SectionEntry* rodata;
+  code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 8);
+
+  X86Assembler a(&code);
+  Label L_Func = a.newNamedLabel("asmjit_elf_func");
+  Label L_Helper = a.newNamedLabel("asmjit_elf_helper");
+  Label L_Data = a.newNamedLabel("asmjit_elf_data");
+
+  // int func(int x) { return helper(x) + data[1]; } (SysV calling convention).
+  a.bind(L_Func);
+  a.push(x86::rbx);
+  a.call(L_Helper);
+  a.add(x86::eax, x86::dword_ptr(L_Data, 4));
+  a.pop(x86::rbx);
+  a.ret();
+
+  a.section(rodata);
+  a.bind(L_Data);
+  a.dint32(1);
+  a.dint32(100);
+
+  StringBuilder obj;
+  INFO("Checking ELF object structure");
+  EXPECT(ElfWriter::write(obj, &code) == kErrorOk, "Failed to write ELF object");
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(obj.getData());
+  EXPECT(obj.getLength() > kElfHeaderSize && ::memcmp(p, "\x7F" "ELF", 4) == 0 && p[4] == 2,
+    "Invalid ELF64 header");
+  EXPECT(Utils::readU16uLE(p + 16) == 1 && Utils::readU16uLE(p + 18) == kElfMachineX86_64,
+    "Expected relocatable X86_64 object");
+
+  uint64_t shoff = Utils::readU64uLE(p + 40);
+  uint32_t shnum = Utils::readU16uLE(p + 60);
+  const uint8_t* shstr = p + Utils::readU64uLE(p + shoff + Utils::readU16uLE(p + 62) * kElfSectionHeaderSize + 24);
+
+  // Sections by index, as they are going to be "loaded" by the test.
+  const uint8_t* symtab = nullptr;
+  const uint8_t* strtab = nullptr;
+  size_t symCount = 0;
+
+  for (uint32_t i = 0; i < shnum; i++) {
+    const uint8_t* sh = p + shoff + i * kElfSectionHeaderSize;
+    uint32_t type = Utils::readU32uLE(sh + 4);
+
+    if (type == kElfShtSymTab) {
+      symtab = p + Utils::readU64uLE(sh + 24);
+      symCount = static_cast<size_t>(Utils::readU64uLE(sh + 32) / kElfSymbolSize);
+      strtab = p + Utils::readU64uLE(p + shoff + Utils::readU32uLE(sh + 40) * kElfSectionHeaderSize + 24);
+    }
+  }
+
+  EXPECT(symtab != nullptr && symCount == 1 + 2 + 3, "Expected 6 symbols, got %u", unsigned(symCount));
+  EXPECT(::strcmp(reinterpret_cast<const char*>(shstr + Utils::readU32uLE(p + shoff + kElfSectionHeaderSize)), ".text") == 0,
+    "The first section must be .text");
+
+  INFO("Checking that the ELF object can be linked");
+#if ASMJIT_ARCH_X64 && ASMJIT_OS_POSIX
+  {
+    // Load all sections (including relocation sections) into memory near
+    // the helper, resolve symbols and apply relocations like a linker would.
+    size_t allocated;
+    uint8_t* mem = static_cast<uint8_t*>(OSUtils::allocVirtualMemoryNear(
+      4096, &allocated, OSUtils::kVMWritable | OSUtils::kVMExecutable, reinterpret_cast<const void*>(&ElfWriter_testHelper)));
+    EXPECT(mem != nullptr, "Failed to allocate virtual memory");
+
+    uint64_t sectionAddress[16] = { 0 };
+    size_t memOffset = 0;
+
+    for (uint32_t i = 1; i < shnum && i < 16; i++) {
+      const uint8_t* sh = p + shoff + i * kElfSectionHeaderSize;
+      if (!(Utils::readU64uLE(sh + 8) & kElfShfAlloc))
+        continue;
+
+      size_t size = static_cast<size_t>(Utils::readU64uLE(sh + 32));
+      memOffset = Utils::alignTo<size_t>(memOffset, static_cast<size_t>(Utils::readU64uLE(sh + 48)));
+      ::memcpy(mem + memOffset, p + Utils::readU64uLE(sh + 24), size);
+
+      sectionAddress[i] = (uint64_t)(uintptr_t)(mem + memOffset);
+      memOffset += size;
+    }
+
+    for (uint32_t i = 1; i < shnum; i++) {
+      const uint8_t* sh = p + shoff + i * kElfSectionHeaderSize;
+      if (Utils::readU32uLE(sh + 4) != kElfShtRela)
+        continue;
+
+      uint32_t target = Utils::readU32uLE(sh + 44);
+      const uint8_t* r = p + Utils::readU64uLE(sh + 24);
+      size_t count = static_cast<size_t>(Utils::readU64uLE(sh + 32) / kElfRelaSize);
+
+      for (size_t j = 0; j < count; j++, r += kElfRelaSize) {
+        uint64_t offset = Utils::readU64uLE(r);
+        uint64_t info = Utils::readU64uLE(r + 8);
+        int64_t addend = static_cast<int64_t>(Utils::readU64uLE(r + 16));
+
+        const uint8_t* sym = symtab + (info >> 32) * kElfSymbolSize;
+        const char* symName = reinterpret_cast<const char*>(strtab + Utils::readU32uLE(sym));
+        uint32_t symSection = Utils::readU16uLE(sym + 6);
+
+        uint64_t s = 0;
+        if (symSection != 0)
+          s = sectionAddress[symSection] + Utils::readU64uLE(sym + 8);
+        else if (::strcmp(symName, "asmjit_elf_helper") == 0)
+          s = (uint64_t)(uintptr_t)&ElfWriter_testHelper;
+        EXPECT(s != 0, "Unresolved symbol '%s'", symName);
+
+        uint64_t place = sectionAddress[target] + offset;
+        uint32_t type = static_cast<uint32_t>(info & 0xFFFFFFFFU);
+
+        if (type == kElfRX86_64_PC32 || type == kElfRX86_64_PLT32)
+          Utils::writeU32uLE((void*)(uintptr_t)place, static_cast<uint32_t>(s + addend - place));
+        else if (type == kElfRX86_64_64)
+          Utils::writeU64uLE((void*)(uintptr_t)place, s + addend);
+        else
+          EXPECT(false, "Unexpected relocation type %u", type);
+      }
+    }
+
+    typedef int (*Func)(int);
+    Func func = (Func)(uintptr_t)sectionAddress[1];
+
+    int result = func(21);
+    EXPECT(result == 142, "Linked function returned %d instead of %d", result, 142);
+    OSUtils::releaseVirtualMemory(mem, allocated);
+  }
+#endif // ASMJIT_ARCH_X64 && ASMJIT_OS_POSIX
+}
+#endif // ASMJIT_TEST && ASMJIT_BUILD_X86
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
@@ -0,0 +1,66 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_BASE_ELFWRITER_H
+#define _ASMJIT_BASE_ELFWRITER_H
+
+// [Dependencies]
+#include "../base/codeholder.h"
+#include "../base/string.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_base
+//! \{
+
+// ============================================================================
+// [asmjit::ElfWriter]
+// ============================================================================
+
+//! ELF relocatable object writer.
+//!
+//! Serializes the content of a \ref CodeHolder into an ELF64 relocatable
+//! object (`.o`), which can be linked by a regular linker. This makes it
+//! possible to generate code ahead of time and to skip JIT compilation for
+//! known functions.
+//!
+//!   - Each section becomes an ELF section. Executable sections are `.text`
+//!     like, `SectionEntry::kFlagConst` sections are read-only and sections
+//!     having `SectionEntry::kFlagZero` without data are written as `NOBITS`.
+//!   - Named labels become symbols. Global labels are global symbols (functions
+//!     if bound to an executable section, objects otherwise), local labels are
+//!     local symbols, and global labels that are not bound are undefined
+//!     symbols resolved by the linker, which can be used to call functions
+//!     defined elsewhere.
+//!   - Relocation entries and references to labels that are not bound become
+//!     ELF relocations. Relocations to absolute addresses (jumps and calls to
+//!     immediates, including trampolines) are not portable between processes
+//!     and are refused with `kErrorInvalidRelocEntry`.
+//!
+//! Only X64 code is supported at the moment.
+struct ElfWriter {
+  //! Serialize `code` as an ELF relocatable object into `dst`.
+  //!
+  //! The content of `dst` is replaced.
+  ASMJIT_API static Error write(StringBuilder& dst, CodeHolder* code) noexcept;
+
+  //! Serialize `code` as an ELF relocatable object into a file `fileName`.
+  ASMJIT_API static Error writeFile(const char* fileName, CodeHolder* code) noexcept;
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // _ASMJIT_BASE_ELFWRITER_H
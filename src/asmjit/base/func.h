@@ -867,6 +867,7 @@ struct FuncFrameInfo {
     kAttrPreserveFP       = 0x00000001U, //!< Preserve frame pointer (EBP|RBP).
     kAttrCompactPE        = 0x00000002U, //!< Use smaller, but possibly slower prolog/epilog.
     kAttrHasCalls         = 0x00000004U, //!< Function calls other functions (is not leaf).
+    kAttrPatchableEntry   = 0x00000008U, //!< Emit a patch site before the prolog.
 
     kX86AttrAlignedVecSR  = 0x00010000U, //!< Use aligned save/restore of VEC regs.
     kX86AttrMmxCleanup    = 0x00020000U, //!< Emit EMMS instruction in epilog (X86).
@@ -927,6 +928,13 @@ struct FuncFrameInfo {
   //! Set `kFlagHasCalls` to false.
   ASMJIT_INLINE void disableCalls() noexcept { _attributes &= ~kAttrHasCalls; }
 
+  //! Get if the function starts with a patch site, see \ref JitRuntime::redirect().
+  ASMJIT_INLINE bool hasPatchableEntry() const noexcept { return (_attributes & kAttrPatchableEntry) != 0; }
+  //! Enable patchable entry.
+  ASMJIT_INLINE void enablePatchableEntry() noexcept { _attributes |= kAttrPatchableEntry; }
+  //! Disable patchable entry.
+  ASMJIT_INLINE void disablePatchableEntry() noexcept { _attributes &= ~kAttrPatchableEntry; }
+
   //! Get if the function contains MMX cleanup - 'emms' instruction in epilog.
   ASMJIT_INLINE bool hasMmxCleanup() const noexcept { return (_attributes & kX86AttrMmxCleanup) != 0; }
   //! Enable MMX cleanup.
@@ -1066,6 +1074,7 @@ struct FuncFrameLayout {
   ASMJIT_INLINE bool hasDsaSlotUsed() const noexcept { return static_cast<bool>(_dsaSlotUsed); }
   ASMJIT_INLINE bool hasAlignedVecSR() const noexcept { return static_cast<bool>(_alignedVecSR); }
   ASMJIT_INLINE bool hasDynamicAlignment() const noexcept { return static_cast<bool>(_dynamicAlignment); }
+  ASMJIT_INLINE bool hasPatchableEntry() const noexcept { return static_cast<bool>(_patchableEntry); }
 
   ASMJIT_INLINE bool hasMmxCleanup() const noexcept { return static_cast<bool>(_mmxCleanup); }
   ASMJIT_INLINE bool hasAvxCleanup() const noexcept { return static_cast<bool>(_avxCleanup); }
@@ -1114,6 +1123,7 @@ struct FuncFrameLayout {
   uint32_t _dsaSlotUsed : 1;             //!< True if `_dsaSlot` contains a valid memory slot/offset.
   uint32_t _alignedVecSR : 1;            //!< Use instructions that perform aligned ops to save/restore XMM regs.
   uint32_t _dynamicAlignment : 1;        //!< Function must dynamically align the stack.
+  uint32_t _patchableEntry : 1;          //!< Function starts with a patch site.
 
   uint32_t _mmxCleanup : 1;              //!< Emit 'emms' in epilog (X86).
   uint32_t _avxCleanup : 1;              //!< Emit 'vzeroupper' in epilog (X86).
@@ -78,6 +78,7 @@ static const char errorMessages[] =
   "No more physical registers\0"
   "Overlapped registers\0"
   "Overlapping register and arguments base-address register\0"
+  "Not position independent\0"
   "Unknown error\0";
 #endif // ASMJIT_DISABLE_TEXT
 
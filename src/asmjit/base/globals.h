@@ -221,6 +221,9 @@ ASMJIT_ENUM(ErrorCode) {
   //! Invalid register to hold stack arguments offset.
   kErrorOverlappingStackRegWithRegArg,
 
+  //! Absolute address used by a position-independent code.
+  kErrorNotPositionIndependent,
+
   //! Count of AsmJit error codes.
   kErrorCount
 };
@@ -366,6 +366,8 @@ Error Logging::formatNode(
   switch (node_->getType()) {
     case CBNode::kNodeInst: {
       const CBInst* node = node_->as<CBInst>();
+      if (node->hasFlag(CBNode::kFlagIsEdge))
+        ASMJIT_PROPAGATE(sb.appendString("[edge] "));
       ASMJIT_PROPAGATE(
         Logging::formatInstruction(sb, logOptions, cb,
           cb->getArchType(),
@@ -394,6 +396,15 @@ Error Logging::formatNode(
       break;
     }
 
+    case CBNode::kNodeJumpTable: {
+      const CBJumpTable* node = node_->as<CBJumpTable>();
+      ASMJIT_PROPAGATE(
+        sb.appendFormat("L%u: .jumptable (%u entries)",
+          Operand::unpackId(node->getId()),
+          node->getCount()));
+      break;
+    }
+
     case CBNode::kNodeComment: {
       const CBComment* node = node_->as<CBComment>();
       ASMJIT_PROPAGATE(sb.appendFormat("; %s", node->getInlineComment()));
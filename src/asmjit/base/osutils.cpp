@@ -94,6 +94,20 @@ void* OSUtils::allocProcessMemory(HANDLE hProcess, size_t size, size_t* allocate
   return mBase;
 }
 
+//! \internal
+//!
+//! Try to allocate virtual memory at `address`, fails if it's not available.
+static ASMJIT_INLINE void* OSUtils_allocVirtualMemoryAt(uintptr_t address, size_t size, uint32_t flags) noexcept {
+  DWORD protectFlags = 0;
+
+  if (flags & OSUtils::kVMExecutable)
+    protectFlags |= (flags & OSUtils::kVMWritable) ? PAGE_EXECUTE_READWRITE : PAGE_EXECUTE_READ;
+  else
+    protectFlags |= (flags & OSUtils::kVMWritable) ? PAGE_READWRITE : PAGE_READONLY;
+
+  return ::VirtualAlloc(reinterpret_cast<LPVOID>(address), size, MEM_COMMIT | MEM_RESERVE, protectFlags);
+}
+
 Error OSUtils::releaseProcessMemory(HANDLE hProcess, void* p, size_t size) noexcept {
   const VMemInfo& vmi = OSUtils_GetVMemInfo();
   if (!hProcess) hProcess = vmi.hCurrentProcess;
@@ -147,8 +161,77 @@ Error OSUtils::releaseVirtualMemory(void* p, size_t size) noexcept {
 
   return kErrorOk;
 }
+
+//! \internal
+//!
+//! Allocate virtual memory using `address` as a hint, the kernel is free to
+//! place the memory anywhere else if the `address` is not available.
+static ASMJIT_INLINE void* OSUtils_allocVirtualMemoryAt(uintptr_t address, size_t size, uint32_t flags) noexcept {
+  int protection = PROT_READ;
+
+  if (flags & OSUtils::kVMWritable  ) protection |= PROT_WRITE;
+  if (flags & OSUtils::kVMExecutable) protection |= PROT_EXEC;
+
+  void* mbase = ::mmap(reinterpret_cast<void*>(address), size, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return mbase != MAP_FAILED ? mbase : static_cast<void*>(nullptr);
+}
 #endif // ASMJIT_OS_POSIX
 
+//! \internal
+//!
+//! Get whether all bytes of `[p, p + size)` are reachable from `nearAddress`
+//! by a 32-bit signed displacement.
+static ASMJIT_INLINE bool OSUtils_isNear(const void* p, size_t size, const void* nearAddress) noexcept {
+  int64_t lo = static_cast<int64_t>((intptr_t)p) - static_cast<int64_t>((intptr_t)nearAddress);
+  int64_t hi = lo + static_cast<int64_t>(size);
+  return Utils::isInt32(lo) && Utils::isInt32(hi);
+}
+
+void* OSUtils::allocVirtualMemoryNear(size_t size, size_t* allocated, uint32_t flags, const void* nearAddress) noexcept {
+#if ASMJIT_ARCH_64BIT
+  if (nearAddress && size != 0) {
+    const VMemInfo& vmi = OSUtils_GetVMemInfo();
+
+    size_t alignedSize = Utils::alignTo<size_t>(size, vmi.pageSize);
+    uintptr_t nearPtr = (uintptr_t)nearAddress;
+
+    // Probe addresses below and above `nearAddress` at increasing distances,
+    // 64MB apart, and accept the first allocation that is within the range.
+    const uintptr_t kProbeStep = uintptr_t(64) * 1024 * 1024;
+    const uint32_t kProbeCount = 28;
+
+    for (uint32_t i = 0; i < kProbeCount * 2; i++) {
+      uintptr_t distance = kProbeStep * ((i >> 1) + 1);
+      uintptr_t candidate;
+
+      if ((i & 1) == 0) {
+        if (nearPtr < distance) continue;
+        candidate = nearPtr - distance;
+      }
+      else {
+        if (nearPtr + distance < nearPtr) continue;
+        candidate = nearPtr + distance;
+      }
+
+      candidate = candidate & ~(uintptr_t(vmi.pageGranularity) - 1);
+      void* p = OSUtils_allocVirtualMemoryAt(candidate, alignedSize, flags);
+
+      if (!p) continue;
+      if (OSUtils_isNear(p, alignedSize, nearAddress)) {
+        if (allocated) *allocated = alignedSize;
+        return p;
+      }
+
+      releaseVirtualMemory(p, alignedSize);
+    }
+  }
+#endif // ASMJIT_ARCH_64BIT
+
+  // There is no range restriction or no memory is available near the given
+  // address, fallback to a regular allocation.
+  return allocVirtualMemory(size, allocated, flags);
+}
+
 // ============================================================================
 // [asmjit::OSUtils - GetTickCount]
 // ============================================================================
@@ -198,7 +281,7 @@ uint32_t OSUtils::getTickCount() noexcept {
   static mach_timebase_info_data_t _machTime;
 
   // See Apple's QA1398.
-  if (ASMJIT_UNLIKELY(_machTime.denom == 0) || mach_timebase_info(&_machTime) != KERN_SUCCESS)
+  if (ASMJIT_UNLIKELY(_machTime.denom == 0) && mach_timebase_info(&_machTime) != KERN_SUCCESS)
     return 0;
 
   // `mach_absolute_time()` returns nanoseconds, we want milliseconds.
@@ -222,6 +305,52 @@ uint32_t OSUtils::getTickCount() noexcept {
 uint32_t OSUtils::getTickCount() noexcept { return 0; }
 #endif
 
+#if ASMJIT_OS_WINDOWS
+uint64_t OSUtils::getNanoTickCount() noexcept {
+  static volatile int64_t _qpcFreq;
+
+  LARGE_INTEGER qpf, now;
+  int64_t freq = _qpcFreq;
+
+  if (ASMJIT_UNLIKELY(freq == 0)) {
+    if (!::QueryPerformanceFrequency(&qpf) || qpf.QuadPart <= 0)
+      return uint64_t(::GetTickCount()) * 1000000;
+    freq = qpf.QuadPart;
+    _qpcFreq = freq;
+  }
+
+  if (!::QueryPerformanceCounter(&now))
+    return uint64_t(::GetTickCount()) * 1000000;
+
+  // Split the conversion to not overflow 64-bit integer.
+  uint64_t ticks = static_cast<uint64_t>(now.QuadPart);
+  uint64_t f = static_cast<uint64_t>(freq);
+  return (ticks / f) * 1000000000 + ((ticks % f) * 1000000000) / f;
+}
+#elif ASMJIT_OS_MAC
+uint64_t OSUtils::getNanoTickCount() noexcept {
+  static mach_timebase_info_data_t _machTime;
+
+  // See Apple's QA1398.
+  if (ASMJIT_UNLIKELY(_machTime.denom == 0) && mach_timebase_info(&_machTime) != KERN_SUCCESS)
+    return 0;
+
+  return mach_absolute_time() * _machTime.numer / _machTime.denom;
+}
+#elif defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK >= 0
+uint64_t OSUtils::getNanoTickCount() noexcept {
+  struct timespec ts;
+
+  if (ASMJIT_UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) != 0))
+    return 0;
+
+  return (uint64_t(ts.tv_sec) * 1000000000) + uint64_t(ts.tv_nsec);
+}
+#else
+#error "[asmjit] OSUtils::getNanoTickCount() is not implemented for your target OS."
+uint64_t OSUtils::getNanoTickCount() noexcept { return 0; }
+#endif
+
 } // asmjit namespace
 
 // [Api-End]
@@ -72,6 +72,12 @@ struct OSUtils {
   //! Release virtual memory previously allocated by \ref allocVirtualMemory().
   ASMJIT_API static Error releaseVirtualMemory(void* p, size_t size) noexcept;
 
+  //! Allocate virtual memory reachable from `nearAddress` by a 32-bit signed
+  //! displacement, if possible. It falls back to \ref allocVirtualMemory() if
+  //! there is no such memory available or if `nearAddress` is null. Memory
+  //! must be released by \ref releaseVirtualMemory().
+  ASMJIT_API static void* allocVirtualMemoryNear(size_t size, size_t* allocated, uint32_t flags, const void* nearAddress) noexcept;
+
 #if ASMJIT_OS_WINDOWS
   //! Allocate virtual memory of `hProcess` (Windows).
   ASMJIT_API static void* allocProcessMemory(HANDLE hProcess, size_t size, size_t* allocated, uint32_t flags) noexcept;
@@ -86,6 +92,11 @@ struct OSUtils {
 
   //! Get the current CPU tick count, used for benchmarking (1ms resolution).
   ASMJIT_API static uint32_t getTickCount() noexcept;
+
+  //! Get the current monotonic time in nanoseconds, used for precise
+  //! benchmarking. The resolution depends on the OS, the value has no
+  //! meaning on its own, only differences between two calls do.
+  ASMJIT_API static uint64_t getNanoTickCount() noexcept;
 };
 
 // ============================================================================
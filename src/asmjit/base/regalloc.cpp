@@ -12,6 +12,7 @@
 #if !defined(ASMJIT_DISABLE_COMPILER)
 
 // [Dependencies]
+#include "../base/osutils.h"
 #include "../base/regalloc_p.h"
 #include "../base/utils.h"
 
@@ -33,7 +34,135 @@ RAPass::~RAPass() noexcept {}
 // [asmjit::RAPass - Interface]
 // ============================================================================
 
+//! \internal
+//!
+//! Compile `func` and record its statistics if pass statistics are enabled.
+static Error RAPass_compileFunc(RAPass* self, CCFunc* func) noexcept {
+  CodeCompiler* cc = self->cc();
+  if (!cc->isPassStatsEnabled())
+    return self->compile(func);
+
+  CBPassStats& stats = self->_stats;
+  CBPassStats prev = stats;
+
+  uint32_t nodesIn = CodeBuilder::countNodes(func, func->getEnd());
+  size_t zoneSize = self->_zone->getUsedSize();
+
+  uint64_t startTime = OSUtils::getNanoTickCount();
+  Error err = self->compile(func);
+  uint64_t endTime = OSUtils::getNanoTickCount();
+
+  CBPassStats record;
+  record._time = endTime - startTime;
+  record._zoneSize = self->_zone->getUsedSize() - zoneSize;
+  record._runCount = 1;
+  record._nodesIn = nodesIn;
+  record._nodesOut = CodeBuilder::countNodes(func, func->getEnd());
+  record._spillCount = stats._spillCount - prev._spillCount;
+  record._moveCount = stats._moveCount - prev._moveCount;
+
+  if (!err)
+    err = cc->addPassRecord(self, func, record);
+  return err;
+}
+
+//! \internal
+//!
+//! Data shared by tasks of a concurrent compilation.
+struct RAWorkerTasks {
+  CodeCompiler** workers;                //!< Workers, one per task.
+  CCFunc** funcs;                        //!< Functions to compile.
+  Error* errors;                         //!< Result of each task.
+  size_t count;                          //!< Count of functions.
+  uint32_t numWorkers;                   //!< Count of workers (and tasks).
+};
+
+//! \internal
+//!
+//! Compile every `numWorkers`-th function by the worker at `index`.
+static void ASMJIT_CDECL RAPass_runWorker(void* data, uint32_t index) {
+  RAWorkerTasks* tasks = static_cast<RAWorkerTasks*>(data);
+  CodeCompiler* worker = tasks->workers[index];
+
+  // The register allocator is always the first pass added by `onAttach()`.
+  RAPass* pass = static_cast<RAPass*>(worker->_cbPasses[0]);
+  tasks->errors[index] = pass->compileFuncs(&worker->_cbPassZone, tasks->funcs, tasks->count, index, tasks->numWorkers);
+
+  if (worker->isPassStatsEnabled())
+    pass->_stats._zoneSize += worker->_cbPassZone.getUsedSize();
+  worker->_cbPassZone.reset();
+}
+
+//! \internal
+//!
+//! Compile all functions concurrently by using workers of the compiler.
+static Error RAPass_processConcurrently(RAPass* self, Zone* zone, CCExecutor* executor) noexcept {
+  CodeCompiler* cc = self->cc();
+  ZoneHeap heap(zone);
+  ZoneVector<CCFunc*> funcs;
+
+  for (CBNode* node = cc->getFirstNode(); node; node = node->getNext()) {
+    if (node->getType() == CBNode::kNodeFunc) {
+      CCFunc* func = static_cast<CCFunc*>(node);
+      ASMJIT_PROPAGATE(funcs.append(&heap, func));
+      node = func->getEnd();
+    }
+  }
+
+  size_t count = funcs.getLength();
+  uint32_t numWorkers = static_cast<uint32_t>(std::min<size_t>(executor->getConcurrency(), count));
+
+  if (numWorkers <= 1)
+    return self->compileFuncs(zone, funcs.getData(), count, 0, 1);
+
+  Error* errors = heap.allocT<Error>(numWorkers * sizeof(Error));
+  if (ASMJIT_UNLIKELY(!errors))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+  ASMJIT_PROPAGATE(cc->_prepareWorkers(numWorkers));
+
+  RAWorkerTasks tasks;
+  tasks.workers = cc->_workers.getData();
+  tasks.funcs = funcs.getData();
+  tasks.errors = errors;
+  tasks.count = count;
+  tasks.numWorkers = numWorkers;
+
+  executor->run(RAPass_runWorker, &tasks, numWorkers);
+
+  // Workers changed the code without notifying this compiler.
+  cc->invalidateCfg();
+  cc->_setCursor(nullptr);
+
+  // Move statistics of workers to this pass, so they look like the functions
+  // were compiled by it.
+  Error err = kErrorOk;
+  for (uint32_t i = 0; i < numWorkers; i++) {
+    CodeCompiler* worker = tasks.workers[i];
+    RAPass* pass = static_cast<RAPass*>(worker->_cbPasses[0]);
+
+    // Time and node counts are measured by `CodeBuilder::runPasses()` of this
+    // compiler, only the counters maintained by workers are added.
+    self->_stats._zoneSize += pass->_stats._zoneSize;
+    self->_stats._spillCount += pass->_stats._spillCount;
+    self->_stats._moveCount += pass->_stats._moveCount;
+    pass->_stats.reset();
+
+    const ZoneVector<CBPassRecord>& records = worker->getPassRecords();
+    for (size_t j = 0, len = records.getLength(); j < len && !err; j++)
+      err = cc->addPassRecord(self, records[j].func, records[j].stats);
+    worker->resetPassStats();
+
+    if (!err)
+      err = errors[i];
+  }
+  return err;
+}
+
 Error RAPass::process(Zone* zone) noexcept {
+  CCExecutor* executor = cc()->getExecutor();
+  if (executor && executor->getConcurrency() > 1 && !cc()->isWorker())
+    return RAPass_processConcurrently(this, zone, executor);
+
   _zone = zone;
   _heap.reset(zone);
   _emitComments = (cb()->getGlobalOptions() & CodeEmitter::kOptionLoggingEnabled) != 0;
@@ -47,7 +176,7 @@ Error RAPass::process(Zone* zone) noexcept {
       CCFunc* func = static_cast<CCFunc*>(node);
       node = func->getEnd();
 
-      err = compile(func);
+      err = RAPass_compileFunc(this, func);
       if (err) break;
     }
 
@@ -62,6 +191,22 @@ Error RAPass::process(Zone* zone) noexcept {
   return err;
 }
 
+Error RAPass::compileFuncs(Zone* zone, CCFunc** funcs, size_t count, size_t first, size_t step) noexcept {
+  _zone = zone;
+  _heap.reset(zone);
+  _emitComments = (cb()->getGlobalOptions() & CodeEmitter::kOptionLoggingEnabled) != 0;
+
+  Error err = kErrorOk;
+  for (size_t i = first; i < count; i += step) {
+    err = RAPass_compileFunc(this, funcs[i]);
+    if (err) break;
+  }
+
+  _heap.reset(nullptr);
+  _zone = nullptr;
+  return err;
+}
+
 Error RAPass::compile(CCFunc* func) noexcept {
   ASMJIT_PROPAGATE(prepare(func));
 
@@ -76,9 +221,21 @@ Error RAPass::compile(CCFunc* func) noexcept {
     err = livenessAnalysis();
     if (err) break;
 
+    if (cc()->getGlobalHints() & CodeEmitter::kHintDeadCodeElimination) {
+      err = removeDeadCode();
+      if (err) break;
+    }
+
 #if !defined(ASMJIT_DISABLE_LOGGING)
     if (cc()->getGlobalOptions() & CodeEmitter::kOptionLoggingEnabled) {
-      err = annotate();
+      // Annotations format labels, which are stored in the shared `CodeHolder`.
+      if (cc()->isWorker()) {
+        AutoLock locked(cc()->getMaster()->_workerLock);
+        err = annotate();
+      }
+      else {
+        err = annotate();
+      }
       if (err) break;
     }
 #endif // !ASMJIT_DISABLE_LOGGING
@@ -140,6 +297,28 @@ void RAPass::cleanup() noexcept {
   _contextVd.reset();
 }
 
+// ============================================================================
+// [asmjit::RAPass - Node-Factory]
+// ============================================================================
+
+CBLabel* RAPass::newLabelNode() noexcept {
+  CodeCompiler* master = cc()->getMaster();
+  if (!master)
+    return cc()->newLabelNode();
+
+  AutoLock locked(master->_workerLock);
+  return cc()->newLabelNode();
+}
+
+Error RAPass::emitJump(uint32_t instId, CBLabel* target) noexcept {
+  CodeCompiler* master = cc()->getMaster();
+  if (!master)
+    return cc()->emit(instId, target->getLabel());
+
+  AutoLock locked(master->_workerLock);
+  return cc()->emit(instId, target->getLabel());
+}
+
 // ============================================================================
 // [asmjit::RAPass - Mem]
 // ============================================================================
@@ -532,6 +711,139 @@ NoMem:
   return DebugUtils::errored(kErrorNoHeapMemory);
 }
 
+// ============================================================================
+// [asmjit::RAPass - Dead Code]
+// ============================================================================
+
+Error RAPass::removeDeadCode() {
+  uint32_t bLen = static_cast<uint32_t>(
+    ((_contextVd.getLength() + RABits::kEntityBits - 1) / RABits::kEntityBits));
+
+  // No variables.
+  if (bLen == 0)
+    return kErrorOk;
+
+  CCFunc* func = getFunc();
+  CBNode* stop = getStop();
+  size_t varMapToVaListOffset = _varMapToVaListOffset;
+
+  // Registers alive after the current node, updated while walking backwards.
+  RABits* live = newBits(bLen);
+  RABits* tmp = newBits(bLen);
+  if (ASMJIT_UNLIKELY(!live || !tmp))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (;;) {
+    uint32_t removed = 0;
+    bool isLive = false;                 // True if `live` is valid.
+    bool changed = false;                // True if liveness of the last node has changed.
+    bool blockChanged = false;           // True if liveness at the start of a block has changed.
+
+    // Iterate backwards, `next` is never removed when `node` is processed.
+    CBNode* node = func->getEnd();
+    while (node != func) {
+      CBNode* prev = node->getPrev();
+      RAData* wd = node->hasPassData() ? node->getPassData<RAData>() : static_cast<RAData*>(nullptr);
+
+      // Jumps and returns end a block, the liveness after them is not known
+      // here. If the block that follows has changed its predecessors have to
+      // be analyzed again.
+      if (!wd || !wd->liveness || node->isJmpOrJcc() || node->isRet()) {
+        blockChanged |= changed;
+        isLive = false;
+        changed = false;
+
+        node = prev;
+        continue;
+      }
+
+      if (!isLive) {
+        CBNode* next = node->getNext();
+        RABits* liveOut = next && next->hasPassData() ? next->getPassData<RAData>()->liveness : static_cast<RABits*>(nullptr);
+
+        if (!liveOut) {
+          node = prev;
+          continue;
+        }
+
+        live->copyBits(liveOut, bLen);
+        isLive = true;
+      }
+
+      uint32_t tiedTotal = wd->tiedTotal;
+      TiedReg* tiedArray = reinterpret_cast<TiedReg*>(((uint8_t*)wd) + varMapToVaListOffset);
+
+      if (node->getType() == CBNode::kNodeInst && !node->isJmpOrJcc()) {
+        bool writesRegs = false;
+        bool isDead = true;
+
+        for (uint32_t i = 0; i < tiedTotal; i++) {
+          TiedReg* tied = &tiedArray[i];
+          if (tied->flags & TiedReg::kWAll) {
+            writesRegs = true;
+            if (live->getBit(tied->vreg->_raId)) {
+              isDead = false;
+              break;
+            }
+          }
+        }
+
+        // Removing a dead instruction doesn't change `live`, registers only
+        // read by it are not added to it.
+        if (isDead && isRemovableInst(static_cast<CBInst*>(node), writesRegs)) {
+          cc()->removeNode(node);
+          changed = !live->eqBits(wd->liveness, bLen);
+          removed++;
+
+          node = prev;
+          continue;
+        }
+      }
+
+      // Liveness of a node contains registers alive after it and all registers
+      // it uses, see `livenessAnalysis()`.
+      tmp->copyBits(live, bLen);
+      for (uint32_t i = 0; i < tiedTotal; i++) {
+        TiedReg* tied = &tiedArray[i];
+        uint32_t flags = tied->flags;
+        uint32_t raId = tied->vreg->_raId;
+
+        tmp->setBit(raId);
+        if ((flags & TiedReg::kWAll) && !(flags & TiedReg::kRAll))
+          live->delBit(raId);
+        else
+          live->setBit(raId);
+      }
+
+      changed = !tmp->eqBits(wd->liveness, bLen);
+      if (changed)
+        wd->liveness->copyBits(tmp, bLen);
+
+      // A label starts a block and other blocks jump to it.
+      if (node->getType() == CBNode::kNodeLabel) {
+        blockChanged |= changed;
+        isLive = false;
+        changed = false;
+      }
+
+      node = prev;
+    }
+
+    if (!removed || !blockChanged)
+      break;
+
+    // Registers read only by removed instructions are not alive anymore in
+    // other blocks, so the liveness is computed again to find instructions
+    // that write them.
+    for (node = func; node != stop; node = node->getNext())
+      if (node->hasPassData())
+        node->getPassData<RAData>()->liveness = nullptr;
+    ASMJIT_PROPAGATE(livenessAnalysis());
+  }
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::RAPass - Annotate]
 // ============================================================================
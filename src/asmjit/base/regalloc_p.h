@@ -249,6 +249,14 @@ struct RABits {
     return r != 0;
   }
 
+  //! Get whether all bits are equal to bits of `s1`.
+  ASMJIT_INLINE bool eqBits(const RABits* s1, uint32_t len) const noexcept {
+    for (uint32_t i = 0; i < len; i++)
+      if (data[i] != s1->data[i])
+        return false;
+    return true;
+  }
+
   ASMJIT_INLINE bool _addBitsDelSource(RABits* s1, uint32_t len) noexcept {
     return _addBitsDelSource(this, s1, len);
   }
@@ -336,6 +344,10 @@ public:
 
   virtual Error process(Zone* zone) noexcept override;
 
+  //! Run the register allocator for functions of `funcs` starting at `first`
+  //! and advancing by `step`, used by workers of a concurrent compilation.
+  Error compileFuncs(Zone* zone, CCFunc** funcs, size_t count, size_t first, size_t step) noexcept;
+
   //! Run the register allocator for a given function `func`.
   virtual Error compile(CCFunc* func) noexcept;
 
@@ -360,6 +372,18 @@ public:
   //! Get stop node.
   ASMJIT_INLINE CBNode* getStop() const noexcept { return _stop; }
 
+  // --------------------------------------------------------------------------
+  // [Node-Factory]
+  // --------------------------------------------------------------------------
+
+  //! Create a new label node, safe to call from a worker of a concurrent
+  //! compilation as label ids are allocated by the shared `CodeHolder`.
+  CBLabel* newLabelNode() noexcept;
+
+  //! Emit a jump `instId` to `target`, safe to call from a worker of a
+  //! concurrent compilation as labels are validated by the shared `CodeHolder`.
+  Error emitJump(uint32_t instId, CBLabel* target) noexcept;
+
   // --------------------------------------------------------------------------
   // [State]
   // --------------------------------------------------------------------------
@@ -496,6 +520,26 @@ public:
   //! repeats until all variables are resolved.
   virtual Error livenessAnalysis();
 
+  // --------------------------------------------------------------------------
+  // [Dead Code]
+  // --------------------------------------------------------------------------
+
+  //! Remove instructions that only write registers which are not alive after
+  //! them, see \ref CodeEmitter::kHintDeadCodeElimination. Liveness analysis
+  //! must be done before. Each block is walked backwards and its liveness is
+  //! updated as instructions are removed, so a chain of dead instructions in
+  //! a block is removed by a single walk. The whole liveness analysis is only
+  //! done again if the liveness at the start of a block has changed.
+  virtual Error removeDeadCode();
+
+  //! Get whether the instruction `node` can be removed if it's dead.
+  //!
+  //! Called only if all registers `node` writes are dead after it. The
+  //! `writesRegs` argument is false if the instruction doesn't write any
+  //! register at all. The implementation must check all side effects, which
+  //! are architecture specific.
+  virtual bool isRemovableInst(CBInst* node, bool writesRegs) = 0;
+
   // --------------------------------------------------------------------------
   // [Annotate]
   // --------------------------------------------------------------------------
@@ -100,36 +100,250 @@ void HostRuntime::flush(const void* p, size_t size) noexcept {
 // [asmjit::JitRuntime - Construction / Destruction]
 // ============================================================================
 
-JitRuntime::JitRuntime() noexcept {}
-JitRuntime::~JitRuntime() noexcept {}
+JitRuntime::JitRuntime() noexcept
+  : _linkZone(4096 - Zone::kZoneOverhead),
+    _linkHeap(&_linkZone),
+    _funcLinks(&_linkHeap),
+    _helperLo(0),
+    _helperHi(0) {
+  _dataMgr.setVMemFlags(OSUtils::kVMWritable);
+}
+
+// Links are released with `_linkZone` and memory of data sections is released
+// by `_dataMgr`, except memory allocated by `OSUtils`.
+JitRuntime::~JitRuntime() noexcept {
+  for (uint32_t i = 0; i < _funcLinks._bucketsCount; i++) {
+    for (ZoneHashNode* node = _funcLinks._data[i]; node; node = node->_hashNext) {
+      for (DataLink* dataLink = static_cast<FuncLink*>(node)->dataLinks; dataLink; dataLink = dataLink->next) {
+        if (dataLink->vSize)
+          OSUtils::releaseVirtualMemory(dataLink->data, dataLink->vSize);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Helpers]
+// ============================================================================
+
+void JitRuntime::addHelperAddress(const void* address) noexcept {
+  uintptr_t p = (uintptr_t)address;
+  if (!p) return;
+
+  if (!_helperLo || p < _helperLo) _helperLo = p;
+  if (p > _helperHi) _helperHi = p;
+
+  // Data sections are addressed relatively from the code, so they must be
+  // allocated near helpers as well.
+  uintptr_t mid = _helperLo + (_helperHi - _helperLo) / 2;
+  _memMgr.setNearAddress(reinterpret_cast<const void*>(mid));
+  _dataMgr.setNearAddress(reinterpret_cast<const void*>(mid));
+}
 
 // ============================================================================
 // [asmjit::JitRuntime - Interface]
 // ============================================================================
 
+//! \internal
+class FuncLinkByCode {
+public:
+  ASMJIT_INLINE FuncLinkByCode(void* code) noexcept
+    : code(code),
+      hVal(static_cast<uint32_t>((uintptr_t)code >> 4) * 0x9E3779B1U) {}
+
+  ASMJIT_INLINE bool matches(const JitRuntime::FuncLink* node) const noexcept {
+    return node->code == code;
+  }
+
+  void* code;
+  uint32_t hVal;
+};
+
+//! \internal
+//!
+//! Get a link of `code` or create a new one, must be called with `_linkLock`.
+static JitRuntime::FuncLink* JitRuntime_getOrNewLink(JitRuntime* self, void* code) noexcept {
+  FuncLinkByCode key(code);
+  JitRuntime::FuncLink* link = self->_funcLinks.get(key);
+  if (link) return link;
+
+  link = self->_linkHeap.allocT<JitRuntime::FuncLink>();
+  if (ASMJIT_UNLIKELY(!link))
+    return nullptr;
+
+  link->_hashNext = nullptr;
+  link->_hVal = key.hVal;
+  link->code = code;
+  link->dataLinks = nullptr;
+  link->used = 0;
+  link->capacity = 0;
+
+  self->_funcLinks.put(link);
+  return link;
+}
+
+//! \internal
+//!
+//! Get whether all of `data` can be addressed relatively from all of `text`.
+static ASMJIT_INLINE bool JitRuntime_isNear(const void* text, size_t textSize, const void* data, size_t dataSize) noexcept {
+  int64_t lo = static_cast<int64_t>((intptr_t)data) - static_cast<int64_t>((intptr_t)text + textSize);
+  int64_t hi = static_cast<int64_t>((intptr_t)data + dataSize) - static_cast<int64_t>((intptr_t)text);
+  return Utils::isInt32(lo) && Utils::isInt32(hi);
+}
+
+//! \internal
+//!
+//! Allocate `dataSize` bytes of non-executable memory for data sections of
+//! `text`. Data is allocated by `_dataMgr`, which prefers blocks near the
+//! first code it relocated. If the memory is out of range of `text` (rip
+//! relative addressing) a block is allocated by `OSUtils` as close to `text`
+//! as possible instead, its size is stored to `vSize`.
+static void* JitRuntime_allocData(JitRuntime* self, const void* text, size_t textSize, size_t dataSize, size_t& vSize) noexcept {
+  vSize = 0;
+
+  if (!self->_dataMgr.getNearAddress())
+    self->_dataMgr.setNearAddress(text);
+
+  void* data = self->_dataMgr.alloc(dataSize, self->getAllocType());
+  if (!ASMJIT_ARCH_64BIT || !data || JitRuntime_isNear(text, textSize, data, dataSize))
+    return data;
+
+  self->_dataMgr.release(data);
+  return OSUtils::allocVirtualMemoryNear(dataSize, &vSize, OSUtils::kVMWritable, text);
+}
+
+//! \internal
+//!
+//! Release memory allocated by `JitRuntime_allocData()`.
+static ASMJIT_INLINE void JitRuntime_releaseData(JitRuntime* self, void* data, size_t vSize) noexcept {
+  if (vSize)
+    OSUtils::releaseVirtualMemory(data, vSize);
+  else
+    self->_dataMgr.release(data);
+}
+
+//! \internal
+//!
+//! Relocate `code` into `text`, which is also its address. Non-executable
+//! sections are allocated by `JitRuntime_allocData()` and linked to `owner`,
+//! which releases them when released by `_release()`. Must be called with
+//! `_linkLock`.
+static Error JitRuntime_relocate(JitRuntime* self, CodeHolder* code, uint8_t* text, void* owner, size_t& relocSize) noexcept {
+  size_t dataSize = code->getDataSize();
+
+  void* data = nullptr;
+  size_t vSize = 0;
+  JitRuntime::DataLink* dataLink = nullptr;
+  JitRuntime::FuncLink* link = nullptr;
+
+  if (dataSize) {
+    data = JitRuntime_allocData(self, text, code->getTextSize(), dataSize, vSize);
+    if (ASMJIT_UNLIKELY(!data))
+      return DebugUtils::errored(kErrorNoVirtualMemory);
+
+    dataLink = self->_linkHeap.allocT<JitRuntime::DataLink>();
+    link = dataLink ? JitRuntime_getOrNewLink(self, owner) : nullptr;
+
+    if (ASMJIT_UNLIKELY(!link)) {
+      if (dataLink) self->_linkHeap.release(dataLink, sizeof(JitRuntime::DataLink));
+      JitRuntime_releaseData(self, data, vSize);
+      return DebugUtils::errored(kErrorNoHeapMemory);
+    }
+  }
+
+  // The relocation still fails if no memory near `text` was available.
+  Error err = code->_relocate(
+    text, static_cast<uint64_t>((uintptr_t)text),
+    data, static_cast<uint64_t>((uintptr_t)data), relocSize);
+
+  if (ASMJIT_UNLIKELY(err || relocSize == 0)) {
+    if (dataLink) {
+      // A link created for this relocation is released by the caller.
+      self->_linkHeap.release(dataLink, sizeof(JitRuntime::DataLink));
+      JitRuntime_releaseData(self, data, vSize);
+    }
+    return err ? err : DebugUtils::errored(kErrorInvalidState);
+  }
+
+  if (dataLink) {
+    dataLink->data = data;
+    dataLink->vSize = vSize;
+    dataLink->next = link->dataLinks;
+    link->dataLinks = dataLink;
+  }
+
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Release a link of `code` and all data sections it owns, must be called
+//! with `_linkLock`.
+static void JitRuntime_releaseLink(JitRuntime* self, void* code) noexcept {
+  JitRuntime::FuncLink* link = self->_funcLinks.get(FuncLinkByCode(code));
+  if (!link) return;
+
+  // A function can have more data links if code was appended to it.
+  JitRuntime::DataLink* dataLink = link->dataLinks;
+  while (dataLink) {
+    JitRuntime::DataLink* next = dataLink->next;
+    JitRuntime_releaseData(self, dataLink->data, dataLink->vSize);
+    self->_linkHeap.release(dataLink, sizeof(JitRuntime::DataLink));
+    dataLink = next;
+  }
+
+  self->_funcLinks.del(link);
+  self->_linkHeap.release(link, sizeof(JitRuntime::FuncLink));
+}
+
 Error JitRuntime::_add(void** dst, CodeHolder* code) noexcept {
-  size_t codeSize = code->getCodeSize();
-  if (ASMJIT_UNLIKELY(codeSize == 0)) {
-    *dst = nullptr;
+  return _addWithSlack(dst, code, 0);
+}
+
+Error JitRuntime::_addWithSlack(void** dst, CodeHolder* code, size_t slackSize) noexcept {
+  *dst = nullptr;
+
+  // Executable sections (and trampolines) are placed into executable memory,
+  // all other sections are placed into memory that is never executable.
+  size_t codeSize = code->getTextSize();
+  if (ASMJIT_UNLIKELY(codeSize == 0))
     return DebugUtils::errored(kErrorNoCodeGenerated);
-  }
 
-  void* p = _memMgr.alloc(codeSize, getAllocType());
-  if (ASMJIT_UNLIKELY(!p)) {
-    *dst = nullptr;
+  if (ASMJIT_UNLIKELY(slackSize > ~static_cast<size_t>(0) - codeSize))
     return DebugUtils::errored(kErrorNoVirtualMemory);
-  }
 
-  // Relocate the code and release the unused memory back to `VMemMgr`.
-  size_t relocSize = code->relocate(p);
-  if (ASMJIT_UNLIKELY(relocSize == 0)) {
-    *dst = nullptr;
-    _memMgr.release(p);
-    return DebugUtils::errored(kErrorInvalidState);
+  uint8_t* p = static_cast<uint8_t*>(_memMgr.alloc(codeSize + slackSize, getAllocType()));
+  if (ASMJIT_UNLIKELY(!p))
+    return DebugUtils::errored(kErrorNoVirtualMemory);
+
+  size_t relocSize;
+  {
+    AutoLock locked(_linkLock);
+    Error err = JitRuntime_relocate(this, code, p, p, relocSize);
+
+    FuncLink* link = nullptr;
+    if (!err && slackSize) {
+      link = JitRuntime_getOrNewLink(this, p);
+      if (ASMJIT_UNLIKELY(!link))
+        err = DebugUtils::errored(kErrorNoHeapMemory);
+    }
+
+    if (ASMJIT_UNLIKELY(err)) {
+      JitRuntime_releaseLink(this, p);
+      _memMgr.release(p);
+      return err;
+    }
+
+    if (link) {
+      link->used = relocSize;
+      link->capacity = relocSize + slackSize;
+    }
   }
 
-  if (relocSize < codeSize)
-    _memMgr.shrink(p, relocSize);
+  // The size is exact unless the code uses trampolines, in that case release
+  // the unused memory back to `VMemMgr`.
+  if (code->hasRelocType(RelocEntry::kTypeTrampoline) && relocSize < codeSize)
+    _memMgr.shrink(p, relocSize + slackSize);
 
   flush(p, relocSize);
   *dst = p;
@@ -137,7 +351,230 @@ Error JitRuntime::_add(void** dst, CodeHolder* code) noexcept {
   return kErrorOk;
 }
 
+Error JitRuntime::_append(void** dst, void* func, CodeHolder* code) noexcept {
+  *dst = nullptr;
+
+  size_t codeSize = code->getTextSize();
+  if (ASMJIT_UNLIKELY(codeSize == 0))
+    return DebugUtils::errored(kErrorNoCodeGenerated);
+
+  AutoLock locked(_linkLock);
+
+  FuncLink* link = _funcLinks.get(FuncLinkByCode(func));
+  if (ASMJIT_UNLIKELY(!link || !link->capacity))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // Keep the alignment of the first section, the gap is never executed.
+  uint8_t* base = static_cast<uint8_t*>(func);
+  size_t alignment = std::max<size_t>(code->getSectionEntry(0)->getAlignment(), 1);
+  size_t offset = Utils::alignTo<size_t>(link->used, alignment);
+
+  if (ASMJIT_UNLIKELY(offset > link->capacity || codeSize > link->capacity - offset))
+    return DebugUtils::errored(kErrorCodeTooLarge);
+
+  size_t relocSize;
+  ASMJIT_PROPAGATE(JitRuntime_relocate(this, code, base + offset, func, relocSize));
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  ::memset(base + link->used, 0xCC, offset - link->used);
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+
+  flush(base + link->used, offset + relocSize - link->used);
+  link->used = offset + relocSize;
+
+  *dst = base + offset;
+  return kErrorOk;
+}
+
+size_t JitRuntime::getSlackSize(void* func) noexcept {
+  AutoLock locked(_linkLock);
+
+  FuncLink* link = _funcLinks.get(FuncLinkByCode(func));
+  return link ? link->capacity - link->used : size_t(0);
+}
+
+Error JitRuntime::patchJump(void* inst, const void* target) noexcept {
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  uint8_t* p = static_cast<uint8_t*>(inst);
+  size_t opSize;
+
+  if (p[0] == 0xE8 || p[0] == 0xE9)
+    opSize = 1;
+  else if (p[0] == 0x0F && (p[1] & 0xF0) == 0x80)
+    opSize = 2;
+  else
+    return DebugUtils::errored(kErrorInvalidInstruction);
+
+  int64_t disp = static_cast<int64_t>((intptr_t)target) -
+                 static_cast<int64_t>((intptr_t)(p + opSize + 4));
+  if (ASMJIT_UNLIKELY(!Utils::isInt32(disp)))
+    return DebugUtils::errored(kErrorInvalidDisplacement);
+
+  Utils::writeI32u(p + opSize, static_cast<int32_t>(disp));
+  flush(p, opSize + 4);
+  return kErrorOk;
+#else
+  ASMJIT_UNUSED(inst);
+  ASMJIT_UNUSED(target);
+  return DebugUtils::errored(kErrorInvalidArch);
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+}
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+//! \internal
+//!
+//! Atomically replace an aligned 8-byte block `p`, bytes `[index, index+size)`
+//! of the block are replaced by `data`, all other bytes are preserved.
+static void JitRuntime_patchBlock(uint64_t* p, size_t index, const uint8_t* data, size_t size) noexcept {
+  volatile uint64_t* block = p;
+  uint64_t oldValue = *block;
+
+  for (;;) {
+    union { uint64_t u64; uint8_t u8[8]; } newValue;
+    newValue.u64 = oldValue;
+    ::memcpy(newValue.u8 + index, data, size);
+
+#if ASMJIT_CC_MSC
+    uint64_t prevValue = static_cast<uint64_t>(
+      _InterlockedCompareExchange64((volatile __int64*)block, (__int64)newValue.u64, (__int64)oldValue));
+#else
+    uint64_t prevValue = __sync_val_compare_and_swap(block, oldValue, newValue.u64);
+#endif
+
+    if (prevValue == oldValue)
+      break;
+    oldValue = prevValue;
+  }
+}
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+
+Error JitRuntime::patchSite(void* site, const void* target) noexcept {
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  uint8_t* p = static_cast<uint8_t*>(site);
+  uint8_t inst[6];
+  size_t size;
+
+  // The patched instruction always keeps its original size:
+  //   - `nop5` and `jmp rel32` are rewritten to `jmp rel32`.
+  //   - `call rel32` is rewritten to `call rel32`.
+  //   - X64 only - `call|jmp [trampoline]` and their `rex call|jmp rel32`
+  //     counterparts are rewritten to `rex call|jmp rel32`.
+  if (p[0] == 0x0F && p[1] == 0x1F && p[2] == 0x44 && p[3] == 0x00 && p[4] == 0x00) {
+    inst[0] = 0xE9;
+    size = 5;
+  }
+  else if (p[0] == 0xE8 || p[0] == 0xE9) {
+    inst[0] = p[0];
+    size = 5;
+  }
+#if ASMJIT_ARCH_X64
+  else if (p[0] == 0x40 && (p[1] == 0xE8 || p[1] == 0xE9)) {
+    inst[0] = 0x40;
+    inst[1] = p[1];
+    size = 6;
+  }
+  else if (p[0] == 0xFF && (p[1] == 0x15 || p[1] == 0x25)) {
+    inst[0] = 0x40;
+    inst[1] = p[1] == 0x15 ? 0xE8 : 0xE9;
+    size = 6;
+  }
+#endif // ASMJIT_ARCH_X64
+  else {
+    return DebugUtils::errored(kErrorInvalidInstruction);
+  }
+
+  size_t index = static_cast<size_t>((uintptr_t)p & 7);
+  if (ASMJIT_UNLIKELY(index + size > 8))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  int64_t disp = static_cast<int64_t>((intptr_t)target) -
+                 static_cast<int64_t>((intptr_t)(p + size));
+  if (ASMJIT_UNLIKELY(!Utils::isInt32(disp)))
+    return DebugUtils::errored(kErrorInvalidDisplacement);
+
+  Utils::writeI32u(inst + size - 4, static_cast<int32_t>(disp));
+  JitRuntime_patchBlock(reinterpret_cast<uint64_t*>(p - index), index, inst, size);
+
+  flush(p, size);
+  return kErrorOk;
+#else
+  ASMJIT_UNUSED(site);
+  ASMJIT_UNUSED(target);
+  return DebugUtils::errored(kErrorInvalidArch);
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+}
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+//! \internal
+//!
+//! Get whether `size` bytes at `p` are NOPs emitted by `align(kAlignCode)`,
+//! which uses either `0x90` or the multi-byte NOPs recommended by Intel.
+static bool JitRuntime_isNopPadding(const uint8_t* p, size_t size) noexcept {
+  size_t i = 0;
+  while (i < size) {
+    while (i < size && p[i] == 0x66)
+      i++;
+
+    if (i == size)
+      return false;
+
+    if (p[i] == 0x90) {
+      i++;
+      continue;
+    }
+
+    if (size - i < 3 || p[i] != 0x0F || p[i + 1] != 0x1F)
+      return false;
+
+    size_t n;
+    switch (p[i + 2]) {
+      case 0x00: n = 3; break;
+      case 0x40: n = 4; break;
+      case 0x44: n = 5; break;
+      case 0x80: n = 7; break;
+      case 0x84: n = 8; break;
+      default:
+        return false;
+    }
+
+    if (size - i < n)
+      return false;
+    i += n;
+  }
+  return true;
+}
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+
+Error JitRuntime::_redirect(void* func, const void* target) noexcept {
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  // The patch site is aligned to 8 bytes, if the function is not aligned the
+  // prolog starts with a NOP padding, which is executed before the site.
+  uint8_t* p = static_cast<uint8_t*>(func);
+  uint8_t* site = reinterpret_cast<uint8_t*>(Utils::alignTo<uintptr_t>((uintptr_t)p, 8));
+
+  if (ASMJIT_UNLIKELY(!JitRuntime_isNopPadding(p, (size_t)(site - p))))
+    return DebugUtils::errored(kErrorInvalidInstruction);
+
+  // The entry is either the `nop5` emitted by the prolog or `jmp rel32` that
+  // replaced it. Any other instruction is a function without patchable entry.
+  bool isNop5 = site[0] == 0x0F && site[1] == 0x1F && site[2] == 0x44 && site[3] == 0x00 && site[4] == 0x00;
+  if (ASMJIT_UNLIKELY(!isNop5 && site[0] != 0xE9))
+    return DebugUtils::errored(kErrorInvalidInstruction);
+
+  return patchSite(site, target);
+#else
+  ASMJIT_UNUSED(func);
+  ASMJIT_UNUSED(target);
+  return DebugUtils::errored(kErrorInvalidArch);
+#endif // ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+}
+
 Error JitRuntime::_release(void* p) noexcept {
+  {
+    AutoLock locked(_linkLock);
+    JitRuntime_releaseLink(this, p);
+  }
+
   return _memMgr.release(p);
 }
 
@@ -11,6 +11,7 @@
 // [Dependencies]
 #include "../base/codeholder.h"
 #include "../base/vmem.h"
+#include "../base/zone.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -171,6 +172,85 @@ public:
 
   //! Get the virtual memory manager.
   ASMJIT_INLINE VMemMgr* getMemMgr() const noexcept { return const_cast<VMemMgr*>(&_memMgr); }
+  //! Get the virtual memory manager used by non-executable sections.
+  ASMJIT_INLINE VMemMgr* getDataMemMgr() const noexcept { return const_cast<VMemMgr*>(&_dataMgr); }
+
+  // --------------------------------------------------------------------------
+  // [Helpers]
+  // --------------------------------------------------------------------------
+
+  //! Register a helper function at `address` called by the generated code.
+  //!
+  //! The runtime prefers to allocate code within +/-2GB of all registered
+  //! helpers (the middle of their range) so calls to them can be relocated
+  //! to a direct `call rel32` instead of an indirect call via trampoline.
+  //! Memory of non-executable sections is allocated near helpers as well.
+  ASMJIT_API void addHelperAddress(const void* address) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Incremental Code]
+  // --------------------------------------------------------------------------
+
+  //! Add `code` like `add()` and reserve `slackSize` bytes of executable
+  //! memory after it, which can be used later by `append()`.
+  template<typename Func>
+  ASMJIT_INLINE Error addWithSlack(Func* dst, CodeHolder* code, size_t slackSize) noexcept {
+    return _addWithSlack(Internal::ptr_cast<void**, Func*>(dst), code, slackSize);
+  }
+
+  //! Append `code` to a function `func` added by `addWithSlack()`.
+  //!
+  //! The code is relocated into the slack of `func` and `dst` receives its
+  //! address. Nothing that was installed before is modified, so appending is
+  //! safe while `func` is running. Use `patchJump()` to make the existing code
+  //! jump to the appended one. Returns `kErrorCodeTooLarge` if the remaining
+  //! slack is too small, in that case nothing is appended.
+  template<typename Func>
+  ASMJIT_INLINE Error append(Func* dst, void* func, CodeHolder* code) noexcept {
+    return _append(Internal::ptr_cast<void**, Func*>(dst), func, code);
+  }
+
+  //! Get the remaining slack of a function `func` (zero if it has none).
+  ASMJIT_API size_t getSlackSize(void* func) noexcept;
+
+  //! Patch a jump or call instruction at `inst` to jump to `target`.
+  //!
+  //! The instruction must be `jmp rel32`, `jcc rel32`, or `call rel32` and
+  //! `inst` must point to its opcode. The displacement is written by a single
+  //! 32-bit store, which other threads observe atomically unless it crosses a
+  //! cache line. Instruction cache is flushed by `flush()`.
+  ASMJIT_API Error patchJump(void* inst, const void* target) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Hot-Patching]
+  // --------------------------------------------------------------------------
+
+  //! Atomically redirect a patch site at `site` to `target`.
+  //!
+  //! The site must be emitted by `patchSite()`, `patchableCall()`, or
+  //! `patchableJmp()` and its address is the address of the code plus the
+  //! offset of its label, see \ref CodeHolder::getPatchSites(). A NOP site
+  //! becomes `jmp target`, a call or jump keeps its kind and only changes
+  //! its target.
+  //!
+  //! The instruction never crosses an 8-byte boundary and it's rewritten by
+  //! a single aligned 8-byte store, so a thread executing the code at the
+  //! same time either sees the old or the new instruction, which is what
+  //! x86 requires for cross-modifying code without stopping other threads.
+  //! Returns `kErrorInvalidDisplacement` if `target` is out of +/-2GB range.
+  ASMJIT_API Error patchSite(void* site, const void* target) noexcept;
+
+  //! Redirect a function `func` that starts with a patchable entry to `target`.
+  //!
+  //! The entry is emitted by the function prolog if the function has \ref
+  //! FuncFrameInfo::kAttrPatchableEntry set. All callers that still hold the
+  //! original function pointer will execute `target` after this call returns.
+  //! Returns `kErrorInvalidInstruction` if `func` doesn't start with such entry,
+  //! the code is never modified in that case.
+  template<typename Func, typename Target>
+  ASMJIT_INLINE Error redirect(Func func, Target target) noexcept {
+    return _redirect(Internal::ptr_cast<void*, Func>(func), Internal::ptr_cast<const void*, Target>(target));
+  }
 
   // --------------------------------------------------------------------------
   // [Interface]
@@ -179,12 +259,48 @@ public:
   ASMJIT_API Error _add(void** dst, CodeHolder* code) noexcept override;
   ASMJIT_API Error _release(void* p) noexcept override;
 
+  ASMJIT_API Error _addWithSlack(void** dst, CodeHolder* code, size_t slackSize) noexcept;
+  ASMJIT_API Error _append(void** dst, void* func, CodeHolder* code) noexcept;
+  ASMJIT_API Error _redirect(void* func, const void* target) noexcept;
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
+  //! Memory allocated for non-executable sections of a function (or of code
+  //! appended to it).
+  struct DataLink {
+    DataLink* next;                      //!< Next link.
+    void* data;                          //!< Data sections allocated by `_dataMgr` (or by `OSUtils`).
+    size_t vSize;                        //!< Size of virtual memory allocated by `OSUtils` (zero if allocated by `_dataMgr`).
+  };
+
+  //! Tracks data sections and slack of a function, hashed by its address so
+  //! `_release()` doesn't have to search all functions.
+  class FuncLink : public ZoneHashNode {
+  public:
+    void* code;                          //!< Function returned by `_add()` or `_addWithSlack()`.
+    DataLink* dataLinks;                 //!< Data sections of the function (and appended code).
+    size_t used;                         //!< Number of bytes used (including appended code).
+    size_t capacity;                     //!< Number of bytes reserved for the function (zero if it has no slack).
+  };
+
   //! Virtual memory manager.
   VMemMgr _memMgr;
+  //! Virtual memory manager of non-executable sections (`.rodata`, `.data`, `.bss`).
+  VMemMgr _dataMgr;
+  //! Lock that protects `_funcLinks` and serializes `append()`.
+  Lock _linkLock;
+  //! Zone used to allocate links.
+  Zone _linkZone;
+  //! ZoneHeap that uses `_linkZone`.
+  ZoneHeap _linkHeap;
+  //! Links of all functions having non-executable sections or slack.
+  ZoneHash<FuncLink> _funcLinks;
+  //! Lowest address of all registered helpers (or zero).
+  uintptr_t _helperLo;
+  //! Highest address of all registered helpers (or zero).
+  uintptr_t _helperHi;
 };
 
 //! \}
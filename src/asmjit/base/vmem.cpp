@@ -236,10 +236,13 @@ struct VMemMgr::PermanentNode {
 //!
 //! Helper to avoid `#ifdef`s in the code.
 ASMJIT_INLINE uint8_t* vMemMgrAllocVMem(VMemMgr* self, size_t size, size_t* vSize) noexcept {
-  uint32_t flags = OSUtils::kVMWritable | OSUtils::kVMExecutable;
+  uint32_t flags = self->_vMemFlags;
 #if !ASMJIT_OS_WINDOWS
-  return static_cast<uint8_t*>(OSUtils::allocVirtualMemory(size, vSize, flags));
+  return static_cast<uint8_t*>(OSUtils::allocVirtualMemoryNear(size, vSize, flags, self->_nearAddress));
 #else
+  // Allocating near an address is only possible in the current process.
+  if (self->_nearAddress && self->_hProcess == OSUtils::getVirtualMemoryInfo().hCurrentProcess)
+    return static_cast<uint8_t*>(OSUtils::allocVirtualMemoryNear(size, vSize, flags, self->_nearAddress));
   return static_cast<uint8_t*>(OSUtils::allocProcessMemory(self->_hProcess, size, vSize, flags));
 #endif
 }
@@ -741,6 +744,8 @@ VMemMgr::VMemMgr(HANDLE hProcess) noexcept {
 
   _permanent = nullptr;
   _keepVirtualMemory = false;
+  _vMemFlags = OSUtils::kVMWritable | OSUtils::kVMExecutable;
+  _nearAddress = nullptr;
 }
 
 VMemMgr::~VMemMgr() noexcept {
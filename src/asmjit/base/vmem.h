@@ -93,6 +93,23 @@ public:
   //! \sa \ref getKeepVirtualMemory.
   ASMJIT_INLINE void setKeepVirtualMemory(bool val) noexcept { _keepVirtualMemory = val; }
 
+  //! Get virtual memory flags used to allocate new blocks, see \ref OSUtils::VMFlags.
+  ASMJIT_INLINE uint32_t getVMemFlags() const noexcept { return _vMemFlags; }
+  //! Set virtual memory flags used to allocate new blocks.
+  //!
+  //! The default is `OSUtils::kVMWritable | OSUtils::kVMExecutable`, which is
+  //! required by code. Memory for data that is never executed should omit the
+  //! `OSUtils::kVMExecutable` flag. Only affects blocks allocated afterwards.
+  ASMJIT_INLINE void setVMemFlags(uint32_t flags) noexcept { _vMemFlags = flags; }
+
+  //! Get the address new blocks should be allocated near to (or null).
+  ASMJIT_INLINE const void* getNearAddress() const noexcept { return _nearAddress; }
+  //! Prefer allocating new blocks within +/-2GB of `p`, see \ref OSUtils::allocVirtualMemoryNear().
+  //!
+  //! Code placed near functions it calls can use direct `call rel32` instead
+  //! of going through trampolines. Only affects blocks allocated afterwards.
+  ASMJIT_INLINE void setNearAddress(const void* p) noexcept { _nearAddress = p; }
+
   // --------------------------------------------------------------------------
   // [Alloc / Release]
   // --------------------------------------------------------------------------
@@ -120,6 +137,8 @@ public:
   size_t _blockSize;                     //!< Default block size.
   size_t _blockDensity;                  //!< Default block density.
   bool _keepVirtualMemory;               //!< Keep virtual memory after destroyed.
+  uint32_t _vMemFlags;                   //!< Virtual memory flags used to allocate new blocks.
+  const void* _nearAddress;              //!< Address new blocks should be allocated near to.
 
   size_t _allocatedBytes;                //!< How many bytes are currently allocated.
   size_t _usedBytes;                     //!< How many bytes are currently used.
@@ -90,6 +90,21 @@ void Zone::reset(bool releaseMemory) noexcept {
   }
 }
 
+// ============================================================================
+// [asmjit::Zone - Accessors]
+// ============================================================================
+
+size_t Zone::getUsedSize() const noexcept {
+  const Block* cur = _block;
+  if (cur == &Zone_zeroBlock)
+    return 0;
+
+  size_t size = (size_t)(_ptr - cur->data);
+  while ((cur = cur->prev) != nullptr)
+    size += cur->size;
+  return size;
+}
+
 // ============================================================================
 // [asmjit::Zone - Alloc]
 // ============================================================================
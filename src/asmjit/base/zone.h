@@ -91,6 +91,11 @@ public:
   ASMJIT_INLINE uint32_t getBlockAlignment() const noexcept { return (uint32_t)1 << _blockAlignmentShift; }
   //! Get remaining size of the current block.
   ASMJIT_INLINE size_t getRemainingSize() const noexcept { return (size_t)(_end - _ptr); }
+  //! Get count of bytes allocated since the last `reset()`.
+  //!
+  //! Includes the unused ends of blocks that were left because an allocation
+  //! didn't fit into them.
+  ASMJIT_API size_t getUsedSize() const noexcept;
 
   //! Get the current zone cursor (dangerous).
   //!
@@ -685,7 +690,7 @@ public:
       ASMJIT_PROPAGATE(grow(heap, 1));
 
     T* dst = static_cast<T*>(_data) + index;
-    ::memmove(dst + 1, dst, _length - index);
+    ::memmove(dst + 1, dst, (_length - index) * sizeof(T));
     ::memcpy(dst, &item, sizeof(T));
 
     _length++;
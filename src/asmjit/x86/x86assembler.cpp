@@ -15,6 +15,7 @@
 #include "../base/cpuinfo.h"
 #include "../base/logging.h"
 #include "../base/misc_p.h"
+#include "../base/runtime.h"
 #include "../base/utils.h"
 #include "../x86/x86assembler.h"
 #include "../x86/x86logging_p.h"
@@ -355,7 +356,10 @@ static ASMJIT_INLINE uint32_t x86EncodeSib(uint32_t s, uint32_t i, uint32_t b) n
 // [asmjit::X86Assembler - Construction / Destruction]
 // ============================================================================
 
-X86Assembler::X86Assembler(CodeHolder* code) noexcept : Assembler() {
+X86Assembler::X86Assembler(CodeHolder* code) noexcept
+  : Assembler(),
+    _fusibleStart(0),
+    _fusibleEnd(Globals::kInvalidIndex) {
   if (code)
     code->attach(this);
 }
@@ -389,9 +393,32 @@ Error X86Assembler::onAttach(CodeHolder* code) noexcept {
 }
 
 Error X86Assembler::onDetach(CodeHolder* code) noexcept {
+  _fusibleStart = 0;
+  _fusibleEnd = Globals::kInvalidIndex;
   return Base::onDetach(code);
 }
 
+// ============================================================================
+// [asmjit::X86Assembler - Code-Buffer]
+// ============================================================================
+
+Error X86Assembler::section(SectionEntry* section) {
+  // Offsets of the last fusible instruction are only valid in its section.
+  _fusibleStart = 0;
+  _fusibleEnd = Globals::kInvalidIndex;
+  return Base::section(section);
+}
+
+// ============================================================================
+// [asmjit::X86Assembler - Label]
+// ============================================================================
+
+Error X86Assembler::bind(const Label& label) {
+  // A label bound between a fusible instruction and a jump splits the pair.
+  _fusibleEnd = Globals::kInvalidIndex;
+  return Base::bind(label);
+}
+
 // ============================================================================
 // [asmjit::X86Assembler - Helpers]
 // ============================================================================
@@ -498,6 +525,430 @@ Error X86Assembler::onDetach(CodeHolder* code) noexcept {
 #define ENC_OPS3(OP0, OP1, OP2)           ((Operand::kOp##OP0) + ((Operand::kOp##OP1) << 3) + ((Operand::kOp##OP2) << 6))
 #define ENC_OPS4(OP0, OP1, OP2, OP3)      ((Operand::kOp##OP0) + ((Operand::kOp##OP1) << 3) + ((Operand::kOp##OP2) << 6) + ((Operand::kOp##OP3) << 9))
 
+// ============================================================================
+// [asmjit::X86Assembler - Nops]
+// ============================================================================
+
+//! \internal
+//!
+//! Fill `size` bytes at `cursor` with NOPs and return the advanced cursor. If
+//! `optimized` is true multi-byte NOPs are used, otherwise 0x90 is repeated.
+static uint8_t* X86Assembler_fillNops(uint8_t* cursor, uint32_t size, bool optimized) noexcept {
+  // Intel 64 and IA-32 Architectures Software Developer's Manual - Volume 2B (NOP).
+  enum { kMaxNopSize = 9 };
+
+  static const uint8_t nopData[kMaxNopSize][kMaxNopSize] = {
+    { 0x90 },
+    { 0x66, 0x90 },
+    { 0x0F, 0x1F, 0x00 },
+    { 0x0F, 0x1F, 0x40, 0x00 },
+    { 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  };
+
+  if (!optimized) {
+    ::memset(cursor, 0x90, size);
+    return cursor + size;
+  }
+
+  while (size) {
+    uint32_t n = std::min<uint32_t>(size, kMaxNopSize);
+    const uint8_t* src = nopData[n - 1];
+
+    size -= n;
+    do {
+      EMIT_BYTE(*src++);
+    } while (--n);
+  }
+
+  return cursor;
+}
+
+// ============================================================================
+// [asmjit::X86Assembler - Compact Encoding]
+// ============================================================================
+
+//! \internal
+//!
+//! Get if `imm` is a non-negative 32-bit signed integer. An instruction that
+//! sign-extends such immediate to 64 bits produces the same result (and the
+//! same flags) as its 32-bit form that zero-extends the destination.
+static ASMJIT_INLINE bool X86Assembler_isPositiveInt32(const Operand_& op) noexcept {
+  int64_t val = op.as<Imm>().getInt64();
+  return val >= 0 && val <= 0x7FFFFFFF;
+}
+
+//! \internal
+//!
+//! Get if the VEX encoded instruction `instId` is commutative in its second
+//! and third operands (bit-exact, so floating-point arithmetic is excluded).
+static ASMJIT_INLINE bool X86Assembler_isVexCommutative(uint32_t instId) noexcept {
+  switch (instId) {
+    case X86Inst::kIdVandpd:
+    case X86Inst::kIdVandps:
+    case X86Inst::kIdVorpd:
+    case X86Inst::kIdVorps:
+    case X86Inst::kIdVpaddb:
+    case X86Inst::kIdVpaddd:
+    case X86Inst::kIdVpaddq:
+    case X86Inst::kIdVpaddsb:
+    case X86Inst::kIdVpaddsw:
+    case X86Inst::kIdVpaddusb:
+    case X86Inst::kIdVpaddusw:
+    case X86Inst::kIdVpaddw:
+    case X86Inst::kIdVpand:
+    case X86Inst::kIdVpavgb:
+    case X86Inst::kIdVpavgw:
+    case X86Inst::kIdVpcmpeqb:
+    case X86Inst::kIdVpcmpeqd:
+    case X86Inst::kIdVpcmpeqw:
+    case X86Inst::kIdVpmaddwd:
+    case X86Inst::kIdVpmaxsw:
+    case X86Inst::kIdVpmaxub:
+    case X86Inst::kIdVpminsw:
+    case X86Inst::kIdVpminub:
+    case X86Inst::kIdVpmulhuw:
+    case X86Inst::kIdVpmulhw:
+    case X86Inst::kIdVpmullw:
+    case X86Inst::kIdVpmuludq:
+    case X86Inst::kIdVpor:
+    case X86Inst::kIdVpxor:
+    case X86Inst::kIdVxorpd:
+    case X86Inst::kIdVxorps:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//! \internal
+//!
+//! Rewrite the instruction into a semantically equivalent form that has a
+//! shorter encoding. Returns true and fills `out` if the rewrite happened.
+//!
+//! Rewrites performed:
+//!
+//!   - `and|test r64, imm` -> `and|test r32, imm` if `imm` is non-negative.
+//!   - `xor|sub r64, r64`  -> `xor|sub r32, r32` if both registers are the same.
+//!   - `movzx r64, r/m`    -> `movzx r32, r/m` (zero-extension is implicit).
+//!   - `vop x, a, b`       -> `vop x, b, a` if the instruction is commutative
+//!                            and the swap allows to use 2-byte VEX prefix.
+//!
+//! NOTE: `mov r64, imm` is always encoded in its shortest form by `_emit()`.
+static bool X86Assembler_compactOperands(const X86Assembler* self, uint32_t instId, uint32_t options,
+  const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, Operand_* out) noexcept {
+
+  if (options & (X86Inst::kOptionLongForm | X86Inst::kOptionLock | CodeEmitter::kOptionOp4Op5Used))
+    return false;
+
+  out[0].copyFrom(o0);
+  out[1].copyFrom(o1);
+  out[2].copyFrom(o2);
+  out[3].copyFrom(o3);
+
+  if (!o0.isReg() || !o3.isNone())
+    return false;
+
+  const X86Reg& r0 = o0.as<X86Reg>();
+  switch (instId) {
+    case X86Inst::kIdAnd:
+    case X86Inst::kIdTest:
+      if (!r0.isGpq() || !o1.isImm() || !o2.isNone() || !X86Assembler_isPositiveInt32(o1))
+        return false;
+
+      out[0].copyFrom(x86::gpd(r0.getId()));
+      return true;
+
+    case X86Inst::kIdXor:
+    case X86Inst::kIdSub:
+      if (!r0.isGpq() || !o1.isReg() || !o2.isNone() || !o1.as<X86Reg>().isGpq() || o1.getId() != r0.getId())
+        return false;
+
+      out[0].copyFrom(x86::gpd(r0.getId()));
+      out[1].copyFrom(out[0]);
+      return true;
+
+    case X86Inst::kIdMovzx:
+      if (!r0.isGpq() || !o2.isNone())
+        return false;
+
+      out[0].copyFrom(x86::gpd(r0.getId()));
+      return true;
+
+    default:
+      break;
+  }
+
+  // VEX3 -> VEX2: The third operand is encoded in MODRM.RM, which requires
+  // VEX.B if it's a high register, the second operand is encoded in VEX.VVVV,
+  // which can encode all 16 registers.
+  if (X86Assembler_isVexCommutative(instId) && o1.isReg() && o2.isReg()) {
+    if ((options & (X86Inst::kOptionVex3 | X86Inst::kOptionEvex)) || self->hasExtraReg())
+      return false;
+
+    const X86Reg& r1 = o1.as<X86Reg>();
+    const X86Reg& r2 = o2.as<X86Reg>();
+
+    if (!(r1.isXmm() || r1.isYmm()) || r1.getType() != r2.getType() || r0.getType() != r1.getType())
+      return false;
+
+    if (r0.getId() >= 16 || r1.getId() >= 8 || r2.getId() < 8 || r2.getId() >= 16)
+      return false;
+
+    out[1].copyFrom(o2);
+    out[2].copyFrom(o1);
+    return true;
+  }
+
+  return false;
+}
+
+// ============================================================================
+// [asmjit::X86Assembler - SSE To AVX]
+// ============================================================================
+
+//! \internal
+//!
+//! Translate a legacy SSE instruction into its AVX counterpart. Returns the
+//! AVX instruction id and fills `out`, or returns zero if the instruction
+//! can't be translated.
+static uint32_t X86Assembler_sseToAvx(uint32_t instId, uint32_t options,
+  const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, Operand_* out) noexcept {
+
+  if (options & CodeEmitter::kOptionOp4Op5Used)
+    return 0;
+
+  const X86Inst& inst = X86Inst::getInst(instId);
+  if (!inst.getCommonData().isSse())
+    return 0;
+
+  const X86Inst::SseToAvxData& sseToAvx = inst.getSseToAvxData();
+  uint32_t mode = sseToAvx.getMode();
+  if (mode == X86Inst::kSseToAvxNone)
+    return 0;
+
+  // Some instructions share their id with MMX forms, which have no AVX form.
+  if (X86Reg::isMm(o0) || X86Reg::isMm(o1))
+    return 0;
+
+  uint32_t avxId = static_cast<uint32_t>(static_cast<int32_t>(instId) + sseToAvx.getDelta());
+
+  if (mode == X86Inst::kSseToAvxMoveIfMem)
+    mode = (o0.isMem() || o1.isMem()) ? uint32_t(X86Inst::kSseToAvxMove) : uint32_t(X86Inst::kSseToAvxExtend);
+
+  switch (mode) {
+    case X86Inst::kSseToAvxMove:
+      out[0].copyFrom(o0);
+      out[1].copyFrom(o1);
+      out[2].copyFrom(o2);
+      out[3].copyFrom(o3);
+      return avxId;
+
+    case X86Inst::kSseToAvxExtend:
+      if (!o0.isReg() || !o3.isNone())
+        return 0;
+
+      out[0].copyFrom(o0);
+      out[1].copyFrom(o0);
+      out[2].copyFrom(o1);
+      out[3].copyFrom(o2);
+      return avxId;
+
+    case X86Inst::kSseToAvxBlend:
+      // The third operand (XMM0) is implicit in SSE and explicit in AVX.
+      if (!o0.isReg() || !o3.isNone())
+        return 0;
+
+      out[0].copyFrom(o0);
+      out[1].copyFrom(o0);
+      out[2].copyFrom(o1);
+      out[3].copyFrom(x86::xmm0);
+      return avxId;
+
+    default:
+      return 0;
+  }
+}
+
+// ============================================================================
+// [asmjit::X86Assembler - Jcc Erratum]
+// ============================================================================
+
+//! \internal
+//!
+//! Boundary that a jump (or a macro-fused pair) must not cross or end at.
+static const uint32_t kX86JccBoundary = 32;
+
+//! \internal
+//!
+//! Get whether the instruction `instId` with the given operands can be macro
+//! fused with a following conditional jump and can be moved freely, which
+//! means that its encoding doesn't depend on its own position.
+static ASMJIT_INLINE bool X86Assembler_isFusible(uint32_t instId, const Operand_& o0, const Operand_& o1) noexcept {
+  switch (instId) {
+    case X86Inst::kIdAdd:
+    case X86Inst::kIdAnd:
+    case X86Inst::kIdCmp:
+    case X86Inst::kIdDec:
+    case X86Inst::kIdInc:
+    case X86Inst::kIdSub:
+    case X86Inst::kIdTest:
+      break;
+
+    default:
+      return false;
+  }
+
+  // MEM+IMM forms are never fused. Memory operands are only accepted when
+  // they are not relative to RIP (label or RIP base), as these would have to
+  // be re-encoded if the instruction is moved.
+  if (o0.isMem())
+    return !o1.isImm() && o0.as<X86Mem>().hasBaseReg() && !o0.as<X86Mem>().hasBaseLabel() && o0.as<X86Mem>().getBaseType() != X86Reg::kRegRip;
+
+  if (o1.isMem())
+    return o1.as<X86Mem>().hasBaseReg() && o1.as<X86Mem>().getBaseType() != X86Reg::kRegRip;
+
+  return o0.isReg() && (o1.isReg() || o1.isImm() || o1.isNone());
+}
+
+//! \internal
+//!
+//! Emit an instruction so that the jump (or the macro-fused pair that ends
+//! with the jump) doesn't cross nor end at 32-byte boundary.
+//!
+//! The size of a jump is not known before it's encoded, so the jump is first
+//! encoded without logging, all side effects the encoding had on `CodeHolder`
+//! (label links, relocations, and trampolines) are reverted, and the jump is
+//! emitted again after the necessary padding has been inserted.
+static Error X86Assembler_emitAvoidingJccErratum(X86Assembler* self, uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) {
+  CodeHolder* code = self->_code;
+  Error err;
+
+  uint32_t hints = self->_globalHints;
+  self->_globalHints = hints & ~CodeEmitter::kHintAvoidJccErratum;
+
+  size_t start = self->getOffset();
+  bool doesJump = instId < X86Inst::_kIdCount && X86Inst::getInst(instId).getCommonData().doesJump();
+
+  if (!doesJump) {
+    err = self->_emit(instId, o0, o1, o2, o3);
+    self->_globalHints = hints;
+
+    if (!err && X86Assembler_isFusible(instId, o0, o1)) {
+      self->_fusibleStart = start;
+      self->_fusibleEnd = self->getOffset();
+    }
+    else {
+      self->_fusibleEnd = Globals::kInvalidIndex;
+    }
+    return err;
+  }
+
+  // Only conditional jumps are fused with the preceding instruction.
+  size_t pairStart = start;
+  if (self->_fusibleEnd == start && X86Inst::getInst(instId).getCommonData().getJumpType() == Inst::kJumpTypeConditional)
+    pairStart = self->_fusibleStart;
+  self->_fusibleEnd = Globals::kInvalidIndex;
+
+  // Remember everything the trial encoding can change.
+  uint32_t globalOptions = self->_globalOptions;
+  uint32_t options = self->_options;
+  RegOnly extraReg(self->_extraReg);
+  const char* inlineComment = self->_inlineComment;
+  Operand_ op4(self->_op4);
+  Operand_ op5(self->_op5);
+
+  size_t relocCount = code->_relocations.getLength();
+  uint32_t unresolvedLabelsCount = code->_unresolvedLabelsCount;
+
+  const Operand_* opArray[] = { &o0, &o1, &o2, &o3 };
+  LabelEntry* labels[4];
+  LabelLink* links[4];
+  uint32_t labelCount = 0;
+
+  for (uint32_t i = 0; i < 4; i++) {
+    const Operand_& op = *opArray[i];
+    LabelEntry* le = nullptr;
+
+    if (op.isLabel())
+      le = code->getLabelEntry(op.getId());
+    else if (op.isMem() && op.as<X86Mem>().hasBaseLabel())
+      le = code->getLabelEntry(op.as<X86Mem>().getBaseId());
+
+    if (le) {
+      labels[labelCount] = le;
+      links[labelCount] = le->_links;
+      labelCount++;
+    }
+  }
+
+  // Trial encoding.
+  self->_globalOptions = globalOptions & ~CodeEmitter::kOptionLoggingEnabled;
+  err = self->_emit(instId, o0, o1, o2, o3);
+  self->_globalOptions = globalOptions;
+
+  if (ASMJIT_UNLIKELY(err)) {
+    self->_globalHints = hints;
+    return err;
+  }
+
+  size_t end = self->getOffset();
+
+  // Revert the trial encoding.
+  for (uint32_t i = 0; i < labelCount; i++) {
+    LabelEntry* le = labels[i];
+    while (le->_links != links[i]) {
+      LabelLink* link = le->_links;
+      le->_links = link->prev;
+      code->releaseLabelLink(link);
+    }
+  }
+
+  for (size_t i = relocCount; i < code->_relocations.getLength(); i++) {
+    RelocEntry* re = code->_relocations[i];
+    if (re->getType() == RelocEntry::kTypeTrampoline)
+      code->_removeTrampoline(re);
+    code->_baseHeap.release(re, sizeof(RelocEntry));
+  }
+
+  code->_relocations.truncate(relocCount);
+  code->_unresolvedLabelsCount = unresolvedLabelsCount;
+
+  self->_bufferPtr = self->_bufferData + start;
+  self->_options = options;
+  self->_extraReg = extraReg;
+  self->_inlineComment = inlineComment;
+  self->_op4 = op4;
+  self->_op5 = op5;
+
+  // Insert padding before the jump or the fused pair, the fused instruction
+  // is moved after the padding (it doesn't depend on its position).
+  if ((pairStart / kX86JccBoundary) != (end / kX86JccBoundary)) {
+    uint32_t padding = static_cast<uint32_t>(kX86JccBoundary - (pairStart % kX86JccBoundary));
+
+    if (self->getRemainingSpace() < padding) {
+      err = code->growBuffer(&self->_section->_buffer, padding);
+      if (ASMJIT_UNLIKELY(err)) {
+        self->_globalHints = hints;
+        return self->setLastError(err);
+      }
+    }
+
+    uint8_t* pairPtr = self->_bufferData + pairStart;
+    ::memmove(pairPtr + padding, pairPtr, start - pairStart);
+    X86Assembler_fillNops(pairPtr, padding, (hints & CodeEmitter::kHintOptimizedAlign) != 0);
+    self->_bufferPtr += padding;
+  }
+
+  err = self->_emit(instId, o0, o1, o2, o3);
+  self->_globalHints = hints;
+  return err;
+}
+
 // ============================================================================
 // [asmjit::X86Assembler - Emit]
 // ============================================================================
@@ -523,6 +974,24 @@ Error X86Assembler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o
   const uint32_t kSHR_W_PP = X86Inst::kOpCode_PP_Shift - 16;
   const uint32_t kSHR_W_EW = X86Inst::kOpCode_EW_Shift - 23;
 
+  if (ASMJIT_UNLIKELY(_globalHints & (kHintCompactEncoding | kHintSseToAvx | kHintAvoidJccErratum))) {
+    if (_globalHints & kHintSseToAvx) {
+      Operand_ avx[4];
+      uint32_t avxId = X86Assembler_sseToAvx(instId, getGlobalOptions() | getOptions(), o0, o1, o2, o3, avx);
+      if (avxId)
+        return _emit(avxId, avx[0], avx[1], avx[2], avx[3]);
+    }
+
+    if (_globalHints & kHintCompactEncoding) {
+      Operand_ compact[4];
+      if (X86Assembler_compactOperands(this, instId, getGlobalOptions() | getOptions(), o0, o1, o2, o3, compact))
+        return _emit(instId, compact[0], compact[1], compact[2], compact[3]);
+    }
+
+    if (_globalHints & kHintAvoidJccErratum)
+      return X86Assembler_emitAvoidingJccErratum(this, instId, o0, o1, o2, o3);
+  }
+
   uint8_t* cursor = _bufferPtr;
   uint32_t options = static_cast<uint32_t>(instId >= X86Inst::_kIdCount)       |
                      static_cast<uint32_t>((size_t)(_bufferEnd - cursor) < 16) |
@@ -3765,9 +4234,11 @@ EmitModSib:
         uint64_t baseAddress = getCodeInfo().getBaseAddress();
         relOffset = rmRel->as<X86Mem>().getOffsetLo32();
 
-        // Prefer absolute addressing mode if FS|GS segment override is present.
+        // Prefer absolute addressing mode if FS|GS segment override is present
+        // or if the code is position independent (base address is not fixed).
         bool absoluteValid = rmRel->as<X86Mem>().getOffsetHi32() == (relOffset >> 31);
-        bool preferAbsolute = (rmRel->as<X86Mem>().getSegmentId() >= X86Seg::kIdFs) || rmRel->as<X86Mem>().isAbs();
+        bool preferAbsolute = (rmRel->as<X86Mem>().getSegmentId() >= X86Seg::kIdFs) || rmRel->as<X86Mem>().isAbs() ||
+                              getCodeInfo().isPIC();
 
         // If we know the base address and the memory operand points to an
         // absolute address it's possible to calculate REL32 that can be
@@ -3820,6 +4291,7 @@ EmitModSib_LabelRip_X86:
 
           if (label->isBound()) {
             // Bound label.
+            re->_targetSectionId = label->getSectionId();
             re->_data += static_cast<uint64_t>(label->getOffset());
             EMIT_32(0);
           }
@@ -3836,6 +4308,7 @@ EmitModSib_LabelRip_X86:
           if (ASMJIT_UNLIKELY(err)) goto Failed;
 
           re->_sourceSectionId = _section->getId();
+          re->_targetSectionId = _section->getId();
           re->_sourceOffset = static_cast<uint64_t>((uintptr_t)(cursor - _bufferData));
           re->_data = re->_sourceOffset + static_cast<uint64_t>(static_cast<int64_t>(relOffset));
           EMIT_32(0);
@@ -3849,13 +4322,13 @@ EmitModSib_LabelRip_X86:
           if (!label) goto InvalidLabel;
 
           relOffset -= (4 + imLen);
-          if (label->isBound()) {
+          if (label->isBound() && label->getSectionId() == _section->getId()) {
             // Bound label.
             relOffset += label->getOffset() - static_cast<int32_t>((intptr_t)(cursor - _bufferData));
             EMIT_32(static_cast<int32_t>(relOffset));
           }
           else {
-            // Non-bound label.
+            // Non-bound label or a label bound in another section.
             relSize = 4;
             goto EmitRel;
           }
@@ -4248,7 +4721,8 @@ EmitVexEvexM:
   // [Emit - Jmp/Jcc/Call]
   // --------------------------------------------------------------------------
 
-  // TODO: Should be adjusted after the support for multiple sections feature is added.
+  // Labels bound in the current section are resolved directly, labels bound
+  // in other sections are always resolved by the relocator.
 EmitJmpCall:
   {
     // Emit REX prefix if asked for (64-bit only).
@@ -4280,13 +4754,13 @@ EmitJmpCall:
       label = _code->getLabelEntry(rmRel->as<Label>());
       if (!label) goto InvalidLabel;
 
-      if (label->isBound()) {
+      if (label->isBound() && label->getSectionId() == _section->getId()) {
         // Bound label.
         rel32 = static_cast<uint32_t>((static_cast<uint64_t>(label->getOffset()) - ip - inst32Size) & 0xFFFFFFFFU);
         goto EmitJmpCallRel;
       }
       else {
-        // Non-bound label.
+        // Non-bound label or a label bound in another section.
         if (opCode8 && (!opCode || (options & X86Inst::kOptionShortForm))) {
           EMIT_BYTE(opCode8);
           relOffset = -1;
@@ -4314,13 +4788,19 @@ EmitJmpCall:
     }
 
     if (rmRel->isImm()) {
+      // Absolute target would have to be relocated when the code is moved.
+      if (ASMJIT_UNLIKELY(getCodeInfo().isPIC()))
+        goto NotPositionIndependent;
+
       uint64_t baseAddress = getCodeInfo().getBaseAddress();
       uint64_t jumpAddress = rmRel->as<Imm>().getUInt64();
 
       // If the base-address is known calculate a relative displacement and
       // check if it fits in 32 bits (which is always true in 32-bit mode).
       // Emit relative displacement as it was a bound label if all checks ok.
-      if (baseAddress != Globals::kNoBaseAddress) {
+      // The base-address is only known for the first section, which is always
+      // placed at the beginning of the code.
+      if (baseAddress != Globals::kNoBaseAddress && _section->getId() == 0) {
         uint64_t rel64 = jumpAddress - (ip + baseAddress) - inst32Size;
         if (getArchType() == ArchInfo::kTypeX86 || Utils::isInt32(static_cast<int64_t>(rel64))) {
           rel32 = static_cast<uint32_t>(rel64 & 0xFFFFFFFFU);
@@ -4357,8 +4837,8 @@ EmitJmpCall:
             EMIT_BYTE(kX86ByteRex);
           }
 
-          re->_type = RelocEntry::kTypeTrampoline;
-          _code->_trampolinesSize += 8;
+          err = _code->addTrampoline(re);
+          if (ASMJIT_UNLIKELY(err)) goto Failed;
         }
 
         // Emit [PREFIX] OPCODE [/X] DISP32.
@@ -4418,11 +4898,29 @@ EmitJmpCallRel:
 
 EmitRel:
   {
-    ASMJIT_ASSERT(!label->isBound());
     ASMJIT_ASSERT(relSize == 1 || relSize == 4);
+    size_t offset = (size_t)(cursor - _bufferData);
+
+    if (label->isBound()) {
+      // Label bound in another section, the displacement is only known after
+      // the sections are placed, which is the relocator's responsibility.
+      ASMJIT_ASSERT(label->getSectionId() != _section->getId());
+      if (ASMJIT_UNLIKELY(relSize != 4))
+        goto InvalidDisplacement;
+
+      err = _code->newRelocEntry(&re, RelocEntry::kTypeAbsToRel, 4);
+      if (ASMJIT_UNLIKELY(err)) goto Failed;
+
+      re->_sourceSectionId = _section->getId();
+      re->_sourceOffset = static_cast<uint64_t>(offset);
+      re->_targetSectionId = label->getSectionId();
+      re->_data = static_cast<uint64_t>(static_cast<int64_t>(label->getOffset()) + relOffset + 4);
+
+      EMIT_32(0);
+      goto EmitRelDone;
+    }
 
     // Chain with label.
-    size_t offset = (size_t)(cursor - _bufferData);
     LabelLink* link = _code->newLabelLink(label, _section->getId(), offset, relOffset);
 
     if (ASMJIT_UNLIKELY(!link))
@@ -4438,6 +4936,8 @@ EmitRel:
       EMIT_32(0x04040404);
   }
 
+EmitRelDone:
+
   if (imLen == 0)
     goto EmitDone;
 
@@ -4522,6 +5022,7 @@ ERROR_HANDLER(InvalidImmediate)
 ERROR_HANDLER(OperandSizeMismatch)
 ERROR_HANDLER(AmbiguousOperandSize)
 ERROR_HANDLER(NotConsecutiveRegs)
+ERROR_HANDLER(NotPositionIndependent)
 
 Failed:
   return _emitFailed(err, instId, options, o0, o1, o2, o3);
@@ -4561,30 +5062,8 @@ Error X86Assembler::align(uint32_t mode, uint32_t alignment) {
   switch (mode) {
     case kAlignCode: {
       if (_globalHints & kHintOptimizedAlign) {
-        // Intel 64 and IA-32 Architectures Software Developer's Manual - Volume 2B (NOP).
-        enum { kMaxNopSize = 9 };
-
-        static const uint8_t nopData[kMaxNopSize][kMaxNopSize] = {
-          { 0x90 },
-          { 0x66, 0x90 },
-          { 0x0F, 0x1F, 0x00 },
-          { 0x0F, 0x1F, 0x40, 0x00 },
-          { 0x0F, 0x1F, 0x44, 0x00, 0x00 },
-          { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
-          { 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
-          { 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
-          { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
-        };
-
-        do {
-          uint32_t n = std::min<uint32_t>(i, kMaxNopSize);
-          const uint8_t* src = nopData[n - 1];
-
-          i -= n;
-          do {
-            EMIT_BYTE(*src++);
-          } while (--n);
-        } while (i);
+        cursor = X86Assembler_fillNops(cursor, i, true);
+        i = 0;
       }
 
       pattern = 0x90;
@@ -4609,6 +5088,800 @@ Error X86Assembler::align(uint32_t mode, uint32_t alignment) {
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Assembler - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_assembler_jcc_erratum) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+  code.addGlobalHints(CodeEmitter::kHintAvoidJccErratum);
+
+  X86Assembler a(&code);
+  Label L_Back = a.newLabel();
+  Label L_Fwd = a.newLabel();
+
+  // Each pair is `cmp eax, ebx` (2 bytes) + `jne rel8|rel32` (2|6 bytes).
+  INFO("Checking that fused pairs never cross or end at 32-byte boundary");
+  a.bind(L_Back);
+  for (uint32_t i = 0; i < 64; i++) {
+    for (uint32_t j = 0; j < i % 7; j++)
+      a.nop();
+
+    a.cmp(x86::eax, x86::ebx);
+    if (i & 1)
+      a.jne(L_Back);
+    else
+      a.jne(L_Fwd);
+
+    // The pair could have been moved, so compute its start from its end.
+    const uint8_t* buf = a.getBufferData();
+    size_t end = a.getOffset();
+    size_t jSize = (buf[end - 6] == 0x0F && buf[end - 5] == 0x85) ? 6 : 2;
+    size_t start = end - jSize - 2;
+
+    EXPECT(buf[start] == 0x3B || buf[start] == 0x39,
+      "Fused pair #%u doesn't start with CMP", i);
+    EXPECT((start / 32) == (end / 32),
+      "Fused pair #%u [%u:%u] crosses or ends at 32-byte boundary", i, unsigned(start), unsigned(end));
+  }
+
+  INFO("Checking that the trial encoding doesn't leave label links behind");
+  a.bind(L_Fwd);
+  EXPECT(code.getUnresolvedLabelsCount() == 0,
+    "All label links should be resolved after binding");
+
+  INFO("Checking that a fusible instruction doesn't pair with a jump in another section");
+  {
+    CodeHolder secCode;
+    secCode.init(CodeInfo(ArchInfo::kTypeX64));
+    secCode.addGlobalHints(CodeEmitter::kHintAvoidJccErratum);
+
+    SectionEntry* cold;
+    secCode.newSection(&cold, ".text.cold", Globals::kInvalidIndex, SectionEntry::kFlagExec, 32);
+
+    X86Assembler sa(&secCode);
+    Label L_Target = sa.newLabel();
+    SectionEntry* text = sa.getSection();
+
+    // CMP ends at 30 in .text and JNE rel32 starts at 30 in .text.cold, which
+    // only has to be moved by 2 bytes to not cross the 32-byte boundary.
+    for (uint32_t i = 0; i < 28; i++)
+      sa.nop();
+    sa.cmp(x86::eax, x86::ebx);
+
+    uint8_t fill[30];
+    ::memset(fill, 0xCC, sizeof(fill));
+
+    sa.section(cold);
+    sa.embed(fill, sizeof(fill));
+    sa.long_().jne(L_Target);
+
+    EXPECT(sa.getOffset() == 38, "JNE should end at 38, not %u", unsigned(sa.getOffset()));
+
+    sa.section(text);
+    sa.bind(L_Target);
+  }
+}
+
+UNIT(x86_assembler_compact_encoding) {
+  struct TestCase {
+    uint32_t instId;
+    Operand o0, o1, o2;
+    uint32_t size;
+  };
+
+  const TestCase cases[] = {
+    { X86Inst::kIdAnd , x86::rax  , imm(0xFF)      , Operand(), 5 }, // and eax, 0xFF
+    { X86Inst::kIdAnd , x86::rcx  , imm(-1)        , Operand(), 4 }, // and rcx, -1 (unchanged)
+    { X86Inst::kIdTest, x86::rdx  , imm(0x100)     , Operand(), 6 }, // test edx, 0x100
+    { X86Inst::kIdXor , x86::rax  , x86::rax       , Operand(), 2 }, // xor eax, eax
+    { X86Inst::kIdXor , x86::rax  , x86::rcx       , Operand(), 3 }, // xor rax, rcx (unchanged)
+    { X86Inst::kIdSub , x86::r8   , x86::r8        , Operand(), 3 }, // sub r8d, r8d
+    { X86Inst::kIdMovzx, x86::rax , x86::cl        , Operand(), 3 }, // movzx eax, cl
+    { X86Inst::kIdVpaddd, x86::xmm0, x86::xmm1     , x86::xmm9 , 4 }, // vpaddd xmm0, xmm9, xmm1
+    { X86Inst::kIdVpxor , x86::ymm2, x86::ymm3     , x86::ymm12, 4 }, // vpxor ymm2, ymm12, ymm3
+    { X86Inst::kIdVpsubd, x86::xmm0, x86::xmm1     , x86::xmm9 , 5 }  // vpsubd (not commutative)
+  };
+
+  INFO("Checking that compact encoding selects the shortest form");
+  for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(cases); i++) {
+    const TestCase& tc = cases[i];
+
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+    code.addGlobalHints(CodeEmitter::kHintCompactEncoding);
+
+    X86Assembler a(&code);
+    EXPECT(a._emit(tc.instId, tc.o0, tc.o1, tc.o2, Operand()) == kErrorOk,
+      "Failed to emit instruction #%u", i);
+    EXPECT(a.getOffset() == tc.size,
+      "Instruction #%u encoded to %u bytes, expected %u", i, unsigned(a.getOffset()), tc.size);
+  }
+}
+
+UNIT(x86_assembler_sse_to_avx) {
+  struct TestCase {
+    uint32_t sseId;
+    Operand o0, o1, o2;
+    uint32_t avxId;
+    Operand a0, a1, a2, a3;
+  };
+
+  const TestCase cases[] = {
+    { X86Inst::kIdAddps   , x86::xmm0, x86::xmm1, Operand() , X86Inst::kIdVaddps   , x86::xmm0, x86::xmm0, x86::xmm1, Operand() },
+    { X86Inst::kIdMovaps  , x86::xmm2, x86::xmm9, Operand() , X86Inst::kIdVmovaps  , x86::xmm2, x86::xmm9, Operand() , Operand() },
+    { X86Inst::kIdMovss   , x86::xmm3, x86::xmm4, Operand() , X86Inst::kIdVmovss   , x86::xmm3, x86::xmm3, x86::xmm4, Operand() },
+    { X86Inst::kIdMovss   , x86::xmm3, x86::dword_ptr(x86::rax), Operand(), X86Inst::kIdVmovss, x86::xmm3, x86::dword_ptr(x86::rax), Operand(), Operand() },
+    { X86Inst::kIdShufps  , x86::xmm1, x86::xmm2, imm(0x1B) , X86Inst::kIdVshufps  , x86::xmm1, x86::xmm1, x86::xmm2, imm(0x1B) },
+    { X86Inst::kIdBlendvps, x86::xmm1, x86::xmm2, Operand() , X86Inst::kIdVblendvps, x86::xmm1, x86::xmm1, x86::xmm2, x86::xmm0 },
+    { X86Inst::kIdPaddb   , x86::mm0 , x86::mm1 , Operand() , X86Inst::kIdPaddb    , x86::mm0 , x86::mm1 , Operand() , Operand() }
+  };
+
+  INFO("Checking that SSE instructions are encoded as their AVX counterparts");
+  for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(cases); i++) {
+    const TestCase& tc = cases[i];
+
+    CodeHolder code0;
+    CodeHolder code1;
+
+    code0.init(CodeInfo(ArchInfo::kTypeX64));
+    code1.init(CodeInfo(ArchInfo::kTypeX64));
+    code0.addGlobalHints(CodeEmitter::kHintSseToAvx);
+
+    X86Assembler a0(&code0);
+    X86Assembler a1(&code1);
+
+    EXPECT(a0._emit(tc.sseId, tc.o0, tc.o1, tc.o2, Operand()) == kErrorOk,
+      "Failed to emit SSE instruction #%u", i);
+    EXPECT(a1._emit(tc.avxId, tc.a0, tc.a1, tc.a2, tc.a3) == kErrorOk,
+      "Failed to emit AVX instruction #%u", i);
+
+    EXPECT(a0.getOffset() == a1.getOffset() &&
+           ::memcmp(a0.getBufferData(), a1.getBufferData(), a0.getOffset()) == 0,
+      "SSE instruction #%u wasn't translated to the expected AVX instruction", i);
+  }
+}
+
+// Emits a function that jumps to an executable `.cold` section, which reads
+// `.rodata` and `.bss` and jumps back, so all references cross sections.
+static void X86Assembler_emitSectionsTest(X86Assembler& a, SectionEntry* cold, SectionEntry* rodata, SectionEntry* bss) {
+  SectionEntry* text = a.getSection();
+
+  Label L_Cold = a.newLabel();
+  Label L_Back = a.newLabel();
+  Label L_RoData = a.newLabel();
+  Label L_Bss = a.newLabel();
+
+  a.section(rodata);
+  a.align(kAlignData, 16);
+  a.bind(L_RoData);
+  a.dint32(0x1234);
+
+  a.section(text);
+  a.jmp(L_Cold);
+  a.bind(L_Back);
+  a.ret();
+
+  a.section(cold);
+  a.bind(L_Cold);
+  a.mov(x86::eax, x86::dword_ptr(L_RoData));
+  a.add(x86::eax, x86::dword_ptr(L_Bss));
+  a.jmp(L_Back);
+
+  a.section(bss);
+  a.bind(L_Bss);
+  bss->setVirtualSize(64);
+}
+
+UNIT(x86_assembler_sections) {
+  INFO("Checking section creation");
+  {
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+
+    SectionEntry* rodata;
+    EXPECT(code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 16) == kErrorOk,
+      "Failed to create .rodata section");
+    EXPECT(code.getSectionByName(".rodata") == rodata && code.getSectionById(rodata->getId()) == rodata,
+      "Section lookup failed");
+
+    SectionEntry* dummy;
+    EXPECT(code.newSection(&dummy, ".rodata") == kErrorInvalidArgument,
+      "Section names must be unique");
+    EXPECT(code.newSection(&dummy, ".data", Globals::kInvalidIndex, 0, 3) == kErrorInvalidArgument,
+      "Section alignment must be a power of 2");
+  }
+
+  for (uint32_t arch = 0; arch < 2; arch++) {
+    INFO("Checking cross-section relocations (%s)", arch == 0 ? "X86" : "X64");
+
+    CodeHolder code;
+    code.init(CodeInfo(arch == 0 ? ArchInfo::kTypeX86 : ArchInfo::kTypeX64));
+
+    SectionEntry* cold;
+    SectionEntry* rodata;
+    SectionEntry* bss;
+
+    code.newSection(&cold, ".text.cold", Globals::kInvalidIndex, SectionEntry::kFlagExec | SectionEntry::kFlagConst, 16);
+    code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 16);
+    code.newSection(&bss, ".bss", Globals::kInvalidIndex, SectionEntry::kFlagZero, 16);
+
+    X86Assembler a(&code);
+    X86Assembler_emitSectionsTest(a, cold, rodata, bss);
+    EXPECT(a.isInErrorState() == false, "Failed to emit the test function");
+
+    size_t textSize = code.getTextSize();
+    size_t dataSize = code.getDataSize();
+
+    EXPECT(cold->getOffset() == 16, "Expected .text.cold to be placed at 16, not %u", unsigned(cold->getOffset()));
+    EXPECT(rodata->getOffset() == 0 && bss->getOffset() == 16 && dataSize == 80,
+      "Unexpected layout of data sections");
+
+    uint8_t textBuf[64];
+    uint8_t dataBuf[128];
+    ::memset(dataBuf, 0xFF, sizeof(dataBuf));
+
+    uint64_t textAddress = 0x10000;
+    uint64_t dataAddress = 0x20000;
+    EXPECT(code.relocate(textBuf, textAddress, dataBuf, dataAddress) == textSize,
+      "Unexpected relocated size");
+
+    // JMP .text.cold (the first instruction in .text).
+    EXPECT(textBuf[0] == 0xE9 && Utils::readI32u(textBuf + 1) == int32_t(16 - 5),
+      "Jump to .text.cold wasn't relocated properly");
+
+    // MOV eax, [.rodata] is the first instruction in .text.cold.
+    uint32_t disp = Utils::readU32u(textBuf + 16 + 2);
+    uint32_t expected = arch == 0 ? uint32_t(dataAddress) : uint32_t(dataAddress - (textAddress + 16 + 6));
+    EXPECT(disp == expected, "Reference to .rodata wasn't relocated properly (0x%08X != 0x%08X)", disp, expected);
+
+    // Data is copied and the virtual part of .bss is zeroed.
+    EXPECT(Utils::readU32u(dataBuf) == 0x1234 && dataBuf[16] == 0 && dataBuf[79] == 0 && dataBuf[80] == 0xFF,
+      "Data sections weren't copied properly");
+
+    // RIP-relative references to data more than 2GB away can't be encoded.
+    if (arch == 1) {
+      size_t textUsed;
+      uint64_t farDataAddress = textAddress + (uint64_t(1) << 32);
+
+      EXPECT(code._relocate(textBuf, textAddress, dataBuf, farDataAddress, textUsed) == kErrorInvalidDisplacement,
+        "Relocation of an out-of-range reference to .rodata should fail");
+      EXPECT(code.relocate(textBuf, textAddress, dataBuf, farDataAddress) == 0,
+        "Relocation of an out-of-range reference to .rodata should return zero");
+    }
+  }
+
+#if ASMJIT_ARCH_X86 || ASMJIT_ARCH_X64
+  INFO("Checking that JitRuntime places data sections into a separate memory");
+  {
+    JitRuntime rt;
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+
+    SectionEntry* cold;
+    SectionEntry* rodata;
+    SectionEntry* bss;
+
+    code.newSection(&cold, ".text.cold", Globals::kInvalidIndex, SectionEntry::kFlagExec | SectionEntry::kFlagConst, 16);
+    code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 16);
+    code.newSection(&bss, ".bss", Globals::kInvalidIndex, SectionEntry::kFlagZero, 16);
+
+    X86Assembler a(&code);
+    X86Assembler_emitSectionsTest(a, cold, rodata, bss);
+
+    typedef int (*Func)(void);
+    Func func;
+
+    EXPECT(rt.add(&func, &code) == kErrorOk, "JitRuntime failed to add the function");
+    EXPECT(rt.getDataMemMgr()->getUsedBytes() != 0, "Data sections weren't allocated by the data memory manager");
+
+    int result = func();
+    EXPECT(result == 0x1234, "Function returned %d instead of %d", result, 0x1234);
+
+    rt.release(func);
+    EXPECT(rt.getDataMemMgr()->getUsedBytes() == 0, "Data sections weren't released together with the function");
+  }
+#endif
+
+#if ASMJIT_ARCH_X64
+  INFO("Checking that JitRuntime places data sections near code if the data memory is far");
+  {
+    JitRuntime rt;
+    void* first;
+
+    // Code is allocated first, new blocks of data are then preferred 16GB away.
+    {
+      CodeHolder firstCode;
+      firstCode.init(rt.getCodeInfo());
+
+      X86Assembler a(&firstCode);
+      a.ret();
+
+      EXPECT(rt.add(&first, &firstCode) == kErrorOk, "JitRuntime failed to add the function");
+      rt.getDataMemMgr()->setNearAddress(static_cast<uint8_t*>(first) + (uint64_t(1) << 34));
+    }
+
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+
+    SectionEntry* cold;
+    SectionEntry* rodata;
+    SectionEntry* bss;
+
+    code.newSection(&cold, ".text.cold", Globals::kInvalidIndex, SectionEntry::kFlagExec | SectionEntry::kFlagConst, 16);
+    code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 16);
+    code.newSection(&bss, ".bss", Globals::kInvalidIndex, SectionEntry::kFlagZero, 16);
+
+    X86Assembler a(&code);
+    X86Assembler_emitSectionsTest(a, cold, rodata, bss);
+
+    typedef int (*Func)(void);
+    Func func;
+
+    EXPECT(rt.add(&func, &code) == kErrorOk, "JitRuntime failed to add the function");
+
+    int result = func();
+    EXPECT(result == 0x1234, "Function returned %d instead of %d", result, 0x1234);
+
+    rt.release(func);
+    rt.release(first);
+  }
+#endif
+}
+
+UNIT(x86_assembler_trampolines) {
+  INFO("Checking that trampolines are shared by calls to the same target");
+  {
+    uint64_t far0 = ASMJIT_UINT64_C(0x00007FFF00001000);
+    uint64_t far1 = ASMJIT_UINT64_C(0x00007FFF00002000);
+
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+
+    X86Assembler a(&code);
+    for (uint32_t i = 0; i < 10; i++) {
+      a.call(imm(far0));
+      a.call(imm(far1));
+    }
+    a.ret();
+
+    size_t codeSize = a.getOffset();
+    EXPECT(code.getTrampolinesSize() == 2 * 8,
+      "Expected space for 2 trampolines, not %u", unsigned(code.getTrampolinesSize() / 8));
+    EXPECT(code.hasRelocType(RelocEntry::kTypeTrampoline) && !code.hasRelocType(RelocEntry::kTypeRelToAbs),
+      "Relocation types weren't tracked properly");
+
+    uint8_t buf[512];
+    size_t relocSize = code.relocate(buf, 0x10000);
+    EXPECT(relocSize == codeSize + 2 * 8,
+      "Expected 2 trampolines to be used, not %d", int(relocSize - codeSize) / 8);
+
+    // The first call is patched to `call [rip + disp32]` pointing to the first slot.
+    EXPECT(buf[0] == 0xFF && buf[1] == 0x15 && Utils::readU64u(buf + codeSize) == far0,
+      "The first call wasn't patched to use a trampoline");
+    EXPECT(Utils::readU64u(buf + codeSize + 8) == far1,
+      "The second trampoline doesn't contain the second target");
+
+    // The last call to `far1` must use the second slot.
+    size_t lastCall = codeSize - 1 - 6;
+    int32_t disp = Utils::readI32u(buf + lastCall + 2);
+    EXPECT(lastCall + 6 + disp == codeSize + 8,
+      "The last call doesn't share the trampoline of the second target");
+
+    INFO("Checking that trampolines are not used for targets within 2GB");
+    relocSize = code.relocate(buf, far0 - 0x10000);
+    EXPECT(relocSize == codeSize, "Expected no trampolines, got %d", int(relocSize - codeSize) / 8);
+    EXPECT(buf[0] == 0x40 && buf[1] == 0xE8, "Expected a direct call, got %02X %02X", buf[0], buf[1]);
+  }
+
+#if ASMJIT_ARCH_64BIT && (ASMJIT_OS_POSIX || ASMJIT_OS_WINDOWS)
+  INFO("Checking that the virtual memory can be allocated near a given address");
+  {
+    const void* nearAddress = reinterpret_cast<const void*>(&OSUtils::getVirtualMemoryInfo);
+    size_t allocated = 0;
+
+    void* p = OSUtils::allocVirtualMemoryNear(65536, &allocated, OSUtils::kVMWritable, nearAddress);
+    EXPECT(p != nullptr, "Failed to allocate virtual memory");
+
+    int64_t distance = static_cast<int64_t>((intptr_t)p) - static_cast<int64_t>((intptr_t)nearAddress);
+    INFO("  Allocated %p, distance from %p is %lld MB", p, nearAddress, (long long)(distance / (1024 * 1024)));
+    EXPECT(Utils::isInt32(distance), "Virtual memory wasn't allocated within 2GB of %p", nearAddress);
+    OSUtils::releaseVirtualMemory(p, allocated);
+  }
+#endif
+}
+
+UNIT(x86_assembler_append) {
+  typedef int (*Func)(void);
+
+  JitRuntime rt;
+  Func func;
+  Func stub;
+
+  INFO("Checking JitRuntime::addWithSlack()");
+  {
+    // The jump is patched later to jump to the appended code.
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    Label L_Body = a.newLabel();
+    a.jmp(L_Body);
+    a.bind(L_Body);
+    a.mov(x86::eax, 1);
+    a.ret();
+
+    EXPECT(rt.addWithSlack(&func, &code, 256) == kErrorOk, "Failed to add the code");
+    EXPECT(rt.getSlackSize(reinterpret_cast<void*>(func)) == 256, "Expected 256 bytes of slack");
+    EXPECT(func() == 1, "The code doesn't work");
+  }
+
+  INFO("Checking JitRuntime::append() and JitRuntime::patchJump()");
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+
+    SectionEntry* rodata;
+    code.newSection(&rodata, ".rodata", Globals::kInvalidIndex, SectionEntry::kFlagConst, 4);
+
+    X86Assembler a(&code);
+    Label L_Data = a.newLabel();
+    a.mov(x86::eax, x86::dword_ptr(L_Data));
+    a.ret();
+
+    a.section(rodata);
+    a.bind(L_Data);
+    a.dint32(2);
+
+    EXPECT(rt.append(&stub, reinterpret_cast<void*>(func), &code) == kErrorOk, "Failed to append the code");
+    EXPECT(stub() == 2, "The appended code doesn't work");
+    EXPECT(rt.getSlackSize(reinterpret_cast<void*>(func)) < 256, "The slack wasn't used");
+
+    EXPECT(rt.patchJump(reinterpret_cast<void*>(func), reinterpret_cast<void*>(stub)) == kErrorOk,
+      "Failed to patch the jump");
+    EXPECT(func() == 2, "The patched jump doesn't jump to the appended code");
+    EXPECT(rt.patchJump(reinterpret_cast<uint8_t*>(stub) + 5, reinterpret_cast<void*>(func)) == kErrorInvalidInstruction,
+      "Only jumps and calls can be patched");
+  }
+
+  INFO("Checking that append() doesn't exceed the slack");
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    for (uint32_t i = 0; i < 256; i++)
+      a.nop();
+    a.ret();
+
+    EXPECT(rt.append(&stub, reinterpret_cast<void*>(func), &code) == kErrorCodeTooLarge,
+      "Appending more code than the slack must fail");
+    EXPECT(func() == 2, "The function must not be modified if append() fails");
+  }
+
+  rt.release(func);
+}
+
+UNIT(x86_assembler_patch_sites) {
+  typedef int (*Func)(void);
+
+  JitRuntime rt;
+  Func baseline;
+  Func optimized;
+
+  INFO("Checking that a function with a patchable entry can be redirected");
+  {
+    FuncDetail func;
+    func.init(FuncSignature0<int>(CallConv::kIdHost));
+
+    FuncFrameInfo ffi;
+    ffi.enablePatchableEntry();
+
+    FuncFrameLayout layout;
+    layout.init(func, ffi);
+
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    FuncUtils::emitProlog(&a, layout);
+    a.mov(x86::eax, 1);
+    FuncUtils::emitEpilog(&a, layout);
+
+    EXPECT(code.getPatchSitesCount() == 1, "Expected one patch site");
+    EXPECT(code.getLabelOffset(code.getPatchSites()[0]) == 0, "The patch site must be at the function entry");
+    EXPECT(code.getSectionEntry(0)->getAlignment() >= 8, "Patch sites require at least 8-byte alignment");
+    EXPECT(rt.add(&baseline, &code) == kErrorOk, "Failed to add the baseline function");
+    EXPECT(baseline() == 1, "The baseline function doesn't work");
+  }
+
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    a.mov(x86::eax, 2);
+    a.ret();
+
+    EXPECT(rt.add(&optimized, &code) == kErrorOk, "Failed to add the optimized function");
+  }
+
+  EXPECT(rt.redirect(baseline, optimized) == kErrorOk, "Failed to redirect the baseline function");
+  EXPECT(baseline() == 2, "The baseline function must call the optimized one");
+  EXPECT(rt.redirect(baseline, reinterpret_cast<uint8_t*>(baseline) + 5) == kErrorOk, "Failed to redirect the baseline function back");
+  EXPECT(baseline() == 1, "The baseline function must execute its own body again");
+  EXPECT(rt.patchSite(reinterpret_cast<uint8_t*>(optimized), reinterpret_cast<void*>(baseline)) == kErrorInvalidInstruction,
+    "Only patch sites can be patched");
+
+  INFO("Checking that a function without patchable entry is never redirected");
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    Label L_Sub = a.newLabel();
+    a.call(L_Sub);
+    a.ret();
+
+    a.bind(L_Sub);
+    a.mov(x86::eax, 3);
+    a.ret();
+
+    Func plain;
+    EXPECT(rt.add(&plain, &code) == kErrorOk, "Failed to add the plain function");
+    EXPECT(rt.redirect(plain, optimized) == kErrorInvalidInstruction,
+      "A function starting with a call must not be redirected");
+    EXPECT(rt.redirect(reinterpret_cast<uint8_t*>(plain) + 1, optimized) == kErrorInvalidInstruction,
+      "A function must only be padded by NOPs before its patch site");
+    EXPECT(plain() == 3, "The plain function must not be modified");
+    rt.release(plain);
+  }
+
+  INFO("Checking that call and jump sites can be redirected");
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    Label L_Call, L_Jmp;
+    Label L_Tail = a.newLabel();
+
+    a.patchableCall(imm_ptr(baseline), &L_Call);
+    a.add(x86::eax, 10);
+    a.ret();
+
+    a.bind(L_Tail);
+    a.patchableJmp(imm_ptr(baseline), &L_Jmp);
+
+    Func caller;
+    EXPECT(code.getPatchSitesCount() == 2, "Expected two patch sites");
+    EXPECT(rt.add(&caller, &code) == kErrorOk, "Failed to add the caller");
+
+    Func jumper = ptr_as_func<Func>(reinterpret_cast<uint8_t*>(caller) + code.getLabelOffset(L_Tail));
+    EXPECT(caller() == 11, "The call site doesn't work");
+    EXPECT(jumper() == 1, "The jump site doesn't work");
+
+    uint8_t* callSite = reinterpret_cast<uint8_t*>(caller) + code.getLabelOffset(L_Call);
+    uint8_t* jmpSite = reinterpret_cast<uint8_t*>(caller) + code.getLabelOffset(L_Jmp);
+
+    EXPECT(rt.patchSite(callSite, reinterpret_cast<void*>(optimized)) == kErrorOk, "Failed to patch the call site");
+    EXPECT(caller() == 12, "The call site must call the new target");
+    EXPECT(rt.patchSite(jmpSite, reinterpret_cast<void*>(optimized)) == kErrorOk, "Failed to patch the jump site");
+    EXPECT(jumper() == 2, "The jump site must jump to the new target");
+
+    rt.release(caller);
+  }
+
+  INFO("Checking that a jump site to a near backward label can be redirected");
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    X86Assembler a(&code);
+
+    Label L_Jmp;
+    Label L_Back = a.newLabel();
+    Label L_Entry = a.newLabel();
+
+    a.bind(L_Back);
+    a.mov(x86::eax, 3);
+    a.ret();
+
+    a.bind(L_Entry);
+    a.patchableJmp(L_Back, &L_Jmp);
+
+    Func back;
+    EXPECT(rt.add(&back, &code) == kErrorOk, "Failed to add the function");
+
+    Func entry = ptr_as_func<Func>(reinterpret_cast<uint8_t*>(back) + code.getLabelOffset(L_Entry));
+    uint8_t* jmpSite = reinterpret_cast<uint8_t*>(back) + code.getLabelOffset(L_Jmp);
+
+    EXPECT(jmpSite[0] == 0xE9, "The jump site must use the rel32 form, not 0x%02X", jmpSite[0]);
+    EXPECT(entry() == 3, "The jump site doesn't work");
+    EXPECT(rt.patchSite(jmpSite, reinterpret_cast<void*>(optimized)) == kErrorOk, "Failed to patch the jump site");
+    EXPECT(entry() == 2, "The jump site must jump to the new target");
+
+    rt.release(back);
+  }
+
+  rt.release(optimized);
+  rt.release(baseline);
+}
+
+UNIT(x86_assembler_pic) {
+  INFO("Checking that position-independent code refuses absolute addresses");
+  {
+    CodeInfo ci(ArchInfo::kTypeX86);
+    ci.addFlags(CodeInfo::kFlagPIC);
+
+    CodeHolder code;
+    code.init(ci);
+    X86Assembler a(&code);
+
+    Label L_Data = a.newLabel();
+    EXPECT(a.mov(x86::eax, x86::dword_ptr(L_Data)) == kErrorNotPositionIndependent,
+      "X86 can't address labels relative to EIP");
+    EXPECT(::strcmp(DebugUtils::errorAsString(kErrorNotPositionIndependent), "Not position independent") == 0,
+      "Error code doesn't match its message");
+  }
+
+  {
+    CodeInfo ci(ArchInfo::kTypeX64, 0, 0x10000);
+    ci.addFlags(CodeInfo::kFlagPIC);
+
+    CodeHolder code;
+    code.init(ci);
+    X86Assembler a(&code);
+
+    EXPECT(a.call(imm(0x12345)) == kErrorNotPositionIndependent,
+      "Calls to absolute addresses must be refused");
+    a.resetLastError();
+
+    EXPECT(a.mov(x86::eax, x86::dword_ptr(0x10100)) == kErrorOk, "Failed to address an absolute address");
+    EXPECT(!code.hasRelocType(RelocEntry::kTypeAbsToRel) && a.getOffset() == 7,
+      "Absolute address must not be converted to RIP-relative");
+  }
+
+  INFO("Checking that position-independent jump tables work");
+  if (ArchInfo::kTypeHost == ArchInfo::kTypeX64) {
+    typedef int (*Func)(int);
+
+    JitRuntime rt;
+    CodeInfo ci(rt.getCodeInfo());
+    ci.addFlags(CodeInfo::kFlagPIC);
+
+    FuncDetail func;
+    func.init(FuncSignature1<int, int>(CallConv::kIdHost));
+    X86Gp idx = x86::rax;
+    idx.setId(func.getArg(0).getRegId());
+
+    CodeHolder code;
+    code.init(ci);
+    X86Assembler a(&code);
+
+    Label L_Entry = a.newLabel();
+    Label L_Table = a.newLabel();
+    Label L_Case0 = a.newLabel();
+    Label L_Case1 = a.newLabel();
+    Label L_Case2 = a.newLabel();
+
+    a.jmp(L_Entry);
+    a.bind(L_Case0);
+    a.mov(x86::eax, 10);
+    a.ret();
+
+    // Entries are relative to themselves, one is bound, two are not yet.
+    a.bind(L_Entry);
+    a.movsxd(idx, idx.r32());
+    a.lea(x86::rdx, x86::ptr(L_Table));
+    a.lea(x86::rdx, x86::ptr(x86::rdx, idx, 2));
+    a.movsxd(x86::rax, x86::dword_ptr(x86::rdx));
+    a.add(x86::rax, x86::rdx);
+    a.jmp(x86::rax);
+
+    a.bind(L_Table);
+    a.embedLabel(L_Case0);
+    a.embedLabel(L_Case1);
+    a.embedLabel(L_Case2);
+
+    a.bind(L_Case1);
+    a.mov(x86::eax, 20);
+    a.ret();
+    a.bind(L_Case2);
+    a.mov(x86::eax, 30);
+    a.ret();
+
+    EXPECT(code.getRelocEntries().getLength() == 0, "Position-independent code must not need relocations");
+
+    Func fn;
+    EXPECT(rt.add(&fn, &code) == kErrorOk, "Failed to add the code");
+    EXPECT(fn(0) == 10 && fn(1) == 20 && fn(2) == 30, "The jump table doesn't work");
+    rt.release(fn);
+  }
+
+  INFO("Checking that label differences are resolved relative to the base label");
+  {
+    CodeHolder code;
+    code.init(CodeInfo(ArchInfo::kTypeX64));
+    X86Assembler a(&code);
+
+    Label L_Back = a.newLabel();
+    Label L_Base = a.newLabel();
+    Label L_Fwd = a.newLabel();
+
+    a.bind(L_Back);
+    a.nop();
+    a.bind(L_Base);
+    EXPECT(a.embedLabelDelta(L_Back, L_Base, 1) == kErrorOk, "Failed to embed a bound label difference");
+    EXPECT(a.embedLabelDelta(L_Fwd, L_Base, 4) == kErrorOk, "Failed to embed an unbound label difference");
+    EXPECT(a.embedLabelDelta(L_Fwd, L_Base, 2) == kErrorInvalidDisplacement,
+      "Unbound label differences must be 32-bit");
+    a.resetLastError();
+    EXPECT(a.embedLabelDelta(L_Back, L_Fwd, 4) == kErrorInvalidLabel, "The base label must be bound");
+    a.resetLastError();
+
+    a.nop();
+    a.bind(L_Fwd);
+
+    const uint8_t* p = code.getSectionEntry(0)->getBuffer().getData();
+    EXPECT(static_cast<int8_t>(p[1]) == -1, "Invalid difference of a bound label");
+    EXPECT(Utils::readI32u(p + 2) == 6, "Invalid difference of a forward label");
+    EXPECT(code.getRelocEntries().getLength() == 0, "Label differences must not need relocations");
+  }
+}
+
+UNIT(x86_assembler_labels) {
+  static const uint32_t kCount = CodeHolder::kLabelBlockSize * 16 + 7;
+
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+  X86Assembler a(&code);
+
+  Label* labels = static_cast<Label*>(::malloc(kCount * sizeof(Label)));
+  EXPECT(labels != nullptr, "Out of memory");
+
+  for (uint32_t i = 0; i < kCount; i++)
+    labels[i] = a.newLabel();
+
+  INFO("Checking that label entries are dense and aligned to a cache line");
+  for (uint32_t i = 0; i < kCount; i++) {
+    LabelEntry* le = code.getLabelEntry(labels[i]);
+    EXPECT(le != nullptr && le->getId() == labels[i].getId() && !le->isBound(),
+      "Label entry #%u is invalid", i);
+
+    if ((i & (CodeHolder::kLabelBlockSize - 1)) != 0)
+      EXPECT(le == code.getLabelEntry(labels[i - 1]) + 1, "Label entry #%u isn't adjacent to the previous one", i);
+    else
+      EXPECT(((uintptr_t)le & 63) == 0, "Label block #%u isn't aligned to 64 bytes", i / CodeHolder::kLabelBlockSize);
+  }
+
+  INFO("Checking that forward references are resolved when labels are bound");
+  for (uint32_t i = 0; i < kCount; i++)
+    a.jmp(labels[kCount - 1 - i]);
+  EXPECT(code.getUnresolvedLabelsCount() == kCount, "Expected %u unresolved references", kCount);
+
+  size_t jmpEnd = a.getOffset();
+  for (uint32_t i = 0; i < kCount; i++) {
+    a.bind(labels[i]);
+    a.nop();
+  }
+  EXPECT(code.getUnresolvedLabelsCount() == 0, "All references must be resolved");
+  EXPECT(code._labelLinkPool != nullptr, "Links must be returned to the pool when a label is bound");
+
+  a.sync();
+  const uint8_t* buf = code.getSectionEntry(0)->getBuffer().getData();
+  for (uint32_t i = 0; i < kCount; i++) {
+    size_t end = (i + 1) * 5;
+    intptr_t target = static_cast<intptr_t>(end) + Utils::readI32u(buf + end - 4);
+    EXPECT(target == code.getLabelOffset(labels[kCount - 1 - i]) && target >= static_cast<intptr_t>(jmpEnd),
+      "Jump #%u doesn't point to its label", i);
+  }
+
+  ::free(labels);
+}
+#endif // ASMJIT_TEST
+
 } // asmjit namespace
 
 // [Api-End]
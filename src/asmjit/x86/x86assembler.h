@@ -75,6 +75,18 @@ public:
   ASMJIT_API Error onAttach(CodeHolder* code) noexcept override;
   ASMJIT_API Error onDetach(CodeHolder* code) noexcept override;
 
+  // --------------------------------------------------------------------------
+  // [Code-Buffer]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API Error section(SectionEntry* section) override;
+
+  // --------------------------------------------------------------------------
+  // [Label]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API Error bind(const Label& label) override;
+
   // --------------------------------------------------------------------------
   // [Code-Generation]
   // --------------------------------------------------------------------------
@@ -83,6 +95,13 @@ public:
 
   ASMJIT_API Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) override;
   ASMJIT_API Error align(uint32_t mode, uint32_t alignment) override;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  size_t _fusibleStart;                  //!< Start of the last instruction that can be macro-fused with JCC.
+  size_t _fusibleEnd;                    //!< End of the last instruction that can be macro-fused with JCC.
 };
 
 //! \}
@@ -12,7 +12,11 @@
 #if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
 
 // [Dependencies]
+#include "../x86/x86assembler.h"
 #include "../x86/x86builder.h"
+#include "../x86/x86internal_p.h"
+#include "../x86/x86peephole.h"
+#include "../x86/x86scheduler.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -53,10 +57,47 @@ Error X86Builder::onAttach(CodeHolder* code) noexcept {
 // ============================================================================
 
 Error X86Builder::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) {
-  // TODO:
+  return _emit(instId, o0, o1, o2, o3, _none, _none);
+}
+
+Error X86Builder::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, const Operand_& o4, const Operand_& o5) {
+  ASMJIT_PROPAGATE(X86Internal::emitInst(this, instId, o0, o1, o2, o3, o4, o5));
+
+  // Makes the return visible to passes that analyze control flow.
+  if (instId == X86Inst::kIdRet)
+    getCursor()->orFlags(CBNode::kFlagIsRet);
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Builder - Passes]
+// ============================================================================
+
+CBPass* X86Builder::_newPassByName(const char* name) noexcept {
+  if (::strcmp(name, "X86Peephole" ) == 0) return newPassT<X86PeepholePass>();
+  if (::strcmp(name, "X86Scheduler") == 0) return newPassT<X86SchedulerPass>();
+  return nullptr;
+}
+
+// ============================================================================
+// [asmjit::X86Builder - Finalize]
+// ============================================================================
+
+Error X86Builder::finalize() {
+  if (_lastError) return _lastError;
+
+  Error err = runPasses();
+  if (ASMJIT_UNLIKELY(err)) return setLastError(err);
+
+  if (_code->_cgAsm) {
+    return serialize(_code->_cgAsm);
+  }
+  else {
+    X86Assembler a(_code);
+    return serialize(&a);
+  }
+}
+
 } // asmjit namespace
 
 // [Api-End]
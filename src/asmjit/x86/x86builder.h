@@ -67,6 +67,13 @@ public:
 
   ASMJIT_API virtual Error onAttach(CodeHolder* code) noexcept override;
 
+  // --------------------------------------------------------------------------
+  // [Passes]
+  // --------------------------------------------------------------------------
+
+  //! Create "X86Peephole" or "X86Scheduler" pass.
+  ASMJIT_API virtual CBPass* _newPassByName(const char* name) noexcept override;
+
   // --------------------------------------------------------------------------
   // [Code-Generation]
   // --------------------------------------------------------------------------
@@ -74,6 +81,13 @@ public:
   using CodeBuilder::_emit;
 
   ASMJIT_API virtual Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) override;
+  ASMJIT_API virtual Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, const Operand_& o4, const Operand_& o5) override;
+
+  // --------------------------------------------------------------------------
+  // [Finalize]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error finalize() override;
 };
 
 //! \}
@@ -14,7 +14,13 @@
 // [Dependencies]
 #include "../base/utils.h"
 #include "../x86/x86compiler.h"
+#include "../x86/x86constfold.h"
+#include "../x86/x86cse.h"
+#include "../x86/x86internal_p.h"
+#include "../x86/x86licm.h"
+#include "../x86/x86peephole.h"
 #include "../x86/x86regalloc_p.h"
+#include "../x86/x86scheduler.h"
 
 // [Api-Begin]
 #include "../asmjit_apibegin.h"
@@ -52,6 +58,29 @@ Error X86Compiler::onAttach(CodeHolder* code) noexcept {
   return addPassT<X86RAPass>();
 }
 
+// ============================================================================
+// [asmjit::X86Compiler - Workers]
+// ============================================================================
+
+CodeCompiler* X86Compiler::_newWorker() noexcept {
+  void* p = Internal::allocMemory(sizeof(X86Compiler));
+  if (ASMJIT_UNLIKELY(!p)) return nullptr;
+  return new(p) X86Compiler();
+}
+
+// ============================================================================
+// [asmjit::X86Compiler - Passes]
+// ============================================================================
+
+CBPass* X86Compiler::_newPassByName(const char* name) noexcept {
+  if (::strcmp(name, "X86ConstFold") == 0) return newPassT<X86ConstFoldPass>();
+  if (::strcmp(name, "X86Cse"      ) == 0) return newPassT<X86CsePass>();
+  if (::strcmp(name, "X86Licm"     ) == 0) return newPassT<X86LicmPass>();
+  if (::strcmp(name, "X86Peephole" ) == 0) return newPassT<X86PeepholePass>();
+  if (::strcmp(name, "X86Scheduler") == 0) return newPassT<X86SchedulerPass>();
+  return nullptr;
+}
+
 // ============================================================================
 // [asmjit::X86Compiler - Finalize]
 // ============================================================================
@@ -65,17 +94,7 @@ Error X86Compiler::finalize() {
     _globalConstPool = nullptr;
   }
 
-  Error err = kErrorOk;
-  ZoneVector<CBPass*>& passes = _cbPasses;
-
-  for (size_t i = 0, len = passes.getLength(); i < len; i++) {
-    CBPass* pass = passes[i];
-    err = pass->process(&_cbPassZone);
-    _cbPassZone.reset();
-    if (err) break;
-  }
-
-  _cbPassZone.reset();
+  Error err = runPasses();
   if (ASMJIT_UNLIKELY(err)) return setLastError(err);
 
   // TODO: There must be possibility to attach more assemblers, this is not so nice.
@@ -92,280 +111,191 @@ Error X86Compiler::finalize() {
 // [asmjit::X86Compiler - Inst]
 // ============================================================================
 
-static ASMJIT_INLINE bool isJumpInst(uint32_t instId) noexcept {
-  return (instId >= X86Inst::kIdJa   && instId <= X86Inst::kIdJz    ) ||
-         (instId >= X86Inst::kIdLoop && instId <= X86Inst::kIdLoopne) ;
-}
-
 Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3) {
-  uint32_t options = getOptions() | getGlobalOptions();
-  const char* inlineComment = getInlineComment();
-
-  uint32_t opCount = static_cast<uint32_t>(!o0.isNone()) +
-                     static_cast<uint32_t>(!o1.isNone()) +
-                     static_cast<uint32_t>(!o2.isNone()) +
-                     static_cast<uint32_t>(!o3.isNone()) ;
-
-  // Handle failure and rare cases first.
-  const uint32_t kErrorsAndSpecialCases = kOptionMaybeFailureCase | // CodeEmitter is in error state.
-                                          kOptionStrictValidation ; // Strict validation.
-
-  if (ASMJIT_UNLIKELY(options & kErrorsAndSpecialCases)) {
-    // Don't do anything if we are in error state.
-    if (_lastError) return _lastError;
-
-#if !defined(ASMJIT_DISABLE_VALIDATION)
-    // Strict validation.
-    if (options & kOptionStrictValidation) {
-      Operand opArray[] = {
-        Operand(o0),
-        Operand(o1),
-        Operand(o2),
-        Operand(o3)
-      };
-
-      Inst::Detail instDetail(instId, options, _extraReg);
-      Error err = Inst::validate(getArchType(), instDetail, opArray, opCount);
-
-      if (err) {
-#if !defined(ASMJIT_DISABLE_LOGGING)
-        StringBuilderTmp<256> sb;
-        sb.appendString(DebugUtils::errorAsString(err));
-        sb.appendString(": ");
-        Logging::formatInstruction(sb, 0, this, getArchType(), instDetail, opArray, opCount);
-        return setLastError(err, sb.getData());
-#else
-        return setLastError(err);
-#endif
-      }
-
-      // Clear it as it must be enabled explicitly on assembler side.
-      options &= ~kOptionStrictValidation;
-    }
-#endif // ASMJIT_DISABLE_VALIDATION
-  }
-
-  resetOptions();
-  resetInlineComment();
-
-  // decide between `CBInst` and `CBJump`.
-  if (isJumpInst(instId)) {
-    CBJump* node = _cbHeap.allocT<CBJump>(sizeof(CBJump) + opCount * sizeof(Operand));
-    Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBJump));
-
-    if (ASMJIT_UNLIKELY(!node))
-      return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
-
-    if (opCount > 0) opArray[0].copyFrom(o0);
-    if (opCount > 1) opArray[1].copyFrom(o1);
-    if (opCount > 2) opArray[2].copyFrom(o2);
-    if (opCount > 3) opArray[3].copyFrom(o3);
-
-    new(node) CBJump(this, instId, options, opArray, opCount);
-    node->_instDetail.extraReg = _extraReg;
-    _extraReg.reset();
-
-    CBLabel* jTarget = nullptr;
-    if (!(options & kOptionUnfollow)) {
-      if (opArray[0].isLabel()) {
-        Error err = getCBLabel(&jTarget, static_cast<Label&>(opArray[0]));
-        if (err) return setLastError(err);
-      }
-      else {
-        options |= kOptionUnfollow;
-      }
-    }
-    node->setOptions(options);
+  return X86Internal::emitInst(this, instId, o0, o1, o2, o3, _none, _none);
+}
 
-    node->orFlags(instId == X86Inst::kIdJmp ? CBNode::kFlagIsJmp | CBNode::kFlagIsTaken : CBNode::kFlagIsJcc);
-    node->_target = jTarget;
-    node->_jumpNext = nullptr;
+Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, const Operand_& o4, const Operand_& o5) {
+  return X86Internal::emitInst(this, instId, o0, o1, o2, o3, o4, o5);
+}
 
-    if (jTarget) {
-      node->_jumpNext = static_cast<CBJump*>(jTarget->_from);
-      jTarget->_from = node;
-      jTarget->addNumRefs();
-    }
+// ============================================================================
+// [asmjit::X86Compiler - Jump Table]
+// ============================================================================
 
-    // The 'jmp' is always taken, conditional jump can contain hint, we detect it.
-    if (instId == X86Inst::kIdJmp)
-      node->orFlags(CBNode::kFlagIsTaken);
-    else if (options & X86Inst::kOptionTaken)
-      node->orFlags(CBNode::kFlagIsTaken);
+Error X86Compiler::jmpTable(const X86Gp& index, const Label* targets, uint32_t count, const Label& outOfRange) {
+  if (_lastError) return _lastError;
 
-    if (inlineComment) {
-      inlineComment = static_cast<char*>(_cbDataZone.dup(inlineComment, ::strlen(inlineComment), true));
-      node->setInlineComment(inlineComment);
+  CCFunc* func = getFunc();
+  if (ASMJIT_UNLIKELY(!func))
+    return setLastError(DebugUtils::errored(kErrorInvalidState));
+
+  if (ASMJIT_UNLIKELY(count == 0 || count > 0x7FFFFFFFU || index.getSize() < 4 || !isLabelValid(outOfRange)))
+    return setLastError(DebugUtils::errored(kErrorInvalidArgument));
+
+  // Validate all targets first, edges are linked with their labels so they
+  // can't be created if the function fails.
+  uint32_t i;
+  for (i = 0; i < count; i++)
+    if (ASMJIT_UNLIKELY(!isLabelValid(targets[i])))
+      return setLastError(DebugUtils::errored(kErrorInvalidLabel));
+
+  CBJumpTable* table = newJumpTableNode(count);
+  if (ASMJIT_UNLIKELY(!table))
+    return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+
+  X86Gp base = newIntPtr("jt.base");
+  X86Gp entry = newIntPtr("jt.entry");
+  X86Gp idx = index;
+
+  ASMJIT_PROPAGATE(cmp(index, Imm(count)));
+  ASMJIT_PROPAGATE(jae(outOfRange));
+  ASMJIT_PROPAGATE(lea(base, x86::ptr(table->getLabel())));
+
+  if (is64Bit()) {
+    // Zero extend a 32-bit index, the upper part of its register is unknown.
+    if (index.getSize() == 4) {
+      idx = newUInt64("jt.idx");
+      ASMJIT_PROPAGATE(mov(idx.r32(), index));
     }
-
-    addNode(node);
-    return kErrorOk;
+    ASMJIT_PROPAGATE(movsxd(entry, x86::dword_ptr(base, idx, 2)));
   }
   else {
-    CBInst* node = _cbHeap.allocT<CBInst>(sizeof(CBInst) + opCount * sizeof(Operand));
-    Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBInst));
-
-    if (ASMJIT_UNLIKELY(!node))
-      return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
-
-    if (opCount > 0) opArray[0].copyFrom(o0);
-    if (opCount > 1) opArray[1].copyFrom(o1);
-    if (opCount > 2) opArray[2].copyFrom(o2);
-    if (opCount > 3) opArray[3].copyFrom(o3);
-
-    node = new(node) CBInst(this, instId, options, opArray, opCount);
-    node->_instDetail.extraReg = _extraReg;
-    _extraReg.reset();
-
-    if (inlineComment) {
-      inlineComment = static_cast<char*>(_cbDataZone.dup(inlineComment, ::strlen(inlineComment), true));
-      node->setInlineComment(inlineComment);
-    }
-
-    addNode(node);
-    return kErrorOk;
+    ASMJIT_PROPAGATE(mov(entry, x86::dword_ptr(base, idx, 2)));
   }
-}
+  ASMJIT_PROPAGATE(add(entry, base));
 
-Error X86Compiler::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_& o3, const Operand_& o4, const Operand_& o5) {
-  uint32_t options = getOptions() | getGlobalOptions();
-  const char* inlineComment = getInlineComment();
-
-  uint32_t opCount = static_cast<uint32_t>(!o0.isNone()) +
-                     static_cast<uint32_t>(!o1.isNone()) +
-                     static_cast<uint32_t>(!o2.isNone()) +
-                     static_cast<uint32_t>(!o3.isNone()) ;
-
-  // Count 5th and 6th operands.
-  if (!o4.isNone()) opCount = 5;
-  if (!o5.isNone()) opCount = 6;
-
-  // Handle failure and rare cases first.
-  const uint32_t kErrorsAndSpecialCases = kOptionMaybeFailureCase | // CodeEmitter in error state.
-                                          kOptionStrictValidation ; // Strict validation.
-
-  if (ASMJIT_UNLIKELY(options & kErrorsAndSpecialCases)) {
-    // Don't do anything if we are in error state.
-    if (_lastError) return _lastError;
-
-#if !defined(ASMJIT_DISABLE_VALIDATION)
-    // Strict validation.
-    if (options & kOptionStrictValidation) {
-      Operand opArray[] = {
-        Operand(o0),
-        Operand(o1),
-        Operand(o2),
-        Operand(o3),
-        Operand(o4),
-        Operand(o5)
-      };
-
-      Inst::Detail instDetail(instId, options, _extraReg);
-      Error err = Inst::validate(getArchType(), instDetail, opArray, opCount);
-
-      if (err) {
-#if !defined(ASMJIT_DISABLE_LOGGING)
-        StringBuilderTmp<256> sb;
-        sb.appendString(DebugUtils::errorAsString(err));
-        sb.appendString(": ");
-        Logging::formatInstruction(sb, 0, this, getArchType(), instDetail, opArray, opCount);
-        return setLastError(err, sb.getData());
-#else
-        return setLastError(err);
-#endif
-      }
-
-      // Clear it as it must be enabled explicitly on assembler side.
-      options &= ~kOptionStrictValidation;
-    }
-#endif // ASMJIT_DISABLE_VALIDATION
-  }
+  // The indirect jump is a regular instruction, the register allocator must
+  // see it as falling through to the edges that follow it.
+  CBInst* jNode = _cbHeap.allocT<CBInst>(sizeof(CBInst) + sizeof(Operand));
+  if (ASMJIT_UNLIKELY(!jNode))
+    return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
 
-  resetOptions();
-  resetInlineComment();
+  Operand* jOpArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(jNode) + sizeof(CBInst));
+  jOpArray[0].copyFrom(entry);
+  addNode(new(jNode) CBInst(this, X86Inst::kIdJmp, 0, jOpArray, 1));
 
-  // decide between `CBInst` and `CBJump`.
-  if (isJumpInst(instId)) {
-    CBJump* node = _cbHeap.allocT<CBJump>(sizeof(CBJump) + opCount * sizeof(Operand));
-    Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBJump));
+  // Add edges, the last one is unconditional so the flow ends there.
+  for (i = 0; i < count; i++) {
+    CBLabel* jTarget;
+    ASMJIT_PROPAGATE(getCBLabel(&jTarget, targets[i]));
 
-    if (ASMJIT_UNLIKELY(!node))
+    CBJump* edge = _cbHeap.allocT<CBJump>(sizeof(CBJump) + sizeof(Operand));
+    if (ASMJIT_UNLIKELY(!edge))
       return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
 
-    if (opCount > 0) opArray[0].copyFrom(o0);
-    if (opCount > 1) opArray[1].copyFrom(o1);
-    if (opCount > 2) opArray[2].copyFrom(o2);
-    if (opCount > 3) opArray[3].copyFrom(o3);
-    if (opCount > 4) opArray[4].copyFrom(o4);
-    if (opCount > 5) opArray[5].copyFrom(o5);
-
-    new(node) CBJump(this, instId, options, opArray, opCount);
-    node->_instDetail.extraReg = _extraReg;
-    _extraReg.reset();
-
-    CBLabel* jTarget = nullptr;
-    if (!(options & kOptionUnfollow)) {
-      if (opArray[0].isLabel()) {
-        Error err = getCBLabel(&jTarget, static_cast<Label&>(opArray[0]));
-        if (err) return setLastError(err);
-      }
-      else {
-        options |= kOptionUnfollow;
-      }
-    }
-    node->setOptions(options);
+    Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(edge) + sizeof(CBJump));
+    opArray[0].copyFrom(targets[i]);
 
-    node->orFlags(instId == X86Inst::kIdJmp ? CBNode::kFlagIsJmp | CBNode::kFlagIsTaken : CBNode::kFlagIsJcc);
-    node->_target = jTarget;
-    node->_jumpNext = nullptr;
+    new(edge) CBJump(this, X86Inst::kIdJmp, 0, opArray, 1);
+    edge->orFlags(i == count - 1 ? CBNode::kFlagIsJmp | CBNode::kFlagIsTaken | CBNode::kFlagIsEdge
+                                 : CBNode::kFlagIsJcc | CBNode::kFlagIsEdge);
+    edge->_target = jTarget;
+    edge->_jumpNext = static_cast<CBJump*>(jTarget->_from);
+    jTarget->_from = edge;
+    jTarget->addNumRefs();
 
-    if (jTarget) {
-      node->_jumpNext = static_cast<CBJump*>(jTarget->_from);
-      jTarget->_from = node;
-      jTarget->addNumRefs();
-    }
+    table->setEdge(i, edge);
+    addNode(edge);
+  }
 
-    // The 'jmp' is always taken, conditional jump can contain hint, we detect it.
-    if (instId == X86Inst::kIdJmp)
-      node->orFlags(CBNode::kFlagIsTaken);
-    else if (options & X86Inst::kOptionTaken)
-      node->orFlags(CBNode::kFlagIsTaken);
+  // Place the table at the end of the function like the local constant pool.
+  addBefore(table, func->getEnd());
+  return kErrorOk;
+}
 
-    if (inlineComment) {
-      inlineComment = static_cast<char*>(_cbDataZone.dup(inlineComment, ::strlen(inlineComment), true));
-      node->setInlineComment(inlineComment);
-    }
+// ============================================================================
+// [asmjit::X86Compiler - Test]
+// ============================================================================
 
-    addNode(node);
-    return kErrorOk;
-  }
-  else {
-    CBInst* node = _cbHeap.allocT<CBInst>(sizeof(CBInst) + opCount * sizeof(Operand));
-    Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + sizeof(CBInst));
+#if defined(ASMJIT_TEST)
+static void X86Compiler_testFunc(X86Compiler& cc, uint32_t count) {
+  cc.addFunc(FuncSignature1<int, const int*>(CallConv::kIdX86SysV64));
 
-    if (ASMJIT_UNLIKELY(!node))
-      return setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+  X86Gp p = cc.newIntPtr("p");
+  X86Gp v[32];
+  cc.setArg(0, p);
 
-    if (opCount > 0) opArray[0].copyFrom(o0);
-    if (opCount > 1) opArray[1].copyFrom(o1);
-    if (opCount > 2) opArray[2].copyFrom(o2);
-    if (opCount > 3) opArray[3].copyFrom(o3);
-    if (opCount > 4) opArray[4].copyFrom(o4);
-    if (opCount > 5) opArray[5].copyFrom(o5);
+  for (uint32_t i = 0; i < count; i++) {
+    v[i] = cc.newInt32("v%u", i);
+    cc.mov(v[i], x86::dword_ptr(p, int32_t(i * 4)));
+  }
 
-    node = new(node) CBInst(this, instId, options, opArray, opCount);
-    node->_instDetail.extraReg = _extraReg;
-    _extraReg.reset();
+  for (uint32_t i = count - 1; i > 0; i--)
+    cc.add(v[i - 1], v[i]);
 
-    if (inlineComment) {
-      inlineComment = static_cast<char*>(_cbDataZone.dup(inlineComment, ::strlen(inlineComment), true));
-      node->setInlineComment(inlineComment);
+  cc.ret(v[0]);
+  cc.endFunc();
+}
+
+UNIT(x86_compiler_passes) {
+  CodeInfo ci(ArchInfo::kTypeX64);
+  ci.setCdeclCallConv(CallConv::kIdX86SysV64);
+
+  CodeHolder code;
+  code.init(ci);
+
+  X86Compiler cc(&code);
+  cc.setPassStatsEnabled(true);
+
+  INFO("Checking that passes are created by name and ordered by dependencies");
+  EXPECT(cc.setPassOptions("X86Scheduler, X86Peephole,X86Licm,+X86Cse,X86ConstFold") == kErrorOk,
+    "Failed to set pass options");
+  EXPECT(cc.getPasses().getLength() == 6, "Expected 6 passes, got %u", unsigned(cc.getPasses().getLength()));
+  EXPECT(cc.setPassOptions("-X86Scheduler") == kErrorOk, "Failed to disable X86Scheduler");
+  EXPECT(!cc.getPassByName("X86Scheduler")->isEnabled(), "X86Scheduler should be disabled");
+  EXPECT(cc.setPassOptions("X86Unknown") == DebugUtils::errored(kErrorInvalidArgument),
+    "Unknown pass should be rejected");
+
+  X86Compiler_testFunc(cc, 4);
+  X86Compiler_testFunc(cc, 24);
+  EXPECT(cc.finalize() == kErrorOk, "Failed to finalize X86Compiler");
+
+  static const char* expectedOrder[] = { "X86ConstFold", "X86Cse", "X86Licm", "RA", "X86Peephole" };
+  const ZoneVector<CBPassRecord>& records = cc.getPassRecords();
+  uint32_t runIndex = 0;
+  uint32_t funcCount = 0;
+
+  for (size_t i = 0; i < records.getLength(); i++) {
+    const CBPassRecord& record = records[i];
+    if (record.func) {
+      EXPECT(::strcmp(record.pass->getName(), "RA") == 0, "Only RA should record functions");
+      EXPECT(record.stats.getNodesIn() > 0 && record.stats.getNodesOut() > 0, "Function record should count nodes");
+      funcCount++;
+      continue;
     }
 
-    addNode(node);
-    return kErrorOk;
+    EXPECT(runIndex < ASMJIT_ARRAY_SIZE(expectedOrder), "Too many pass runs recorded");
+    EXPECT(::strcmp(record.pass->getName(), expectedOrder[runIndex]) == 0,
+      "Pass #%u should be %s, not %s", runIndex, expectedOrder[runIndex], record.pass->getName());
+    runIndex++;
   }
+
+  EXPECT(runIndex == ASMJIT_ARRAY_SIZE(expectedOrder), "Expected %u pass runs, got %u",
+    unsigned(ASMJIT_ARRAY_SIZE(expectedOrder)), runIndex);
+  EXPECT(funcCount == 2, "Expected 2 function records, got %u", funcCount);
+
+  INFO("Checking statistics of the register allocator");
+  const CBPassStats& stats = cc.getPassByName("RA")->getStats();
+  EXPECT(stats.getRunCount() == 1, "RA should run once, ran %u times", stats.getRunCount());
+  EXPECT(stats.getSpillCount() > 0, "24 live registers should be spilled");
+  EXPECT(stats.getZoneSize() > 0, "RA should allocate from the pass zone");
+
+  cc.resetPassStats();
+  EXPECT(cc.getPassRecords().isEmpty(), "Records should be removed by resetPassStats()");
+  EXPECT(cc.getPassByName("RA")->getStats().getSpillCount() == 0, "Statistics should be reset by resetPassStats()");
+
+  INFO("Checking that cyclic dependencies are rejected");
+  CodeHolder code2;
+  code2.init(ci);
+
+  X86Compiler cc2(&code2);
+  EXPECT(cc2.setPassOptions("X86Peephole") == kErrorOk, "Failed to add X86Peephole");
+  cc2.getPassByName("RA")->runAfter("X86Peephole");
+  X86Compiler_testFunc(cc2, 2);
+  EXPECT(cc2.finalize() == DebugUtils::errored(kErrorInvalidState), "Cyclic dependencies should fail");
 }
+#endif // ASMJIT_TEST
 
 } // asmjit namespace
 
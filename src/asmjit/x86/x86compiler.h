@@ -67,6 +67,20 @@ public:
 
   ASMJIT_API virtual Error onAttach(CodeHolder* code) noexcept override;
 
+  // --------------------------------------------------------------------------
+  // [Workers]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual CodeCompiler* _newWorker() noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Passes]
+  // --------------------------------------------------------------------------
+
+  //! Create "X86ConstFold", "X86Cse", "X86Licm", "X86Peephole", or
+  //! "X86Scheduler" pass.
+  ASMJIT_API virtual CBPass* _newPassByName(const char* name) noexcept override;
+
   // --------------------------------------------------------------------------
   // [Code-Generation]
   // --------------------------------------------------------------------------
@@ -269,6 +283,17 @@ public:
   //! \overload
   ASMJIT_INLINE CCFuncCall* call(uint64_t dst, const FuncSignature& sign) { return addCall(X86Inst::kIdCall, Imm(dst), sign); }
 
+  //! Jump to `targets[index]` or to `outOfRange` if `index` is not less than
+  //! `count` (unsigned comparison).
+  //!
+  //! The targets are stored in a \ref CBJumpTable placed at the end of the
+  //! current function. Each entry is 32-bit offset relative to the table, so
+  //! the dispatch doesn't need any relocation and works in PIC mode on X64.
+  //! The register allocator sees all targets as successors of the jump, so
+  //! variables can be live across the dispatch. The `index` must be a 32-bit
+  //! or 64-bit general purpose register.
+  ASMJIT_API Error jmpTable(const X86Gp& index, const Label* targets, uint32_t count, const Label& outOfRange);
+
   //! Return.
   ASMJIT_INLINE CCFuncRet* ret() { return addRet(Operand(), Operand()); }
   //! \overload
@@ -0,0 +1,1000 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/utils.h"
+#include "../x86/x86compiler.h"
+#include "../x86/x86constfold.h"
+#include "../x86/x86inst.h"
+#include "../x86/x86passutils_p.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Value of a virtual register, only valid if its `epoch` matches the epoch of
+//! the context.
+struct X86ConstValue {
+  uint64_t value;                        //!< Value (zero extended).
+  uint32_t epoch;                        //!< Epoch the value was written in.
+  uint32_t size;                         //!< Size of the write that produced the value.
+};
+
+//! \internal
+struct X86ConstFoldContext {
+  X86Compiler* cc;                       //!< Compiler being processed.
+  X86ConstFoldPass* pass;                //!< Pass (statistics).
+  X86ConstValue* values;                 //!< Values of virtual registers.
+  uint32_t count;                        //!< Count of `values`.
+  uint32_t epoch;                        //!< Current epoch, incremented to forget all values.
+  CBNode* cursor;                        //!< Cursor of the compiler to restore.
+  CBNode* prev;                          //!< Node before the replaced one.
+};
+
+//! \internal
+static ASMJIT_INLINE uint64_t X86ConstFold_mask(uint32_t size) noexcept {
+  return size >= 8 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << (size * 8)) - 1;
+}
+
+//! \internal
+//!
+//! Get the immediate that represents `value` of `size`. 32-bit values are
+//! sign extended, so they fit into imm32 of any instruction.
+static ASMJIT_INLINE Imm X86ConstFold_imm(uint64_t value, uint32_t size) noexcept {
+  if (size <= 4)
+    return Imm(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(value))));
+  else
+    return Imm(static_cast<int64_t>(value));
+}
+
+//! \internal
+//!
+//! Get whether `value` of `size` fits into a sign extended imm32.
+static ASMJIT_INLINE bool X86ConstFold_fitsImm32(uint64_t value, uint32_t size) noexcept {
+  return size <= 4 || Utils::isInt32(static_cast<int64_t>(value));
+}
+
+//! \internal
+static ASMJIT_INLINE uint32_t X86ConstFold_log2(uint64_t value) noexcept {
+  uint32_t n = 0;
+  while (value > 1) {
+    value >>= 1;
+    n++;
+  }
+  return n;
+}
+
+//! \internal
+//!
+//! Get whether `op` is a GP virtual register the pass can read.
+static ASMJIT_INLINE bool X86ConstFold_isGp(const Operand& op) noexcept {
+  if (!op.isVirtReg())
+    return false;
+
+  uint32_t type = op.as<Reg>().getType();
+  return type == X86Reg::kRegGpbLo || (type >= X86Reg::kRegGpw && type <= X86Reg::kRegGpq);
+}
+
+//! \internal
+//!
+//! Get whether `op` is a 32-bit or 64-bit GP virtual register of the same size
+//! as the register itself, the only registers the pass writes.
+static ASMJIT_INLINE bool X86ConstFold_isFullGp(const X86ConstFoldContext& ctx, const Operand& op) noexcept {
+  if (!op.isVirtReg())
+    return false;
+
+  const Reg& reg = op.as<Reg>();
+  if (!reg.isReg(X86Reg::kRegGpd) && !reg.isReg(X86Reg::kRegGpq))
+    return false;
+
+  VirtReg* vreg = ctx.cc->getVirtRegById(reg.getId());
+  return vreg->getSize() == reg.getSize();
+}
+
+//! \internal
+static ASMJIT_INLINE bool X86ConstFold_isSameReg(const Operand& a, const Operand& b) noexcept {
+  return a.isReg() && b.isReg() && a.getId() == b.getId();
+}
+
+//! \internal
+//!
+//! Get the known value of a virtual register `id` read as `size` bytes.
+static ASMJIT_INLINE bool X86ConstFold_getRegValue(const X86ConstFoldContext& ctx, uint32_t id, uint32_t size, uint64_t& out) noexcept {
+  uint32_t index = Operand::unpackId(id);
+  if (index >= ctx.count)
+    return false;
+
+  const X86ConstValue& v = ctx.values[index];
+  if (v.epoch != ctx.epoch || v.size < size)
+    return false;
+
+  out = v.value & X86ConstFold_mask(size);
+  return true;
+}
+
+//! \internal
+//!
+//! Get the known value of `op` (immediate or GP virtual register) of `size`.
+static bool X86ConstFold_getValue(const X86ConstFoldContext& ctx, const Operand& op, uint32_t size, uint64_t& out) noexcept {
+  if (op.isImm()) {
+    out = op.as<Imm>().getUInt64() & X86ConstFold_mask(size);
+    return true;
+  }
+
+  if (!X86ConstFold_isGp(op) || op.as<Reg>().getSize() != size)
+    return false;
+
+  return X86ConstFold_getRegValue(ctx, op.getId(), size, out);
+}
+
+//! \internal
+static ASMJIT_INLINE void X86ConstFold_setValue(X86ConstFoldContext& ctx, const Operand& op, uint64_t value) noexcept {
+  uint32_t index = Operand::unpackId(op.getId());
+  if (index >= ctx.count)
+    return;
+
+  uint32_t size = op.as<Reg>().getSize();
+  X86ConstValue& v = ctx.values[index];
+
+  v.value = value & X86ConstFold_mask(size);
+  v.epoch = ctx.epoch;
+  v.size = size;
+}
+
+//! \internal
+static ASMJIT_INLINE void X86ConstFold_forgetId(X86ConstFoldContext& ctx, uint32_t id) noexcept {
+  if (!Operand::isPackedId(id))
+    return;
+
+  uint32_t index = Operand::unpackId(id);
+  if (index < ctx.count)
+    ctx.values[index].epoch = 0;
+}
+
+//! \internal
+static ASMJIT_INLINE void X86ConstFold_forget(X86ConstFoldContext& ctx, const Operand& op) noexcept {
+  if (op.isVirtReg())
+    X86ConstFold_forgetId(ctx, op.getId());
+}
+
+//! \internal
+//!
+//! Forget values of all virtual registers used by `node`, including the ones
+//! only used to address memory (string instructions modify them).
+static void X86ConstFold_forgetAll(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  const Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    if (op.isReg()) {
+      X86ConstFold_forget(ctx, op);
+    }
+    else if (op.isMem()) {
+      const X86Mem& m = op.as<X86Mem>();
+      if (m.hasBaseReg()) X86ConstFold_forgetId(ctx, m.getBaseId());
+      if (m.hasIndexReg()) X86ConstFold_forgetId(ctx, m.getIndexId());
+    }
+  }
+
+  if (node->hasExtraReg())
+    X86ConstFold_forgetId(ctx, node->getExtraReg().getId());
+}
+
+//! \internal
+//!
+//! Rewrite `node` to `instId o0, o1` in place.
+static void X86ConstFold_rewrite(CBInst* node, uint32_t instId, const Operand_& o0, const Operand_& o1) noexcept {
+  ASMJIT_ASSERT(node->getOpCount() >= 2);
+  Operand* opArray = node->getOpArray();
+
+  node->setInstId(instId);
+  node->setOptions(0);
+  opArray[0].copyFrom(o0);
+  opArray[1].copyFrom(o1);
+  node->_opCount = 2;
+  node->_updateMemOp();
+}
+
+//! \internal
+//!
+//! Rewrite `node` to `mov dst, value`.
+static ASMJIT_INLINE void X86ConstFold_rewriteMov(X86ConstFoldContext& ctx, CBInst* node, const Operand& dst, uint64_t value) noexcept {
+  uint32_t size = dst.as<Reg>().getSize();
+  X86ConstFold_rewrite(node, X86Inst::kIdMov, dst, X86ConstFold_imm(value, size));
+  X86ConstFold_setValue(ctx, node->getOpArray()[0], value);
+}
+
+//! \internal
+//!
+//! Start replacing `node`, instructions emitted until `X86ConstFold_end()` are
+//! inserted before it.
+static ASMJIT_INLINE void X86ConstFold_begin(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  ctx.prev = node->getPrev();
+  ctx.cc->_setCursor(ctx.prev);
+}
+
+//! \internal
+//!
+//! Remove `node` replaced by the instructions emitted since `X86ConstFold_begin()`.
+static ASMJIT_INLINE void X86ConstFold_end(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  CBNode* last = ctx.cc->getCursor();
+  if (last != ctx.prev && !last->hasInlineComment())
+    last->setInlineComment(node->getInlineComment());
+
+  if (ctx.cursor == node)
+    ctx.cursor = last;
+  ctx.cc->removeNode(node);
+}
+
+//! \internal
+//!
+//! Remove `node` that has no effect.
+static ASMJIT_INLINE void X86ConstFold_remove(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  if (ctx.cursor == node)
+    ctx.cursor = node->getPrev();
+  ctx.cc->removeNode(node);
+  ctx.pass->_foldedCount++;
+}
+
+//! \internal
+//!
+//! Calculate `2^p / d`, the quotient is truncated to 64 bits. `d` must be less
+//! than `2^63`.
+static void X86ConstFold_divPow2(uint32_t p, uint64_t d, uint64_t& q, uint64_t& r) noexcept {
+  q = 0;
+  r = 0;
+
+  for (uint32_t i = p + 1; i != 0; i--) {
+    r = (r << 1) | static_cast<uint64_t>(i == p + 1);
+    q <<= 1;
+    if (r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+}
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass - Instructions]
+// ============================================================================
+
+//! \internal
+//!
+//! Calculate `instId a, b` of `size`, returns false if not supported.
+static bool X86ConstFold_calc(uint32_t instId, uint64_t a, uint64_t b, uint32_t size, uint64_t& out) noexcept {
+  uint64_t mask = X86ConstFold_mask(size);
+  uint32_t bits = size * 8;
+
+  switch (instId) {
+    case X86Inst::kIdAdd : out = a + b; break;
+    case X86Inst::kIdSub : out = a - b; break;
+    case X86Inst::kIdAnd : out = a & b; break;
+    case X86Inst::kIdOr  : out = a | b; break;
+    case X86Inst::kIdXor : out = a ^ b; break;
+    case X86Inst::kIdImul: out = a * b; break;
+    case X86Inst::kIdShl : out = a << b; break;
+    case X86Inst::kIdShr : out = a >> b; break;
+
+    case X86Inst::kIdSar: {
+      // Sign extend to 64 bits first.
+      int64_t x = static_cast<int64_t>(a << (64 - bits)) >> (64 - bits);
+      out = static_cast<uint64_t>(x >> b);
+      break;
+    }
+
+    case X86Inst::kIdNeg : out = 0 - a; break;
+    case X86Inst::kIdNot : out = ~a; break;
+    case X86Inst::kIdInc : out = a + 1; break;
+    case X86Inst::kIdDec : out = a - 1; break;
+
+    default:
+      return false;
+  }
+
+  out &= mask;
+  return true;
+}
+
+//! \internal
+//!
+//! `mov r, r|imm` and `mov [m], r`.
+static Error X86ConstFold_mov(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  if (node->getOpCount() != 2) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  Operand& o0 = opArray[0];
+  Operand& o1 = opArray[1];
+  uint64_t value;
+
+  if (X86ConstFold_isFullGp(ctx, o0)) {
+    uint32_t size = o0.as<Reg>().getSize();
+
+    if (X86ConstFold_getValue(ctx, o1, size, value)) {
+      if (o1.isReg()) {
+        o1 = X86ConstFold_imm(value, size);
+        ctx.pass->_propagatedCount++;
+      }
+      X86ConstFold_setValue(ctx, o0, value);
+    }
+    else {
+      X86ConstFold_forget(ctx, o0);
+    }
+    return kErrorOk;
+  }
+
+  if (o0.isMem() && X86ConstFold_isGp(o1)) {
+    uint32_t size = o1.as<Reg>().getSize();
+    if (o0.as<X86Mem>().getSize() == size &&
+        X86ConstFold_getValue(ctx, o1, size, value) &&
+        X86ConstFold_fitsImm32(value, size)) {
+      o1 = X86ConstFold_imm(value, size);
+      ctx.pass->_propagatedCount++;
+    }
+    return kErrorOk;
+  }
+
+  X86ConstFold_forgetAll(ctx, node);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `add|sub|and|or|xor r, r|imm`.
+static Error X86ConstFold_arith(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  uint32_t instId = node->getInstId();
+  Operand* opArray = node->getOpArray();
+
+  if (node->getOpCount() != 2 || !X86ConstFold_isFullGp(ctx, opArray[0])) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  Operand& o0 = opArray[0];
+  Operand& o1 = opArray[1];
+
+  uint32_t size = o0.as<Reg>().getSize();
+  uint64_t mask = X86ConstFold_mask(size);
+
+  bool isSame = X86ConstFold_isSameReg(o0, o1);
+
+  // SUB|XOR of the same register is zero, AND|OR keeps its value.
+  if (isSame && instId != X86Inst::kIdAdd) {
+    if (instId == X86Inst::kIdSub || instId == X86Inst::kIdXor)
+      X86ConstFold_setValue(ctx, o0, 0);
+    return kErrorOk;
+  }
+
+  uint64_t a, b;
+  bool hasA = X86ConstFold_getValue(ctx, o0, size, a);
+  bool hasB = X86ConstFold_getValue(ctx, o1, size, b);
+
+  if (hasB && o1.isReg() && !isSame && X86ConstFold_fitsImm32(b, size)) {
+    o1 = X86ConstFold_imm(b, size);
+    ctx.pass->_propagatedCount++;
+  }
+
+  if (hasA && hasB) {
+    uint64_t result;
+    X86ConstFold_calc(instId, a, b, size, result);
+
+    if (X86PassUtils::canDropFlags(node)) {
+      X86ConstFold_rewriteMov(ctx, node, o0, result);
+      ctx.pass->_foldedCount++;
+    }
+    else {
+      X86ConstFold_setValue(ctx, o0, result);
+    }
+    return kErrorOk;
+  }
+
+  if (hasB) {
+    bool isIdentity = (instId == X86Inst::kIdAnd) ? b == mask : b == 0;
+    bool isConstant = (instId == X86Inst::kIdAnd && b == 0) || (instId == X86Inst::kIdOr && b == mask);
+
+    if (isIdentity && X86PassUtils::canDropFlags(node)) {
+      X86ConstFold_remove(ctx, node);
+      return kErrorOk;
+    }
+
+    if (isConstant) {
+      if (X86PassUtils::canDropFlags(node)) {
+        X86ConstFold_rewriteMov(ctx, node, o0, b);
+        ctx.pass->_foldedCount++;
+      }
+      else {
+        X86ConstFold_setValue(ctx, o0, b);
+      }
+      return kErrorOk;
+    }
+  }
+
+  X86ConstFold_forget(ctx, o0);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `cmp|test r|[m], r`, doesn't write registers.
+static Error X86ConstFold_cmp(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  if (node->getOpCount() != 2)
+    return kErrorOk;
+
+  Operand& o0 = opArray[0];
+  Operand& o1 = opArray[1];
+
+  if (!X86ConstFold_isGp(o1) || X86ConstFold_isSameReg(o0, o1))
+    return kErrorOk;
+
+  uint32_t size = o1.as<Reg>().getSize();
+  uint64_t value;
+
+  bool isEligible = o0.isMem() ? o0.as<X86Mem>().getSize() == size
+                               : X86ConstFold_isGp(o0) && o0.as<Reg>().getSize() == size;
+
+  if (isEligible && X86ConstFold_getValue(ctx, o1, size, value) && X86ConstFold_fitsImm32(value, size)) {
+    o1 = X86ConstFold_imm(value, size);
+    ctx.pass->_propagatedCount++;
+  }
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `shl|shr|sar r, cl|imm`.
+static Error X86ConstFold_shift(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+
+  if (node->getOpCount() != 2 || !X86ConstFold_isFullGp(ctx, opArray[0])) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  Operand& o0 = opArray[0];
+  Operand& o1 = opArray[1];
+
+  uint32_t size = o0.as<Reg>().getSize();
+  uint64_t count, value;
+
+  if (!X86ConstFold_getValue(ctx, o1, o1.isImm() ? 1 : o1.as<Reg>().getSize(), count)) {
+    X86ConstFold_forget(ctx, o0);
+    return kErrorOk;
+  }
+
+  count &= size == 8 ? 63 : 31;
+  if (o1.isReg()) {
+    o1 = Imm(static_cast<int64_t>(count));
+    ctx.pass->_propagatedCount++;
+  }
+
+  // A shift by zero doesn't change the register nor flags.
+  if (count == 0) {
+    X86ConstFold_remove(ctx, node);
+    return kErrorOk;
+  }
+
+  if (X86ConstFold_getValue(ctx, o0, size, value)) {
+    uint64_t result;
+    X86ConstFold_calc(node->getInstId(), value, count, size, result);
+
+    if (X86PassUtils::canDropFlags(node)) {
+      X86ConstFold_rewriteMov(ctx, node, o0, result);
+      ctx.pass->_foldedCount++;
+    }
+    else {
+      X86ConstFold_setValue(ctx, o0, result);
+    }
+    return kErrorOk;
+  }
+
+  X86ConstFold_forget(ctx, o0);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `neg|not|inc|dec r`.
+static Error X86ConstFold_unary(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+
+  if (node->getOpCount() != 1 || !X86ConstFold_isFullGp(ctx, opArray[0])) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  Operand& o0 = opArray[0];
+  uint32_t size = o0.as<Reg>().getSize();
+  uint64_t value;
+
+  if (!X86ConstFold_getValue(ctx, o0, size, value)) {
+    X86ConstFold_forget(ctx, o0);
+    return kErrorOk;
+  }
+
+  uint64_t result;
+  X86ConstFold_calc(node->getInstId(), value, 0, size, result);
+
+  // The node has a single operand, so it can't be rewritten in place.
+  if (X86PassUtils::canDropFlags(node)) {
+    X86ConstFold_begin(ctx, node);
+    ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdMov, o0, X86ConstFold_imm(result, size)));
+    X86ConstFold_setValue(ctx, o0, result);
+    X86ConstFold_end(ctx, node);
+    ctx.pass->_foldedCount++;
+  }
+  else {
+    X86ConstFold_setValue(ctx, o0, result);
+  }
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `imul r, r|imm` and `imul r, r, imm`.
+static Error X86ConstFold_imul(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  if (opCount < 2 || opCount > 3 || !X86ConstFold_isFullGp(ctx, opArray[0])) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  // Operands are copied as the node can be removed.
+  X86Gp dst = opArray[0].as<X86Gp>();
+  Operand src;
+  uint64_t k;
+
+  uint32_t size = dst.getSize();
+  uint64_t value;
+  bool isPropagated = false;
+
+  if (opCount == 3) {
+    src = opArray[1];
+    if (!opArray[2].isImm() || (!src.isMem() && !X86ConstFold_isFullGp(ctx, src))) {
+      X86ConstFold_forgetAll(ctx, node);
+      return kErrorOk;
+    }
+    k = opArray[2].as<Imm>().getUInt64() & X86ConstFold_mask(size);
+  }
+  else if (opArray[1].isImm()) {
+    src = dst;
+    k = opArray[1].as<Imm>().getUInt64() & X86ConstFold_mask(size);
+  }
+  else if (X86ConstFold_isFullGp(ctx, opArray[1]) && opArray[1].as<Reg>().getSize() == size) {
+    // Multiplication is commutative, any known operand can be the immediate.
+    if (X86ConstFold_getValue(ctx, opArray[1], size, k))
+      src = dst;
+    else if (X86ConstFold_getValue(ctx, dst, size, k))
+      src = opArray[1];
+    else {
+      X86ConstFold_forget(ctx, dst);
+      return kErrorOk;
+    }
+    isPropagated = true;
+  }
+  else {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  if (src.isReg() && X86ConstFold_getValue(ctx, src, size, value)) {
+    uint64_t result = (value * k) & X86ConstFold_mask(size);
+
+    if (X86PassUtils::canDropFlags(node)) {
+      X86ConstFold_begin(ctx, node);
+      ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdMov, dst, X86ConstFold_imm(result, size)));
+      X86ConstFold_end(ctx, node);
+      ctx.pass->_foldedCount++;
+    }
+    X86ConstFold_setValue(ctx, dst, result);
+    return kErrorOk;
+  }
+
+  bool isSame = X86ConstFold_isSameReg(dst, src);
+  if (src.isReg() && X86PassUtils::canDropFlags(node)) {
+    const X86Gp& srcGp = src.as<X86Gp>();
+
+    if (k == 0) {
+      X86ConstFold_begin(ctx, node);
+      ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdMov, dst, Imm(0)));
+      X86ConstFold_end(ctx, node);
+      X86ConstFold_setValue(ctx, dst, 0);
+      ctx.pass->_foldedCount++;
+      return kErrorOk;
+    }
+
+    if (k == 1 && isSame) {
+      X86ConstFold_remove(ctx, node);
+      X86ConstFold_forget(ctx, dst);
+      return kErrorOk;
+    }
+
+    if (Utils::isPowerOf2(k)) {
+      X86ConstFold_begin(ctx, node);
+      if (!isSame)
+        ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdMov, dst, srcGp));
+      if (k != 1)
+        ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdShl, dst, Imm(X86ConstFold_log2(k))));
+      X86ConstFold_end(ctx, node);
+      X86ConstFold_forget(ctx, dst);
+      ctx.pass->_reducedCount++;
+      return kErrorOk;
+    }
+
+    if (k == 3 || k == 5 || k == 9) {
+      X86ConstFold_begin(ctx, node);
+      ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdLea, dst, x86::ptr(srcGp, srcGp, X86ConstFold_log2(k - 1))));
+      X86ConstFold_end(ctx, node);
+      X86ConstFold_forget(ctx, dst);
+      ctx.pass->_reducedCount++;
+      return kErrorOk;
+    }
+  }
+
+  if (isPropagated && X86ConstFold_fitsImm32(k, size)) {
+    X86ConstFold_begin(ctx, node);
+    ASMJIT_PROPAGATE(ctx.cc->emit(X86Inst::kIdImul, dst, src, X86ConstFold_imm(k, size)));
+    X86ConstFold_end(ctx, node);
+    ctx.pass->_propagatedCount++;
+  }
+
+  X86ConstFold_forget(ctx, dst);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `div hi, lo, r` (unsigned) with `hi` known to be zero and `r` known.
+static Error X86ConstFold_div(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  uint64_t zero, d, n;
+
+  if (node->getOpCount() != 3 ||
+      !X86ConstFold_isFullGp(ctx, opArray[0]) ||
+      !X86ConstFold_isFullGp(ctx, opArray[1]) ||
+      !X86ConstFold_isGp(opArray[2])) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  X86Gp hi = opArray[0].as<X86Gp>();
+  X86Gp lo = opArray[1].as<X86Gp>();
+  uint32_t size = lo.getSize();
+
+  if (hi.getSize() != size ||
+      !X86ConstFold_getValue(ctx, hi, size, zero) || zero != 0 ||
+      !X86ConstFold_getValue(ctx, opArray[2], size, d) || d == 0) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  X86Compiler* cc = ctx.cc;
+  uint32_t w = size * 8;
+
+  // DIV leaves flags undefined, so nothing can read them.
+  if (X86ConstFold_getValue(ctx, lo, size, n)) {
+    X86ConstFold_begin(ctx, node);
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, lo, X86ConstFold_imm(n / d, size)));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, hi, X86ConstFold_imm(n % d, size)));
+    X86ConstFold_end(ctx, node);
+
+    X86ConstFold_setValue(ctx, lo, n / d);
+    X86ConstFold_setValue(ctx, hi, n % d);
+    ctx.pass->_foldedCount++;
+    return kErrorOk;
+  }
+
+  if (d == 1) {
+    X86ConstFold_remove(ctx, node);
+    return kErrorOk;
+  }
+
+  if (Utils::isPowerOf2(d)) {
+    X86ConstFold_begin(ctx, node);
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, hi, lo));
+    if (X86ConstFold_fitsImm32(d - 1, size)) {
+      ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdAnd, hi, X86ConstFold_imm(d - 1, size)));
+    }
+    else {
+      X86Gp m = cc->newSimilarReg(lo);
+      ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, m, X86ConstFold_imm(d - 1, size)));
+      ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdAnd, hi, m));
+    }
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdShr, lo, Imm(X86ConstFold_log2(d))));
+    X86ConstFold_end(ctx, node);
+
+    X86ConstFold_forget(ctx, lo);
+    X86ConstFold_forget(ctx, hi);
+    ctx.pass->_reducedCount++;
+    return kErrorOk;
+  }
+
+  // Divisors having the most significant bit set would need a different
+  // sequence, they are rare enough to keep DIV.
+  if (d > (X86ConstFold_mask(size) >> 1)) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  // Multiplication by a magic number `m` (Granlund & Montgomery), `q = n / d`
+  // is calculated as `mulhi(n, m) >> s`. If `m` doesn't fit into `w` bits the
+  // missing bit is added by `(((n - t) >> 1) + t) >> (l - 1)`.
+  uint32_t l = X86ConstFold_log2(d - 1) + 1;
+  uint64_t q, r;
+
+  X86ConstFold_divPow2(w + l - 1, d, q, r);
+  bool fits = d - r <= (static_cast<uint64_t>(1) << (l - 1));
+
+  uint64_t magic;
+  if (fits) {
+    magic = q + 1;
+  }
+  else {
+    X86ConstFold_divPow2(w + l, d, q, r);
+    magic = (q + 1) & X86ConstFold_mask(size);
+  }
+
+  X86Gp n0 = cc->newSimilarReg(lo);
+  X86Gp m = cc->newSimilarReg(lo);
+
+  X86ConstFold_begin(ctx, node);
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, n0, lo));
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, m, X86ConstFold_imm(magic, size)));
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMul, hi, lo, m));
+
+  if (fits) {
+    if (l > 1)
+      ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdShr, hi, Imm(l - 1)));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, lo, hi));
+  }
+  else {
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, lo, n0));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdSub, lo, hi));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdShr, lo, Imm(1)));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdAdd, lo, hi));
+    if (l > 1)
+      ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdShr, lo, Imm(l - 1)));
+  }
+
+  // Remainder `n - q * d`.
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, hi, lo));
+  if (X86ConstFold_fitsImm32(d, size)) {
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdImul, hi, hi, X86ConstFold_imm(d, size)));
+  }
+  else {
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, m, X86ConstFold_imm(d, size)));
+    ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdImul, hi, m));
+  }
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdSub, n0, hi));
+  ASMJIT_PROPAGATE(cc->emit(X86Inst::kIdMov, hi, n0));
+  X86ConstFold_end(ctx, node);
+
+  X86ConstFold_forget(ctx, lo);
+  X86ConstFold_forget(ctx, hi);
+  ctx.pass->_reducedCount++;
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `lea r, [base + index * scale + offset]`.
+static Error X86ConstFold_lea(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+
+  if (node->getOpCount() != 2 || !X86ConstFold_isFullGp(ctx, opArray[0]) || !opArray[1].isMem()) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  Operand& o0 = opArray[0];
+  const X86Mem& m = opArray[1].as<X86Mem>();
+
+  uint32_t size = o0.as<Reg>().getSize();
+  uint32_t addrSize = 0;
+  uint64_t base = 0;
+  uint64_t index = 0;
+
+  // The address of a label (or RIP) is not known until the code is relocated.
+  if (m.hasBaseLabel() || (!m.hasBaseReg() && !m.hasIndexReg())) {
+    X86ConstFold_forget(ctx, o0);
+    return kErrorOk;
+  }
+
+  if (m.hasBaseReg()) {
+    addrSize = m.getBaseType() == X86Reg::kRegGpq ? 8 : 4;
+    if ((m.getBaseType() != X86Reg::kRegGpd && m.getBaseType() != X86Reg::kRegGpq) ||
+        !X86ConstFold_getRegValue(ctx, m.getBaseId(), addrSize, base)) {
+      X86ConstFold_forget(ctx, o0);
+      return kErrorOk;
+    }
+  }
+
+  if (m.hasIndexReg()) {
+    addrSize = m.getIndexType() == X86Reg::kRegGpq ? 8 : 4;
+    if ((m.getIndexType() != X86Reg::kRegGpd && m.getIndexType() != X86Reg::kRegGpq) ||
+        !X86ConstFold_getRegValue(ctx, m.getIndexId(), addrSize, index)) {
+      X86ConstFold_forget(ctx, o0);
+      return kErrorOk;
+    }
+  }
+
+  uint64_t result = base + (index << m.getShift()) + static_cast<uint64_t>(m.getOffset());
+  result &= X86ConstFold_mask(addrSize) & X86ConstFold_mask(size);
+
+  X86ConstFold_rewriteMov(ctx, node, o0, result);
+  ctx.pass->_foldedCount++;
+  return kErrorOk;
+}
+
+//! \internal
+static Error X86ConstFold_processInst(X86ConstFoldContext& ctx, CBInst* node) noexcept {
+  uint32_t instId = node->getInstId();
+
+  if (instId == X86Inst::kIdNone || instId >= X86Inst::_kIdCount || node->hasExtraReg() ||
+      (node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz))) {
+    X86ConstFold_forgetAll(ctx, node);
+    return kErrorOk;
+  }
+
+  switch (instId) {
+    case X86Inst::kIdMov : return X86ConstFold_mov(ctx, node);
+
+    case X86Inst::kIdAdd :
+    case X86Inst::kIdSub :
+    case X86Inst::kIdAnd :
+    case X86Inst::kIdOr  :
+    case X86Inst::kIdXor : return X86ConstFold_arith(ctx, node);
+
+    case X86Inst::kIdCmp :
+    case X86Inst::kIdTest: return X86ConstFold_cmp(ctx, node);
+
+    case X86Inst::kIdShl :
+    case X86Inst::kIdShr :
+    case X86Inst::kIdSar : return X86ConstFold_shift(ctx, node);
+
+    case X86Inst::kIdNeg :
+    case X86Inst::kIdNot :
+    case X86Inst::kIdInc :
+    case X86Inst::kIdDec : return X86ConstFold_unary(ctx, node);
+
+    case X86Inst::kIdImul: return X86ConstFold_imul(ctx, node);
+    case X86Inst::kIdDiv : return X86ConstFold_div(ctx, node);
+    case X86Inst::kIdLea : return X86ConstFold_lea(ctx, node);
+
+    default:
+      // Jumps don't write registers, the fall-through path keeps all values.
+      if (!X86Inst::getInst(instId).getCommonData().doesJump())
+        X86ConstFold_forgetAll(ctx, node);
+      return kErrorOk;
+  }
+}
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass - Construction / Destruction]
+// ============================================================================
+
+X86ConstFoldPass::X86ConstFoldPass() noexcept : CBPass("X86ConstFold") {
+  runBefore("RA");
+  resetCounts();
+}
+X86ConstFoldPass::~X86ConstFoldPass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass - Interface]
+// ============================================================================
+
+Error X86ConstFoldPass::process(Zone* zone) noexcept {
+  if (ASMJIT_UNLIKELY(!_cb->isCodeCompiler()))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  X86Compiler* cc = static_cast<X86Compiler*>(_cb);
+  uint32_t count = static_cast<uint32_t>(cc->getVirtRegArray().getLength());
+
+  if (count == 0)
+    return kErrorOk;
+
+  X86ConstFoldContext ctx;
+  ctx.cc = cc;
+  ctx.pass = this;
+  ctx.values = zone->allocZeroedT<X86ConstValue>(count * sizeof(X86ConstValue));
+  ctx.count = count;
+  ctx.epoch = 1;
+  ctx.cursor = cc->getCursor();
+  ctx.prev = nullptr;
+
+  if (ASMJIT_UNLIKELY(!ctx.values))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  Error err = kErrorOk;
+  CBNode* node = cc->getFirstNode();
+
+  while (node) {
+    CBNode* next = node->getNext();
+    uint32_t type = node->getType();
+
+    if (type == CBNode::kNodeInst) {
+      err = X86ConstFold_processInst(ctx, static_cast<CBInst*>(node));
+      if (ASMJIT_UNLIKELY(err)) break;
+    }
+    else if (type != CBNode::kNodeComment && type != CBNode::kNodeHint) {
+      // Labels, functions, calls, and everything else start a new block.
+      ctx.epoch++;
+    }
+
+    node = next;
+  }
+
+  cc->_setCursor(ctx.cursor);
+  return err;
+}
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_constfold) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX86));
+
+  X86Compiler cc(&code);
+  X86ConstFoldPass* pass = cc.newPassT<X86ConstFoldPass>();
+  EXPECT(cc.insertPass(0, pass) == kErrorOk, "Failed to add X86ConstFoldPass");
+
+  Label L_Table = cc.newLabel();
+  cc.addFunc(FuncSignature1<void, uint32_t*>(CallConv::kIdX86CDecl));
+
+  X86Gp p = cc.newIntPtr("p");
+  X86Gp idx = cc.newUInt32("idx");
+  X86Gp r = cc.newUInt32("r");
+
+  cc.setArg(0, p);
+  cc.mov(idx, 2);
+  cc.lea(r, x86::ptr(L_Table, idx, 2));
+  cc.mov(x86::dword_ptr(p), r);
+  cc.endFunc();
+
+  cc.bind(L_Table);
+  cc.dint32(0);
+
+  EXPECT(cc.finalize() == kErrorOk, "Failed to finalize X86Compiler");
+
+  INFO("Checking that LEA with a label base is not folded");
+  uint32_t leaCount = 0;
+  for (CBNode* node = cc.getFirstNode(); node; node = node->getNext())
+    leaCount += node->getType() == CBNode::kNodeInst && static_cast<CBInst*>(node)->getInstId() == X86Inst::kIdLea;
+
+  EXPECT(pass->getFoldedCount() == 0, "Expected no folded instructions, got %u", pass->getFoldedCount());
+  EXPECT(leaCount == 1, "Expected 1 LEA, got %u", leaCount);
+}
+#endif // ASMJIT_TEST
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
@@ -0,0 +1,108 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86CONSTFOLD_H
+#define _ASMJIT_X86_X86CONSTFOLD_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86ConstFoldPass]
+// ============================================================================
+
+//! Constant folding and strength reduction of virtual registers (X86/X64).
+//!
+//! The pass is not added automatically and it only works on virtual registers,
+//! so it always runs before the register allocator of \ref X86Compiler, see
+//! \ref CBPass::runBefore().
+//!
+//! The pass tracks values of 32-bit and 64-bit GP virtual registers that are
+//! known to be constant. Tracking is local, all values are forgotten at labels,
+//! function calls, and other nodes that aren't instructions. Known values are
+//! used to:
+//!
+//!   - Fold `mov`, `add`, `sub`, `and`, `or`, `xor`, `shl`, `shr`, `sar`,
+//!     `neg`, `not`, `inc`, `dec`, `imul`, `lea`, and `div` of known values
+//!     into `mov r, imm`.
+//!   - Propagate known values into immediate operands (`add r, v` becomes
+//!     `add r, imm`), only if the instruction has such form and the value
+//!     fits into its immediate.
+//!   - Remove arithmetic with an identity operand (`add r, 0`, `shl r, 0`,
+//!     `imul r, 1`, ...).
+//!   - Replace `imul` by a constant by `shl` or `lea`, and unsigned `div` by a
+//!     constant by `shr` and `and` or by a multiplication by a magic number.
+//!
+//! Instructions that write flags are only changed when the flags are not read
+//! before they are overwritten. Instructions whose operands don't match the
+//! size of their virtual registers are never changed.
+class ASMJIT_VIRTAPI X86ConstFoldPass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86ConstFoldPass)
+  typedef CBPass Base;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API X86ConstFoldPass() noexcept;
+  ASMJIT_API virtual ~X86ConstFoldPass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get the count of instructions folded into a move or removed (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getFoldedCount() const noexcept { return _foldedCount; }
+  //! Get the count of instructions replaced by cheaper ones (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getReducedCount() const noexcept { return _reducedCount; }
+  //! Get the count of operands replaced by an immediate (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getPropagatedCount() const noexcept { return _propagatedCount; }
+
+  //! Reset all statistics.
+  ASMJIT_INLINE void resetCounts() noexcept {
+    _foldedCount = 0;
+    _reducedCount = 0;
+    _propagatedCount = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _foldedCount;                 //!< Count of folded instructions.
+  uint32_t _reducedCount;                //!< Count of strength-reduced instructions.
+  uint32_t _propagatedCount;             //!< Count of propagated immediates.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86CONSTFOLD_H
@@ -0,0 +1,948 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../x86/x86compiler.h"
+#include "../x86/x86cse.h"
+#include "../x86/x86inst.h"
+#include "../x86/x86passutils_p.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86CsePass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Initial capacity of the expression table.
+static const uint32_t kX86CseInitialCapacity = 256;
+
+//! \internal
+//!
+//! Kind of operands of `X86CseKey`.
+enum X86CseKind {
+  kX86CseKindRegs         = 0,           //!< `a` and `b` are value numbers of registers.
+  kX86CseKindImm          = 1,           //!< `a` is a value number of a register, `imm` is an immediate.
+  kX86CseKindMem          = 2,           //!< Memory based on a register, `a` and `b` are value numbers of base and index.
+  kX86CseKindLabel        = 3,           //!< Memory based on a label, `a` is label id and `b` value number of index.
+  kX86CseKindAbs          = 4,           //!< Memory at absolute address, `b` is value number of index.
+  kX86CseKindMask         = 0x0000000F,  //!< Mask of the kind.
+
+  kX86CseShiftShift       = 4,           //!< Shift of index (memory).
+  kX86CseSizeShift        = 8,           //!< Shift of access size (memory).
+  kX86CseSizeMask         = 0x0000FF00,  //!< Mask of access size (memory).
+  kX86CseTypeShift        = 16           //!< Shift of base and index types (memory) or type of `b` (registers).
+};
+
+//! \internal
+//!
+//! Operation of an expression, two expressions having the same key produce
+//! the same value.
+struct X86CseKey {
+  ASMJIT_INLINE bool operator==(const X86CseKey& other) const noexcept {
+    return instId == other.instId && signature == other.signature && kind == other.kind &&
+           a == other.a && b == other.b && imm == other.imm;
+  }
+
+  uint32_t instId;                       //!< Instruction id.
+  uint32_t signature;                    //!< Signature of the destination register.
+  uint32_t kind;                         //!< Kind of operands, see \ref X86CseKind.
+  uint32_t a;                            //!< First operand (see kind).
+  uint32_t b;                            //!< Second operand (see kind).
+  uint32_t reserved;                     //!< \internal
+  uint64_t imm;                          //!< Immediate or offset (memory).
+};
+
+//! \internal
+//!
+//! Entry of the expression table.
+struct X86CseEntry {
+  X86CseKey key;                         //!< Key.
+  uint32_t vn;                           //!< Value number of the result.
+  uint32_t holder;                       //!< Virtual register that held the result last (packed id).
+  uint32_t epoch;                        //!< Epoch of the entry, entries of other epochs are empty.
+  uint8_t isLoad;                        //!< Entry describes memory content.
+  uint8_t isKilled;                      //!< Memory content was possibly overwritten.
+  uint8_t isListed;                      //!< Entry is in the list of loads.
+  uint8_t reserved;                      //!< \internal
+};
+
+//! \internal
+//!
+//! Value number of a virtual register, only valid if its `epoch` matches the
+//! epoch of the context.
+struct X86CseValue {
+  uint32_t vn;                           //!< Value number.
+  uint32_t epoch;                        //!< Epoch the value number was assigned in.
+};
+
+//! \internal
+struct X86CseContext {
+  X86Compiler* cc;                       //!< Compiler being processed.
+  X86CsePass* pass;                      //!< Pass (statistics).
+  Zone* zone;                            //!< Zone used for all allocations.
+
+  X86CseValue* values;                   //!< Value numbers of virtual registers.
+  uint32_t count;                        //!< Count of `values`.
+
+  X86CseEntry* table;                    //!< Expression table (open addressing).
+  uint32_t* loads;                       //!< Indexes of entries that describe memory content.
+  uint32_t capacity;                     //!< Capacity of `table` and `loads` (power of 2).
+  uint32_t used;                         //!< Count of used entries of `table`.
+  uint32_t loadCount;                    //!< Count of `loads`.
+
+  uint32_t epoch;                        //!< Current epoch, incremented to forget everything.
+  uint32_t nextVn;                       //!< Next value number.
+  CBNode* cursor;                        //!< Cursor of the compiler to restore.
+};
+
+//! \internal
+static ASMJIT_INLINE uint32_t X86Cse_hash(const X86CseKey& key) noexcept {
+  uint32_t h = key.instId * 0x9E3779B1U;
+  h = (h ^ key.signature) * 0x85EBCA6BU;
+  h = (h ^ key.kind     ) * 0xC2B2AE35U;
+  h = (h ^ key.a        ) * 0x9E3779B1U;
+  h = (h ^ key.b        ) * 0x85EBCA6BU;
+  h = (h ^ static_cast<uint32_t>(key.imm)) * 0xC2B2AE35U;
+  h = (h ^ static_cast<uint32_t>(key.imm >> 32));
+  return h ^ (h >> 16);
+}
+
+//! \internal
+//!
+//! Start a new epoch, forgets all value numbers and expressions.
+static ASMJIT_INLINE void X86Cse_newEpoch(X86CseContext& ctx) noexcept {
+  ctx.epoch++;
+  ctx.used = 0;
+  ctx.loadCount = 0;
+}
+
+//! \internal
+//!
+//! Get the value number of a virtual register `id`, a new one is assigned if
+//! the register has none yet.
+static ASMJIT_INLINE uint32_t X86Cse_vnOf(X86CseContext& ctx, uint32_t id) noexcept {
+  uint32_t index = Operand::unpackId(id);
+  if (ASMJIT_UNLIKELY(index >= ctx.count))
+    return ctx.nextVn++;
+
+  X86CseValue& v = ctx.values[index];
+  if (v.epoch != ctx.epoch) {
+    v.vn = ctx.nextVn++;
+    v.epoch = ctx.epoch;
+  }
+  return v.vn;
+}
+
+//! \internal
+static ASMJIT_INLINE void X86Cse_setVn(X86CseContext& ctx, uint32_t id, uint32_t vn) noexcept {
+  uint32_t index = Operand::unpackId(id);
+  if (ASMJIT_UNLIKELY(index >= ctx.count))
+    return;
+
+  X86CseValue& v = ctx.values[index];
+  v.vn = vn;
+  v.epoch = ctx.epoch;
+}
+
+//! \internal
+//!
+//! Assign a new value number to `op` if it's a virtual register.
+static ASMJIT_INLINE void X86Cse_clobber(X86CseContext& ctx, const Operand& op) noexcept {
+  if (op.isVirtReg())
+    X86Cse_setVn(ctx, op.getId(), ctx.nextVn++);
+}
+
+//! \internal
+//!
+//! Get whether the virtual register `id` still holds value number `vn`.
+static ASMJIT_INLINE bool X86Cse_holds(const X86CseContext& ctx, uint32_t id, uint32_t vn) noexcept {
+  uint32_t index = Operand::unpackId(id);
+  if (index >= ctx.count)
+    return false;
+
+  const X86CseValue& v = ctx.values[index];
+  return v.epoch == ctx.epoch && v.vn == vn;
+}
+
+//! \internal
+//!
+//! Get whether `op` is a virtual register the pass can track, which is a 32-bit
+//! or 64-bit GP register or XMM register of the same size as the register.
+static ASMJIT_INLINE bool X86Cse_isFullReg(const X86CseContext& ctx, const Operand& op) noexcept {
+  if (!op.isVirtReg())
+    return false;
+
+  const Reg& reg = op.as<Reg>();
+  if (!reg.isReg(X86Reg::kRegGpd) && !reg.isReg(X86Reg::kRegGpq) && !reg.isReg(X86Reg::kRegXmm))
+    return false;
+
+  VirtReg* vreg = ctx.cc->getVirtRegById(reg.getId());
+  return vreg->getSize() == reg.getSize();
+}
+
+//! \internal
+static ASMJIT_INLINE bool X86Cse_isFullGp(const X86CseContext& ctx, const Operand& op) noexcept {
+  return X86Cse_isFullReg(ctx, op) && !op.as<Reg>().isReg(X86Reg::kRegXmm);
+}
+
+//! \internal
+//!
+//! Get the key of memory operand `m` accessing `size` bytes (0 if unknown),
+//! returns false if the address is not tracked (it uses a physical register,
+//! a segment, or RIP).
+static bool X86Cse_memKey(X86CseContext& ctx, const X86Mem& m, uint32_t size, X86CseKey& key) noexcept {
+  if (m.hasSegment())
+    return false;
+
+  uint32_t kind;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t baseType = 0;
+  uint32_t indexType = 0;
+
+  if (m.hasBaseReg()) {
+    baseType = m.getBaseType();
+    if (baseType == X86Reg::kRegRip || !Operand::isPackedId(m.getBaseId()))
+      return false;
+    kind = kX86CseKindMem;
+    a = X86Cse_vnOf(ctx, m.getBaseId());
+  }
+  else if (m.hasBaseLabel()) {
+    kind = kX86CseKindLabel;
+    a = m.getBaseId();
+  }
+  else {
+    kind = kX86CseKindAbs;
+  }
+
+  if (m.hasIndexReg()) {
+    indexType = m.getIndexType();
+    if (!Operand::isPackedId(m.getIndexId()) || indexType < X86Reg::kRegGpw || indexType > X86Reg::kRegGpq)
+      return false;
+    b = X86Cse_vnOf(ctx, m.getIndexId());
+  }
+
+  key.kind = kind |
+             (m.getShift() << kX86CseShiftShift) |
+             ((size & 0xFF) << kX86CseSizeShift) |
+             (baseType << kX86CseTypeShift) |
+             (indexType << (kX86CseTypeShift + 8));
+  key.a = a;
+  key.b = b;
+  key.reserved = 0;
+  key.imm = static_cast<uint64_t>(m.getOffset());
+  return true;
+}
+
+//! \internal
+//!
+//! Get whether memory described by keys `x` and `y` may overlap.
+static bool X86Cse_mayAlias(const X86CseKey& x, const X86CseKey& y) noexcept {
+  if ((x.kind & ~kX86CseSizeMask) != (y.kind & ~kX86CseSizeMask) || x.a != y.a || x.b != y.b)
+    return true;
+
+  int64_t xSize = static_cast<int64_t>((x.kind & kX86CseSizeMask) >> kX86CseSizeShift);
+  int64_t ySize = static_cast<int64_t>((y.kind & kX86CseSizeMask) >> kX86CseSizeShift);
+
+  if (!xSize || !ySize)
+    return true;
+
+  int64_t xOffset = static_cast<int64_t>(x.imm);
+  int64_t yOffset = static_cast<int64_t>(y.imm);
+  return xOffset < yOffset + ySize && yOffset < xOffset + xSize;
+}
+
+//! \internal
+//!
+//! Find an entry of `key`, returns null if it doesn't exist.
+static X86CseEntry* X86Cse_find(X86CseContext& ctx, const X86CseKey& key) noexcept {
+  uint32_t mask = ctx.capacity - 1;
+  uint32_t i = X86Cse_hash(key) & mask;
+
+  for (;;) {
+    X86CseEntry& entry = ctx.table[i];
+    if (entry.epoch != ctx.epoch)
+      return nullptr;
+
+    if (entry.key == key)
+      return &entry;
+
+    i = (i + 1) & mask;
+  }
+}
+
+//! \internal
+//!
+//! Add `entry` to the list of loads.
+static ASMJIT_INLINE void X86Cse_listLoad(X86CseContext& ctx, X86CseEntry* entry) noexcept {
+  if (entry->isListed)
+    return;
+
+  ASMJIT_ASSERT(ctx.loadCount < ctx.capacity);
+  entry->isListed = 1;
+  ctx.loads[ctx.loadCount++] = static_cast<uint32_t>(entry - ctx.table);
+}
+
+//! \internal
+//!
+//! Double the capacity of the table and rehash entries of the current epoch.
+static Error X86Cse_grow(X86CseContext& ctx) noexcept {
+  uint32_t oldCapacity = ctx.capacity;
+  X86CseEntry* oldTable = ctx.table;
+
+  uint32_t capacity = oldCapacity * 2;
+  X86CseEntry* table = ctx.zone->allocZeroedT<X86CseEntry>(capacity * sizeof(X86CseEntry));
+  uint32_t* loads = ctx.zone->allocT<uint32_t>(capacity * sizeof(uint32_t));
+
+  if (ASMJIT_UNLIKELY(!table || !loads))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ctx.table = table;
+  ctx.loads = loads;
+  ctx.capacity = capacity;
+  ctx.loadCount = 0;
+
+  uint32_t mask = capacity - 1;
+  for (uint32_t j = 0; j < oldCapacity; j++) {
+    const X86CseEntry& src = oldTable[j];
+    if (src.epoch != ctx.epoch)
+      continue;
+
+    uint32_t i = X86Cse_hash(src.key) & mask;
+    while (table[i].epoch == ctx.epoch)
+      i = (i + 1) & mask;
+
+    X86CseEntry* dst = &table[i];
+    *dst = src;
+
+    if (dst->isListed) {
+      dst->isListed = 0;
+      X86Cse_listLoad(ctx, dst);
+    }
+  }
+
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Add a new entry of `key`, which must not exist.
+static Error X86Cse_insert(X86CseContext& ctx, const X86CseKey& key, uint32_t vn, uint32_t holder, bool isLoad, X86CseEntry** out) noexcept {
+  if ((ctx.used + 1) * 2 > ctx.capacity)
+    ASMJIT_PROPAGATE(X86Cse_grow(ctx));
+
+  uint32_t mask = ctx.capacity - 1;
+  uint32_t i = X86Cse_hash(key) & mask;
+
+  while (ctx.table[i].epoch == ctx.epoch)
+    i = (i + 1) & mask;
+
+  X86CseEntry* entry = &ctx.table[i];
+  entry->key = key;
+  entry->vn = vn;
+  entry->holder = holder;
+  entry->epoch = ctx.epoch;
+  entry->isLoad = static_cast<uint8_t>(isLoad);
+  entry->isKilled = 0;
+  entry->isListed = 0;
+  ctx.used++;
+
+  if (isLoad)
+    X86Cse_listLoad(ctx, entry);
+
+  if (out) *out = entry;
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Forget all memory content.
+static void X86Cse_killAll(X86CseContext& ctx) noexcept {
+  for (uint32_t i = 0; i < ctx.loadCount; i++) {
+    X86CseEntry& entry = ctx.table[ctx.loads[i]];
+    entry.isKilled = 1;
+    entry.isListed = 0;
+  }
+  ctx.loadCount = 0;
+}
+
+//! \internal
+//!
+//! Forget memory content that may alias a store to `m` of `size` bytes.
+static void X86Cse_killMem(X86CseContext& ctx, const X86Mem& m, uint32_t size) noexcept {
+  X86CseKey key;
+  if (!X86Cse_memKey(ctx, m, size, key)) {
+    X86Cse_killAll(ctx);
+    return;
+  }
+
+  for (uint32_t i = 0; i < ctx.loadCount; i++) {
+    X86CseEntry& entry = ctx.table[ctx.loads[i]];
+    if (!entry.isKilled && X86Cse_mayAlias(entry.key, key))
+      entry.isKilled = 1;
+  }
+}
+
+//! \internal
+//!
+//! Remove `node` that doesn't change anything.
+static ASMJIT_INLINE void X86Cse_remove(X86CseContext& ctx, CBInst* node) noexcept {
+  if (ctx.cursor == node)
+    ctx.cursor = node->getPrev();
+  ctx.cc->removeNode(node);
+}
+
+//! \internal
+//!
+//! Rewrite `node` to a move of `dst` from virtual register `holder`.
+static void X86Cse_rewriteCopy(CBInst* node, const Reg& dst, uint32_t holder) noexcept {
+  Operand* opArray = node->getOpArray();
+  ASMJIT_ASSERT(node->getOpCount() >= 2);
+
+  node->setInstId(dst.isReg(X86Reg::kRegXmm) ? X86Inst::kIdMovaps : X86Inst::kIdMov);
+  node->setOptions(0);
+  opArray[0] = dst;
+  opArray[1] = Reg::fromSignature(dst.getSignature(), holder);
+  node->_opCount = 2;
+  node->_updateMemOp();
+}
+
+//! \internal
+//!
+//! Reuse the value computed by an instruction having `key` for `node`, which
+//! writes `dst`. Returns true if the node was replaced or removed.
+static Error X86Cse_reuse(X86CseContext& ctx, CBInst* node, const X86CseKey& key, bool isLoad, bool& replaced) noexcept {
+  Reg dst = node->getOpArray()[0].as<Reg>();
+  uint32_t dstId = dst.getId();
+  replaced = false;
+
+  X86CseEntry* entry = X86Cse_find(ctx, key);
+  if (!entry) {
+    uint32_t vn = ctx.nextVn++;
+    X86Cse_setVn(ctx, dstId, vn);
+    return X86Cse_insert(ctx, key, vn, dstId, isLoad, nullptr);
+  }
+
+  if (entry->isKilled) {
+    // Memory was overwritten since, the load gets a new value.
+    entry->vn = ctx.nextVn++;
+    entry->holder = dstId;
+    entry->isKilled = 0;
+    X86Cse_listLoad(ctx, entry);
+    X86Cse_setVn(ctx, dstId, entry->vn);
+    return kErrorOk;
+  }
+
+  uint32_t vn = entry->vn;
+  if (isLoad || X86PassUtils::canDropFlags(node)) {
+    if (X86Cse_holds(ctx, dstId, vn)) {
+      X86Cse_remove(ctx, node);
+      replaced = true;
+    }
+    else if (X86Cse_holds(ctx, entry->holder, vn)) {
+      X86Cse_rewriteCopy(node, dst, entry->holder);
+      replaced = true;
+    }
+  }
+
+  if (!replaced)
+    entry->holder = dstId;
+  X86Cse_setVn(ctx, dstId, vn);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86CsePass - Instructions]
+// ============================================================================
+
+//! \internal
+//!
+//! Instruction that isn't handled, clobbers all registers it may write and
+//! forgets memory it may write.
+static void X86Cse_other(X86CseContext& ctx, CBInst* node) noexcept {
+  uint32_t instId = node->getInstId();
+  Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  bool writesAll = true;
+  bool killsAll = true;
+  uint32_t flags = 0;
+
+  if (instId != X86Inst::kIdNone && instId < X86Inst::_kIdCount && !node->hasExtraReg() &&
+      !(node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz))) {
+    const X86Inst& inst = X86Inst::getInst(instId);
+    const X86Inst::CommonData& commonData = inst.getCommonData();
+    const X86Inst::OperationData& opData = inst.getOperationData();
+
+    flags = commonData.getFlags();
+    writesAll = commonData.hasFixedRM() || (flags & X86Inst::kFlagUseA) != 0;
+    killsAll = commonData.hasFixedMem() || opData.isVolatile() || opData.isBarrier() || opData.isPrivileged();
+  }
+
+  if (killsAll)
+    X86Cse_killAll(ctx);
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    bool isWritten = writesAll ||
+                     (i == 0 && (flags & X86Inst::kFlagUseX) != X86Inst::kFlagUseR) ||
+                     (i == 1 && (flags & X86Inst::kFlagUseXX) != 0);
+
+    if (!isWritten)
+      continue;
+
+    if (op.isReg())
+      X86Cse_clobber(ctx, op);
+    else if (op.isMem() && !killsAll)
+      X86Cse_killMem(ctx, op.as<X86Mem>(), op.as<X86Mem>().getSize());
+  }
+
+  if (node->hasExtraReg() && Operand::isPackedId(node->getExtraReg().getId()))
+    X86Cse_setVn(ctx, node->getExtraReg().getId(), ctx.nextVn++);
+}
+
+//! \internal
+//!
+//! Load `dst, [m]` of `size` bytes (`mov`, `movzx`, `movsx`, and SSE moves).
+static Error X86Cse_load(X86CseContext& ctx, CBInst* node, uint32_t keyId, uint32_t size) noexcept {
+  Operand* opArray = node->getOpArray();
+  X86CseKey key;
+
+  if (!X86Cse_memKey(ctx, opArray[1].as<X86Mem>(), size, key)) {
+    X86Cse_clobber(ctx, opArray[0]);
+    return kErrorOk;
+  }
+
+  key.instId = keyId;
+  key.signature = opArray[0].getSignature();
+
+  bool replaced;
+  ASMJIT_PROPAGATE(X86Cse_reuse(ctx, node, key, true, replaced));
+
+  if (replaced)
+    ctx.pass->_loadCount++;
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Store `[m], src` of `size` bytes. If `forward` is true the stored register
+//! is remembered as the content of the memory.
+static Error X86Cse_store(X86CseContext& ctx, CBInst* node, uint32_t keyId, uint32_t size, bool forward) noexcept {
+  Operand* opArray = node->getOpArray();
+  const X86Mem& m = opArray[0].as<X86Mem>();
+
+  X86Cse_killMem(ctx, m, size);
+  if (!forward || !X86Cse_isFullReg(ctx, opArray[1]))
+    return kErrorOk;
+
+  X86CseKey key;
+  if (!X86Cse_memKey(ctx, m, size, key))
+    return kErrorOk;
+
+  key.instId = keyId;
+  key.signature = opArray[1].getSignature();
+
+  uint32_t srcId = opArray[1].getId();
+  uint32_t vn = X86Cse_vnOf(ctx, srcId);
+
+  X86CseEntry* entry = X86Cse_find(ctx, key);
+  if (!entry)
+    return X86Cse_insert(ctx, key, vn, srcId, true, nullptr);
+
+  entry->vn = vn;
+  entry->holder = srcId;
+  entry->isKilled = 0;
+  X86Cse_listLoad(ctx, entry);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `mov`.
+static Error X86Cse_mov(X86CseContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  if (node->getOpCount() != 2) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  const Operand& o0 = opArray[0];
+  const Operand& o1 = opArray[1];
+
+  if (X86Cse_isFullGp(ctx, o0)) {
+    uint32_t dstId = o0.getId();
+
+    if (o1.isMem())
+      return X86Cse_load(ctx, node, X86Inst::kIdMov, o0.as<Reg>().getSize());
+
+    if (o1.isImm()) {
+      X86CseKey key;
+      key.instId = X86Inst::kIdMov;
+      key.signature = o0.getSignature();
+      key.kind = kX86CseKindImm;
+      key.a = 0;
+      key.b = 0;
+      key.reserved = 0;
+      key.imm = o1.as<Imm>().getUInt64();
+
+      // A move from another register is not cheaper than a move of immediate,
+      // the move is only removed if the register already holds the value.
+      X86CseEntry* entry = X86Cse_find(ctx, key);
+      if (!entry) {
+        uint32_t vn = ctx.nextVn++;
+        X86Cse_setVn(ctx, dstId, vn);
+        return X86Cse_insert(ctx, key, vn, dstId, false, nullptr);
+      }
+
+      if (X86Cse_holds(ctx, dstId, entry->vn)) {
+        X86Cse_remove(ctx, node);
+        ctx.pass->_moveCount++;
+        return kErrorOk;
+      }
+
+      entry->holder = dstId;
+      X86Cse_setVn(ctx, dstId, entry->vn);
+      return kErrorOk;
+    }
+
+    if (o1.isVirtReg() && o1.getSignature() == o0.getSignature() && X86Cse_isFullGp(ctx, o1)) {
+      uint32_t vn = X86Cse_vnOf(ctx, o1.getId());
+      if (X86Cse_holds(ctx, dstId, vn)) {
+        X86Cse_remove(ctx, node);
+        ctx.pass->_moveCount++;
+      }
+      else {
+        X86Cse_setVn(ctx, dstId, vn);
+      }
+      return kErrorOk;
+    }
+
+    X86Cse_clobber(ctx, o0);
+    return kErrorOk;
+  }
+
+  if (o0.isMem()) {
+    uint32_t size = o0.as<X86Mem>().getSize();
+    bool forward = false;
+
+    if (o1.isReg()) {
+      size = o1.as<Reg>().getSize();
+      forward = X86Cse_isFullGp(ctx, o1);
+    }
+    return X86Cse_store(ctx, node, X86Inst::kIdMov, size, forward);
+  }
+
+  X86Cse_other(ctx, node);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `movzx|movsx r, [m]`.
+static Error X86Cse_movx(X86CseContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  if (node->getOpCount() != 2 || !X86Cse_isFullGp(ctx, opArray[0]) || !opArray[1].isMem()) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  return X86Cse_load(ctx, node, node->getInstId(), opArray[1].as<X86Mem>().getSize());
+}
+
+//! \internal
+//!
+//! `movaps|movups|movdqa|movdqu|movss|movsd`, loads and stores of XMM.
+static Error X86Cse_movVec(X86CseContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  uint32_t instId = node->getInstId();
+
+  if (node->getOpCount() != 2) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  // Loads and stores of the whole register are the same operation.
+  uint32_t size = 16;
+  uint32_t keyId = X86Inst::kIdMovaps;
+
+  if (instId == X86Inst::kIdMovss) {
+    size = 4;
+    keyId = instId;
+  }
+  else if (instId == X86Inst::kIdMovsd) {
+    size = 8;
+    keyId = instId;
+  }
+
+  if (opArray[1].isMem() && X86Cse_isFullReg(ctx, opArray[0]) && opArray[0].as<Reg>().isReg(X86Reg::kRegXmm))
+    return X86Cse_load(ctx, node, keyId, size);
+
+  // Stores of a part of the register can't be forwarded, a load zeroes the rest.
+  if (opArray[0].isMem())
+    return X86Cse_store(ctx, node, keyId, size, size == 16);
+
+  X86Cse_other(ctx, node);
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `lea r, [m]`.
+static Error X86Cse_lea(X86CseContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  if (node->getOpCount() != 2 || !X86Cse_isFullGp(ctx, opArray[0]) || !opArray[1].isMem()) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  X86CseKey key;
+  if (!X86Cse_memKey(ctx, opArray[1].as<X86Mem>(), 0, key)) {
+    X86Cse_clobber(ctx, opArray[0]);
+    return kErrorOk;
+  }
+
+  key.instId = X86Inst::kIdLea;
+  key.signature = opArray[0].getSignature();
+
+  bool replaced;
+  ASMJIT_PROPAGATE(X86Cse_reuse(ctx, node, key, false, replaced));
+
+  if (replaced)
+    ctx.pass->_exprCount++;
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! `add|sub|and|or|xor|shl|shr|sar|imul r, r|imm`, `imul r, r, imm`, and
+//! `neg|not r`.
+static Error X86Cse_arith(X86CseContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+  uint32_t instId = node->getInstId();
+
+  bool isUnary = instId == X86Inst::kIdNeg || instId == X86Inst::kIdNot;
+  if (opCount != (isUnary ? 1U : 2U) && !(instId == X86Inst::kIdImul && opCount == 3)) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  const Operand& o0 = opArray[0];
+  if (!X86Cse_isFullGp(ctx, o0)) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  X86CseKey key;
+  key.instId = instId;
+  key.signature = o0.getSignature();
+  key.kind = kX86CseKindRegs;
+  key.a = 0;
+  key.b = 0;
+  key.reserved = 0;
+  key.imm = 0;
+
+  if (isUnary) {
+    key.a = X86Cse_vnOf(ctx, o0.getId());
+  }
+  else {
+    const Operand& src = opCount == 3 ? opArray[1] : o0;
+    const Operand& o1 = opArray[opCount - 1];
+
+    if (opCount == 3 && (!o1.isImm() || !src.isVirtReg() || src.getSignature() != o0.getSignature())) {
+      X86Cse_other(ctx, node);
+      return kErrorOk;
+    }
+
+    if (o1.isImm()) {
+      key.kind = kX86CseKindImm | (opCount << kX86CseTypeShift);
+      key.a = X86Cse_vnOf(ctx, src.getId());
+      key.imm = o1.as<Imm>().getUInt64();
+    }
+    else if (o1.isVirtReg() && o1.as<Reg>().isGp()) {
+      // SUB|XOR of the same register is zero, AND|OR keeps its value.
+      if (o1.getId() == o0.getId() && o1.getSignature() == o0.getSignature()) {
+        if (instId == X86Inst::kIdAnd || instId == X86Inst::kIdOr)
+          return kErrorOk;
+
+        if (instId == X86Inst::kIdSub || instId == X86Inst::kIdXor) {
+          key.instId = X86Inst::kIdMov;
+          key.kind = kX86CseKindImm;
+          X86CseEntry* entry = X86Cse_find(ctx, key);
+          if (entry) {
+            X86Cse_setVn(ctx, o0.getId(), entry->vn);
+            entry->holder = o0.getId();
+            return kErrorOk;
+          }
+
+          uint32_t vn = ctx.nextVn++;
+          X86Cse_setVn(ctx, o0.getId(), vn);
+          return X86Cse_insert(ctx, key, vn, o0.getId(), false, nullptr);
+        }
+      }
+
+      uint32_t a = X86Cse_vnOf(ctx, o0.getId());
+      uint32_t b = X86Cse_vnOf(ctx, o1.getId());
+
+      // Operands of commutative operations are sorted.
+      bool isCommutative = instId == X86Inst::kIdAdd || instId == X86Inst::kIdAnd ||
+                           instId == X86Inst::kIdOr  || instId == X86Inst::kIdXor ||
+                           instId == X86Inst::kIdImul;
+      if (isCommutative && o1.getSignature() == o0.getSignature() && b < a)
+        std::swap(a, b);
+
+      key.kind = kX86CseKindRegs | (o1.as<Reg>().getType() << kX86CseTypeShift);
+      key.a = a;
+      key.b = b;
+    }
+    else {
+      X86Cse_other(ctx, node);
+      return kErrorOk;
+    }
+  }
+
+  bool replaced;
+  ASMJIT_PROPAGATE(X86Cse_reuse(ctx, node, key, false, replaced));
+
+  if (replaced)
+    ctx.pass->_exprCount++;
+  return kErrorOk;
+}
+
+//! \internal
+static Error X86Cse_processInst(X86CseContext& ctx, CBInst* node) noexcept {
+  uint32_t instId = node->getInstId();
+
+  if (instId == X86Inst::kIdNone || instId >= X86Inst::_kIdCount || node->hasExtraReg() ||
+      (node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz))) {
+    X86Cse_other(ctx, node);
+    return kErrorOk;
+  }
+
+  switch (instId) {
+    case X86Inst::kIdMov   : return X86Cse_mov(ctx, node);
+
+    case X86Inst::kIdMovzx :
+    case X86Inst::kIdMovsx : return X86Cse_movx(ctx, node);
+
+    case X86Inst::kIdMovaps:
+    case X86Inst::kIdMovups:
+    case X86Inst::kIdMovdqa:
+    case X86Inst::kIdMovdqu:
+    case X86Inst::kIdMovss :
+    case X86Inst::kIdMovsd : return X86Cse_movVec(ctx, node);
+
+    case X86Inst::kIdLea   : return X86Cse_lea(ctx, node);
+
+    case X86Inst::kIdAdd   :
+    case X86Inst::kIdSub   :
+    case X86Inst::kIdAnd   :
+    case X86Inst::kIdOr    :
+    case X86Inst::kIdXor   :
+    case X86Inst::kIdShl   :
+    case X86Inst::kIdShr   :
+    case X86Inst::kIdSar   :
+    case X86Inst::kIdImul  :
+    case X86Inst::kIdNeg   :
+    case X86Inst::kIdNot   : return X86Cse_arith(ctx, node);
+
+    case X86Inst::kIdCmp   :
+    case X86Inst::kIdTest  :
+      // Only read registers and memory.
+      return kErrorOk;
+
+    default:
+      X86Cse_other(ctx, node);
+      return kErrorOk;
+  }
+}
+
+// ============================================================================
+// [asmjit::X86CsePass - Construction / Destruction]
+// ============================================================================
+
+X86CsePass::X86CsePass() noexcept : CBPass("X86Cse") {
+  runAfter("X86ConstFold");
+  runBefore("RA");
+  resetCounts();
+}
+X86CsePass::~X86CsePass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86CsePass - Interface]
+// ============================================================================
+
+Error X86CsePass::process(Zone* zone) noexcept {
+  if (ASMJIT_UNLIKELY(!_cb->isCodeCompiler()))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  X86Compiler* cc = static_cast<X86Compiler*>(_cb);
+  uint32_t count = static_cast<uint32_t>(cc->getVirtRegArray().getLength());
+
+  if (count == 0)
+    return kErrorOk;
+
+  X86CseContext ctx;
+  ctx.cc = cc;
+  ctx.pass = this;
+  ctx.zone = zone;
+  ctx.values = zone->allocZeroedT<X86CseValue>(count * sizeof(X86CseValue));
+  ctx.count = count;
+  ctx.table = zone->allocZeroedT<X86CseEntry>(kX86CseInitialCapacity * sizeof(X86CseEntry));
+  ctx.loads = zone->allocT<uint32_t>(kX86CseInitialCapacity * sizeof(uint32_t));
+  ctx.capacity = kX86CseInitialCapacity;
+  ctx.used = 0;
+  ctx.loadCount = 0;
+  ctx.epoch = 1;
+  ctx.nextVn = 1;
+  ctx.cursor = cc->getCursor();
+
+  if (ASMJIT_UNLIKELY(!ctx.values || !ctx.table || !ctx.loads))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  Error err = kErrorOk;
+  CBNode* node = cc->getFirstNode();
+
+  while (node) {
+    CBNode* next = node->getNext();
+    uint32_t type = node->getType();
+
+    if (type == CBNode::kNodeInst) {
+      err = X86Cse_processInst(ctx, static_cast<CBInst*>(node));
+      if (ASMJIT_UNLIKELY(err)) break;
+    }
+    else if (type != CBNode::kNodeComment && type != CBNode::kNodeHint) {
+      // Labels, functions, calls, and everything else start a new block.
+      X86Cse_newEpoch(ctx);
+    }
+
+    node = next;
+  }
+
+  cc->_setCursor(ctx.cursor);
+  return err;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
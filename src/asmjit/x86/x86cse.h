@@ -0,0 +1,109 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86CSE_H
+#define _ASMJIT_X86_X86CSE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86CsePass]
+// ============================================================================
+
+//! Common subexpression and redundant load elimination (X86/X64).
+//!
+//! The pass is not added automatically and it only works on virtual registers,
+//! so it always runs before the register allocator of \ref X86Compiler (and after "X86ConstFold"), see
+//! \ref CBPass::runBefore().
+//!
+//! The pass numbers values of virtual registers within straight-line code (all
+//! numbers are forgotten at labels, function calls, and other nodes that aren't
+//! instructions). Two instructions that compute the same operation of the same
+//! value numbers (or load the same address) produce the same value, so the
+//! second one is replaced by a move from the register that still holds the
+//! result of the first one. It handles GP loads (`mov`, `movzx`, `movsx`), SSE
+//! loads (`movaps`, `movups`, `movdqa`, `movdqu`, `movss`, `movsd`), `lea`,
+//! and GP arithmetic (`add`, `sub`, `and`, `or`, `xor`, `shl`, `shr`, `sar`,
+//! `imul`, `neg`, `not`). Moves that copy a value the register already holds
+//! are removed.
+//!
+//! Loaded values are forgotten when memory they come from may be written. Two
+//! memory operands don't alias if they use registers of the same value numbers
+//! (or the same label) and access different bytes, otherwise any store between
+//! them is considered to alias. Instructions that are volatile, use implicit
+//! memory operands, or have a LOCK prefix forget all loaded values. A store of
+//! a register is forwarded to a load from the same address.
+//!
+//! Arithmetic is only replaced when the flags it writes are not read before
+//! they are overwritten.
+class ASMJIT_VIRTAPI X86CsePass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86CsePass)
+  typedef CBPass Base;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API X86CsePass() noexcept;
+  ASMJIT_API virtual ~X86CsePass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get the count of eliminated loads (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getLoadCount() const noexcept { return _loadCount; }
+  //! Get the count of eliminated arithmetic instructions (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getExprCount() const noexcept { return _exprCount; }
+  //! Get the count of removed moves (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getMoveCount() const noexcept { return _moveCount; }
+
+  //! Reset all statistics.
+  ASMJIT_INLINE void resetCounts() noexcept {
+    _loadCount = 0;
+    _exprCount = 0;
+    _moveCount = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _loadCount;                   //!< Count of eliminated loads.
+  uint32_t _exprCount;                   //!< Count of eliminated arithmetic instructions.
+  uint32_t _moveCount;                   //!< Count of removed moves.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86CSE_H
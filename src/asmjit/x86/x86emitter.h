@@ -334,6 +334,58 @@ struct X86EmitterExplicitT {
   template<typename T>
   ASMJIT_INLINE Error dstruct(const T& x) { return static_cast<This*>(this)->embed(&x, static_cast<uint32_t>(sizeof(T))); }
 
+  // --------------------------------------------------------------------------
+  // [Patch Sites]
+  // --------------------------------------------------------------------------
+
+  //! Emit a 5-byte NOP that can be later rewritten to `jmp target`, see
+  //! \ref JitRuntime::patchSite(). The label of the site is stored in
+  //! `labelOut` (if not null) and recorded in \ref CodeHolder.
+  ASMJIT_INLINE Error patchSite(Label* labelOut = nullptr) {
+    static const uint8_t nop5[] = { 0x0F, 0x1F, 0x44, 0x00, 0x00 };
+    ASMJIT_PROPAGATE(_beginPatchSite(labelOut));
+    return static_cast<This*>(this)->embed(nop5, 5);
+  }
+
+  //! Emit `call target` that can be later redirected to a different target.
+  //!
+  //! Only direct calls (`Label`, `Imm`, or an absolute address) can be patched.
+  template<typename T>
+  ASMJIT_INLINE Error patchableCall(const T& target, Label* labelOut = nullptr) {
+    ASMJIT_PROPAGATE(_beginPatchSite(labelOut));
+    return static_cast<This*>(this)->long_().call(target);
+  }
+
+  //! Emit `jmp target` that can be later redirected to a different target.
+  //!
+  //! Only direct jumps (`Label`, `Imm`, or an absolute address) can be patched.
+  //! The jump is always emitted in its rel32 form, even if the target is near.
+  template<typename T>
+  ASMJIT_INLINE Error patchableJmp(const T& target, Label* labelOut = nullptr) {
+    ASMJIT_PROPAGATE(_beginPatchSite(labelOut));
+    return static_cast<This*>(this)->long_().jmp(target);
+  }
+
+protected:
+  //! \internal
+  //!
+  //! Align to 8 bytes and bind a new label recorded as a patch site, the
+  //! instruction that follows never crosses an 8-byte boundary.
+  ASMJIT_INLINE Error _beginPatchSite(Label* labelOut) {
+    This* self = static_cast<This*>(this);
+    Label label = self->newLabel();
+
+    if (ASMJIT_UNLIKELY(!label.isValid()))
+      return DebugUtils::errored(kErrorNoHeapMemory);
+
+    ASMJIT_PROPAGATE(self->align(kAlignCode, 8));
+    ASMJIT_PROPAGATE(self->bind(label));
+    ASMJIT_PROPAGATE(self->getCode()->addPatchSite(label.getId()));
+
+    if (labelOut) *labelOut = label;
+    return kErrorOk;
+  }
+
   // --------------------------------------------------------------------------
   // [Options]
   // --------------------------------------------------------------------------
@@ -690,6 +690,7 @@ ASMJIT_FAVOR_SIZE Error X86Internal::initFrameLayout(FuncFrameLayout& layout, co
     layout._calleeStackCleanup = static_cast<uint16_t>(func.getArgStackSize());
 
   // Initialize variables based on FFI flags.
+  layout._patchableEntry = ffi.hasPatchableEntry();
   layout._mmxCleanup = ffi.hasMmxCleanup();
   layout._avxEnabled = ffi.isAvxEnabled();
   layout._avxCleanup = ffi.hasAvxCleanup();
@@ -1031,6 +1032,10 @@ ASMJIT_FAVOR_SIZE Error X86Internal::emitProlog(X86Emitter* emitter, const FuncF
   X86Gp gpReg = emitter->zsp(); // General purpose register (temporary).
   X86Gp saReg = emitter->zsp(); // Stack-arguments base register.
 
+  // Emit: 'nop' patch site that can be redirected by `JitRuntime::redirect()`.
+  if (layout.hasPatchableEntry())
+    ASMJIT_PROPAGATE(emitter->patchSite());
+
   // Emit: 'push zbp'
   //       'mov  zbp, zsp'.
   if (layout.hasPreservedFP()) {
@@ -1347,6 +1352,137 @@ ASMJIT_FAVOR_SIZE Error X86Internal::allocArgs(X86Emitter* emitter, const FuncFr
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86Internal - EmitInst]
+// ============================================================================
+
+#if !defined(ASMJIT_DISABLE_BUILDER)
+static ASMJIT_INLINE bool X86Internal_isJumpInst(uint32_t instId) noexcept {
+  return (instId >= X86Inst::kIdJa   && instId <= X86Inst::kIdJz    ) ||
+         (instId >= X86Inst::kIdLoop && instId <= X86Inst::kIdLoopne) ;
+}
+
+Error X86Internal::emitInst(CodeBuilder* cb, uint32_t instId,
+  const Operand_& o0, const Operand_& o1, const Operand_& o2,
+  const Operand_& o3, const Operand_& o4, const Operand_& o5) {
+
+  uint32_t options = cb->getOptions() | cb->getGlobalOptions();
+  const char* inlineComment = cb->getInlineComment();
+
+  uint32_t opCount = static_cast<uint32_t>(!o0.isNone()) +
+                     static_cast<uint32_t>(!o1.isNone()) +
+                     static_cast<uint32_t>(!o2.isNone()) +
+                     static_cast<uint32_t>(!o3.isNone()) ;
+
+  // Count 5th and 6th operands.
+  if (!o4.isNone()) opCount = 5;
+  if (!o5.isNone()) opCount = 6;
+
+  // Handle failure and rare cases first.
+  const uint32_t kErrorsAndSpecialCases = CodeEmitter::kOptionMaybeFailureCase | // CodeEmitter in error state.
+                                          CodeEmitter::kOptionStrictValidation ; // Strict validation.
+
+  if (ASMJIT_UNLIKELY(options & kErrorsAndSpecialCases)) {
+    // Don't do anything if we are in error state.
+    if (cb->_lastError) return cb->_lastError;
+
+#if !defined(ASMJIT_DISABLE_VALIDATION)
+    // Strict validation.
+    if (options & CodeEmitter::kOptionStrictValidation) {
+      Operand opArray[] = {
+        Operand(o0),
+        Operand(o1),
+        Operand(o2),
+        Operand(o3),
+        Operand(o4),
+        Operand(o5)
+      };
+
+      Inst::Detail instDetail(instId, options, cb->_extraReg);
+      Error err = Inst::validate(cb->getArchType(), instDetail, opArray, opCount);
+
+      if (err) {
+#if !defined(ASMJIT_DISABLE_LOGGING)
+        StringBuilderTmp<256> sb;
+        sb.appendString(DebugUtils::errorAsString(err));
+        sb.appendString(": ");
+        Logging::formatInstruction(sb, 0, cb, cb->getArchType(), instDetail, opArray, opCount);
+        return cb->setLastError(err, sb.getData());
+#else
+        return cb->setLastError(err);
+#endif
+      }
+
+      // Clear it as it must be enabled explicitly on assembler side.
+      options &= ~CodeEmitter::kOptionStrictValidation;
+    }
+#endif // ASMJIT_DISABLE_VALIDATION
+  }
+
+  cb->resetOptions();
+  cb->resetInlineComment();
+
+  // Decide between `CBInst` and `CBJump`.
+  size_t nodeSize = X86Internal_isJumpInst(instId) ? sizeof(CBJump) : sizeof(CBInst);
+  CBInst* node = cb->_cbHeap.allocT<CBInst>(nodeSize + opCount * sizeof(Operand));
+
+  if (ASMJIT_UNLIKELY(!node))
+    return cb->setLastError(DebugUtils::errored(kErrorNoHeapMemory));
+
+  Operand* opArray = reinterpret_cast<Operand*>(reinterpret_cast<uint8_t*>(node) + nodeSize);
+  if (opCount > 0) opArray[0].copyFrom(o0);
+  if (opCount > 1) opArray[1].copyFrom(o1);
+  if (opCount > 2) opArray[2].copyFrom(o2);
+  if (opCount > 3) opArray[3].copyFrom(o3);
+  if (opCount > 4) opArray[4].copyFrom(o4);
+  if (opCount > 5) opArray[5].copyFrom(o5);
+
+  if (nodeSize == sizeof(CBJump)) {
+    CBJump* jNode = new(node) CBJump(cb, instId, options, opArray, opCount);
+    CBLabel* jTarget = nullptr;
+
+    if (!(options & CodeEmitter::kOptionUnfollow)) {
+      if (opArray[0].isLabel()) {
+        Error err = cb->getCBLabel(&jTarget, static_cast<Label&>(opArray[0]));
+        if (err) return cb->setLastError(err);
+      }
+      else {
+        options |= CodeEmitter::kOptionUnfollow;
+      }
+    }
+    jNode->setOptions(options);
+
+    jNode->orFlags(instId == X86Inst::kIdJmp ? CBNode::kFlagIsJmp | CBNode::kFlagIsTaken : CBNode::kFlagIsJcc);
+    jNode->_target = jTarget;
+    jNode->_jumpNext = nullptr;
+
+    if (jTarget) {
+      jNode->_jumpNext = static_cast<CBJump*>(jTarget->_from);
+      jTarget->_from = jNode;
+      jTarget->addNumRefs();
+    }
+
+    // The 'jmp' is always taken, conditional jump can contain hint, we detect it.
+    if (options & X86Inst::kOptionTaken)
+      jNode->orFlags(CBNode::kFlagIsTaken);
+  }
+  else {
+    new(node) CBInst(cb, instId, options, opArray, opCount);
+  }
+
+  node->_instDetail.extraReg = cb->_extraReg;
+  cb->_extraReg.reset();
+
+  if (inlineComment) {
+    inlineComment = static_cast<char*>(cb->_cbDataZone.dup(inlineComment, ::strlen(inlineComment), true));
+    node->setInlineComment(inlineComment);
+  }
+
+  cb->addNode(node);
+  return kErrorOk;
+}
+#endif // !ASMJIT_DISABLE_BUILDER
+
 } // asmjit namespace
 
 // [Api-End]
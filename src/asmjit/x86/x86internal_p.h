@@ -11,6 +11,7 @@
 #include "../asmjit_build.h"
 
 // [Dependencies]
+#include "../base/codebuilder.h"
 #include "../base/func.h"
 #include "../x86/x86emitter.h"
 #include "../x86/x86operand.h"
@@ -66,6 +67,14 @@ struct X86Internal {
     const Operand_& src_, uint32_t srcTypeId, bool avxEnabled, const char* comment = nullptr);
 
   static Error allocArgs(X86Emitter* emitter, const FuncFrameLayout& layout, const FuncArgsMapper& args);
+
+#if !defined(ASMJIT_DISABLE_BUILDER)
+  //! Add an instruction to `cb` as \ref CBInst (or \ref CBJump if it's a jump),
+  //! implements `_emit()` of both `X86Builder` and `X86Compiler`.
+  static Error emitInst(CodeBuilder* cb, uint32_t instId,
+    const Operand_& o0, const Operand_& o1, const Operand_& o2,
+    const Operand_& o3, const Operand_& o4, const Operand_& o5);
+#endif // !ASMJIT_DISABLE_BUILDER
 };
 
 //! \}
@@ -0,0 +1,1038 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/cfg.h"
+#include "../x86/x86compiler.h"
+#include "../x86/x86inst.h"
+#include "../x86/x86licm.h"
+#include "../x86/x86passutils_p.h"
+#include "../x86/x86regalloc_p.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86LicmPass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Maximum count of instructions of a loop, larger loops are not processed.
+static const uint32_t kX86LicmMaxInsts = 1024;
+
+//! \internal
+//!
+//! Maximum count of stores of a loop, a loop that has more clobbers all memory
+//! (an instruction can write more than one memory operand, like MOVS).
+static const uint32_t kX86LicmMaxStores = kX86LicmMaxInsts;
+
+//! \internal
+//!
+//! Maximum count of instructions that write the same register and are hoisted
+//! together.
+static const uint32_t kX86LicmMaxChain = 8;
+
+//! \internal
+//!
+//! Count of registers kept for temporaries of the loop body when estimating
+//! register pressure.
+static const uint32_t kX86LicmReservedRegs = 2;
+
+//! \internal
+//!
+//! State of an instruction in a loop.
+enum X86LicmState {
+  kX86LicmStateNone      = 0,            //!< Instruction stays in the loop (for now).
+  kX86LicmStateHoisted   = 1,            //!< Instruction is hoisted.
+  kX86LicmStateRejected  = 2             //!< Instruction is invariant, but there is no free register.
+};
+
+//! \internal
+//!
+//! Properties of an instruction that can be hoisted.
+struct X86LicmInstInfo {
+  uint32_t useFlags;                     //!< Use of the first operand (`kFlagUseW` or `kFlagUseX`).
+  uint32_t flagsW;                       //!< Status flags written.
+  bool readsMem;                         //!< Instruction reads memory.
+};
+
+//! \internal
+struct X86LicmContext {
+  X86Compiler* cc;                       //!< Compiler being processed.
+  X86LicmPass* pass;                     //!< Pass (statistics).
+  Zone* zone;                            //!< Zone used for all allocations.
+  CBCfg* cfg;                            //!< Control-flow graph of the current loop.
+
+  uint32_t count;                        //!< Count of virtual registers.
+  uint32_t* totalRefs;                   //!< References of virtual registers (all code).
+  uint32_t* loopRefs;                    //!< References of virtual registers (current loop).
+  uint32_t* loopDefs;                    //!< Writes of virtual registers (current loop).
+  uint32_t* regStamps;                   //!< Stamps of virtual registers (pressure).
+
+  uint32_t blockCapacity;                //!< Capacity of block arrays.
+  uint32_t* blockStamps;                 //!< Stamps of blocks (loop membership).
+  CBBlock** loopBlocks;                  //!< Blocks of the current loop.
+  CBBlock** exitBlocks;                  //!< Blocks of the current loop that can leave it.
+  uint32_t loopBlockCount;               //!< Count of `loopBlocks`.
+  uint32_t exitBlockCount;               //!< Count of `exitBlocks`.
+  uint32_t stamp;                        //!< Current stamp.
+
+  CBInst** insts;                        //!< Instructions of the current loop.
+  CBBlock** instBlocks;                  //!< Block of each instruction.
+  uint8_t* instStates;                   //!< State of each instruction, see \ref X86LicmState.
+  uint32_t* hoisted;                     //!< Indexes of hoisted instructions (in hoisting order).
+  uint32_t instCount;                    //!< Count of `insts`.
+  uint32_t hoistedCount;                 //!< Count of `hoisted`.
+
+  const X86Mem** stores;                 //!< Memory written in the current loop.
+  uint32_t* storeSizes;                  //!< Size of each store (0 if unknown).
+  uint32_t storeCount;                   //!< Count of `stores`.
+  bool clobbersAll;                      //!< The loop writes memory that can't be described.
+
+  uint32_t liveFlags;                    //!< Status flags alive at the loop header.
+  uint32_t avail[Globals::kMaxVRegKinds];//!< Allocable registers of each kind.
+  uint32_t live[Globals::kMaxVRegKinds]; //!< Registers alive across the loop of each kind.
+};
+
+//! \internal
+static ASMJIT_INLINE uint32_t* X86Licm_refOf(uint32_t* refs, uint32_t count, uint32_t id) noexcept {
+  if (!Operand::isPackedId(id))
+    return nullptr;
+
+  uint32_t index = Operand::unpackId(id);
+  return index < count ? &refs[index] : static_cast<uint32_t*>(nullptr);
+}
+
+//! \internal
+static ASMJIT_INLINE void X86Licm_addRef(uint32_t* refs, uint32_t count, uint32_t id) noexcept {
+  uint32_t* p = X86Licm_refOf(refs, count, id);
+  if (p) (*p)++;
+}
+
+//! \internal
+//!
+//! Add references of virtual registers used by `op` to `refs`.
+static void X86Licm_addOpRefs(uint32_t* refs, uint32_t count, const Operand& op) noexcept {
+  if (op.isReg()) {
+    X86Licm_addRef(refs, count, op.getId());
+  }
+  else if (op.isMem()) {
+    const X86Mem& m = op.as<X86Mem>();
+    if (m.hasBaseReg()) X86Licm_addRef(refs, count, m.getBaseId());
+    if (m.hasIndexReg()) X86Licm_addRef(refs, count, m.getIndexId());
+  }
+}
+
+//! \internal
+//!
+//! Add references of virtual registers used by `node` to `refs`.
+static void X86Licm_addNodeRefs(uint32_t* refs, uint32_t count, CBNode* node_) noexcept {
+  switch (node_->getType()) {
+    case CBNode::kNodeFuncCall: {
+      CCFuncCall* node = static_cast<CCFuncCall*>(node_);
+      X86Licm_addOpRefs(refs, count, node->getRet(0));
+      X86Licm_addOpRefs(refs, count, node->getRet(1));
+
+      if (node->_args) {
+        uint32_t argCount = node->getDetail().getArgCount();
+        for (uint32_t i = 0; i < argCount; i++)
+          X86Licm_addOpRefs(refs, count, node->getArg(i));
+      }
+      ASMJIT_FALLTHROUGH;
+    }
+
+    case CBNode::kNodeInst: {
+      CBInst* node = static_cast<CBInst*>(node_);
+      Operand* opArray = node->getOpArray();
+      uint32_t opCount = node->getOpCount();
+
+      for (uint32_t i = 0; i < opCount; i++)
+        X86Licm_addOpRefs(refs, count, opArray[i]);
+
+      if (node->hasExtraReg())
+        X86Licm_addRef(refs, count, node->getExtraReg().getId());
+      break;
+    }
+
+    case CBNode::kNodeFuncExit: {
+      CCFuncRet* node = static_cast<CCFuncRet*>(node_);
+      X86Licm_addOpRefs(refs, count, node->getFirst());
+      X86Licm_addOpRefs(refs, count, node->getSecond());
+      break;
+    }
+
+    case CBNode::kNodeFunc: {
+      CCFunc* node = static_cast<CCFunc*>(node_);
+      uint32_t argCount = node->getArgCount();
+
+      for (uint32_t i = 0; i < argCount; i++) {
+        VirtReg* vreg = node->getArg(i);
+        if (vreg) X86Licm_addRef(refs, count, vreg->getId());
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+//! \internal
+//!
+//! Get whether `node` references virtual register `id`.
+static bool X86Licm_refsReg(const CBInst* node, uint32_t id) noexcept {
+  const Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    if (op.isReg()) {
+      if (op.getId() == id) return true;
+    }
+    else if (op.isMem()) {
+      const X86Mem& m = op.as<X86Mem>();
+      if (m.hasBaseReg() && m.getBaseId() == id) return true;
+      if (m.hasIndexReg() && m.getIndexId() == id) return true;
+    }
+  }
+
+  return node->hasExtraReg() && node->getExtraReg().getId() == id;
+}
+
+//! \internal
+//!
+//! Get the function that contains `node`.
+static CCFunc* X86Licm_getFunc(CBNode* node) noexcept {
+  while (node && node->getType() != CBNode::kNodeFunc)
+    node = node->getPrev();
+  return static_cast<CCFunc*>(node);
+}
+
+//! \internal
+//!
+//! Get status flags alive before `node`, which are read before they are
+//! written on the fall-through path. Flags not decided before a jump or a
+//! node that isn't an instruction are considered alive, except at the end
+//! of the function.
+static uint32_t X86Licm_getLiveFlags(CBNode* node) noexcept {
+  uint32_t undecided = X86PassUtils::kStatusFlags;
+  uint32_t live = 0;
+
+  for (; node; node = node->getNext()) {
+    uint32_t type = node->getType();
+    if (type == CBNode::kNodeComment || type == CBNode::kNodeHint ||
+        type == CBNode::kNodeLabel   || type == CBNode::kNodeAlign)
+      continue;
+
+    if (type == CBNode::kNodeFuncExit || type == CBNode::kNodeSentinel)
+      return live;
+
+    if (type != CBNode::kNodeInst)
+      break;
+
+    uint32_t instId = static_cast<CBInst*>(node)->getInstId();
+    if (instId == X86Inst::kIdNone || instId >= X86Inst::_kIdCount)
+      break;
+
+    const X86Inst::OperationData& opData = X86Inst::getInst(instId).getOperationData();
+    uint32_t r = opData.getSpecialRegsR() & undecided;
+
+    live |= r;
+    undecided &= ~(r | opData.getSpecialRegsW());
+
+    if (!undecided)
+      return live;
+
+    if (node->isJmpOrJcc() || node->isRet())
+      break;
+  }
+
+  return live | undecided;
+}
+
+//! \internal
+//!
+//! Get whether `node` can be hoisted as far as the instruction itself is
+//! concerned (operands are checked separately) and fill `info`.
+static bool X86Licm_analyze(CBInst* node, X86LicmInstInfo& info) noexcept {
+  uint32_t instId = node->getInstId();
+  uint32_t opCount = node->getOpCount();
+
+  if (instId == X86Inst::kIdNone || instId >= X86Inst::_kIdCount || opCount == 0 ||
+      node->isJmpOrJcc() || node->hasExtraReg() ||
+      (node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz)))
+    return false;
+
+  const X86Inst& inst = X86Inst::getInst(instId);
+  const X86Inst::CommonData& commonData = inst.getCommonData();
+  const X86Inst::OperationData& opData = inst.getOperationData();
+
+  uint32_t flags = commonData.getFlags();
+  if ((flags & (X86Inst::kFlagUseA | X86Inst::kFlagUseXX)) ||
+      commonData.hasFixedRM() || commonData.hasFixedMem() ||
+      commonData.isFpu() || commonData.isMmx() || commonData.doesJump() ||
+      opData.isVolatile() || opData.isBarrier() || opData.isPrivileged() || opData.isPrefetch())
+    return false;
+
+  if (opData.getSpecialRegsR() || (opData.getSpecialRegsW() & ~X86PassUtils::kStatusFlags))
+    return false;
+
+  uint32_t useFlags = flags & X86Inst::kFlagUseX;
+  if (useFlags != X86Inst::kFlagUseW && useFlags != X86Inst::kFlagUseX)
+    return false;
+
+  Operand* opArray = node->getOpArray();
+  if (!opArray[0].isReg())
+    return false;
+
+  bool readsMem = false;
+  for (uint32_t i = 1; i < opCount; i++)
+    readsMem |= opArray[i].isMem();
+
+  info.useFlags = useFlags;
+  info.flagsW = opData.getSpecialRegsW();
+  info.readsMem = readsMem && instId != X86Inst::kIdLea;
+  return true;
+}
+
+//! \internal
+//!
+//! Get the kind of `op` if it's a virtual GP or vector register that covers
+//! the whole virtual register, otherwise `kInvalidValue`.
+static uint32_t X86Licm_getFullRegKind(const X86LicmContext& ctx, const Operand& op) noexcept {
+  if (!op.isVirtReg())
+    return kInvalidValue;
+
+  VirtReg* vreg = ctx.cc->getVirtRegById(op.getId());
+  uint32_t kind = vreg->getKind();
+
+  if ((kind != X86Reg::kKindGp && kind != X86Reg::kKindVec) || vreg->getSize() != op.getSize())
+    return kInvalidValue;
+
+  return kind;
+}
+
+//! \internal
+//!
+//! Get whether memory operands `a` of `aSize` bytes and `b` of `bSize` bytes
+//! may overlap.
+static bool X86Licm_mayAlias(const X86Mem& a, uint32_t aSize, const X86Mem& b, uint32_t bSize) noexcept {
+  if (a.hasSegment() || b.hasSegment() || !aSize || !bSize)
+    return true;
+
+  if (a.hasBase() != b.hasBase() || a.getBaseType() != b.getBaseType() || a.getBaseId() != b.getBaseId())
+    return true;
+
+  if (a.hasBaseReg() && (!Operand::isPackedId(a.getBaseId()) || a.getBaseType() == X86Reg::kRegRip))
+    return true;
+
+  if (a.hasIndex() != b.hasIndex())
+    return true;
+
+  if (a.hasIndex()) {
+    if (a.getIndexType() != b.getIndexType() || a.getIndexId() != b.getIndexId() || a.getShift() != b.getShift())
+      return true;
+    if (!Operand::isPackedId(a.getIndexId()))
+      return true;
+  }
+
+  int64_t aOffset = a.getOffset();
+  int64_t bOffset = b.getOffset();
+  return aOffset < bOffset + int64_t(bSize) && bOffset < aOffset + int64_t(aSize);
+}
+
+//! \internal
+//!
+//! Get whether `op` is not changed by the current loop. Instructions already
+//! hoisted don't count as writes.
+static bool X86Licm_isInvariant(const X86LicmContext& ctx, const Operand& op, uint32_t memSize) noexcept {
+  if (op.isReg()) {
+    uint32_t* p = X86Licm_refOf(ctx.loopDefs, ctx.count, op.getId());
+    return p && *p == 0;
+  }
+
+  if (op.isMem()) {
+    const X86Mem& m = op.as<X86Mem>();
+    if (m.hasSegment())
+      return false;
+
+    if (m.hasBaseReg()) {
+      uint32_t* p = X86Licm_refOf(ctx.loopDefs, ctx.count, m.getBaseId());
+      if (!p || *p != 0) return false;
+    }
+
+    if (m.hasIndexReg()) {
+      uint32_t* p = X86Licm_refOf(ctx.loopDefs, ctx.count, m.getIndexId());
+      if (!p || *p != 0) return false;
+    }
+
+    // Address only (LEA).
+    if (memSize == kInvalidValue)
+      return true;
+
+    if (ctx.clobbersAll)
+      return false;
+
+    for (uint32_t i = 0; i < ctx.storeCount; i++)
+      if (X86Licm_mayAlias(m, memSize, *ctx.stores[i], ctx.storeSizes[i]))
+        return false;
+  }
+
+  return true;
+}
+
+//! \internal
+//!
+//! Get whether block `block` of the current loop is executed before the loop
+//! can be left.
+static bool X86Licm_isGuaranteed(const X86LicmContext& ctx, const CBBlock* block) noexcept {
+  for (uint32_t i = 0; i < ctx.exitBlockCount; i++)
+    if (!ctx.cfg->dominates(block, ctx.exitBlocks[i]))
+      return false;
+  return true;
+}
+
+//! \internal
+//!
+//! Add writes of `node` (in the current loop) to `loopDefs` and memory it
+//! writes to the list of stores.
+static void X86Licm_addDefs(X86LicmContext& ctx, CBInst* node) noexcept {
+  uint32_t instId = node->getInstId();
+  Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  bool writesAll = true;
+  uint32_t flags = 0;
+
+  if (instId != X86Inst::kIdNone && instId < X86Inst::_kIdCount) {
+    const X86Inst& inst = X86Inst::getInst(instId);
+    const X86Inst::CommonData& commonData = inst.getCommonData();
+    const X86Inst::OperationData& opData = inst.getOperationData();
+
+    flags = commonData.getFlags();
+    writesAll = commonData.hasFixedRM() || (flags & X86Inst::kFlagUseA) != 0;
+
+    // IMUL only writes implicit registers in its single-operand form.
+    if (instId == X86Inst::kIdImul && opCount >= 2) {
+      flags = X86Inst::kFlagUseX;
+      writesAll = false;
+    }
+
+    // Jumps are volatile, but they don't write memory.
+    if (commonData.hasFixedMem() || opData.isBarrier() || opData.isPrivileged() ||
+        (opData.isVolatile() && !node->isJmpOrJcc()))
+      ctx.clobbersAll = true;
+  }
+  else {
+    ctx.clobbersAll = true;
+  }
+
+  if (node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz))
+    ctx.clobbersAll = true;
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    bool isWritten = writesAll ||
+                     (i == 0 && (flags & X86Inst::kFlagUseX) != X86Inst::kFlagUseR) ||
+                     (i == 1 && (flags & X86Inst::kFlagUseXX) != 0);
+
+    if (!isWritten)
+      continue;
+
+    if (op.isReg()) {
+      X86Licm_addRef(ctx.loopDefs, ctx.count, op.getId());
+    }
+    else if (op.isMem() && instId != X86Inst::kIdLea) {
+      const X86Mem& m = op.as<X86Mem>();
+      uint32_t size = m.getSize();
+
+      if (!size && i == 0 && opCount > 1 && opArray[1].isReg())
+        size = opArray[1].getSize();
+
+      if (ctx.storeCount == kX86LicmMaxStores) {
+        ctx.clobbersAll = true;
+        continue;
+      }
+
+      ctx.stores[ctx.storeCount] = &m;
+      ctx.storeSizes[ctx.storeCount] = size;
+      ctx.storeCount++;
+    }
+  }
+
+  if (node->hasExtraReg())
+    X86Licm_addRef(ctx.loopDefs, ctx.count, node->getExtraReg().getId());
+}
+
+//! \internal
+//!
+//! Clear loop counters of all registers referenced by `node`.
+static void X86Licm_clearRefs(X86LicmContext& ctx, CBInst* node) noexcept {
+  Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    uint32_t ids[2] = { kInvalidValue, kInvalidValue };
+
+    if (op.isReg()) {
+      ids[0] = op.getId();
+    }
+    else if (op.isMem()) {
+      const X86Mem& m = op.as<X86Mem>();
+      if (m.hasBaseReg()) ids[0] = m.getBaseId();
+      if (m.hasIndexReg()) ids[1] = m.getIndexId();
+    }
+
+    for (uint32_t j = 0; j < 2; j++) {
+      uint32_t* p = X86Licm_refOf(ctx.loopRefs, ctx.count, ids[j]);
+      if (!p) continue;
+
+      uint32_t index = static_cast<uint32_t>(p - ctx.loopRefs);
+      ctx.loopRefs[index] = 0;
+      ctx.loopDefs[index] = 0;
+    }
+  }
+
+  if (node->hasExtraReg()) {
+    uint32_t* p = X86Licm_refOf(ctx.loopRefs, ctx.count, node->getExtraReg().getId());
+    if (p) {
+      uint32_t index = static_cast<uint32_t>(p - ctx.loopRefs);
+      ctx.loopRefs[index] = 0;
+      ctx.loopDefs[index] = 0;
+    }
+  }
+}
+
+//! \internal
+//!
+//! Count virtual register `id` as alive across the current loop if it's also
+//! used outside of it (each register is counted once per `stamp`).
+static void X86Licm_addLive(X86LicmContext& ctx, uint32_t id, uint32_t stamp) noexcept {
+  if (!Operand::isPackedId(id))
+    return;
+
+  uint32_t vIndex = Operand::unpackId(id);
+  if (vIndex >= ctx.count || ctx.regStamps[vIndex] == stamp)
+    return;
+
+  ctx.regStamps[vIndex] = stamp;
+  if (ctx.totalRefs[vIndex] != ctx.loopRefs[vIndex]) {
+    uint32_t kind = ctx.cc->getVirtRegById(id)->getKind();
+    if (kind < Globals::kMaxVRegKinds)
+      ctx.live[kind]++;
+  }
+}
+
+//! \internal
+//!
+//! Make sure that block arrays can hold `count` blocks.
+static Error X86Licm_reserveBlocks(X86LicmContext& ctx, uint32_t count) noexcept {
+  if (count <= ctx.blockCapacity)
+    return kErrorOk;
+
+  uint32_t capacity = Utils::alignTo<uint32_t>(count, 64);
+  uint32_t* blockStamps = ctx.zone->allocZeroedT<uint32_t>(capacity * sizeof(uint32_t));
+  CBBlock** loopBlocks = ctx.zone->allocT<CBBlock*>(capacity * sizeof(CBBlock*));
+  CBBlock** exitBlocks = ctx.zone->allocT<CBBlock*>(capacity * sizeof(CBBlock*));
+
+  if (ASMJIT_UNLIKELY(!blockStamps || !loopBlocks || !exitBlocks))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  ctx.blockCapacity = capacity;
+  ctx.blockStamps = blockStamps;
+  ctx.loopBlocks = loopBlocks;
+  ctx.exitBlocks = exitBlocks;
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86LicmPass - Hoisting]
+// ============================================================================
+
+//! \internal
+//!
+//! Try to hoist the instruction at `index` (together with instructions that
+//! modify the register it writes). Returns true if it was marked as hoisted.
+static bool X86Licm_tryHoist(X86LicmContext& ctx, uint32_t index) noexcept {
+  CBInst* node = ctx.insts[index];
+  CBBlock* block = ctx.instBlocks[index];
+
+  X86LicmInstInfo info;
+  if (!X86Licm_analyze(node, info) || info.useFlags != X86Inst::kFlagUseW)
+    return false;
+
+  const Operand& dst = node->getOpArray()[0];
+  uint32_t kind = X86Licm_getFullRegKind(ctx, dst);
+  if (kind == kInvalidValue)
+    return false;
+
+  uint32_t id = dst.getId();
+  uint32_t vIndex = Operand::unpackId(id);
+  uint32_t defCount = ctx.loopDefs[vIndex];
+
+  if (defCount == 0 || defCount > kX86LicmMaxChain)
+    return false;
+
+  // Collect the chain of instructions that write the register, the first one
+  // initializes it and the others modify it, all in the same block without any
+  // other use of the register between them.
+  uint32_t chain[kX86LicmMaxChain];
+  uint32_t chainLength = 1;
+  uint32_t flagsW = info.flagsW;
+  bool readsMem = info.readsMem;
+
+  chain[0] = index;
+  uint32_t i = index + 1;
+
+  while (chainLength < defCount) {
+    if (i >= ctx.instCount || ctx.instBlocks[i] != block)
+      return false;
+
+    CBInst* member = ctx.insts[i];
+    if (ctx.instStates[i] == kX86LicmStateNone && X86Licm_refsReg(member, id)) {
+      X86LicmInstInfo memberInfo;
+      if (!X86Licm_analyze(member, memberInfo) || memberInfo.useFlags != X86Inst::kFlagUseX)
+        return false;
+
+      const Operand* opArray = member->getOpArray();
+      if (opArray[0].getId() != id || opArray[0].getSignature() != dst.getSignature())
+        return false;
+
+      for (uint32_t j = 1; j < member->getOpCount(); j++) {
+        const Operand& op = opArray[j];
+        if ((op.isReg() && op.getId() == id) ||
+            (op.isMem() && ((op.as<X86Mem>().hasBaseReg() && op.as<X86Mem>().getBaseId() == id) ||
+                            (op.as<X86Mem>().hasIndexReg() && op.as<X86Mem>().getIndexId() == id))))
+          return false;
+      }
+
+      chain[chainLength++] = i;
+      flagsW |= memberInfo.flagsW;
+      readsMem |= memberInfo.readsMem;
+    }
+
+    i++;
+  }
+
+  // All operands read by the chain must be invariant.
+  for (uint32_t c = 0; c < chainLength; c++) {
+    CBInst* member = ctx.insts[chain[c]];
+    const Operand* opArray = member->getOpArray();
+    uint32_t opCount = member->getOpCount();
+
+    for (uint32_t j = 1; j < opCount; j++) {
+      const Operand& op = opArray[j];
+      uint32_t memSize = kInvalidValue;
+
+      if (op.isMem() && member->getInstId() != X86Inst::kIdLea) {
+        memSize = op.as<X86Mem>().getSize();
+        if (!memSize) memSize = dst.getSize();
+      }
+
+      if (!X86Licm_isInvariant(ctx, op, memSize))
+        return false;
+    }
+
+    // Flags written by the chain must not be read in the loop, nor after it
+    // is hoisted.
+    uint32_t memberFlags = X86Inst::getInst(member->getInstId()).getOperationData().getSpecialRegsW();
+    if (memberFlags && (X86Licm_getLiveFlags(member->getNext()) & memberFlags))
+      return false;
+  }
+
+  if (flagsW & ctx.liveFlags)
+    return false;
+
+  // All other uses of the register must follow the chain.
+  uint32_t last = chain[chainLength - 1];
+  for (i = 0; i < ctx.instCount; i++) {
+    if (ctx.instStates[i] == kX86LicmStateHoisted || !X86Licm_refsReg(ctx.insts[i], id))
+      continue;
+
+    CBBlock* useBlock = ctx.instBlocks[i];
+    if (useBlock == block) {
+      if (i < index)
+        return false;
+      if (i > index && i < last) {
+        bool isMember = false;
+        for (uint32_t c = 0; c < chainLength; c++)
+          isMember |= chain[c] == i;
+        if (!isMember) return false;
+      }
+    }
+    else if (!ctx.cfg->dominates(block, useBlock)) {
+      return false;
+    }
+  }
+
+  // Loads can fault, they are only hoisted from blocks executed whenever the
+  // loop is entered. Other instructions can be speculated if the register is
+  // not used outside of the loop.
+  bool isGuaranteed = X86Licm_isGuaranteed(ctx, block);
+  bool isLocal = ctx.totalRefs[vIndex] == ctx.loopRefs[vIndex];
+
+  if (readsMem ? !isGuaranteed : (!isGuaranteed && !isLocal))
+    return false;
+
+  // A register only used by the loop becomes alive across it.
+  if (isLocal) {
+    uint32_t avail = ctx.avail[kind];
+    if (ctx.live[kind] + 1 + kX86LicmReservedRegs > avail) {
+      ctx.instStates[index] = kX86LicmStateRejected;
+      ctx.pass->_pressureCount++;
+      return false;
+    }
+    ctx.live[kind]++;
+  }
+
+  for (uint32_t c = 0; c < chainLength; c++) {
+    ctx.instStates[chain[c]] = kX86LicmStateHoisted;
+    ctx.hoisted[ctx.hoistedCount++] = chain[c];
+  }
+
+  ctx.loopDefs[vIndex] = 0;
+  return true;
+}
+
+//! \internal
+//!
+//! Process the loop of `header`.
+static Error X86Licm_processLoop(X86LicmContext& ctx, CBBlock* header) noexcept {
+  CBCfg* cfg = ctx.cfg;
+  uint32_t blockCount = static_cast<uint32_t>(cfg->getBlocks().getLength());
+  ASMJIT_PROPAGATE(X86Licm_reserveBlocks(ctx, blockCount));
+
+  // --------------------------------------------------------------------------
+  // [Blocks]
+  // --------------------------------------------------------------------------
+
+  // The loop body is formed by blocks that reach a back-edge without passing
+  // through the header.
+  uint32_t stamp = ++ctx.stamp;
+  uint32_t n = 0;
+  uint32_t wl = 0;
+  CBBlock** workList = ctx.exitBlocks;
+
+  ctx.blockStamps[header->getId()] = stamp;
+  ctx.loopBlocks[n++] = header;
+
+  const ZoneVector<CBBlock*>& headerPreds = header->getPredecessors();
+  for (size_t i = 0; i < headerPreds.getLength(); i++) {
+    CBBlock* pred = headerPreds[i];
+    if (!cfg->dominates(header, pred) || ctx.blockStamps[pred->getId()] == stamp)
+      continue;
+
+    ctx.blockStamps[pred->getId()] = stamp;
+    workList[wl++] = pred;
+  }
+
+  while (wl) {
+    CBBlock* block = workList[--wl];
+    ctx.loopBlocks[n++] = block;
+
+    const ZoneVector<CBBlock*>& preds = block->getPredecessors();
+    for (size_t i = 0; i < preds.getLength(); i++) {
+      CBBlock* pred = preds[i];
+      if (!pred->isReachable() || ctx.blockStamps[pred->getId()] == stamp)
+        continue;
+
+      ctx.blockStamps[pred->getId()] = stamp;
+      workList[wl++] = pred;
+    }
+  }
+  ctx.loopBlockCount = n;
+
+  // --------------------------------------------------------------------------
+  // [Preheader]
+  // --------------------------------------------------------------------------
+
+  CBBlock* preheader = nullptr;
+  for (size_t i = 0; i < headerPreds.getLength(); i++) {
+    CBBlock* pred = headerPreds[i];
+    if (ctx.blockStamps[pred->getId()] == stamp)
+      continue;
+
+    if (preheader)
+      return kErrorOk;
+    preheader = pred;
+  }
+
+  if (!preheader || preheader->hasFlag(CBBlock::kFlagHasIndirect))
+    return kErrorOk;
+
+  CBNode* last = preheader->getLast();
+  CBNode* before = nullptr;
+
+  if (last->isJmpOrJcc() && !last->isJcc()) {
+    // Unconditional jump to the header, hoisted code goes before it.
+    CBLabel* target = static_cast<CBJump*>(last)->getTarget();
+    if (!target || cfg->getBlockByLabel(target->getId()) != header)
+      return kErrorOk;
+    before = last;
+  }
+  else {
+    // Fall-through (after a conditional jump somewhere else), hoisted code goes
+    // before the header and its alignment.
+    if (last->isRet() || preheader->getId() + 1 != header->getId())
+      return kErrorOk;
+
+    if (last->isJcc()) {
+      CBLabel* target = static_cast<CBJump*>(last)->getTarget();
+      if (!target || cfg->getBlockByLabel(target->getId()) == header)
+        return kErrorOk;
+    }
+
+    before = header->getFirst();
+    while (before->getPrev() && before->getPrev()->getType() == CBNode::kNodeAlign)
+      before = before->getPrev();
+  }
+
+  // --------------------------------------------------------------------------
+  // [Instructions]
+  // --------------------------------------------------------------------------
+
+  uint32_t instCount = 0;
+  for (uint32_t b = 0; b < n; b++) {
+    CBBlock* block = ctx.loopBlocks[b];
+    CBNode* node = block->getFirst();
+
+    for (;;) {
+      uint32_t type = node->getType();
+      if (type == CBNode::kNodeInst) {
+        if (instCount == kX86LicmMaxInsts)
+          return kErrorOk;
+
+        ctx.insts[instCount] = static_cast<CBInst*>(node);
+        ctx.instBlocks[instCount] = block;
+        ctx.instStates[instCount] = kX86LicmStateNone;
+        instCount++;
+      }
+      else if (type != CBNode::kNodeLabel   && type != CBNode::kNodeAlign &&
+               type != CBNode::kNodeComment && type != CBNode::kNodeHint  &&
+               type != CBNode::kNodeFuncExit) {
+        // Function calls and embedded data are not handled.
+        return kErrorOk;
+      }
+
+      if (node == block->getLast())
+        break;
+      node = node->getNext();
+    }
+  }
+
+  ctx.instCount = instCount;
+  ctx.hoistedCount = 0;
+  ctx.storeCount = 0;
+  ctx.clobbersAll = false;
+
+  uint32_t i;
+  for (i = 0; i < instCount; i++) {
+    X86Licm_addNodeRefs(ctx.loopRefs, ctx.count, ctx.insts[i]);
+    X86Licm_addDefs(ctx, ctx.insts[i]);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Exits, Flags, and Pressure]
+  // --------------------------------------------------------------------------
+
+  uint32_t exitCount = 0;
+  for (uint32_t b = 0; b < n; b++) {
+    CBBlock* block = ctx.loopBlocks[b];
+    const ZoneVector<CBBlock*>& succs = block->getSuccessors();
+    bool isExit = succs.isEmpty() || block->hasFlag(CBBlock::kFlagHasIndirect);
+
+    for (size_t j = 0; j < succs.getLength(); j++)
+      isExit |= ctx.blockStamps[succs[j]->getId()] != stamp;
+
+    if (isExit)
+      ctx.exitBlocks[exitCount++] = block;
+  }
+  ctx.exitBlockCount = exitCount;
+  ctx.liveFlags = X86Licm_getLiveFlags(header->getFirst());
+
+  uint32_t archType = ctx.cc->getArchType();
+  CCFunc* func = X86Licm_getFunc(header->getFirst());
+
+  for (uint32_t kind = 0; kind < Globals::kMaxVRegKinds; kind++) {
+    ctx.avail[kind] = X86RAPass::getAllocableRegCount(archType, kind, func);
+    ctx.live[kind] = 0;
+  }
+
+  for (i = 0; i < instCount; i++) {
+    CBInst* node = ctx.insts[i];
+    const Operand* opArray = node->getOpArray();
+
+    for (uint32_t j = 0; j < node->getOpCount(); j++) {
+      const Operand& op = opArray[j];
+      uint32_t ids[2] = { kInvalidValue, kInvalidValue };
+
+      if (op.isReg()) {
+        ids[0] = op.getId();
+      }
+      else if (op.isMem()) {
+        const X86Mem& m = op.as<X86Mem>();
+        if (m.hasBaseReg()) ids[0] = m.getBaseId();
+        if (m.hasIndexReg()) ids[1] = m.getIndexId();
+      }
+
+      for (uint32_t k = 0; k < 2; k++)
+        X86Licm_addLive(ctx, ids[k], stamp);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [Hoist]
+  // --------------------------------------------------------------------------
+
+  // Hoisting an instruction can make others invariant, repeat until nothing
+  // changes.
+  bool changed;
+  do {
+    changed = false;
+    for (i = 0; i < instCount; i++)
+      if (ctx.instStates[i] == kX86LicmStateNone && X86Licm_tryHoist(ctx, i))
+        changed = true;
+  } while (changed);
+
+  X86Compiler* cc = ctx.cc;
+  for (i = 0; i < ctx.hoistedCount; i++) {
+    CBInst* node = ctx.insts[ctx.hoisted[i]];
+    cc->removeNode(node);
+    cc->addBefore(node, before);
+  }
+
+  ctx.pass->_loopCount++;
+  ctx.pass->_hoistedCount += ctx.hoistedCount;
+
+  for (i = 0; i < instCount; i++)
+    X86Licm_clearRefs(ctx, ctx.insts[i]);
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86LicmPass - Construction / Destruction]
+// ============================================================================
+
+X86LicmPass::X86LicmPass() noexcept : CBPass("X86Licm") {
+  runAfter("X86Cse");
+  runBefore("RA");
+  resetCounts();
+}
+X86LicmPass::~X86LicmPass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86LicmPass - Interface]
+// ============================================================================
+
+Error X86LicmPass::process(Zone* zone) noexcept {
+  if (ASMJIT_UNLIKELY(!_cb->isCodeCompiler()))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  X86Compiler* cc = static_cast<X86Compiler*>(_cb);
+  uint32_t count = static_cast<uint32_t>(cc->getVirtRegArray().getLength());
+
+  if (count == 0)
+    return kErrorOk;
+
+  CBCfg* cfg;
+  ASMJIT_PROPAGATE(cc->getCfg(&cfg));
+
+  // Loop headers, the innermost first (they follow outer headers in RPO).
+  const ZoneVector<CBBlock*>& rpo = cfg->getRPO();
+  uint32_t* headers = zone->allocT<uint32_t>((rpo.getLength() + 1) * sizeof(uint32_t));
+  uint32_t headerCount = 0;
+
+  if (ASMJIT_UNLIKELY(!headers))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (size_t i = rpo.getLength(); i != 0; i--) {
+    CBBlock* block = rpo[i - 1];
+    if (block->isLoopHeader() && block->getFirst()->getType() == CBNode::kNodeLabel)
+      headers[headerCount++] = static_cast<CBLabel*>(block->getFirst())->getId();
+  }
+
+  if (!headerCount)
+    return kErrorOk;
+
+  X86LicmContext ctx;
+  ctx.cc = cc;
+  ctx.pass = this;
+  ctx.zone = zone;
+  ctx.cfg = nullptr;
+  ctx.count = count;
+  ctx.totalRefs = zone->allocZeroedT<uint32_t>(count * sizeof(uint32_t));
+  ctx.loopRefs = zone->allocZeroedT<uint32_t>(count * sizeof(uint32_t));
+  ctx.loopDefs = zone->allocZeroedT<uint32_t>(count * sizeof(uint32_t));
+  ctx.regStamps = zone->allocZeroedT<uint32_t>(count * sizeof(uint32_t));
+  ctx.blockCapacity = 0;
+  ctx.blockStamps = nullptr;
+  ctx.loopBlocks = nullptr;
+  ctx.exitBlocks = nullptr;
+  ctx.loopBlockCount = 0;
+  ctx.exitBlockCount = 0;
+  ctx.stamp = 0;
+  ctx.insts = zone->allocT<CBInst*>(kX86LicmMaxInsts * sizeof(CBInst*));
+  ctx.instBlocks = zone->allocT<CBBlock*>(kX86LicmMaxInsts * sizeof(CBBlock*));
+  ctx.instStates = zone->allocT<uint8_t>(kX86LicmMaxInsts);
+  ctx.hoisted = zone->allocT<uint32_t>(kX86LicmMaxInsts * sizeof(uint32_t));
+  ctx.instCount = 0;
+  ctx.hoistedCount = 0;
+  ctx.stores = zone->allocT<const X86Mem*>(kX86LicmMaxStores * sizeof(const X86Mem*));
+  ctx.storeSizes = zone->allocT<uint32_t>(kX86LicmMaxStores * sizeof(uint32_t));
+  ctx.storeCount = 0;
+  ctx.clobbersAll = false;
+  ctx.liveFlags = 0;
+
+  if (ASMJIT_UNLIKELY(!ctx.totalRefs || !ctx.loopRefs || !ctx.loopDefs || !ctx.regStamps ||
+                      !ctx.insts || !ctx.instBlocks || !ctx.instStates || !ctx.hoisted ||
+                      !ctx.stores || !ctx.storeSizes))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (CBNode* node = cc->getFirstNode(); node; node = node->getNext())
+    X86Licm_addNodeRefs(ctx.totalRefs, count, node);
+
+  // Hoisting changes nodes, the graph is built again for each loop. Stamps
+  // only grow, so stamps of blocks of previous graphs never match.
+  CBNode* cursor = cc->getCursor();
+  for (uint32_t i = 0; i < headerCount; i++) {
+    ASMJIT_PROPAGATE(cc->getCfg(&cfg));
+
+    CBBlock* header = cfg->getBlockByLabel(headers[i]);
+    if (!header || !header->isLoopHeader() || header->getFirst()->getType() != CBNode::kNodeLabel)
+      continue;
+
+    ctx.cfg = cfg;
+
+    Error err = X86Licm_processLoop(ctx, header);
+    if (ASMJIT_UNLIKELY(err)) {
+      cc->_setCursor(cursor);
+      return err;
+    }
+  }
+
+  cc->_setCursor(cursor);
+  return kErrorOk;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_COMPILER
@@ -0,0 +1,114 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86LICM_H
+#define _ASMJIT_X86_X86LICM_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_COMPILER)
+
+// [Dependencies]
+#include "../base/codecompiler.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86LicmPass]
+// ============================================================================
+
+//! Loop-invariant code motion (X86/X64).
+//!
+//! The pass is not added automatically and it only works on virtual registers,
+//! so it always runs before the register allocator of \ref X86Compiler (and after "X86Cse"), see
+//! \ref CBPass::runBefore().
+//!
+//! Loops are found by \ref CBCfg (back-edges of jumps to labels) and processed
+//! from the innermost. A loop is only processed if its header is a label that
+//! is entered from outside by a single block, which either falls through to the
+//! header or jumps to it. Instructions are hoisted into that block (before the
+//! header label and any alignment that precedes it) if:
+//!
+//!   - They write a single virtual register and have no other side effects
+//!     according to the instruction database (no memory writes, no implicit
+//!     operands, not volatile, no LOCK or REP prefix), and the flags they
+//!     write are not read.
+//!   - All registers they read are not written in the loop, and memory they
+//!     read can't be written by a store in the loop (only stores through the
+//!     same base and index to different bytes don't alias).
+//!   - The register is only written by them in the loop and all its uses in
+//!     the loop follow them. Two-operand forms are hoisted together with the
+//!     instruction that initializes the register (`mov r, a` + `add r, b`).
+//!   - Loads are only hoisted from blocks executed before the loop can exit,
+//!     other instructions can be executed speculatively if their register is
+//!     not used outside of the loop.
+//!
+//! Hoisted registers stay alive during the whole loop, so hoisting stops when
+//! the count of registers alive across the loop would exceed the count of
+//! registers \ref X86RAPass can allocate (minus a few kept for temporaries).
+//! Loops that contain function calls are not processed.
+class ASMJIT_VIRTAPI X86LicmPass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86LicmPass)
+  typedef CBPass Base;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API X86LicmPass() noexcept;
+  ASMJIT_API virtual ~X86LicmPass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get the count of processed loops (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getLoopCount() const noexcept { return _loopCount; }
+  //! Get the count of hoisted instructions (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getHoistedCount() const noexcept { return _hoistedCount; }
+  //! Get the count of invariant instructions kept in a loop because of register
+  //! pressure (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getPressureCount() const noexcept { return _pressureCount; }
+
+  //! Reset all statistics.
+  ASMJIT_INLINE void resetCounts() noexcept {
+    _loopCount = 0;
+    _hoistedCount = 0;
+    _pressureCount = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _loopCount;                   //!< Count of processed loops.
+  uint32_t _hoistedCount;                //!< Count of hoisted instructions.
+  uint32_t _pressureCount;               //!< Count of instructions not hoisted because of register pressure.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_COMPILER
+#endif // _ASMJIT_X86_X86LICM_H
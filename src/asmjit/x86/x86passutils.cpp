@@ -0,0 +1,72 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../x86/x86passutils_p.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86PassUtils - Flags]
+// ============================================================================
+
+bool X86PassUtils::areFlagsDead(const CBNode* node, uint32_t flags) noexcept {
+  for (node = node->getNext(); node; node = node->getNext()) {
+    switch (node->getType()) {
+      case CBNode::kNodeComment:
+      case CBNode::kNodeHint:
+      case CBNode::kNodeLabel:
+      case CBNode::kNodeAlign:
+        continue;
+
+      case CBNode::kNodeFuncExit:
+      case CBNode::kNodeFuncCall:
+      case CBNode::kNodeSentinel:
+        return true;
+
+      case CBNode::kNodeInst: {
+        if (node->isJmpOrJcc() || node->isRet())
+          return false;
+
+        uint32_t instId = static_cast<const CBInst*>(node)->getInstId();
+        if (instId == X86Inst::kIdNone || !X86Inst::isDefinedId(instId))
+          return false;
+
+        const X86Inst& inst = X86Inst::getInst(instId);
+        if (inst.getCommonData().doesJump() || (inst.getOperationData().getSpecialRegsR() & flags))
+          return false;
+
+        flags &= ~inst.getOperationData().getSpecialRegsW();
+        if (!flags)
+          return true;
+        break;
+      }
+
+      default:
+        return false;
+    }
+  }
+
+  return false;
+}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_BUILDER
@@ -0,0 +1,74 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86PASSUTILS_P_H
+#define _ASMJIT_X86_X86PASSUTILS_P_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+#include "../x86/x86globals.h"
+#include "../x86/x86inst.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86PassUtils]
+// ============================================================================
+
+//! \internal
+//!
+//! X86 utilities shared by passes that analyze \ref CodeBuilder nodes, not
+//! part of public API, not exported.
+struct X86PassUtils {
+  //! Status flags (CF|PF|AF|ZF|SF|OF), the only flags passes can remove or
+  //! reorder writes of. DF and AC are never considered dead.
+  static const uint32_t kStatusFlags =
+    x86defs::kSpecialReg_FLAGS_CF |
+    x86defs::kSpecialReg_FLAGS_PF |
+    x86defs::kSpecialReg_FLAGS_AF |
+    x86defs::kSpecialReg_FLAGS_ZF |
+    x86defs::kSpecialReg_FLAGS_SF |
+    x86defs::kSpecialReg_FLAGS_OF ;
+
+  //! Get whether `flags` written by `node` are dead, which means that all of
+  //! them are overwritten before they are read.
+  //!
+  //! Only the fall-through path that follows `node` is scanned, so the scan
+  //! continues past labels (code that jumps there doesn't see flags written
+  //! by `node`), alignment, comments, and hints. Flags are not preserved by a
+  //! function call, a function return (\ref CCFuncRet), and the end of the
+  //! function, all of them make flags dead. Jumps, `ret` instructions, and all
+  //! other nodes keep flags alive.
+  static bool areFlagsDead(const CBNode* node, uint32_t flags) noexcept;
+
+  //! Get whether `node` can be removed or replaced by an instruction that
+  //! doesn't write status flags (or writes different ones).
+  static ASMJIT_INLINE bool canDropFlags(const CBInst* node) noexcept {
+    uint32_t flags = X86Inst::getInst(node->getInstId()).getOperationData().getSpecialRegsW() & kStatusFlags;
+    return !flags || areFlagsDead(node, flags);
+  }
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_X86_X86PASSUTILS_P_H
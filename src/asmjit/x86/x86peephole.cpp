@@ -0,0 +1,479 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../x86/x86inst.h"
+#include "../x86/x86operand.h"
+#include "../x86/x86passutils_p.h"
+#include "../x86/x86peephole.h"
+
+#if defined(ASMJIT_TEST)
+#include "../x86/x86builder.h"
+#endif // ASMJIT_TEST
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86PeepholePass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Maximum number of jumps followed when resolving a jump chain.
+static const uint32_t kX86PeepholeMaxChain = 16;
+
+//! \internal
+struct X86PeepholeContext {
+  ASMJIT_INLINE X86PeepholeContext(CodeBuilder* cb) noexcept
+    : cb(cb),
+      gpSize(cb->getGpSize()) {}
+
+  CodeBuilder* cb;                       //!< CodeBuilder being processed.
+  uint32_t gpSize;                       //!< Size of a GP register of the target.
+};
+
+//! \internal
+typedef bool (ASMJIT_CDECL* X86PeepholeHandler)(X86PeepholeContext& ctx, CBInst* node);
+
+//! \internal
+//!
+//! Peephole rule, matches instructions `[firstId, lastId]`.
+struct X86PeepholeRule {
+  uint32_t firstId;                      //!< First instruction id matched.
+  uint32_t lastId;                       //!< Last instruction id matched.
+  uint32_t rule;                         //!< Rule, see \ref X86PeepholePass::Rule.
+  X86PeepholeHandler handler;            //!< Handler, returns true if it changed the code.
+};
+
+//! \internal
+//!
+//! Get whether the pass can change the `node`. Jump table edges describe an
+//! indirect jump and instructions having an extra register (AVX-512 masks,
+//! REP prefix) are never touched.
+static ASMJIT_INLINE bool X86Peephole_isEligible(const CBNode* node) noexcept {
+  if (node->getType() != CBNode::kNodeInst || node->hasFlag(CBNode::kFlagIsEdge))
+    return false;
+
+  const CBInst* inst = static_cast<const CBInst*>(node);
+  return inst->getInstId() != X86Inst::kIdNone &&
+         inst->getInstId() <  X86Inst::_kIdCount &&
+         !inst->hasExtraReg();
+}
+
+//! \internal
+//!
+//! Get the instruction that follows `node`, skipping comments. Returns null
+//! if there is any other node in between (including a label).
+static ASMJIT_INLINE CBInst* X86Peephole_nextInst(CBNode* node) noexcept {
+  for (node = node->getNext(); node; node = node->getNext()) {
+    if (node->getType() == CBNode::kNodeComment)
+      continue;
+    return X86Peephole_isEligible(node) ? static_cast<CBInst*>(node) : static_cast<CBInst*>(nullptr);
+  }
+  return nullptr;
+}
+
+//! \internal
+//!
+//! Get the first node after `node` that is not a label or comment.
+static ASMJIT_INLINE CBNode* X86Peephole_skipLabels(CBNode* node) noexcept {
+  for (node = node->getNext(); node; node = node->getNext()) {
+    uint32_t type = node->getType();
+    if (type != CBNode::kNodeLabel && type != CBNode::kNodeComment)
+      break;
+  }
+  return node;
+}
+
+//! \internal
+//!
+//! Get whether `op` is a physical GP register that stays the same when it's
+//! written with its own value. In 64-bit mode writing a 32-bit GP register
+//! zeroes its upper half, so it's never the same.
+static ASMJIT_INLINE bool X86Peephole_isInPlaceGp(const X86PeepholeContext& ctx, const Operand& op) noexcept {
+  if (!op.isPhysReg())
+    return false;
+
+  const Reg& reg = op.as<Reg>();
+  return reg.isGp() && (reg.getSize() != 4 || ctx.gpSize == 4);
+}
+
+//! \internal
+//!
+//! Get whether operand `op` reads a GP register `id` (conservative).
+static ASMJIT_INLINE bool X86Peephole_readsGp(const Operand& op, uint32_t id) noexcept {
+  if (op.isReg())
+    return !op.isPhysReg() || (op.as<Reg>().isGp() && op.as<Reg>().getId() == id);
+
+  if (op.isMem()) {
+    const X86Mem& m = op.as<X86Mem>();
+    return (m.hasBaseReg() && m.getBaseId() == id) ||
+           (m.hasIndexReg() && m.getIndexId() == id);
+  }
+
+  return false;
+}
+
+//! \internal
+//!
+//! Get `node` as a jump that can be removed or retargeted (null otherwise).
+//! JECXZ only has a short form and is never retargeted.
+static ASMJIT_INLINE CBJump* X86Peephole_asJump(CBInst* node) noexcept {
+  if (!node->isJmpOrJcc() || node->getInstId() == X86Inst::kIdJecxz)
+    return nullptr;
+
+  CBJump* jump = static_cast<CBJump*>(node);
+  return jump->getTarget() ? jump : static_cast<CBJump*>(nullptr);
+}
+
+//! \internal
+//!
+//! Change the target of `jump` to `target`.
+static void X86Peephole_retarget(CodeBuilder* cb, CBJump* jump, CBLabel* target) noexcept {
+  CBLabel* old = jump->getTarget();
+  CBJump** pPrev = &old->_from;
+
+  while (*pPrev) {
+    CBJump* current = *pPrev;
+    if (current == jump) {
+      *pPrev = jump->_jumpNext;
+      break;
+    }
+    pPrev = &current->_jumpNext;
+  }
+  old->subNumRefs();
+
+  jump->getOpArray()[jump->getOpCount() - 1] = target->getLabel();
+  jump->_target = target;
+  jump->_jumpNext = target->_from;
+  jump->delOptions(X86Inst::kOptionShortForm);
+
+  target->_from = jump;
+  target->addNumRefs();
+  cb->invalidateCfg();
+}
+
+// ============================================================================
+// [asmjit::X86PeepholePass - Rules]
+// ============================================================================
+
+//! \internal
+//!
+//! `mov r, r` and `movaps|movapd|movdqa|movdqu|movups|movupd xmm, xmm`.
+static bool ASMJIT_CDECL X86Peephole_movSelf(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  if (node->getOpCount() != 2)
+    return false;
+
+  const Operand* opArray = node->getOpArray();
+  if (!opArray[0].isPhysReg() || !opArray[0].as<Reg>().isSame(opArray[1].as<Reg>()))
+    return false;
+
+  if (node->getInstId() == X86Inst::kIdMov) {
+    if (!X86Peephole_isInPlaceGp(ctx, opArray[0]))
+      return false;
+  }
+  else {
+    // VEX encoded moves zero the upper part of YMM|ZMM, only SSE ones qualify.
+    if (!opArray[0].as<Reg>().isReg(X86Reg::kRegXmm))
+      return false;
+  }
+
+  ctx.cb->removeNode(node);
+  return true;
+}
+
+//! \internal
+//!
+//! `mov a, b` followed by `mov b, a` - the second move is removed.
+static bool ASMJIT_CDECL X86Peephole_movSwap(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  if (node->getOpCount() != 2)
+    return false;
+
+  const Operand* a = node->getOpArray();
+  if (!X86Peephole_isInPlaceGp(ctx, a[0]) || !X86Peephole_isInPlaceGp(ctx, a[1]))
+    return false;
+
+  CBInst* next = X86Peephole_nextInst(node);
+  if (!next || next->getInstId() != X86Inst::kIdMov || next->getOpCount() != 2)
+    return false;
+
+  const Operand* b = next->getOpArray();
+  if (!b[0].isPhysReg() || !b[1].isPhysReg())
+    return false;
+
+  if (!b[0].as<Reg>().isSame(a[1].as<Reg>()) || !b[1].as<Reg>().isSame(a[0].as<Reg>()))
+    return false;
+
+  ctx.cb->removeNode(next);
+  return true;
+}
+
+//! \internal
+//!
+//! `mov r, x` followed by `mov r, y` where `y` doesn't read `r` - the first
+//! move is removed. Only moves from a register or an immediate are removed as
+//! a load from memory can fault.
+static bool ASMJIT_CDECL X86Peephole_movDead(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  if (node->getOpCount() != 2)
+    return false;
+
+  const Operand* a = node->getOpArray();
+  if (!a[0].isPhysReg() || !a[0].as<Reg>().isGp())
+    return false;
+
+  if (!a[1].isPhysReg() && !a[1].isImm())
+    return false;
+
+  CBInst* next = X86Peephole_nextInst(node);
+  if (!next || next->getInstId() != X86Inst::kIdMov || next->getOpCount() != 2)
+    return false;
+
+  const Operand* b = next->getOpArray();
+  if (!b[0].isPhysReg() || !b[0].as<Reg>().isSame(a[0].as<Reg>()))
+    return false;
+
+  if (X86Peephole_readsGp(b[1], a[0].as<Reg>().getId()))
+    return false;
+
+  ctx.cb->removeNode(node);
+  return true;
+}
+
+//! \internal
+//!
+//! `add|sub|or|xor r, 0` and `and r, -1` - removed if the flags they write
+//! are dead.
+static bool ASMJIT_CDECL X86Peephole_arithNop(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  if (node->getOpCount() != 2)
+    return false;
+
+  const Operand* opArray = node->getOpArray();
+  if (!X86Peephole_isInPlaceGp(ctx, opArray[0]) || !opArray[1].isImm())
+    return false;
+
+  uint32_t size = opArray[0].as<Reg>().getSize();
+  uint64_t mask = size >= 8 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << (size * 8)) - 1;
+  uint64_t imm = opArray[1].as<Imm>().getUInt64() & mask;
+
+  uint32_t instId = node->getInstId();
+  if (imm != (instId == X86Inst::kIdAnd ? mask : static_cast<uint64_t>(0)))
+    return false;
+
+  if (!X86PassUtils::canDropFlags(node))
+    return false;
+
+  ctx.cb->removeNode(node);
+  return true;
+}
+
+//! \internal
+//!
+//! `jmp|jcc L` where `L` follows (only labels and comments in between).
+static bool ASMJIT_CDECL X86Peephole_jumpNext(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  CBJump* jump = X86Peephole_asJump(node);
+  if (!jump)
+    return false;
+
+  CBLabel* target = jump->getTarget();
+  for (CBNode* n = jump->getNext(); n; n = n->getNext()) {
+    if (n == target) {
+      ctx.cb->removeNode(jump);
+      return true;
+    }
+
+    uint32_t type = n->getType();
+    if (type != CBNode::kNodeLabel && type != CBNode::kNodeComment)
+      break;
+  }
+
+  return false;
+}
+
+//! \internal
+//!
+//! `jmp|jcc L` where `L` is followed by `jmp M` - retargeted to the end of
+//! the chain. Chains that don't end within `kX86PeepholeMaxChain` jumps (and
+//! cycles) are left as is.
+static bool ASMJIT_CDECL X86Peephole_jumpChain(X86PeepholeContext& ctx, CBInst* node) noexcept {
+  CBJump* jump = X86Peephole_asJump(node);
+  if (!jump)
+    return false;
+
+  CBLabel* origin = jump->getTarget();
+  CBLabel* target = origin;
+
+  for (uint32_t i = 0; i <= kX86PeepholeMaxChain; i++) {
+    CBNode* n = X86Peephole_skipLabels(target);
+    if (!n || !X86Peephole_isEligible(n) || !n->isJmp())
+      break;
+
+    CBJump* next = X86Peephole_asJump(static_cast<CBInst*>(n));
+    if (!next || next->getInstId() != X86Inst::kIdJmp)
+      break;
+
+    if (i == kX86PeepholeMaxChain || next->getTarget() == origin)
+      return false;
+    target = next->getTarget();
+  }
+
+  if (target == origin)
+    return false;
+
+  X86Peephole_retarget(ctx.cb, jump, target);
+  return true;
+}
+
+//! \internal
+static const X86PeepholeRule X86PeepholePass_rules[] = {
+  { X86Inst::kIdMov   , X86Inst::kIdMov   , X86PeepholePass::kRuleMovSelf  , X86Peephole_movSelf   },
+  { X86Inst::kIdMovapd, X86Inst::kIdMovaps, X86PeepholePass::kRuleMovSelf  , X86Peephole_movSelf   },
+  { X86Inst::kIdMovdqa, X86Inst::kIdMovdqu, X86PeepholePass::kRuleMovSelf  , X86Peephole_movSelf   },
+  { X86Inst::kIdMovupd, X86Inst::kIdMovups, X86PeepholePass::kRuleMovSelf  , X86Peephole_movSelf   },
+  { X86Inst::kIdMov   , X86Inst::kIdMov   , X86PeepholePass::kRuleMovSwap  , X86Peephole_movSwap   },
+  { X86Inst::kIdMov   , X86Inst::kIdMov   , X86PeepholePass::kRuleMovDead  , X86Peephole_movDead   },
+  { X86Inst::kIdAdd   , X86Inst::kIdAdd   , X86PeepholePass::kRuleArithNop , X86Peephole_arithNop  },
+  { X86Inst::kIdAnd   , X86Inst::kIdAnd   , X86PeepholePass::kRuleArithNop , X86Peephole_arithNop  },
+  { X86Inst::kIdOr    , X86Inst::kIdOr    , X86PeepholePass::kRuleArithNop , X86Peephole_arithNop  },
+  { X86Inst::kIdSub   , X86Inst::kIdSub   , X86PeepholePass::kRuleArithNop , X86Peephole_arithNop  },
+  { X86Inst::kIdXor   , X86Inst::kIdXor   , X86PeepholePass::kRuleArithNop , X86Peephole_arithNop  },
+  { X86Inst::kIdJa    , X86Inst::kIdJz    , X86PeepholePass::kRuleJumpNext , X86Peephole_jumpNext  },
+  { X86Inst::kIdJa    , X86Inst::kIdJz    , X86PeepholePass::kRuleJumpChain, X86Peephole_jumpChain }
+};
+
+// ============================================================================
+// [asmjit::X86PeepholePass - Construction / Destruction]
+// ============================================================================
+
+X86PeepholePass::X86PeepholePass() noexcept : CBPass("X86Peephole") {
+  runAfter("RA");
+  resetCounts();
+}
+X86PeepholePass::~X86PeepholePass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86PeepholePass - Interface]
+// ============================================================================
+
+Error X86PeepholePass::process(Zone* zone) noexcept {
+  ASMJIT_UNUSED(zone);
+
+  CodeBuilder* cb = _cb;
+  X86PeepholeContext ctx(cb);
+
+  // Every rule either removes a node or retargets a jump to a label that is
+  // not followed by another jump, so visiting the node preceding a change
+  // again reaches a fixpoint in a bounded number of steps.
+  CBNode* node = cb->getFirstNode();
+  while (node) {
+    CBNode* next = node->getNext();
+
+    if (X86Peephole_isEligible(node)) {
+      CBInst* inst = static_cast<CBInst*>(node);
+      uint32_t instId = inst->getInstId();
+
+      for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(X86PeepholePass_rules); i++) {
+        const X86PeepholeRule& rule = X86PeepholePass_rules[i];
+        if (instId < rule.firstId || instId > rule.lastId)
+          continue;
+
+        CBNode* prev = node->getPrev();
+        if (rule.handler(ctx, inst)) {
+          _counts[rule.rule]++;
+          next = prev ? prev : cb->getFirstNode();
+          break;
+        }
+      }
+    }
+
+    node = next;
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86PeepholePass - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_peephole) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+
+  X86Builder cb(&code);
+  X86PeepholePass* pass = cb.newPassT<X86PeepholePass>();
+  EXPECT(cb.addPass(pass) == kErrorOk, "Failed to add X86PeepholePass");
+
+  Label L_Next = cb.newLabel();
+  Label L_Chain = cb.newLabel();
+  Label L_Final = cb.newLabel();
+
+  cb.mov(x86::rax, x86::rax);                      // MovSelf.
+  cb.mov(x86::eax, x86::eax);                      // Kept, zero-extends RAX.
+  cb.movaps(x86::xmm1, x86::xmm1);                 // MovSelf.
+  cb.mov(x86::rcx, x86::rdx);
+  cb.mov(x86::rdx, x86::rcx);                      // MovSwap.
+  cb.mov(x86::rsi, 1);                             // MovDead.
+  cb.mov(x86::rsi, 2);
+  cb.mov(x86::rdi, 1);                             // Kept, read by the next move.
+  cb.mov(x86::rdi, x86::ptr(x86::rdi));
+  cb.add(x86::rbx, 0);                             // ArithNop, flags written by CMP.
+  cb.cmp(x86::rax, x86::rcx);
+  cb.xor_(x86::r8, 0);                             // Kept, flags read by JZ.
+  cb.jz(L_Chain);                                  // JumpChain, retargeted to L_Final.
+  cb.jmp(L_Next);                                  // JumpNext.
+  cb.bind(L_Next);
+  cb.and_(x86::r9d, -1);                           // Kept, zero-extends R9.
+  cb.ret();
+  cb.bind(L_Chain);
+  cb.jmp(L_Final);
+  cb.int3();
+  cb.bind(L_Final);
+  cb.ret();
+
+  EXPECT(cb.finalize() == kErrorOk, "Failed to finalize X86Builder");
+
+  INFO("Checking that each rule was applied");
+  EXPECT(pass->getCount(X86PeepholePass::kRuleMovSelf  ) == 2, "MovSelf expected 2, got %u"  , pass->getCount(X86PeepholePass::kRuleMovSelf  ));
+  EXPECT(pass->getCount(X86PeepholePass::kRuleMovSwap  ) == 1, "MovSwap expected 1, got %u"  , pass->getCount(X86PeepholePass::kRuleMovSwap  ));
+  EXPECT(pass->getCount(X86PeepholePass::kRuleMovDead  ) == 1, "MovDead expected 1, got %u"  , pass->getCount(X86PeepholePass::kRuleMovDead  ));
+  EXPECT(pass->getCount(X86PeepholePass::kRuleArithNop ) == 1, "ArithNop expected 1, got %u" , pass->getCount(X86PeepholePass::kRuleArithNop ));
+  EXPECT(pass->getCount(X86PeepholePass::kRuleJumpNext ) == 1, "JumpNext expected 1, got %u" , pass->getCount(X86PeepholePass::kRuleJumpNext ));
+  EXPECT(pass->getCount(X86PeepholePass::kRuleJumpChain) == 1, "JumpChain expected 1, got %u", pass->getCount(X86PeepholePass::kRuleJumpChain));
+
+  INFO("Checking that the retargeted jump is disconnected from its old target");
+  CBLabel* chain;
+  CBLabel* final_;
+  EXPECT(cb.getCBLabel(&chain, L_Chain) == kErrorOk && cb.getCBLabel(&final_, L_Final) == kErrorOk,
+    "Failed to get CBLabel nodes");
+  EXPECT(chain->getNumRefs() == 0, "L_Chain should have no references, got %u", chain->getNumRefs());
+  EXPECT(final_->getNumRefs() == 2, "L_Final should have 2 references, got %u", final_->getNumRefs());
+
+  INFO("Checking the remaining instructions");
+  uint32_t count = 0;
+  for (CBNode* node = cb.getFirstNode(); node; node = node->getNext())
+    count += node->getType() == CBNode::kNodeInst;
+  EXPECT(count == 13, "Expected 13 instructions, got %u", count);
+}
+#endif // ASMJIT_TEST
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_BUILDER
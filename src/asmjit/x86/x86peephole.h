@@ -0,0 +1,124 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86PEEPHOLE_H
+#define _ASMJIT_X86_X86PEEPHOLE_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86PeepholePass]
+// ============================================================================
+
+//! Peephole optimizer of `CBInst` nodes (X86/X64).
+//!
+//! The pass is not added automatically, it must be added to a \ref X86Builder
+//! or \ref X86Compiler by `addPass()` or `addPassT<X86PeepholePass>()`. When
+//! added to \ref X86Compiler it always runs after the register allocator, so it sees
+//! physical registers and the moves the allocator inserted. Instructions that
+//! still use virtual registers are never changed.
+//!
+//! Rewrite rules are matched by instruction id and applied until no rule
+//! matches anymore, each rule either removes a node or retargets a jump:
+//!
+//!   - `kRuleMovSelf` - Removes `mov r, r` and SSE register moves to itself.
+//!   - `kRuleMovSwap` - Removes `mov b, a` that follows `mov a, b`.
+//!   - `kRuleMovDead` - Removes `mov r, x` followed by `mov r, y` that doesn't
+//!     read `r`.
+//!   - `kRuleArithNop` - Removes `add|sub|or|xor r, 0` and `and r, -1` if the
+//!     flags they write are not read before they are overwritten (uses flags
+//!     read and written by instructions provided by \ref X86Inst).
+//!   - `kRuleJumpNext` - Removes `jmp` and `jcc` to a label that follows.
+//!   - `kRuleJumpChain` - Retargets `jmp` and `jcc` to a label followed by an
+//!     unconditional `jmp` to the final target of the chain.
+//!
+//! 32-bit GP writes in 64-bit mode zero the upper part of the register, so
+//! such instructions are never considered no-ops.
+class ASMJIT_VIRTAPI X86PeepholePass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86PeepholePass)
+  typedef CBPass Base;
+
+  //! Peephole rules.
+  ASMJIT_ENUM(Rule) {
+    kRuleMovSelf          = 0,           //!< Move to itself.
+    kRuleMovSwap          = 1,           //!< Move back of a register just moved.
+    kRuleMovDead          = 2,           //!< Move overwritten by the next move.
+    kRuleArithNop         = 3,           //!< Arithmetic with an identity immediate.
+    kRuleJumpNext         = 4,           //!< Jump to the next instruction.
+    kRuleJumpChain        = 5,           //!< Jump to another jump.
+    kRuleCount            = 6            //!< Count of rules.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API X86PeepholePass() noexcept;
+  ASMJIT_API virtual ~X86PeepholePass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get how many times `rule` was applied (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getCount(uint32_t rule) const noexcept {
+    ASMJIT_ASSERT(rule < kRuleCount);
+    return _counts[rule];
+  }
+
+  //! Get the count of removed instructions (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getRemovedCount() const noexcept {
+    return _counts[kRuleMovSelf ] + _counts[kRuleMovSwap ] +
+           _counts[kRuleMovDead ] + _counts[kRuleArithNop] +
+           _counts[kRuleJumpNext];
+  }
+
+  //! Get the count of retargeted jumps (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getRetargetedCount() const noexcept { return _counts[kRuleJumpChain]; }
+
+  //! Reset all statistics.
+  ASMJIT_INLINE void resetCounts() noexcept {
+    for (uint32_t i = 0; i < kRuleCount; i++)
+      _counts[i] = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _counts[kRuleCount];          //!< How many times each rule was applied.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_X86_X86PEEPHOLE_H
@@ -17,6 +17,7 @@
 #include "../x86/x86assembler.h"
 #include "../x86/x86compiler.h"
 #include "../x86/x86internal_p.h"
+#include "../x86/x86passutils_p.h"
 #include "../x86/x86regalloc_p.h"
 
 // [Api-Begin]
@@ -214,11 +215,35 @@ Error X86RAPass::prepare(CCFunc* func) noexcept {
   return kErrorOk;
 }
 
+uint32_t X86RAPass::getAllocableRegCount(uint32_t archType, uint32_t kind, const CCFunc* func) noexcept {
+  uint32_t count = archType == ArchInfo::kTypeX86 ? 8 : 16;
+
+  switch (kind) {
+    case X86Reg::kKindGp:
+      count--;
+      if (func && func->getFrameInfo().hasPreservedFP())
+        count--;
+      return count;
+
+    case X86Reg::kKindMm:
+    case X86Reg::kKindK:
+      return 8;
+
+    case X86Reg::kKindVec:
+      return count;
+
+    default:
+      return 0;
+  }
+}
+
 // ============================================================================
 // [asmjit::X86RAPass - Emit]
 // ============================================================================
 
 Error X86RAPass::emitMove(VirtReg* vReg, uint32_t dstId, uint32_t srcId, const char* reason) {
+  _stats._moveCount++;
+
   const char* comment = nullptr;
   if (_emitComments) {
     _stringBuilder.setFormat("[%s] %s", reason, vReg->getName());
@@ -231,6 +256,8 @@ Error X86RAPass::emitMove(VirtReg* vReg, uint32_t dstId, uint32_t srcId, const c
 }
 
 Error X86RAPass::emitLoad(VirtReg* vReg, uint32_t id, const char* reason) {
+  _stats._spillCount++;
+
   const char* comment = nullptr;
   if (_emitComments) {
     _stringBuilder.setFormat("[%s] %s", reason, vReg->getName());
@@ -243,6 +270,8 @@ Error X86RAPass::emitLoad(VirtReg* vReg, uint32_t id, const char* reason) {
 }
 
 Error X86RAPass::emitSave(VirtReg* vReg, uint32_t id, const char* reason) {
+  _stats._spillCount++;
+
   const char* comment = nullptr;
   if (_emitComments) {
     _stringBuilder.setFormat("[%s] %s", reason, vReg->getName());
@@ -257,6 +286,7 @@ Error X86RAPass::emitSave(VirtReg* vReg, uint32_t id, const char* reason) {
 Error X86RAPass::emitSwapGp(VirtReg* dstReg, VirtReg* srcReg, uint32_t dstPhysId, uint32_t srcPhysId, const char* reason) noexcept {
   ASMJIT_ASSERT(dstPhysId != Globals::kInvalidRegId);
   ASMJIT_ASSERT(srcPhysId != Globals::kInvalidRegId);
+  _stats._moveCount++;
 
   uint32_t is64 = std::max(dstReg->getTypeId(), srcReg->getTypeId()) >= TypeId::kI64;
   uint32_t sign = is64 ? uint32_t(X86RegTraits<X86Reg::kRegGpq>::kSignature)
@@ -2093,6 +2123,52 @@ NoMem:
   return DebugUtils::errored(kErrorNoHeapMemory);
 }
 
+// ============================================================================
+// [asmjit::X86RAPass - Dead Code]
+// ============================================================================
+
+bool X86RAPass::isRemovableInst(CBInst* node, bool writesRegs) {
+  uint32_t instId = node->getInstId();
+  uint32_t opCount = node->getOpCount();
+
+  if (!X86Inst::isDefinedId(instId) || opCount == 0 || node->isSpecial() || node->hasExtraReg())
+    return false;
+
+  const X86Inst& inst = X86Inst::getInst(instId);
+  const X86Inst::CommonData& commonData = inst.getCommonData();
+  const X86Inst::OperationData& opData = inst.getOperationData();
+
+  // Control flow, FPU stack, and side effects. Forms that use implicit
+  // operands are marked as special by `fetch()` and rejected above.
+  if (commonData.doesJump() || commonData.isFpu())
+    return false;
+
+  if (opData.isPrefetch() || opData.isBarrier() || opData.isVolatile() || opData.isPrivileged())
+    return false;
+
+  uint32_t flags = opData.getSpecialRegsW();
+  if (flags & ~X86PassUtils::kStatusFlags)
+    return false;
+
+  // Only virtual registers (not fixed) and immediates, memory operands can
+  // be written or fault and physical registers are not tracked.
+  const Operand* opArray = node->getOpArray();
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+    if (op.isImm())
+      continue;
+
+    if (!op.isVirtReg() || !cc()->isVirtRegValid(op.getId()) || cc()->getVirtRegById(op.getId())->isFixed())
+      return false;
+  }
+
+  // Instructions that write only flags qualify only if they compare operands.
+  if (!writesRegs && (!commonData.isUseR() || opCount < 2 || !flags))
+    return false;
+
+  return !flags || X86PassUtils::areFlagsDead(node, flags);
+}
+
 // ============================================================================
 // [asmjit::X86RAPass - Annotate]
 // ============================================================================
@@ -3718,6 +3794,147 @@ static Error X86RAPass_patchFuncMem(X86RAPass* self, CCFunc* func, CBNode* stop,
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::X86RAPass - AvxCleanup]
+// ============================================================================
+
+//! \internal
+//!
+//! Get if the function signature passes or returns a vector wider than 128
+//! bits, which would be destroyed by `vzeroupper`.
+static bool X86RAPass_hasWideVecValue(const FuncDetail& fd) noexcept {
+  for (uint32_t i = 0; i < fd.getRetCount(); i++)
+    if (TypeId::sizeOf(fd.getRet(i).getTypeId()) > 16)
+      return true;
+
+  for (uint32_t i = 0; i < fd.getArgCount(); i++)
+    if (TypeId::sizeOf(fd.getArg(i).getTypeId()) > 16)
+      return true;
+
+  return false;
+}
+
+//! \internal
+//!
+//! Get if the instruction uses YMM or ZMM register, which makes the upper
+//! part of vector registers dirty.
+static ASMJIT_INLINE bool X86RAPass_dirtiesUpperVec(const CBInst* node) noexcept {
+  const Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  for (uint32_t i = 0; i < opCount; i++)
+    if (X86Reg::isYmm(opArray[i]) || X86Reg::isZmm(opArray[i]))
+      return true;
+  return false;
+}
+
+//! \internal
+//!
+//! Walk the translated function and track whether the upper part of vector
+//! registers can be dirty. `dirtyIn` holds the state at each label (indexed
+//! by label index) and is only extended, so the caller can iterate until the
+//! walk doesn't change it anymore. If `apply` is true `vzeroupper` is emitted
+//! before every call made in dirty state and the function epilog is marked
+//! to clean up if the exit label can be reached in dirty state.
+static bool X86RAPass_walkAvxState(X86RAPass* self, CCFunc* func, CBNode* stop, ZoneBitVector& dirtyIn, bool& dirtyAll, bool apply) noexcept {
+  X86Compiler* cc = self->cc();
+  CBLabel* exitNode = func->getExitNode();
+
+  bool changed = false;
+  bool dirty = X86RAPass_hasWideVecValue(func->getDetail());
+
+  CBNode* node = func;
+  do {
+    CBNode* next = node->getNext();
+
+    switch (node->getType()) {
+      case CBNode::kNodeLabel: {
+        size_t index = Operand::unpackId(static_cast<CBLabel*>(node)->getId());
+        if (dirtyAll || (index < dirtyIn.getLength() && dirtyIn.getAt(index)))
+          dirty = true;
+
+        if (node == exitNode && dirty && apply && !X86RAPass_hasWideVecValue(func->getDetail()))
+          func->getFrameInfo().enableAvxCleanup();
+        break;
+      }
+
+      case CBNode::kNodeFuncCall: {
+        CCFuncCall* call = static_cast<CCFuncCall*>(node);
+        if (dirty && apply && !X86RAPass_hasWideVecValue(call->getDetail())) {
+          cc->_setCursor(call->getPrev());
+          cc->vzeroupper();
+        }
+
+        // The callee is expected to return with clean upper state.
+        dirty = false;
+        break;
+      }
+
+      case CBNode::kNodeInst: {
+        CBInst* inst = static_cast<CBInst*>(node);
+        uint32_t instId = inst->getInstId();
+
+        if (instId == X86Inst::kIdVzeroupper || instId == X86Inst::kIdVzeroall)
+          dirty = false;
+        else if (!dirty && X86RAPass_dirtiesUpperVec(inst))
+          dirty = true;
+
+        if (node->isJmpOrJcc()) {
+          if (dirty) {
+            const Operand& target = inst->getOpCount() ? inst->getOpArray()[0] : Operand();
+            size_t index = target.isLabel() ? Operand::unpackId(target.getId()) : dirtyIn.getLength();
+
+            if (index < dirtyIn.getLength()) {
+              if (!dirtyIn.getAt(index)) {
+                dirtyIn.setAt(index, true);
+                changed = true;
+              }
+            }
+            else if (!dirtyAll) {
+              dirtyAll = true;
+              changed = true;
+            }
+          }
+
+          if (node->isJmp())
+            dirty = false;
+        }
+        break;
+      }
+
+      default:
+        break;
+    }
+
+    node = next;
+  } while (node != stop);
+
+  return changed;
+}
+
+//! \internal
+//!
+//! Insert `vzeroupper` before calls and into the epilog of a function that
+//! can reach them with dirty upper part of vector registers. This avoids the
+//! SSE/AVX transition penalty that happens when the callee (or the caller of
+//! this function) executes legacy SSE instructions.
+static Error X86RAPass_insertAvxCleanup(X86RAPass* self, CCFunc* func, CBNode* stop) noexcept {
+  X86Compiler* cc = self->cc();
+  CBNode* oldCursor = cc->getCursor();
+
+  ZoneBitVector dirtyIn;
+  ASMJIT_PROPAGATE(dirtyIn.resize(&self->_heap, cc->getLabels().getLength(), false));
+
+  bool dirtyAll = false;
+  while (X86RAPass_walkAvxState(self, func, stop, dirtyIn, dirtyAll, false))
+    continue;
+
+  X86RAPass_walkAvxState(self, func, stop, dirtyIn, dirtyAll, true);
+  cc->_setCursor(oldCursor);
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::X86RAPass - Translate - Jump]
 // ============================================================================
@@ -3734,10 +3951,10 @@ static void X86RAPass_translateJump(X86RAPass* self, CBJump* jNode, CBLabel* jTa
   // Any code necessary to `switchState()` will be added at the end of the function.
   if (cc->getCursor() != injectRef) {
     // TODO: Can fail.
-    CBLabel* injectLabel = cc->newLabelNode();
+    CBLabel* injectLabel = self->newLabelNode();
 
     // Add the jump to the target.
-    cc->jmp(jTarget->getLabel());
+    self->emitJump(X86Inst::kIdJmp, jTarget);
 
     // Inject the label.
     cc->_setCursor(injectRef);
@@ -3823,7 +4040,7 @@ static Error X86RAPass_translateRet(X86RAPass* self, CCFuncRet* rNode, CBLabel*
 _EmitRet:
   {
     cc->_setCursor(rNode);
-    cc->jmp(exitTarget->getLabel());
+    self->emitJump(X86Inst::kIdJmp, exitTarget);
   }
   return kErrorOk;
 }
@@ -3961,6 +4178,14 @@ _NextGroup:
 
             if (node->isJmp()) {
               if (jTarget->hasPassData() && jTarget->getPassData<RAData>()->state) {
+                // Edges are preceded by an indirect jump, thus the state must
+                // be switched by a code injected at the end of the function.
+                if (node->hasFlag(CBNode::kFlagIsEdge)) {
+                  node->getPassData<RAData>()->state = saveState();
+                  X86RAPass_translateJump(this, node, jTarget);
+                  goto _NextGroup;
+                }
+
                 cc->_setCursor(node->getPrev());
                 switchState(jTarget->getPassData<RAData>()->state);
 
@@ -4032,6 +4257,9 @@ _NextGroup:
 
 _Done:
   {
+    if (cc->getGlobalHints() & CodeEmitter::kHintAvxCleanup)
+      ASMJIT_PROPAGATE(X86RAPass_insertAvxCleanup(this, func, stop));
+
     ASMJIT_PROPAGATE(resolveCellOffsets());
     ASMJIT_PROPAGATE(X86RAPass_prepareFuncFrame(this, func));
 
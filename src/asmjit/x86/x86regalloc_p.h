@@ -301,6 +301,12 @@ public:
 
   ASMJIT_INLINE uint32_t getGpSize() const noexcept { return _zsp.getSize(); }
 
+  //! Get the count of registers of `kind` the allocator can assign to virtual
+  //! registers of `func` (the stack pointer and a preserved frame pointer are
+  //! never assigned). Can be used before the pass runs to estimate register
+  //! pressure.
+  static uint32_t getAllocableRegCount(uint32_t archType, uint32_t kind, const CCFunc* func) noexcept;
+
   // --------------------------------------------------------------------------
   // [Accessors]
   // --------------------------------------------------------------------------
@@ -651,6 +657,12 @@ public:
 
   virtual Error fetch() override;
 
+  // --------------------------------------------------------------------------
+  // [Dead Code]
+  // --------------------------------------------------------------------------
+
+  virtual bool isRemovableInst(CBInst* node, bool writesRegs) override;
+
   // --------------------------------------------------------------------------
   // [Annotate]
   // --------------------------------------------------------------------------
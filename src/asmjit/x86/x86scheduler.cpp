@@ -0,0 +1,701 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define ASMJIT_EXPORTS
+
+// [Guard]
+#include "../asmjit_build.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../x86/x86inst.h"
+#include "../x86/x86operand.h"
+#include "../x86/x86passutils_p.h"
+#include "../x86/x86scheduler.h"
+
+#if defined(ASMJIT_TEST)
+#include "../x86/x86builder.h"
+#endif // ASMJIT_TEST
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Latency]
+// ============================================================================
+
+//! \internal
+//!
+//! Latency class of an instruction.
+enum X86SchedClass {
+  kX86SchedAlu            = 0,           //!< GP arithmetic and moves.
+  kX86SchedMul            = 1,           //!< GP multiplication.
+  kX86SchedVecAlu         = 2,           //!< MMX/SSE/AVX integer arithmetic, logic, moves, and shuffles.
+  kX86SchedVecMul         = 3,           //!< MMX/SSE/AVX integer multiplication.
+  kX86SchedFpAdd          = 4,           //!< FP addition and subtraction.
+  kX86SchedFpMul          = 5,           //!< FP multiplication and FMA.
+  kX86SchedFpDiv          = 6,           //!< FP division and square root.
+  kX86SchedLoad           = 7,           //!< Load-to-use latency, added to the class of the instruction.
+  kX86SchedCount          = 8            //!< Count of latency classes.
+};
+
+//! \internal
+//!
+//! Latencies [cycles] of each class, per \ref X86SchedulerPass::Model.
+static const uint8_t X86SchedulerPass_latency[X86SchedulerPass::kModelCount][kX86SchedCount] = {
+  // Alu | Mul | VecAlu | VecMul | FpAdd | FpMul | FpDiv | Load
+  {  1   , 3   , 1      , 5      , 4     , 4     , 14    , 4    }, // Generic.
+  {  1   , 5   , 1      , 5      , 3     , 5     , 30    , 3    }, // Atom.
+  {  1   , 3   , 1      , 5      , 4     , 4     , 13    , 5    }, // Core.
+  {  1   , 3   , 1      , 3      , 3     , 3     , 10    , 4    }  // Zen.
+};
+
+//! \internal
+//!
+//! Latency class of instructions `[firstId, lastId]`.
+struct X86SchedRange {
+  uint32_t firstId;                      //!< First instruction id.
+  uint32_t lastId;                       //!< Last instruction id.
+  uint32_t schedClass;                   //!< Latency class, see \ref X86SchedClass.
+};
+
+//! \internal
+static const X86SchedRange X86SchedulerPass_classes[] = {
+  { X86Inst::kIdImul        , X86Inst::kIdImul         , kX86SchedMul    },
+  { X86Inst::kIdPmaddwd     , X86Inst::kIdPmaddwd      , kX86SchedVecMul },
+  { X86Inst::kIdPmuldq      , X86Inst::kIdPmuludq      , kX86SchedVecMul },
+  { X86Inst::kIdVpmaddwd    , X86Inst::kIdVpmaddwd     , kX86SchedVecMul },
+  { X86Inst::kIdVpmuldq     , X86Inst::kIdVpmuludq     , kX86SchedVecMul },
+  { X86Inst::kIdAddpd       , X86Inst::kIdAddss        , kX86SchedFpAdd  },
+  { X86Inst::kIdSubpd       , X86Inst::kIdSubss        , kX86SchedFpAdd  },
+  { X86Inst::kIdVaddpd      , X86Inst::kIdVaddss       , kX86SchedFpAdd  },
+  { X86Inst::kIdVsubpd      , X86Inst::kIdVsubss       , kX86SchedFpAdd  },
+  { X86Inst::kIdMulpd       , X86Inst::kIdMulss        , kX86SchedFpMul  },
+  { X86Inst::kIdVmulpd      , X86Inst::kIdVmulss       , kX86SchedFpMul  },
+  { X86Inst::kIdVfmadd132pd , X86Inst::kIdVfnmsub231ss , kX86SchedFpMul  },
+  { X86Inst::kIdDivpd       , X86Inst::kIdDivss        , kX86SchedFpDiv  },
+  { X86Inst::kIdSqrtpd      , X86Inst::kIdSqrtss       , kX86SchedFpDiv  },
+  { X86Inst::kIdVdivpd      , X86Inst::kIdVdivss       , kX86SchedFpDiv  },
+  { X86Inst::kIdVsqrtpd     , X86Inst::kIdVsqrtss      , kX86SchedFpDiv  }
+};
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Helpers]
+// ============================================================================
+
+//! \internal
+//!
+//! Flags tracked as a single resource (status flags, DF, and AC), instructions
+//! that access any other special register are never moved.
+static const uint32_t kX86SchedFlags =
+  X86PassUtils::kStatusFlags        |
+  x86defs::kSpecialReg_FLAGS_DF     |
+  x86defs::kSpecialReg_FLAGS_AC     ;
+
+//! \internal
+//!
+//! Instruction of a region and its dependencies.
+struct X86SchedInst {
+  CBInst* node;                          //!< Instruction node.
+  uint64_t regsR;                        //!< Registers read.
+  uint64_t regsW;                        //!< Registers written.
+  uint64_t preds;                        //!< Instructions of the region that must precede.
+  uint64_t rawPreds;                     //!< Predecessors that produce a value read by this instruction.
+  uint32_t latency;                      //!< Latency of the result.
+  uint32_t priority;                     //!< Length of the longest latency path to the end of the region.
+  uint32_t readyTime;                    //!< Earliest cycle all predecessors' results are available.
+  uint32_t issueTime;                    //!< Cycle the instruction was scheduled at.
+  uint32_t flagsR;                       //!< Flags read (see `kX86SchedFlags`).
+  uint32_t flagsW;                       //!< Flags written (see `kX86SchedFlags`).
+  bool load;                             //!< Reads memory.
+  bool store;                            //!< Writes memory.
+};
+
+//! \internal
+//!
+//! Get the bit index of a physical register of `type` and `id` (64 if the
+//! register is not tracked). GP registers use bits [0, 16), vector registers
+//! [16, 48), MMX registers [48, 56), and K registers [56, 64). Registers are
+//! tracked as a whole, so partial writes are also dependencies.
+static ASMJIT_INLINE uint32_t X86Scheduler_regIndex(uint32_t type, uint32_t id) noexcept {
+  if (type >= X86Reg::kRegGpbLo && type <= X86Reg::kRegGpq)
+    return id < 16 ? id : 64;
+
+  if (type >= X86Reg::kRegXmm && type <= X86Reg::kRegZmm)
+    return id < 32 ? 16 + id : 64;
+
+  if (type == X86Reg::kRegMm)
+    return id < 8 ? 48 + id : 64;
+
+  if (type == X86Reg::kRegK)
+    return id < 8 ? 56 + id : 64;
+
+  return 64;
+}
+
+//! \internal
+//!
+//! Add a register `type` and `id` to `mask`, returns false if it's not tracked.
+static ASMJIT_INLINE bool X86Scheduler_addReg(uint64_t& mask, uint32_t type, uint32_t id) noexcept {
+  if (Operand::isPackedId(id))
+    return false;
+
+  uint32_t index = X86Scheduler_regIndex(type, id);
+  if (index >= 64)
+    return false;
+
+  mask |= static_cast<uint64_t>(1) << index;
+  return true;
+}
+
+//! \internal
+//!
+//! Get the latency class of `instId`.
+static uint32_t X86Scheduler_classOf(uint32_t instId, const X86Inst::CommonData& commonData) noexcept {
+  for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(X86SchedulerPass_classes); i++) {
+    const X86SchedRange& range = X86SchedulerPass_classes[i];
+    if (instId >= range.firstId && instId <= range.lastId)
+      return range.schedClass;
+  }
+
+  return commonData.isVec() || commonData.isMmx() ? kX86SchedVecAlu : kX86SchedAlu;
+}
+
+//! \internal
+//!
+//! Get whether `node` is `imul r, r/m` or `imul r, r/m, imm`. Unlike all other
+//! forms of IMUL (including `imul ax, r/m8`) these don't use rAX and rDX, but
+//! X86Inst only describes IMUL as a whole, with ambiguous USE flags.
+static ASMJIT_INLINE bool X86Scheduler_isExplicitImul(const CBInst* node) noexcept {
+  const Operand* opArray = node->getOpArray();
+  uint32_t opCount = node->getOpCount();
+
+  if (node->getInstId() != X86Inst::kIdImul || !opArray[0].isReg())
+    return false;
+
+  if (opCount == 2)
+    return opArray[1].getSize() != 1;
+
+  return opCount == 3 && opArray[2].isImm();
+}
+
+//! \internal
+//!
+//! Fill `si` from `node`, returns false if the node can't be moved.
+static bool X86Scheduler_analyze(X86SchedInst& si, CBNode* node_, uint32_t model) noexcept {
+  if (node_->getType() != CBNode::kNodeInst || node_->hasFlag(CBNode::kFlagIsEdge))
+    return false;
+
+  CBInst* node = static_cast<CBInst*>(node_);
+  uint32_t instId = node->getInstId();
+  uint32_t opCount = node->getOpCount();
+
+  if (instId == X86Inst::kIdNone || instId >= X86Inst::_kIdCount || opCount == 0 || node->hasExtraReg())
+    return false;
+
+  if (node->getOptions() & (X86Inst::kOptionLock | X86Inst::kOptionRep | X86Inst::kOptionRepnz))
+    return false;
+
+  const X86Inst& inst = X86Inst::getInst(instId);
+  const X86Inst::CommonData& commonData = inst.getCommonData();
+  const X86Inst::OperationData& opData = inst.getOperationData();
+  uint32_t flags = commonData.getFlags();
+
+  bool explicitImul = X86Scheduler_isExplicitImul(node);
+  if (commonData.doesJump() || commonData.isFpu() || commonData.isVsibOp())
+    return false;
+
+  if (!explicitImul && (commonData.hasFixedRM() || (flags & X86Inst::kFlagUseA)))
+    return false;
+
+  if (opData.isPrefetch() || opData.isBarrier() || opData.isVolatile() || opData.isPrivileged())
+    return false;
+
+  uint32_t specialR = opData.getSpecialRegsR();
+  uint32_t specialW = opData.getSpecialRegsW();
+  if ((specialR | specialW) & ~kX86SchedFlags)
+    return false;
+
+  si.node = node;
+  si.regsR = 0;
+  si.regsW = 0;
+  si.preds = 0;
+  si.rawPreds = 0;
+  si.readyTime = 0;
+  si.issueTime = 0;
+  si.flagsR = specialR & kX86SchedFlags;
+  si.flagsW = specialW & kX86SchedFlags;
+  si.load = false;
+  si.store = false;
+
+  const Operand* opArray = node->getOpArray();
+  for (uint32_t i = 0; i < opCount; i++) {
+    const Operand& op = opArray[i];
+
+    // The first operand is read and/or written as described by the USE flags
+    // (both if unknown), XCHG|XADD also write the second one. Other operands
+    // are only read.
+    bool r = true;
+    bool w = false;
+
+    if (i == 0) {
+      uint32_t use = flags & X86Inst::kFlagUseX;
+      r = use != X86Inst::kFlagUseW;
+      w = use != X86Inst::kFlagUseR;
+    }
+
+    if (i <= 1 && (flags & X86Inst::kFlagUseXX)) {
+      r = true;
+      w = true;
+    }
+
+    // `imul r, r/m` reads its first operand, `imul r, r/m, imm` doesn't.
+    if (i == 0 && explicitImul) {
+      r = opCount == 2;
+      w = true;
+    }
+
+    if (op.isReg()) {
+      const Reg& reg = op.as<Reg>();
+      uint64_t mask = 0;
+
+      if (!X86Scheduler_addReg(mask, reg.getType(), reg.getId()))
+        return false;
+
+      if (r) si.regsR |= mask;
+      if (w) si.regsW |= mask;
+    }
+    else if (op.isMem()) {
+      const X86Mem& m = op.as<X86Mem>();
+
+      if (m.hasBaseReg() && m.getBaseType() != X86Reg::kRegRip && !X86Scheduler_addReg(si.regsR, m.getBaseType(), m.getBaseId()))
+        return false;
+
+      if (m.hasIndexReg() && !X86Scheduler_addReg(si.regsR, m.getIndexType(), m.getIndexId()))
+        return false;
+
+      // LEA only calculates the address.
+      if (instId != X86Inst::kIdLea) {
+        if (r) si.load = true;
+        if (w) si.store = true;
+      }
+    }
+  }
+
+  const uint8_t* latency = X86SchedulerPass_latency[model];
+  si.latency = latency[X86Scheduler_classOf(instId, commonData)];
+  if (si.load)
+    si.latency += latency[kX86SchedLoad];
+
+  return true;
+}
+
+//! \internal
+//!
+//! Build dependencies between instructions of the region `insts`.
+static void X86Scheduler_buildDeps(X86SchedInst* insts, uint32_t count) noexcept {
+  uint32_t i, j;
+
+  // Registers and memory.
+  for (j = 1; j < count; j++) {
+    X86SchedInst& b = insts[j];
+
+    for (i = 0; i < j; i++) {
+      const X86SchedInst& a = insts[i];
+
+      bool raw = (a.regsW & b.regsR) != 0 || (a.store && b.load);
+      bool dep = raw ||
+                 (a.regsR & b.regsW) != 0 ||
+                 (a.regsW & b.regsW) != 0 ||
+                 (a.store && b.store) ||
+                 (a.load && b.store);
+
+      if (dep) {
+        uint64_t bit = static_cast<uint64_t>(1) << i;
+        b.preds |= bit;
+        if (raw) b.rawPreds |= bit;
+      }
+    }
+  }
+
+  // Flags. Almost every GP instruction writes flags, but they are rarely read,
+  // thus a write followed by another write (within the region) is dead. Each
+  // flag is tracked separately as some instructions only write a part of them
+  // (INC and DEC don't write CF). Live accesses of a flag keep their order,
+  // dead writes only stay between the live accesses that surround them. The
+  // last write of the region is considered live.
+  uint32_t allFlags = 0;
+  for (i = 0; i < count; i++)
+    allFlags |= insts[i].flagsR | insts[i].flagsW;
+
+  while (allFlags) {
+    uint32_t flag = allFlags & (0U - allFlags);
+    allFlags ^= flag;
+
+    bool nextIsWrite = false;
+    uint64_t deadMask = 0;
+
+    for (i = count; i != 0; i--) {
+      const X86SchedInst& a = insts[i - 1];
+      bool r = (a.flagsR & flag) != 0;
+      bool w = (a.flagsW & flag) != 0;
+
+      if (!r && !w)
+        continue;
+
+      if (!r && nextIsWrite)
+        deadMask |= static_cast<uint64_t>(1) << (i - 1);
+      nextIsWrite = !r;
+    }
+
+    uint32_t lastLive = count;
+    uint64_t pendingDead = 0;
+
+    for (j = 0; j < count; j++) {
+      X86SchedInst& b = insts[j];
+      bool r = (b.flagsR & flag) != 0;
+      bool w = (b.flagsW & flag) != 0;
+
+      if (!r && !w)
+        continue;
+
+      uint64_t bit = static_cast<uint64_t>(1) << j;
+      uint64_t liveBit = lastLive < count ? static_cast<uint64_t>(1) << lastLive : static_cast<uint64_t>(0);
+
+      if (deadMask & bit) {
+        b.preds |= liveBit;
+        pendingDead |= bit;
+        continue;
+      }
+
+      b.preds |= liveBit | pendingDead;
+      if (r && lastLive < count && (insts[lastLive].flagsW & flag))
+        b.rawPreds |= liveBit;
+
+      pendingDead = 0;
+      lastLive = j;
+    }
+  }
+}
+
+//! \internal
+//!
+//! Schedule the region `insts`, returns the count of instructions that changed
+//! their position (`order` receives the new order).
+static uint32_t X86Scheduler_schedule(X86SchedInst* insts, uint32_t count, uint8_t* order) noexcept {
+  uint32_t i, j;
+
+  // Priority is the longest latency path from the instruction to the end of
+  // the region (including its own latency).
+  for (i = count; i != 0; i--) {
+    X86SchedInst& a = insts[i - 1];
+    uint64_t bit = static_cast<uint64_t>(1) << (i - 1);
+    uint32_t priority = a.latency;
+
+    for (j = i; j < count; j++) {
+      const X86SchedInst& b = insts[j];
+      if (!(b.preds & bit))
+        continue;
+
+      uint32_t path = b.priority + ((b.rawPreds & bit) ? a.latency : 0);
+      priority = std::max(priority, path);
+    }
+
+    a.priority = priority;
+  }
+
+  // Issue one instruction per cycle, always the one that can be issued first,
+  // then the one with the highest priority, then the one that came first.
+  uint64_t scheduled = 0;
+  uint32_t cycle = 0;
+  uint32_t moved = 0;
+
+  for (uint32_t k = 0; k < count; k++) {
+    uint32_t best = count;
+    uint32_t bestTime = 0;
+
+    for (i = 0; i < count; i++) {
+      const X86SchedInst& a = insts[i];
+      uint64_t bit = static_cast<uint64_t>(1) << i;
+
+      if ((scheduled & bit) || (a.preds & ~scheduled))
+        continue;
+
+      uint32_t time = std::max(a.readyTime, cycle);
+      if (best == count || time < bestTime || (time == bestTime && a.priority > insts[best].priority)) {
+        best = i;
+        bestTime = time;
+      }
+    }
+
+    ASMJIT_ASSERT(best < count);
+    X86SchedInst& a = insts[best];
+    uint64_t bit = static_cast<uint64_t>(1) << best;
+
+    a.issueTime = bestTime;
+    scheduled |= bit;
+    cycle = bestTime + 1;
+
+    for (j = best + 1; j < count; j++) {
+      X86SchedInst& b = insts[j];
+      if (b.preds & bit)
+        b.readyTime = std::max(b.readyTime, bestTime + ((b.rawPreds & bit) ? a.latency : 0));
+    }
+
+    order[k] = static_cast<uint8_t>(best);
+    moved += best != k;
+  }
+
+  return moved;
+}
+
+//! \internal
+//!
+//! Relink nodes of the region `insts` in the given `order`.
+static void X86Scheduler_relink(CodeBuilder* cb, X86SchedInst* insts, uint32_t count, const uint8_t* order) noexcept {
+  CBNode* prev = insts[0].node->getPrev();
+  CBNode* next = insts[count - 1].node->getNext();
+
+  for (uint32_t k = 0; k < count; k++) {
+    CBNode* node = insts[order[k]].node;
+
+    node->_prev = prev;
+    if (prev)
+      prev->_next = node;
+    else
+      cb->_firstNode = node;
+    prev = node;
+  }
+
+  prev->_next = next;
+  if (next)
+    next->_prev = prev;
+  else
+    cb->_lastNode = prev;
+
+  cb->invalidateCfg();
+}
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Construction / Destruction]
+// ============================================================================
+
+X86SchedulerPass::X86SchedulerPass() noexcept
+  : CBPass("X86Scheduler"),
+    _model(modelOf(CpuInfo::getHost())) {
+
+  runAfter("RA");
+  runAfter("X86Peephole");
+  resetCounts();
+}
+
+X86SchedulerPass::X86SchedulerPass(const CpuInfo& cpuInfo) noexcept
+  : CBPass("X86Scheduler"),
+    _model(modelOf(cpuInfo)) {
+
+  runAfter("RA");
+  runAfter("X86Peephole");
+  resetCounts();
+}
+
+X86SchedulerPass::~X86SchedulerPass() noexcept {}
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Model]
+// ============================================================================
+
+uint32_t X86SchedulerPass::modelOf(const CpuInfo& cpuInfo) noexcept {
+  if (!ArchInfo::isX86Family(cpuInfo.getArchInfo().getType()))
+    return kModelGeneric;
+
+  switch (cpuInfo.getVendorId()) {
+    case CpuInfo::kVendorIntel:
+      // Atom cores (Bonnell, Silvermont, Goldmont, ...) have MOVBE, but unlike
+      // Core (Haswell+) they don't have AVX.
+      if (cpuInfo.hasFeature(CpuInfo::kX86FeatureMOVBE) && !cpuInfo.hasFeature(CpuInfo::kX86FeatureAVX))
+        return kModelAtom;
+      return cpuInfo.getFamily() == 6 ? kModelCore : kModelGeneric;
+
+    case CpuInfo::kVendorAMD:
+      return cpuInfo.getFamily() >= 0x17 ? kModelZen : kModelGeneric;
+
+    default:
+      return kModelGeneric;
+  }
+}
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Interface]
+// ============================================================================
+
+Error X86SchedulerPass::process(Zone* zone) noexcept {
+  CodeBuilder* cb = _cb;
+
+  X86SchedInst* insts = zone->allocT<X86SchedInst>(kMaxRegionSize * sizeof(X86SchedInst));
+  if (ASMJIT_UNLIKELY(!insts))
+    return DebugUtils::errored(kErrorNoHeapMemory);
+
+  uint8_t order[kMaxRegionSize];
+  CBNode* node = cb->getFirstNode();
+
+  while (node) {
+    uint32_t count = 0;
+    while (node && count < kMaxRegionSize && X86Scheduler_analyze(insts[count], node, _model)) {
+      node = node->getNext();
+      count++;
+    }
+
+    if (count == 0) {
+      node = node->getNext();
+      continue;
+    }
+
+    if (count < 2)
+      continue;
+
+    X86Scheduler_buildDeps(insts, count);
+    uint32_t moved = X86Scheduler_schedule(insts, count, order);
+
+    if (moved) {
+      X86Scheduler_relink(cb, insts, count, order);
+      _regionCount++;
+      _movedCount += moved;
+    }
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::X86SchedulerPass - Test]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_scheduler) {
+  CodeHolder code;
+  code.init(CodeInfo(ArchInfo::kTypeX64));
+
+  X86Builder cb(&code);
+  X86SchedulerPass* pass = cb.newPassT<X86SchedulerPass>();
+  EXPECT(cb.addPass(pass) == kErrorOk, "Failed to add X86SchedulerPass");
+  pass->setModel(X86SchedulerPass::kModelCore);
+
+  CBNode* n[10];
+  Label L = cb.newLabel();
+
+  cb.mov(x86::rax, x86::ptr(x86::rdi));     n[0] = cb.getCursor();
+  cb.add(x86::rax, 1);                      n[1] = cb.getCursor();
+  cb.mov(x86::rcx, x86::ptr(x86::rsi));     n[2] = cb.getCursor();
+  cb.add(x86::rcx, 2);                      n[3] = cb.getCursor();
+  cb.mov(x86::ptr(x86::rdi, 8), x86::rax);  n[4] = cb.getCursor();
+  cb.cmp(x86::rcx, x86::rax);               n[5] = cb.getCursor();
+  cb.jz(L);
+  cb.mulps(x86::xmm0, x86::xmm1);           n[6] = cb.getCursor();
+  cb.addps(x86::xmm0, x86::xmm2);           n[7] = cb.getCursor();
+  cb.movaps(x86::xmm3, x86::xmm4);          n[8] = cb.getCursor();
+  cb.mov(x86::rdx, x86::ptr(x86::rdi, 16)); n[9] = cb.getCursor();
+  cb.bind(L);
+  cb.ret();
+
+  EXPECT(cb.finalize() == kErrorOk, "Failed to finalize X86Builder");
+
+  // Expected order of instructions, -1 means a node that is not checked.
+  static const int expected[] = { 0, 2, 1, 3, 4, 5, -1, 6, 9, 8, 7, -1, -1 };
+
+  INFO("Checking that loads are hoisted and their users delayed");
+  uint32_t i = 0;
+  for (CBNode* node = cb.getFirstNode(); node; node = node->getNext(), i++) {
+    EXPECT(i < ASMJIT_ARRAY_SIZE(expected), "Unexpected node at position %u", i);
+    if (expected[i] >= 0)
+      EXPECT(node == n[expected[i]], "Unexpected node at position %u", i);
+  }
+  EXPECT(i == ASMJIT_ARRAY_SIZE(expected), "Expected %u nodes, got %u", unsigned(ASMJIT_ARRAY_SIZE(expected)), i);
+
+  INFO("Checking statistics");
+  EXPECT(pass->getRegionCount() == 2, "Expected 2 reordered regions, got %u", pass->getRegionCount());
+  EXPECT(pass->getMovedCount() == 4, "Expected 4 moved instructions, got %u", pass->getMovedCount());
+
+  INFO("Checking that two and three operand multiplies are issued first");
+  {
+    CodeHolder mulCode;
+    mulCode.init(CodeInfo(ArchInfo::kTypeX64));
+
+    X86Builder mb(&mulCode);
+    X86SchedulerPass* mulPass = mb.newPassT<X86SchedulerPass>();
+    EXPECT(mb.addPass(mulPass) == kErrorOk, "Failed to add X86SchedulerPass");
+    mulPass->setModel(X86SchedulerPass::kModelCore);
+
+    CBNode* m[5];
+
+    mb.add(x86::rax, 1);                      m[0] = mb.getCursor();
+    mb.add(x86::rbx, 2);                      m[1] = mb.getCursor();
+    mb.imul(x86::rcx, x86::rdx, 3);           m[2] = mb.getCursor();
+    mb.imul(x86::r8, x86::r9);                m[3] = mb.getCursor();
+    mb.add(x86::rcx, x86::rsi);               m[4] = mb.getCursor();
+    mb.ret();
+
+    EXPECT(mb.finalize() == kErrorOk, "Failed to finalize X86Builder");
+
+    static const int mulExpected[] = { 2, 3, 0, 1, 4, -1 };
+
+    i = 0;
+    for (CBNode* node = mb.getFirstNode(); node; node = node->getNext(), i++) {
+      EXPECT(i < ASMJIT_ARRAY_SIZE(mulExpected), "Unexpected node at position %u", i);
+      if (mulExpected[i] >= 0)
+        EXPECT(node == m[mulExpected[i]], "Unexpected node at position %u", i);
+    }
+    EXPECT(mulPass->getMovedCount() == 4, "Expected 4 moved instructions, got %u", mulPass->getMovedCount());
+  }
+
+  INFO("Checking that a partial flags write doesn't kill other flags");
+  {
+    CodeHolder adcCode;
+    adcCode.init(CodeInfo(ArchInfo::kTypeX64));
+
+    X86Builder ab(&adcCode);
+    X86SchedulerPass* adcPass = ab.newPassT<X86SchedulerPass>();
+    EXPECT(ab.addPass(adcPass) == kErrorOk, "Failed to add X86SchedulerPass");
+    adcPass->setModel(X86SchedulerPass::kModelCore);
+
+    CBNode* a[4];
+
+    ab.add(x86::eax, 1);                        a[0] = ab.getCursor();
+    ab.sub(x86::ebx, x86::dword_ptr(x86::rdi)); a[1] = ab.getCursor();
+    ab.inc(x86::ecx);                           a[2] = ab.getCursor();
+    ab.adc(x86::edx, 0);                        a[3] = ab.getCursor();
+    ab.ret();
+
+    EXPECT(ab.finalize() == kErrorOk, "Failed to finalize X86Builder");
+
+    // CF read by ADC is written by SUB, which must stay after ADD.
+    CBNode* node = ab.getFirstNode();
+    int subPos = -1;
+    int addPos = -1;
+
+    for (i = 0; node; node = node->getNext(), i++) {
+      if (node == a[0]) addPos = int(i);
+      if (node == a[1]) subPos = int(i);
+      if (node == a[3]) EXPECT(i == 3, "ADC must remain the last instruction");
+    }
+    EXPECT(addPos < subPos, "ADD must precede SUB (CF is read by ADC)");
+  }
+
+  INFO("Checking the CPU model of CpuInfo");
+  CpuInfo cpu;
+  EXPECT(X86SchedulerPass::modelOf(cpu) == X86SchedulerPass::kModelGeneric, "Unknown CPU should use the generic model");
+}
+#endif // ASMJIT_TEST
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_DISABLE_BUILDER
@@ -0,0 +1,130 @@
+// [AsmJit]
+// Complete x86/x64 JIT and Remote Assembler for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _ASMJIT_X86_X86SCHEDULER_H
+#define _ASMJIT_X86_X86SCHEDULER_H
+
+#include "../asmjit_build.h"
+#if !defined(ASMJIT_DISABLE_BUILDER)
+
+// [Dependencies]
+#include "../base/codebuilder.h"
+#include "../base/cpuinfo.h"
+
+// [Api-Begin]
+#include "../asmjit_apibegin.h"
+
+namespace asmjit {
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::X86SchedulerPass]
+// ============================================================================
+
+//! List scheduler of `CBInst` nodes (X86/X64).
+//!
+//! The pass is not added automatically, it must be added to a \ref X86Builder
+//! or \ref X86Compiler by `addPass()`. When added to \ref X86Compiler it runs
+//! after the register allocator (and after "X86Peephole"), so it schedules
+//! physical registers.
+//!
+//! Each run of instructions without a label, jump, call, or return in between
+//! (up to `kMaxRegionSize` instructions) is a region. The pass builds a graph
+//! of dependencies of the region from registers, flags, and memory read and
+//! written by each instruction (as provided by \ref X86Inst) and reorders the
+//! instructions, so the ones on the longest latency path (loads, multiplies,
+//! and FP arithmetic) are issued first and their users as late as possible.
+//! Latencies are taken from a table selected by the CPU model, see \ref Model.
+//!
+//! Instructions having implicit operands, a LOCK or REP prefix, an extra
+//! register, or ones that are volatile, privileged, or FPU are never moved
+//! and split the region (IMUL is only moved in its `imul r, r/m` and `imul r,
+//! r/m, imm` forms). Loads can pass each other, but never a store.
+class ASMJIT_VIRTAPI X86SchedulerPass : public CBPass {
+public:
+  ASMJIT_NONCOPYABLE(X86SchedulerPass)
+  typedef CBPass Base;
+
+  //! CPU model that selects the latency table.
+  ASMJIT_ENUM(Model) {
+    kModelGeneric         = 0,           //!< Generic x86 CPU.
+    kModelAtom            = 1,           //!< Intel Atom (in-order or narrow out-of-order core).
+    kModelCore            = 2,           //!< Intel Core (wide out-of-order core).
+    kModelZen             = 3,           //!< AMD Zen.
+    kModelCount           = 4            //!< Count of models.
+  };
+
+  //! Maximum number of instructions in a region.
+  static const uint32_t kMaxRegionSize = 64;
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a new `X86SchedulerPass` for the host CPU.
+  ASMJIT_API X86SchedulerPass() noexcept;
+  //! Create a new `X86SchedulerPass` for the CPU described by `cpuInfo`.
+  ASMJIT_API explicit X86SchedulerPass(const CpuInfo& cpuInfo) noexcept;
+  ASMJIT_API virtual ~X86SchedulerPass() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  ASMJIT_API virtual Error process(Zone* zone) noexcept override;
+
+  // --------------------------------------------------------------------------
+  // [Model]
+  // --------------------------------------------------------------------------
+
+  //! Get the CPU model, see \ref Model.
+  ASMJIT_INLINE uint32_t getModel() const noexcept { return _model; }
+  //! Set the CPU model, see \ref Model.
+  ASMJIT_INLINE void setModel(uint32_t model) noexcept {
+    ASMJIT_ASSERT(model < kModelCount);
+    _model = model;
+  }
+
+  //! Get the CPU model that matches `cpuInfo`.
+  ASMJIT_API static uint32_t modelOf(const CpuInfo& cpuInfo) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Statistics]
+  // --------------------------------------------------------------------------
+
+  //! Get the count of regions that were reordered (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getRegionCount() const noexcept { return _regionCount; }
+  //! Get the count of instructions that changed their position (accumulated over all runs).
+  ASMJIT_INLINE uint32_t getMovedCount() const noexcept { return _movedCount; }
+
+  //! Reset all statistics.
+  ASMJIT_INLINE void resetCounts() noexcept {
+    _regionCount = 0;
+    _movedCount = 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uint32_t _model;                       //!< CPU model, see \ref Model.
+  uint32_t _regionCount;                 //!< Count of reordered regions.
+  uint32_t _movedCount;                  //!< Count of moved instructions.
+};
+
+//! \}
+
+} // asmjit namespace
+
+// [Api-End]
+#include "../asmjit_apiend.h"
+
+// [Guard]
+#endif // !ASMJIT_DISABLE_BUILDER
+#endif // _ASMJIT_X86_X86SCHEDULER_H
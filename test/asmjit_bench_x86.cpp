@@ -10,6 +10,10 @@
 #include <string.h>
 
 #include "./asmjit.h"
+#if ASMJIT_OS_POSIX
+# include <pthread.h>
+#endif // ASMJIT_OS_POSIX
+
 #include "./asmjit_test_misc.h"
 #include "./asmjit_test_opcode.h"
 
@@ -19,128 +23,1138 @@ using namespace asmjit;
 // [Configuration]
 // ============================================================================
 
-static const uint32_t kNumRepeats = 10;
-static const uint32_t kNumIterations = 5000;
+enum OutputFormat {
+  kFormatText = 0,
+  kFormatCsv  = 1,
+  kFormatJson = 2
+};
+
+struct BenchConfig {
+  uint32_t warmup;                       //!< Number of samples discarded before measuring.
+  uint32_t samples;                      //!< Number of measured samples.
+  uint32_t iterations;                   //!< Number of code generations per sample.
+  uint32_t rounds;                       //!< Number of instruction groups per category.
+  uint32_t labels;                       //!< Number of labels created by label benchmarks.
+  uint32_t functions;                    //!< Number of functions compiled by the concurrent benchmark.
+  uint32_t threads;                      //!< Maximum number of threads used by the concurrent benchmark.
+  uint32_t format;                       //!< Output format, see \ref OutputFormat.
+  bool loopAlign;                        //!< Run also the loop alignment benchmark.
+  bool passStats;                        //!< Collect and print statistics of passes.
+  const char* passes;                    //!< Passes enabled by name in X86Compiler, see `CodeBuilder::setPassOptions()`.
+};
+
+static const uint32_t kMaxSamples = 1024;
+static const uint32_t kMaxThreads = 64;
+
+static BenchConfig benchConfig = {
+  3,                                     // warmup
+  15,                                    // samples
+  20,                                    // iterations
+  64,                                    // rounds
+  1000000,                               // labels
+  256,                                   // functions
+  8,                                     // threads
+  kFormatText,                           // format
+  true,                                  // loopAlign
+  false,                                 // passStats
+  nullptr                                // passes
+};
+
+static bool parseUIntArg(const char* arg, const char* name, uint32_t& out) {
+  size_t len = ::strlen(name);
+  if (::strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+
+  out = static_cast<uint32_t>(::strtoul(arg + len + 1, nullptr, 10));
+  return true;
+}
+
+static bool parseStringArg(const char* arg, const char* name, const char*& out) {
+  size_t len = ::strlen(name);
+  if (::strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+
+  out = arg + len + 1;
+  return true;
+}
+
+static void parseArgs(int argc, char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+
+    if (::strcmp(arg, "--csv") == 0)
+      benchConfig.format = kFormatCsv;
+    else if (::strcmp(arg, "--json") == 0)
+      benchConfig.format = kFormatJson;
+    else if (::strcmp(arg, "--no-loop-align") == 0)
+      benchConfig.loopAlign = false;
+    else if (::strcmp(arg, "--pass-stats") == 0)
+      benchConfig.passStats = true;
+    else if (parseStringArg(arg, "--passes", benchConfig.passes))
+      continue;
+    else if (parseUIntArg(arg, "--warmup", benchConfig.warmup) ||
+             parseUIntArg(arg, "--samples", benchConfig.samples) ||
+             parseUIntArg(arg, "--iterations", benchConfig.iterations) ||
+             parseUIntArg(arg, "--rounds", benchConfig.rounds) ||
+             parseUIntArg(arg, "--labels", benchConfig.labels) ||
+             parseUIntArg(arg, "--functions", benchConfig.functions) ||
+             parseUIntArg(arg, "--threads", benchConfig.threads))
+      continue;
+    else
+      fprintf(stderr, "Unknown argument '%s' (ignored)\n", arg);
+  }
+
+  if (benchConfig.samples == 0) benchConfig.samples = 1;
+  if (benchConfig.samples > kMaxSamples) benchConfig.samples = kMaxSamples;
+  if (benchConfig.iterations == 0) benchConfig.iterations = 1;
+  if (benchConfig.rounds == 0) benchConfig.rounds = 1;
+  if (benchConfig.threads == 0) benchConfig.threads = 1;
+  if (benchConfig.threads > kMaxThreads) benchConfig.threads = kMaxThreads;
+}
 
 // ============================================================================
 // [Performance]
 // ============================================================================
 
+//! Collects nanosecond samples and calculates statistics from them.
 struct Performance {
-  static inline uint32_t now() {
-    return OSUtils::getTickCount();
+  static inline uint64_t now() {
+    return OSUtils::getNanoTickCount();
   }
 
-  inline void reset() {
-    tick = 0;
-    best = 0xFFFFFFFF;
+  static int compareSamples(const void* a, const void* b) {
+    uint64_t x = *static_cast<const uint64_t*>(a);
+    uint64_t y = *static_cast<const uint64_t*>(b);
+    return x < y ? -1 : x > y ? 1 : 0;
   }
 
-  inline uint32_t start() { return (tick = now()); }
-  inline uint32_t diff() const { return now() - tick; }
+  inline void reset() { count = 0; }
+  inline void start() { tick = now(); }
 
-  inline uint32_t end() {
-    tick = diff();
-    if (best > tick)
-      best = tick;
-    return tick;
+  //! End the sample, `divisor` is the number of operations measured.
+  inline void end(uint32_t divisor) {
+    uint64_t t = (now() - tick) / divisor;
+    if (count < kMaxSamples)
+      samples[count++] = t;
   }
 
-  uint32_t tick;
-  uint32_t best;
+  //! Sort samples so percentiles can be calculated.
+  inline void finish() {
+    ::qsort(samples, count, sizeof(uint64_t), compareSamples);
+  }
+
+  //! Get the `p`-th percentile (nearest-rank), samples must be sorted.
+  inline uint64_t percentile(uint32_t p) const {
+    if (!count) return 0;
+    uint32_t rank = (p * count + 99) / 100;
+    return samples[rank ? rank - 1 : 0];
+  }
+
+  inline uint64_t mean() const {
+    if (!count) return 0;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; i++)
+      sum += samples[i];
+    return sum / count;
+  }
+
+  uint64_t tick;
+  uint32_t count;
+  uint64_t samples[kMaxSamples];
+};
+
+// ============================================================================
+// [Output]
+// ============================================================================
+
+struct BenchResult {
+  const char* pipeline;                  //!< Emitter used to generate the code.
+  const char* arch;                      //!< Target architecture.
+  char category[32];                     //!< Category of instructions generated.
+  uint64_t min;                          //!< Minimum time of one run [ns].
+  uint64_t median;                       //!< Median time of one run [ns].
+  uint64_t p90;                          //!< 90th percentile [ns].
+  uint64_t p99;                          //!< 99th percentile [ns].
+  uint64_t mean;                         //!< Mean time of one run [ns].
+  size_t codeSize;                       //!< Size of code generated by one run.
+  uint32_t instCount;                    //!< Instructions emitted by one run (0 if unknown).
 };
 
-static double mbps(uint32_t time, size_t outputSize) {
-  if (!time) return 0.0;
+static uint32_t resultCount;
+
+static void printHeader() {
+  switch (benchConfig.format) {
+    case kFormatText:
+      printf("%-12s %-4s %-16s | %10s %10s %10s %10s | %8s | %9s | %7s\n",
+        "Pipeline", "Arch", "Category", "Min [us]", "Med [us]", "P90 [us]", "P99 [us]", "Size", "MB/s", "ns/inst");
+      break;
+
+    case kFormatCsv:
+      printf("version,pipeline,arch,category,samples,iterations,min_ns,median_ns,p90_ns,p99_ns,mean_ns,code_size,inst_count\n");
+      break;
 
-  double bytesTotal = static_cast<double>(outputSize);
-  return (bytesTotal * 1000) / (static_cast<double>(time) * 1024 * 1024);
+    case kFormatJson:
+      printf("{\n");
+      printf("  \"version\": \"%d.%d.%d\",\n", ASMJIT_VERSION_MAJOR, ASMJIT_VERSION_MINOR, ASMJIT_VERSION_PATCH);
+      printf("  \"samples\": %u,\n", benchConfig.samples);
+      printf("  \"iterations\": %u,\n", benchConfig.iterations);
+      printf("  \"results\": [");
+      break;
+  }
+}
+
+static void printFooter() {
+  if (benchConfig.format == kFormatJson)
+    printf("\n  ]\n}\n");
 }
 
 // ============================================================================
-// [Main]
+// [Pass Statistics]
+// ============================================================================
+
+//! Statistics of a pass accumulated over all benchmarks.
+struct PassTotal {
+  const char* name;                      //!< Name of the pass.
+  CBPassStats stats;                     //!< Statistics of all runs.
+  uint32_t funcCount;                    //!< Number of functions recorded.
+  uint64_t maxFuncTime;                  //!< The longest time spent in a single function.
+};
+
+static const uint32_t kMaxPasses = 16;
+static PassTotal passTotals[kMaxPasses];
+static uint32_t passTotalCount;
+
+//! Enable passes and pass statistics of a compiler as requested by the command line.
+static Error setupPasses(CodeBuilder& cc) {
+  cc.setPassStatsEnabled(benchConfig.passStats);
+  return benchConfig.passes ? cc.setPassOptions(benchConfig.passes) : kErrorOk;
+}
+
+static PassTotal* getPassTotal(const char* name) {
+  for (uint32_t i = 0; i < passTotalCount; i++)
+    if (::strcmp(passTotals[i].name, name) == 0)
+      return &passTotals[i];
+
+  if (passTotalCount == kMaxPasses)
+    return nullptr;
+
+  PassTotal* total = &passTotals[passTotalCount++];
+  ::memset(total, 0, sizeof(PassTotal));
+  total->name = name;
+  return total;
+}
+
+//! Add records of passes run by `cb` to the totals.
+static void collectPassStats(const CodeBuilder& cb) {
+  const ZoneVector<CBPassRecord>& records = cb.getPassRecords();
+
+  for (size_t i = 0, len = records.getLength(); i < len; i++) {
+    const CBPassRecord& record = records[i];
+    PassTotal* total = getPassTotal(record.pass->getName());
+    if (!total) continue;
+
+    if (record.func) {
+      total->funcCount++;
+      if (total->maxFuncTime < record.stats.getTime())
+        total->maxFuncTime = record.stats.getTime();
+    }
+    else {
+      total->stats.add(record.stats);
+    }
+  }
+}
+
+//! Print the totals, to stderr if the output is CSV or JSON.
+static void printPassStats() {
+  FILE* out = benchConfig.format == kFormatText ? stdout : stderr;
+  uint64_t totalTime = 0;
+
+  for (uint32_t i = 0; i < passTotalCount; i++)
+    totalTime += passTotals[i].stats.getTime();
+
+  fprintf(out, "\n%-14s | %8s | %10s %6s | %10s | %10s %10s | %9s %9s | %8s %12s\n",
+    "Pass", "Runs", "Time [ms]", "Share", "Zone [KB]", "Nodes In", "Nodes Out", "Spills", "Moves", "Funcs", "Max Fn [us]");
+
+  for (uint32_t i = 0; i < passTotalCount; i++) {
+    const PassTotal& total = passTotals[i];
+    const CBPassStats& stats = total.stats;
+
+    fprintf(out, "%-14s | %8u | %10.3f %5.1f%% | %10.1f | %10u %10u | %9u %9u | %8u %12.3f\n",
+      total.name,
+      stats.getRunCount(),
+      double(stats.getTime()) / 1e6,
+      totalTime ? 100.0 * double(stats.getTime()) / double(totalTime) : 0.0,
+      double(stats.getZoneSize()) / 1024.0,
+      stats.getNodesIn(),
+      stats.getNodesOut(),
+      stats.getSpillCount(),
+      stats.getMoveCount(),
+      total.funcCount,
+      double(total.maxFuncTime) / 1e3);
+  }
+}
+
+static void printResult(const BenchResult& r) {
+  switch (benchConfig.format) {
+    case kFormatText: {
+      double mbps = r.median ? (double(r.codeSize) * 1e9) / (double(r.median) * 1024 * 1024) : 0.0;
+
+      printf("%-12s %-4s %-16s | %10.3f %10.3f %10.3f %10.3f | %8u | %9.3f | ",
+        r.pipeline, r.arch, r.category,
+        double(r.min) / 1e3, double(r.median) / 1e3, double(r.p90) / 1e3, double(r.p99) / 1e3,
+        static_cast<unsigned int>(r.codeSize), mbps);
+
+      if (r.instCount)
+        printf("%7.2f\n", double(r.median) / double(r.instCount));
+      else
+        printf("%7s\n", "-");
+      break;
+    }
+
+    case kFormatCsv:
+      printf("%d.%d.%d,%s,%s,%s,%u,%u,%llu,%llu,%llu,%llu,%llu,%u,%u\n",
+        ASMJIT_VERSION_MAJOR, ASMJIT_VERSION_MINOR, ASMJIT_VERSION_PATCH,
+        r.pipeline, r.arch, r.category, benchConfig.samples, benchConfig.iterations,
+        (unsigned long long)r.min, (unsigned long long)r.median,
+        (unsigned long long)r.p90, (unsigned long long)r.p99, (unsigned long long)r.mean,
+        static_cast<unsigned int>(r.codeSize), r.instCount);
+      break;
+
+    case kFormatJson:
+      printf("%s\n    { \"pipeline\": \"%s\", \"arch\": \"%s\", \"category\": \"%s\", "
+             "\"min_ns\": %llu, \"median_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"mean_ns\": %llu, "
+             "\"code_size\": %u, \"inst_count\": %u }",
+        resultCount ? "," : "",
+        r.pipeline, r.arch, r.category,
+        (unsigned long long)r.min, (unsigned long long)r.median,
+        (unsigned long long)r.p90, (unsigned long long)r.p99, (unsigned long long)r.mean,
+        static_cast<unsigned int>(r.codeSize), r.instCount);
+      break;
+  }
+
+  resultCount++;
+  fflush(stdout);
+}
+
+static void fillResult(BenchResult& r, const char* pipeline, const char* arch, const char* category, Performance& perf, size_t codeSize, uint32_t instCount) {
+  perf.finish();
+
+  r.pipeline = pipeline;
+  r.arch = arch;
+  snprintf(r.category, ASMJIT_ARRAY_SIZE(r.category), "%s", category);
+  r.min = perf.percentile(0);
+  r.median = perf.percentile(50);
+  r.p90 = perf.percentile(90);
+  r.p99 = perf.percentile(99);
+  r.mean = perf.mean();
+  r.codeSize = codeSize;
+  r.instCount = instCount;
+}
+
+// ============================================================================
+// [Categories]
+// ============================================================================
+
+enum Category {
+  kCategoryGp,
+  kCategorySse,
+  kCategoryAvx,
+  kCategoryAvx512,
+  kCategoryMem,
+  kCategoryJump,
+  kCategoryCount
+};
+
+static const char* categoryNames[kCategoryCount] = {
+  "GP",
+  "SSE",
+  "AVX",
+  "AVX512",
+  "Mem",
+  "Jump"
+};
+
+//! Registers used by generators, physical for Assembler/Builder and virtual
+//! for Compiler.
+struct BenchRegs {
+  uint32_t gpCount;
+  uint32_t vecCount;
+
+  X86Gp gp[16];
+  X86Xmm xmm[16];
+  X86Ymm ymm[16];
+  X86Zmm zmm[16];
+  X86KReg k[8];
+};
+
+static void initPhysRegs(BenchRegs& r, uint32_t archType) {
+  bool is64 = archType == ArchInfo::kTypeX64;
+
+  r.gpCount = 0;
+  r.vecCount = is64 ? 16 : 8;
+
+  for (uint32_t i = 0; i < (is64 ? 16U : 8U); i++) {
+    if (i == X86Gp::kIdSp) continue;
+    r.gp[r.gpCount++] = is64 ? X86Gp(x86::gpq(i)) : X86Gp(x86::gpd(i));
+  }
+
+  for (uint32_t i = 0; i < r.vecCount; i++) {
+    r.xmm[i] = x86::xmm(i);
+    r.ymm[i] = x86::ymm(i);
+    r.zmm[i] = x86::zmm(i);
+  }
+
+  for (uint32_t i = 0; i < 8; i++)
+    r.k[i] = x86::k(i);
+}
+
+static void initVirtRegs(BenchRegs& r, X86Compiler& cc) {
+  r.gpCount = 6;
+  r.vecCount = 8;
+
+  for (uint32_t i = 0; i < r.gpCount; i++)
+    r.gp[i] = cc.newIntPtr();
+
+  for (uint32_t i = 0; i < r.vecCount; i++) {
+    r.xmm[i] = cc.newXmm();
+    r.ymm[i] = cc.newYmm();
+    r.zmm[i] = cc.newZmm();
+  }
+
+  for (uint32_t i = 0; i < 8; i++)
+    r.k[i] = cc.newKw();
+}
+
+template<typename Emitter>
+static uint32_t generateGp(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  for (uint32_t i = 0; i < rounds; i++) {
+    const X86Gp& a = r.gp[i % r.gpCount];
+    const X86Gp& b = r.gp[(i + 1) % r.gpCount];
+    const X86Gp& c = r.gp[(i + 3) % r.gpCount];
+
+    e.mov(a, b);
+    e.add(a, c);
+    e.sub(b, imm(i & 0xFF));
+    e.imul(a, b);
+    e.and_(c, imm(0x7F));
+    e.or_(a, c);
+    e.xor_(b, a);
+    e.shl(c, imm(i & 31));
+    e.cmp(a, b);
+    e.inc(c);
+    e.neg(b);
+    e.adc(a, imm(i));
+  }
+  return rounds * 12;
+}
+
+template<typename Emitter>
+static uint32_t generateSse(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  for (uint32_t i = 0; i < rounds; i++) {
+    const X86Xmm& a = r.xmm[i % r.vecCount];
+    const X86Xmm& b = r.xmm[(i + 1) % r.vecCount];
+    const X86Xmm& c = r.xmm[(i + 3) % r.vecCount];
+
+    e.movaps(a, b);
+    e.addps(a, c);
+    e.mulps(b, a);
+    e.subps(c, b);
+    e.pxor(a, c);
+    e.paddd(b, a);
+    e.pshufd(c, a, imm(0x1B));
+    e.shufps(a, b, imm(0x44));
+    e.cvtdq2ps(b, c);
+    e.pmullw(a, b);
+    e.minps(c, a);
+    e.sqrtps(b, c);
+  }
+  return rounds * 12;
+}
+
+template<typename Emitter>
+static uint32_t generateAvx(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  for (uint32_t i = 0; i < rounds; i++) {
+    const X86Ymm& a = r.ymm[i % r.vecCount];
+    const X86Ymm& b = r.ymm[(i + 1) % r.vecCount];
+    const X86Ymm& c = r.ymm[(i + 3) % r.vecCount];
+
+    e.vmovaps(a, b);
+    e.vaddps(a, b, c);
+    e.vmulps(b, a, c);
+    e.vfmadd231ps(c, a, b);
+    e.vxorps(a, b, c);
+    e.vpermilps(b, a, imm(0x1B));
+    e.vblendps(c, a, b, imm(0x0F));
+    e.vperm2f128(a, b, c, imm(0x21));
+    e.vsqrtps(b, c);
+    e.vpaddd(c, a, b);
+    e.vpshufb(a, b, c);
+    e.vmaxps(b, c, a);
+  }
+  return rounds * 12;
+}
+
+template<typename Emitter>
+static uint32_t generateAvx512(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  for (uint32_t i = 0; i < rounds; i++) {
+    const X86Zmm& a = r.zmm[i % r.vecCount];
+    const X86Zmm& b = r.zmm[(i + 1) % r.vecCount];
+    const X86Zmm& c = r.zmm[(i + 3) % r.vecCount];
+    const X86KReg& k = r.k[1 + (i % 7)];
+
+    e.vmovaps(a, b);
+    e.vaddps(a, b, c);
+    e.k(k).vmulps(b, a, c);
+    e.vfmadd231ps(c, a, b);
+    e.vpxord(a, b, c);
+    e.vpternlogd(b, a, c, imm(0x96));
+    e.vpermd(c, a, b);
+    e.k(k).z().vmovaps(a, c);
+    e.vpaddd(b, c, a);
+    e.vpcmpd(k, a, b, imm(1));
+    e.vsqrtps(c, b);
+    e.vmaxps(a, b, c);
+  }
+  return rounds * 12;
+}
+
+template<typename Emitter>
+static uint32_t generateMem(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  const X86Gp& base = r.gp[r.gpCount - 1];
+  const X86Gp& index = r.gp[r.gpCount - 2];
+
+  for (uint32_t i = 0; i < rounds; i++) {
+    const X86Gp& a = r.gp[i % (r.gpCount - 2)];
+    const X86Xmm& x = r.xmm[i % r.vecCount];
+    int32_t disp = static_cast<int32_t>(i * 8);
+
+    e.mov(a, x86::ptr(base, index, 2, disp));
+    e.add(x86::ptr(base, disp), a);
+    e.movdqu(x, x86::ptr(base, index, 3, disp + 1024));
+    e.movdqu(x86::ptr(base, disp), x);
+    e.cmp(x86::dword_ptr(base, disp), imm(i));
+    e.lea(a, x86::ptr(base, index, 1, disp));
+    e.movzx(a.r32(), x86::byte_ptr(base, index));
+    e.inc(x86::dword_ptr(base, index, 2));
+    e.test(x86::dword_ptr(base, disp), a.r32());
+    e.addps(x, x86::ptr(base, disp + 16));
+    e.vpaddd(x, x, x86::ptr(base, index, 0, disp));
+    e.xchg(x86::ptr(base, disp), a);
+  }
+  return rounds * 12;
+}
+
+template<typename Emitter>
+static uint32_t generateJump(Emitter& e, const BenchRegs& r, uint32_t rounds) {
+  const X86Gp& a = r.gp[0];
+  const X86Gp& b = r.gp[1];
+  uint32_t count = 0;
+
+  Label back = e.newLabel();
+  e.bind(back);
+
+  for (uint32_t i = 0; i < rounds; i++) {
+    Label fwd = e.newLabel();
+
+    e.cmp(a, imm(i));
+    e.jz(fwd);
+    e.add(a, b);
+    e.test(b, a);
+    e.jnz(back);
+    count += 5;
+
+    if ((i & 3) == 0) {
+      e.jmp(fwd);
+      count++;
+    }
+
+    e.sub(b, 1);
+    e.bind(fwd);
+    count++;
+
+    if ((i & 15) == 15) {
+      back = e.newLabel();
+      e.bind(back);
+    }
+  }
+
+  return count;
+}
+
+template<typename Emitter>
+static uint32_t generateCategory(Emitter& e, uint32_t category, const BenchRegs& r) {
+  uint32_t rounds = benchConfig.rounds;
+
+  switch (category) {
+    case kCategoryGp    : return generateGp(e, r, rounds);
+    case kCategorySse   : return generateSse(e, r, rounds);
+    case kCategoryAvx   : return generateAvx(e, r, rounds);
+    case kCategoryAvx512: return generateAvx512(e, r, rounds);
+    case kCategoryMem   : return generateMem(e, r, rounds);
+    case kCategoryJump  : return generateJump(e, r, rounds);
+
+    default:
+      return 0;
+  }
+}
+
+// ============================================================================
+// [Bench - Pipelines]
 // ============================================================================
 
 #if defined(ASMJIT_BUILD_X86)
-static void benchX86(uint32_t archType) {
-  CodeHolder code;
-  Performance perf;
+enum Pipeline {
+  kPipelineAssembler,
+  kPipelineBuilder,
+  kPipelineCompiler
+};
 
-  X86Assembler a;
-  X86Compiler cc;
+static const char* pipelineNames[] = {
+  "X86Assembler",
+  "X86Builder",
+  "X86Compiler"
+};
 
-  uint32_t r, i;
-  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+// Since we don't have JitRuntime we don't know anything about function calling
+// conventions, which is required by the compiler, so we must setup it manually.
+static CodeInfo makeCodeInfo(uint32_t archType) {
+  CodeInfo ci(archType);
+  ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+  return ci;
+}
 
-  // --------------------------------------------------------------------------
-  // [Bench - Assembler]
-  // --------------------------------------------------------------------------
+//! Generate code of the given `category` once, `category` equal to
+//! `kCategoryCount` means the full opcode corpus (Assembler and Builder) or
+//! the alpha-blend function (Compiler).
+static Error runOnce(CodeHolder& code, uint32_t pipeline, uint32_t archType, uint32_t category, size_t& codeSize, uint32_t& instCount) {
+  Error err = kErrorOk;
+  BenchRegs regs;
 
-  size_t asmOutputSize = 0;
-  size_t cmpOutputSize = 0;
+  code.init(makeCodeInfo(archType));
 
-  perf.reset();
-  for (r = 0; r < kNumRepeats; r++) {
-    asmOutputSize = 0;
-    perf.start();
-    for (i = 0; i < kNumIterations; i++) {
-      code.init(CodeInfo(archType));
-      code.attach(&a);
+  switch (pipeline) {
+    case kPipelineAssembler: {
+      X86Assembler a(&code);
+      if (category == kCategoryCount) {
+        asmtest::generateOpcodes(a);
+        instCount = 0;
+      }
+      else {
+        initPhysRegs(regs, archType);
+        instCount = generateCategory(a, category, regs);
+      }
+      err = a.getLastError();
+      break;
+    }
+
+    case kPipelineBuilder: {
+      X86Builder cb(&code);
+      cb.setPassStatsEnabled(benchConfig.passStats);
 
-      asmtest::generateOpcodes(a);
-      asmOutputSize += code.getCodeSize();
+      initPhysRegs(regs, archType);
+      instCount = generateCategory(cb, category, regs);
+      err = cb.finalize();
+      collectPassStats(cb);
+      break;
+    }
+
+    case kPipelineCompiler: {
+      X86Compiler cc(&code);
+      err = setupPasses(cc);
+      if (err) break;
 
-      code.reset(false); // Detaches `a`.
+      if (category == kCategoryCount) {
+        asmtest::generateAlphaBlend(cc);
+        instCount = 0;
+      }
+      else {
+        cc.addFunc(FuncSignature0<void>(CallConv::kIdHost));
+        initVirtRegs(regs, cc);
+        instCount = generateCategory(cc, category, regs);
+        cc.endFunc();
+      }
+      err = cc.finalize();
+      collectPassStats(cc);
+      break;
     }
-    perf.end();
   }
 
-  printf("%-12s (%s) | Time: %-6u [ms] | Speed: %7.3f [MB/s]\n",
-    "X86Assembler", archName, perf.best, mbps(perf.best, asmOutputSize));
+  codeSize = code.getCodeSize();
+  code.reset(false);
+  return err;
+}
 
-  // --------------------------------------------------------------------------
-  // [Bench - CodeBuilder]
-  // --------------------------------------------------------------------------
+static void benchPipeline(uint32_t pipeline, uint32_t archType, uint32_t category) {
+  CodeHolder code;
+  Performance perf;
 
-  // TODO:
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+  const char* categoryName = category == kCategoryCount
+    ? (pipeline == kPipelineCompiler ? "AlphaBlend" : "Opcodes")
+    : categoryNames[category];
 
-  // --------------------------------------------------------------------------
-  // [Bench - CodeCompiler]
-  // --------------------------------------------------------------------------
+  size_t codeSize = 0;
+  uint32_t instCount = 0;
 
   perf.reset();
-  for (r = 0; r < kNumRepeats; r++) {
-    cmpOutputSize = 0;
+  for (uint32_t s = 0; s < benchConfig.warmup + benchConfig.samples; s++) {
     perf.start();
-    for (i = 0; i < kNumIterations; i++) {
-      // NOTE: Since we don't have JitRuntime we don't know anything about
-      // function calling conventions, which is required by generateAlphaBlend.
-      // So we must setup this manually.
-      CodeInfo ci(archType);
-      ci.setCdeclCallConv(archType == ArchInfo::kTypeX86 ? CallConv::kIdX86CDecl : CallConv::kIdX86SysV64);
+    for (uint32_t i = 0; i < benchConfig.iterations; i++) {
+      Error err = runOnce(code, pipeline, archType, category, codeSize, instCount);
+      if (ASMJIT_UNLIKELY(err)) {
+        fprintf(stderr, "%s (%s) %s: %s\n", pipelineNames[pipeline], archName, categoryName, DebugUtils::errorAsString(err));
+        return;
+      }
+    }
 
-      code.init(ci);
-      code.attach(&cc);
+    if (s < benchConfig.warmup)
+      continue;
+    perf.end(benchConfig.iterations);
+  }
+
+  BenchResult r;
+  fillResult(r, pipelineNames[pipeline], archName, categoryName, perf, codeSize, instCount);
+  printResult(r);
+}
 
-      asmtest::generateAlphaBlend(cc);
+static void benchX86(uint32_t archType) {
+  // Opcode corpus.
+  benchPipeline(kPipelineAssembler, archType, kCategoryCount);
+
+  for (uint32_t c = 0; c < kCategoryCount; c++)
+    benchPipeline(kPipelineAssembler, archType, c);
+
+  for (uint32_t c = 0; c < kCategoryCount; c++)
+    benchPipeline(kPipelineBuilder, archType, c);
+
+  // Alpha-blend function.
+  benchPipeline(kPipelineCompiler, archType, kCategoryCount);
+
+  // The register allocator doesn't handle AVX-512 mask registers yet.
+  for (uint32_t c = 0; c < kCategoryCount; c++)
+    if (c != kCategoryAvx512)
+      benchPipeline(kPipelineCompiler, archType, c);
+}
+
+// ============================================================================
+// [Bench - Loop Alignment]
+// ============================================================================
+
+typedef uint32_t (*LoopFunc)(uint32_t);
+
+// Generate a tight loop preceded by `misalign` bytes of NOPs. The loop is
+// not aligned explicitly, so its header is placed at `misalign` offset unless
+// the alignment policy of `cc` moves it.
+static void generateTightLoop(X86Compiler& cc, uint32_t misalign, Label& loop) {
+  cc.addFunc(FuncSignature1<uint32_t, uint32_t>(CallConv::kIdHost));
+
+  X86Gp n = cc.newUInt32("n");
+  X86Gp acc = cc.newUInt32("acc");
+  X86Gp tmp = cc.newUInt32("tmp");
+
+  loop = cc.newLabel();
+  cc.setArg(0, n);
+  cc.xor_(acc, acc);
+
+  for (uint32_t i = 0; i < misalign; i++)
+    cc.nop();
+
+  cc.bind(loop);
+  cc.mov(tmp, n);
+  cc.shr(tmp, 1);
+  cc.add(acc, tmp);
+  cc.xor_(acc, n);
+  cc.sub(n, 1);
+  cc.jnz(loop);
+
+  cc.ret(acc);
+  cc.endFunc();
+}
+
+static void benchLoopAlignment() {
+  static const uint32_t kLoopIterations = 100000000;
+  static const uint32_t misalignments[] = { 0, 13, 27, 30 };
+
+  JitRuntime rt;
+  Performance perf;
+
+  const char* archName = rt.getArchType() == ArchInfo::kTypeX86 ? "X86" : "X64";
+
+  for (uint32_t m = 0; m < ASMJIT_ARRAY_SIZE(misalignments); m++) {
+    for (uint32_t policy = 0; policy < 2; policy++) {
+      CodeHolder code;
+      code.init(rt.getCodeInfo());
+
+      X86Compiler cc(&code);
+      if (policy) {
+        cc.setFuncAlignment(16);
+        cc.setLoopAlignment(32, 31);
+      }
+
+      Label loop;
+      generateTightLoop(cc, misalignments[m], loop);
       cc.finalize();
-      cmpOutputSize += code.getCodeSize();
 
-      code.reset(false); // Detaches `cc`.
+      intptr_t loopOffset = code.getLabelOffset(loop);
+      LoopFunc fn;
+      if (rt.add(&fn, &code) != kErrorOk) {
+        fprintf(stderr, "LoopAlign: Failed to add the generated function\n");
+        return;
+      }
+
+      // Runs of the generated code are much longer than code generation,
+      // thus the number of samples is limited.
+      uint32_t numSamples = benchConfig.samples < 5 ? benchConfig.samples : 5;
+      volatile uint32_t result = 0;
+
+      perf.reset();
+      for (uint32_t s = 0; s < numSamples + 1; s++) {
+        perf.start();
+        result += fn(kLoopIterations);
+        if (s) perf.end(1);
+      }
+      rt.release(fn);
+
+      char category[32];
+      snprintf(category, ASMJIT_ARRAY_SIZE(category), "LoopAlign%s@%u",
+        policy ? "On" : "Off", static_cast<unsigned int>(loopOffset));
+
+      BenchResult r;
+      fillResult(r, "JitRuntime", archName, category, perf, code.getCodeSize(), 0);
+      printResult(r);
+    }
+  }
+}
+
+// ============================================================================
+// [Bench - Labels]
+// ============================================================================
+
+enum LabelBench {
+  kLabelBenchNew,
+  kLabelBenchForward,
+  kLabelBenchBackward,
+  kLabelBenchCount
+};
+
+static const char* labelBenchNames[kLabelBenchCount] = {
+  "LabelsNew",
+  "LabelsFwd",
+  "LabelsBack"
+};
+
+// Generate code similar to a large state machine. `kLabelBenchNew` only
+// creates labels, `kLabelBenchForward` references each label by two forward
+// jumps from a block of 4096 states that are all pending at the same time and
+// binds it later, `kLabelBenchBackward` binds labels first and then jumps to
+// them from far away. The "ns/inst" column shows nanoseconds per label.
+static Error generateLabels(X86Assembler& a, uint32_t bench, uint32_t count) {
+  static const uint32_t kBlockSize = 4096;
+
+  Label* labels = static_cast<Label*>(::malloc(kBlockSize * sizeof(Label)));
+  if (!labels) return DebugUtils::errored(kErrorNoHeapMemory);
+
+  for (uint32_t base = 0; base < count; base += kBlockSize) {
+    uint32_t n = count - base < kBlockSize ? count - base : kBlockSize;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+      labels[i] = a.newLabel();
+
+    switch (bench) {
+      case kLabelBenchForward:
+        // Scatter references so links of different labels interleave.
+        for (i = 0; i < n; i++) {
+          a.jz(labels[(i * 7) % n]);
+          a.jnz(labels[(i * 13 + 5) % n]);
+        }
+        for (i = 0; i < n; i++) {
+          a.bind(labels[i]);
+          a.inc(x86::eax);
+        }
+        break;
+
+      case kLabelBenchBackward:
+        for (i = 0; i < n; i++) {
+          a.bind(labels[i]);
+          a.inc(x86::eax);
+        }
+        for (i = 0; i < n; i++)
+          a.jnz(labels[(i * 7) % n]);
+        break;
     }
-    perf.end();
   }
 
-  printf("%-12s (%s) | Time: %-6u [ms] | Speed: %7.3f [MB/s]\n",
-    "X86Compiler", archName, perf.best, mbps(perf.best, cmpOutputSize));
+  ::free(labels);
+  return a.getLastError();
+}
+
+static void benchLabels(uint32_t archType) {
+  CodeHolder code;
+  Performance perf;
+
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+  uint32_t count = benchConfig.labels;
+
+  // Each sample creates millions of labels, thus the number of samples is
+  // limited.
+  uint32_t numSamples = benchConfig.samples < 5 ? benchConfig.samples : 5;
+
+  for (uint32_t bench = 0; bench < kLabelBenchCount; bench++) {
+    size_t codeSize = 0;
+
+    perf.reset();
+    for (uint32_t s = 0; s < numSamples + 1; s++) {
+      code.init(makeCodeInfo(archType));
+      X86Assembler a(&code);
+
+      perf.start();
+      Error err = generateLabels(a, bench, count);
+      if (s) perf.end(1);
+
+      codeSize = code.getCodeSize();
+      code.reset(false);
+
+      if (ASMJIT_UNLIKELY(err)) {
+        fprintf(stderr, "%s (%s): %s\n", labelBenchNames[bench], archName, DebugUtils::errorAsString(err));
+        return;
+      }
+    }
+
+    BenchResult r;
+    fillResult(r, "X86Assembler", archName, labelBenchNames[bench], perf, codeSize, count);
+    printResult(r);
+  }
+}
+
+// ============================================================================
+// [Bench - Templates]
+// ============================================================================
+
+static const uint32_t kTemplateCopies = 16;
+
+//! Create nodes of `kTemplateCopies` copies of the GP category in a single
+//! function, either by emitting them or by instantiating `tmpl`. Only the
+//! creation of nodes is measured, the function is not finalized.
+static Error generateCopies(CodeHolder& code, uint32_t archType, const CBTemplate* tmpl, Performance& perf, bool measure) {
+  code.init(makeCodeInfo(archType));
+
+  X86Compiler cc(&code);
+  BenchRegs regs;
+
+  cc.addFunc(FuncSignature0<void>(CallConv::kIdHost));
+  initVirtRegs(regs, cc);
+
+  if (measure) perf.start();
+  for (uint32_t i = 0; i < kTemplateCopies; i++) {
+    if (tmpl)
+      tmpl->instantiate(&cc, regs.gp, nullptr, nullptr);
+    else
+      generateGp(cc, regs, benchConfig.rounds);
+  }
+  if (measure) perf.end(1);
+
+  cc.endFunc();
+  Error err = cc.getLastError();
+
+  code.reset(false);
+  return err;
+}
+
+static void benchTemplates(uint32_t archType) {
+  CodeHolder code;
+  Performance perf;
+
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+  uint32_t instCount = 0;
+
+  // Record the GP category once, all registers are parameters.
+  CBTemplate tmpl;
+  {
+    code.init(makeCodeInfo(archType));
+
+    X86Compiler cc(&code);
+    BenchRegs regs;
+
+    cc.addFunc(FuncSignature0<void>(CallConv::kIdHost));
+    initVirtRegs(regs, cc);
+
+    for (uint32_t i = 0; i < regs.gpCount; i++)
+      tmpl.addRegParam(regs.gp[i]);
+
+    CBNode* prev = cc.getCursor();
+    instCount = generateGp(cc, regs, benchConfig.rounds) * kTemplateCopies;
+
+    Error err = tmpl.record(&cc, prev->getNext(), cc.getCursor());
+    code.reset(false);
+
+    if (ASMJIT_UNLIKELY(err)) {
+      fprintf(stderr, "Template (%s): %s\n", archName, DebugUtils::errorAsString(err));
+      return;
+    }
+  }
+
+  static const char* benchNames[] = { "EmitGP", "TemplateGP" };
+  for (uint32_t bench = 0; bench < ASMJIT_ARRAY_SIZE(benchNames); bench++) {
+    perf.reset();
+    for (uint32_t s = 0; s < benchConfig.warmup + benchConfig.samples; s++) {
+      Error err = generateCopies(code, archType, bench ? &tmpl : nullptr, perf, s >= benchConfig.warmup);
+      if (ASMJIT_UNLIKELY(err)) {
+        fprintf(stderr, "%s (%s): %s\n", benchNames[bench], archName, DebugUtils::errorAsString(err));
+        return;
+      }
+    }
+
+    BenchResult r;
+    fillResult(r, "X86Compiler", archName, benchNames[bench], perf, 0, instCount);
+    printResult(r);
+  }
+}
+
+// ============================================================================
+// [Bench - Concurrent Functions]
+// ============================================================================
+
+//! Executor that runs each task on its own thread, the calling thread runs
+//! the first one. Without threads support tasks run sequentially.
+class BenchExecutor : public CCExecutor {
+public:
+  explicit BenchExecutor(uint32_t numThreads) : _numThreads(numThreads) {}
+
+  virtual uint32_t getConcurrency() const noexcept { return _numThreads; }
+
+  virtual void run(TaskFunc func, void* data, uint32_t count) noexcept {
+#if ASMJIT_OS_POSIX
+    pthread_t threads[kMaxThreads];
+    Task tasks[kMaxThreads];
+    bool started[kMaxThreads];
+
+    if (count > kMaxThreads) count = kMaxThreads;
+    for (uint32_t i = 1; i < count; i++) {
+      tasks[i].func = func;
+      tasks[i].data = data;
+      tasks[i].index = i;
+      started[i] = pthread_create(&threads[i], nullptr, threadEntry, &tasks[i]) == 0;
+      if (!started[i]) func(data, i);
+    }
+
+    if (count) func(data, 0);
+
+    for (uint32_t i = 1; i < count; i++)
+      if (started[i]) pthread_join(threads[i], nullptr);
+#else
+    for (uint32_t i = 0; i < count; i++)
+      func(data, i);
+#endif // ASMJIT_OS_POSIX
+  }
+
+#if ASMJIT_OS_POSIX
+  struct Task {
+    TaskFunc func;
+    void* data;
+    uint32_t index;
+  };
+
+  static void* threadEntry(void* arg) {
+    Task* task = static_cast<Task*>(arg);
+    task->func(task->data, task->index);
+    return nullptr;
+  }
+#endif // ASMJIT_OS_POSIX
+
+  uint32_t _numThreads;
+};
+
+// Compile a module of many functions, each generated like the GP category.
+// Generation and `finalize()` are measured, only the register allocation runs
+// concurrently, the serialization into the `CodeHolder` is sequential.
+static Error generateFunctions(CodeHolder& code, CCExecutor* executor, uint32_t count, uint32_t& instCount) {
+  X86Compiler cc(&code);
+  cc.setExecutor(executor);
+  ASMJIT_PROPAGATE(setupPasses(cc));
+
+  BenchRegs regs;
+  instCount = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    cc.addFunc(FuncSignature0<void>(CallConv::kIdHost));
+    initVirtRegs(regs, cc);
+    instCount += generateGp(cc, regs, benchConfig.rounds);
+    cc.endFunc();
+  }
+
+  Error err = cc.finalize();
+  collectPassStats(cc);
+  return err;
+}
+
+static void benchFunctions(uint32_t archType) {
+  CodeHolder code;
+  Performance perf;
+
+  const char* archName = archType == ArchInfo::kTypeX86 ? "X86" : "X64";
+  uint32_t numSamples = benchConfig.samples < 5 ? benchConfig.samples : 5;
+
+  for (uint32_t numThreads = 1; numThreads <= benchConfig.threads; numThreads *= 2) {
+    BenchExecutor executor(numThreads);
+    size_t codeSize = 0;
+    uint32_t instCount = 0;
+
+    perf.reset();
+    for (uint32_t s = 0; s < numSamples + 1; s++) {
+      code.init(makeCodeInfo(archType));
+
+      perf.start();
+      Error err = generateFunctions(code, numThreads > 1 ? &executor : nullptr, benchConfig.functions, instCount);
+      if (s) perf.end(1);
+
+      codeSize = code.getCodeSize();
+      code.reset(false);
+
+      if (ASMJIT_UNLIKELY(err)) {
+        fprintf(stderr, "Functions (%s) with %u threads: %s\n", archName, numThreads, DebugUtils::errorAsString(err));
+        return;
+      }
+    }
+
+    char category[32];
+    snprintf(category, ASMJIT_ARRAY_SIZE(category), "Funcs%u@%uT", benchConfig.functions, numThreads);
+
+    BenchResult r;
+    fillResult(r, "X86Compiler", archName, category, perf, codeSize, instCount);
+    printResult(r);
+  }
 }
 #endif
 
 int main(int argc, char* argv[]) {
+  parseArgs(argc, argv);
+  printHeader();
+
 #if defined(ASMJIT_BUILD_X86)
   benchX86(ArchInfo::kTypeX86);
   benchX86(ArchInfo::kTypeX64);
+
+  if (benchConfig.labels) {
+    benchLabels(ArchInfo::kTypeX86);
+    benchLabels(ArchInfo::kTypeX64);
+  }
+
+  benchTemplates(ArchInfo::kTypeX86);
+  benchTemplates(ArchInfo::kTypeX64);
+
+  if (benchConfig.functions) {
+    benchFunctions(ArchInfo::kTypeX86);
+    benchFunctions(ArchInfo::kTypeX64);
+  }
+
+  if (benchConfig.loopAlign)
+    benchLoopAlignment();
 #endif // ASMJIT_BUILD_X86
 
+  printFooter();
+
+  if (benchConfig.passStats)
+    printPassStats();
   return 0;
 }
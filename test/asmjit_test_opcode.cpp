@@ -86,6 +86,27 @@ int main(int argc, char* argv[]) {
       Error err = runtime.add(&p, &code);
       if (err == kErrorOk) p();
     }
+
+    // Generate the same opcodes again with compact encoding enabled and
+    // report how many bytes the shortest-form selection saves.
+    CodeHolder compactCode;
+    compactCode.init(CodeInfo(info.archType));
+    compactCode.setErrorHandler(&eh);
+    compactCode.addGlobalHints(CodeEmitter::kHintCompactEncoding);
+
+    X86Assembler ca(&compactCode);
+    asmtest::generateOpcodes(ca, info.useRex1, info.useRex2);
+
+    size_t normalSize = code.getCodeSize();
+    size_t compactSize = compactCode.getCodeSize();
+
+    printf("Compact encoding [ARCH=%s REX1=%s REX2=%s]: %u -> %u bytes (saved %u)\n",
+      archTypeToString(info.archType),
+      info.useRex1 ? "true" : "false",
+      info.useRex2 ? "true" : "false",
+      unsigned(normalSize),
+      unsigned(compactSize),
+      unsigned(normalSize - compactSize));
   }
 
   return 0;
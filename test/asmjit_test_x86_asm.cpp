@@ -61,21 +61,10 @@ static void makeFunc(X86Emitter* emitter) {
   FuncUtils::emitEpilog(emitter, layout);
 }
 
-int main(int argc, char* argv[]) {
-  JitRuntime rt;                          // Create JIT Runtime
-
-  CodeHolder code;                        // Create a CodeHolder.
-  code.init(rt.getCodeInfo());            // Initialize it to match `rt`.
-  X86Assembler a(&code);                  // Create and attach X86Assembler to `code`.
-
-  FileLogger logger(stderr);
-  code.setLogger(&logger);
-
-  makeFunc(a.asEmitter());
-
+static bool runFunc(JitRuntime& rt, CodeHolder& code) {
   SumIntsFunc fn;
   Error err = rt.add(&fn, &code);         // Add the code generated to the runtime.
-  if (err) return 1;                      // Handle a possible error case.
+  if (err) return false;                  // Handle a possible error case.
 
   // Execute the generated function.
   int inA[4] = { 4, 3, 2, 1 };
@@ -87,9 +76,38 @@ int main(int argc, char* argv[]) {
   printf("{%d %d %d %d}\n", out[0], out[1], out[2], out[3]);
 
   rt.release(fn);
+  return out[0] == 5 && out[1] == 8 && out[2] == 4 && out[3] == 9;
+}
+
+int main(int argc, char* argv[]) {
+  JitRuntime rt;                          // Create JIT Runtime
+  FileLogger logger(stderr);
+
+  // Generate the function by X86Assembler.
+  {
+    CodeHolder code;                      // Create a CodeHolder.
+    code.init(rt.getCodeInfo());          // Initialize it to match `rt`.
+    code.setLogger(&logger);
+
+    X86Assembler a(&code);                // Create and attach X86Assembler to `code`.
+    makeFunc(a.asEmitter());
+
+    if (!runFunc(rt, code))
+      return 1;
+  }
+
+  // Generate the same function by X86Builder, which serializes to X86Assembler.
+  {
+    CodeHolder code;
+    code.init(rt.getCodeInfo());
+    code.setLogger(&logger);
+
+    X86Builder cb(&code);                 // Create and attach X86Builder to `code`.
+    makeFunc(cb.asEmitter());
+
+    if (cb.finalize() != kErrorOk || !runFunc(rt, code))
+      return 1;
+  }
 
-  if (out[0] == 5 && out[1] == 8 && out[2] == 4 && out[3] == 9)
-    return 0;
-  else
-    return 1;
+  return 0;
 }
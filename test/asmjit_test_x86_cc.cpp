@@ -11,6 +11,10 @@
 #include <setjmp.h>
 
 #include "./asmjit.h"
+#if ASMJIT_OS_POSIX
+# include <pthread.h>
+#endif // ASMJIT_OS_POSIX
+
 #include "./asmjit_test_misc.h"
 
 using namespace asmjit;
@@ -77,7 +81,22 @@ public:
   int _returnCode;
   int _binSize;
   bool _verbose;
+  bool _peephole;
+  bool _schedule;
+  bool _fold;
+  bool _cse;
+  bool _licm;
+  const char* _passes;
   StringBuilder _output;
+
+  size_t _baseSize;
+  size_t _peepholeSize;
+  uint64_t _baseTime;
+  uint64_t _peepholeTime;
+  uint32_t _peepholeRemoved;
+  uint32_t _peepholeRetargeted;
+  uint32_t _scheduleRegions;
+  uint32_t _scheduleMoved;
 };
 
 X86TestManager::X86TestManager() :
@@ -85,7 +104,21 @@ X86TestManager::X86TestManager() :
   _zoneHeap(&_zone),
   _returnCode(0),
   _binSize(0),
-  _verbose(false) {}
+  _verbose(false),
+  _peephole(false),
+  _schedule(false),
+  _fold(false),
+  _cse(false),
+  _licm(false),
+  _passes(NULL),
+  _baseSize(0),
+  _peepholeSize(0),
+  _baseTime(0),
+  _peepholeTime(0),
+  _peepholeRemoved(0),
+  _peepholeRetargeted(0),
+  _scheduleRegions(0),
+  _scheduleMoved(0) {}
 
 X86TestManager::~X86TestManager() {
   size_t i;
@@ -131,13 +164,69 @@ int X86TestManager::run() {
     }
 #endif // ASMJIT_DISABLE_LOGGING
 
-    X86Compiler cc(&code);
     X86Test* test = _tests[i];
+
+    // Compile the test without the peephole pass to get the reference size.
+    if (_peephole) {
+      CodeHolder refCode;
+      refCode.init(runtime.getCodeInfo());
+
+      X86Compiler refCc(&refCode);
+      test->compile(refCc);
+
+      uint64_t start = OSUtils::getNanoTickCount();
+      if (refCc.finalize() == kErrorOk)
+        _baseSize += refCode.getCodeSize();
+      _baseTime += OSUtils::getNanoTickCount() - start;
+    }
+
+    X86Compiler cc(&code);
+    X86PeepholePass* peephole = NULL;
+
+    if (_peephole) {
+      peephole = cc.newPassT<X86PeepholePass>();
+      cc.addPass(peephole);
+    }
+
+    if (_fold)
+      cc.insertPass(0, cc.newPassT<X86ConstFoldPass>());
+
+    if (_cse)
+      cc.insertPass(0, cc.newPassT<X86CsePass>());
+
+    if (_licm)
+      cc.insertPass(0, cc.newPassT<X86LicmPass>());
+
+    X86SchedulerPass* scheduler = NULL;
+    if (_schedule) {
+      scheduler = cc.newPassT<X86SchedulerPass>();
+      cc.addPass(scheduler);
+    }
+
+    if (_passes && cc.setPassOptions(_passes) != kErrorOk) {
+      fprintf(file, "[Failure] Invalid passes '%s'.\n", _passes);
+      return 1;
+    }
     test->compile(cc);
 
+    uint64_t start = OSUtils::getNanoTickCount();
     Error err = cc.finalize();
     void* func;
 
+    if (peephole) {
+      _peepholeTime += OSUtils::getNanoTickCount() - start;
+      if (err == kErrorOk) {
+        _peepholeSize += code.getCodeSize();
+        _peepholeRemoved += peephole->getRemovedCount();
+        _peepholeRetargeted += peephole->getRetargetedCount();
+      }
+    }
+
+    if (scheduler && err == kErrorOk) {
+      _scheduleRegions += scheduler->getRegionCount();
+      _scheduleMoved += scheduler->getMovedCount();
+    }
+
     if (err == kErrorOk)
       err = runtime.add(&func, &code);
     if (_verbose) fflush(file);
@@ -185,6 +274,23 @@ int X86TestManager::run() {
 
   fputs("\n", file);
   fputs(_output.getData(), file);
+
+  if (_peephole) {
+    double ratio = _baseSize ? 100.0 * double(_baseSize - _peepholeSize) / double(_baseSize) : 0.0;
+
+    fprintf(file, "Peephole: Code size %u -> %u bytes (%.2f%% smaller)\n",
+      unsigned(_baseSize), unsigned(_peepholeSize), ratio);
+    fprintf(file, "Peephole: %u instructions removed, %u jumps retargeted\n",
+      unsigned(_peepholeRemoved), unsigned(_peepholeRetargeted));
+    fprintf(file, "Peephole: finalize() took %.3f ms without and %.3f ms with the pass\n",
+      double(_baseTime) / 1000000.0, double(_peepholeTime) / 1000000.0);
+  }
+
+  if (_schedule) {
+    fprintf(file, "Scheduler: %u instructions moved in %u regions\n",
+      unsigned(_scheduleMoved), unsigned(_scheduleRegions));
+  }
+
   fflush(file);
 
   return _returnCode;
@@ -569,6 +675,181 @@ public:
   }
 };
 
+// ============================================================================
+// [X86Test_JumpJccErratum]
+// ============================================================================
+
+class X86Test_JumpJccErratum : public X86Test {
+public:
+  X86Test_JumpJccErratum() : X86Test("[Jump] JCC erratum padding") {}
+
+  enum { kNumBranches = 24 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_JumpJccErratum());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.getCode()->addGlobalHints(CodeEmitter::kHintAvoidJccErratum);
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp n = cc.newInt32("n");
+    X86Gp i = cc.newInt32("i");
+    X86Gp acc = cc.newInt32("acc");
+    Label L_Loop = cc.newLabel();
+
+    cc.setArg(0, n);
+    cc.xor_(i, i);
+    cc.xor_(acc, acc);
+
+    cc.bind(L_Loop);
+    for (uint32_t k = 0; k < kNumBranches; k++) {
+      Label L_Skip = cc.newLabel();
+
+      // Shift the fused pairs to all possible offsets within 32 bytes.
+      for (uint32_t j = 0; j < k % 5; j++)
+        cc.nop();
+
+      cc.test(i, k + 1);
+      cc.jz(L_Skip);
+      cc.add(acc, k);
+      cc.bind(L_Skip);
+    }
+
+    cc.inc(i);
+    cc.cmp(i, n);
+    cc.jl(L_Loop);
+
+    cc.ret(acc);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func(100);
+    int expectRet = 0;
+
+    for (int i = 0; i < 100; i++)
+      for (int k = 0; k < kNumBranches; k++)
+        if (i & (k + 1))
+          expectRet += k;
+
+    result.setFormat("ret={%d}", resultRet);
+    expect.setFormat("ret={%d}", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
+// ============================================================================
+// [X86Test_JumpTable]
+// ============================================================================
+
+class X86Test_JumpTable : public X86Test {
+public:
+  X86Test_JumpTable() : X86Test("[Jump] Jump table") {}
+
+  enum { kNumCases = 6 };
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_JumpTable());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp n = cc.newInt32("n");
+    X86Gp i = cc.newInt32("i");
+    X86Gp k = cc.newInt32("k");
+    X86Gp acc = cc.newInt32("acc");
+    X86Gp sel = cc.newUInt32("sel");
+
+    Label L_Inc = cc.newLabel();
+    Label L_Loop = cc.newLabel();
+    Label L_Default = cc.newLabel();
+    Label L_Done = cc.newLabel();
+    Label L_Cases[kNumCases];
+
+    for (uint32_t c = 0; c < kNumCases - 1; c++)
+      L_Cases[c] = cc.newLabel();
+
+    // The last case jumps backward, directly to the increment.
+    L_Cases[kNumCases - 1] = L_Inc;
+
+    cc.setArg(0, n);
+    cc.mov(i, -1);
+    cc.mov(k, 7);
+    cc.xor_(acc, acc);
+
+    cc.bind(L_Inc);
+    cc.inc(i);
+
+    cc.bind(L_Loop);
+    cc.cmp(i, n);
+    cc.jge(L_Done);
+
+    cc.mov(sel, i);
+    cc.and_(sel, 7);
+    cc.jmpTable(sel, L_Cases, kNumCases, L_Default);
+
+    cc.bind(L_Cases[0]);
+    cc.add(acc, i);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Cases[1]);
+    cc.xor_(acc, k);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Cases[2]);
+    cc.sub(acc, 3);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Cases[3]);
+    cc.add(k, acc);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Cases[4]);
+    cc.add(acc, k);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Default);
+    cc.add(acc, 100);
+    cc.jmp(L_Inc);
+
+    cc.bind(L_Done);
+    cc.ret(acc);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int resultRet = func(1000);
+    int expectRet = 0;
+    int k = 7;
+
+    for (int i = 0; i < 1000; i++) {
+      switch (i & 7) {
+        case 0: expectRet += i; break;
+        case 1: expectRet ^= k; break;
+        case 2: expectRet -= 3; break;
+        case 3: k += expectRet; break;
+        case 4: expectRet += k; break;
+        case 5: break;
+        default: expectRet += 100; break;
+      }
+    }
+
+    result.setFormat("ret={%d}", resultRet);
+    expect.setFormat("ret={%d}", expectRet);
+
+    return resultRet == expectRet;
+  }
+};
+
 // ============================================================================
 // [X86Test_AllocBase]
 // ============================================================================
@@ -3430,6 +3711,790 @@ public:
   }
 };
 
+// ============================================================================
+// [X86Test_MiscAvxCleanup]
+// ============================================================================
+
+class X86Test_MiscAvxCleanup : public X86Test {
+public:
+  X86Test_MiscAvxCleanup() : X86Test("[Misc] AVX cleanup") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscAvxCleanup());
+  }
+
+  static float calledFunc(float a, float b) {
+    return a * b;
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.getCode()->addGlobalHints(CodeEmitter::kHintAvxCleanup);
+    cc.addFunc(FuncSignature2<float, float*, float>(CallConv::kIdHost));
+
+    X86Gp data = cc.newIntPtr("data");
+    X86Xmm x = cc.newXmmSs("x");
+    X86Xmm ret = cc.newXmmSs("ret");
+
+    cc.setArg(0, data);
+    cc.setArg(1, x);
+
+    // Make the upper part of YMM registers dirty before calling a function
+    // that uses legacy SSE, `vzeroupper` must be inserted before the call.
+    if (CpuInfo::getHost().hasFeature(CpuInfo::kX86FeatureAVX)) {
+      X86Ymm v = cc.newYmmPs("v");
+      cc.vmovups(v, x86::ptr(data));
+      cc.vaddps(v, v, v);
+      cc.vmovups(x86::ptr(data), v);
+    }
+
+    X86Gp fn = cc.newIntPtr("fn");
+    cc.mov(fn, imm_ptr(calledFunc));
+
+    CCFuncCall* call = cc.call(fn, FuncSignature2<float, float, float>(CallConv::kIdHost));
+    call->setArg(0, x);
+    call->setArg(1, x);
+    call->setRet(0, ret);
+
+    cc.ret(ret);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef float (*Func)(float*, float);
+    Func func = ptr_as_func<Func>(_func);
+
+    float data[8] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f };
+    float resultRet = func(data, 3.0f);
+    float expectRet = calledFunc(3.0f, 3.0f);
+    float scale = CpuInfo::getHost().hasFeature(CpuInfo::kX86FeatureAVX) ? 2.0f : 1.0f;
+
+    result.setFormat("ret=%g data={%g %g %g %g %g %g %g %g}", resultRet,
+      data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
+    expect.setFormat("ret=%g data={%g %g %g %g %g %g %g %g}", expectRet,
+      1.0f * scale, 2.0f * scale, 3.0f * scale, 4.0f * scale,
+      5.0f * scale, 6.0f * scale, 7.0f * scale, 8.0f * scale);
+
+    return result == expect;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscDeadCode]
+// ============================================================================
+
+class X86Test_MiscDeadCode : public X86Test {
+public:
+  X86Test_MiscDeadCode() : X86Test("[Misc] Dead code") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscDeadCode());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.getCode()->addGlobalHints(CodeEmitter::kHintDeadCodeElimination);
+    cc.addFunc(FuncSignature2<int, int*, int>(CallConv::kIdHost));
+
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp n = cc.newInt32("n");
+    X86Gp i = cc.newInt32("i");
+    X86Gp sum = cc.newInt32("sum");
+    X86Gp t = cc.newInt32("t");
+    X86Gp u = cc.newInt32("u");
+
+    Label L_Loop = cc.newLabel();
+    Label L_Next = cc.newLabel();
+
+    cc.setArg(0, p);
+    cc.setArg(1, n);
+
+    cc.xor_(i, i);
+    cc.xor_(sum, sum);
+
+    cc.bind(L_Loop);
+    cc.mov(t, i);                                  // Dead.
+    cc.add(t, t);                                  // Dead.
+    cc.mov(u, t);                                  // Dead.
+    cc.add(u, 7);                                  // Dead, flags written by INC.
+    cc.add(sum, i);
+    cc.inc(i);
+    cc.cmp(i, n);                                  // Kept, flags read by JL.
+    cc.jl(L_Loop);
+
+    cc.mov(t, sum);                                // Dead once the next block is cleaned.
+    cc.jmp(L_Next);
+
+    cc.bind(L_Next);
+    cc.mov(u, t);                                  // Dead.
+    cc.cmp(sum, n);                                // Dead, flags unused by RET.
+    cc.mov(x86::dword_ptr(p), sum);                // Kept, writes memory.
+    cc.ret(sum);
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int*, int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int out = 0;
+    int resultRet = func(&out, 10);
+
+    result.setFormat("ret=%d out=%d", resultRet, out);
+    expect.setFormat("ret=%d out=%d", 45, 45);
+
+    return result == expect;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscConstFold]
+// ============================================================================
+
+class X86Test_MiscConstFold : public X86Test {
+public:
+  X86Test_MiscConstFold() : X86Test("[Misc] Constant folding") {}
+
+  enum {
+    kNumDiv32 = 8,
+    kNumDivZ = 5,
+    kNumArith = 6,
+    kNumOut32 = kNumDiv32 * 2 + kNumArith,
+    kNumOutZ = kNumDivZ * 2
+  };
+
+  static const uint32_t div32[kNumDiv32];
+  static const uint64_t divZ[kNumDivZ];
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscConstFold());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    X86ConstFoldPass* pass = cc.newPassT<X86ConstFoldPass>();
+    cc.insertPass(0, pass);
+
+    cc.addFunc(FuncSignature4<void, uint32_t*, uintptr_t*, uint32_t, uintptr_t>(CallConv::kIdHost));
+
+    X86Gp p32 = cc.newIntPtr("p32");
+    X86Gp pZ = cc.newIntPtr("pZ");
+    X86Gp a = cc.newUInt32("a");
+    X86Gp b = cc.newUIntPtr("b");
+
+    cc.setArg(0, p32);
+    cc.setArg(1, pZ);
+    cc.setArg(2, a);
+    cc.setArg(3, b);
+
+    uint32_t i;
+    uint32_t o = 0;
+
+    // Unsigned division by a constant, becomes SHR|AND or MUL by a magic number.
+    for (i = 0; i < kNumDiv32; i++) {
+      X86Gp hi = cc.newUInt32("hi%u", i);
+      X86Gp lo = cc.newUInt32("lo%u", i);
+      X86Gp d = cc.newUInt32("d%u", i);
+
+      cc.xor_(hi, hi);
+      cc.mov(lo, a);
+      cc.mov(d, div32[i]);
+      cc.div(hi, lo, d);
+      cc.mov(x86::dword_ptr(p32, o++ * 4), lo);
+      cc.mov(x86::dword_ptr(p32, o++ * 4), hi);
+    }
+
+    for (i = 0; i < kNumDivZ; i++) {
+      X86Gp hi = cc.newUIntPtr("hiZ%u", i);
+      X86Gp lo = cc.newUIntPtr("loZ%u", i);
+      X86Gp d = cc.newUIntPtr("dZ%u", i);
+
+      cc.xor_(hi, hi);
+      cc.mov(lo, b);
+      cc.mov(d, imm_u(divZ[i]));
+      cc.div(hi, lo, d);
+      cc.mov(x86::ptr(pZ, i * 2 * int32_t(sizeof(uintptr_t))), lo);
+      cc.mov(x86::ptr(pZ, (i * 2 + 1) * int32_t(sizeof(uintptr_t))), hi);
+    }
+
+    // Multiplication by a constant, becomes IMUL by immediate, SHL, and LEA.
+    X86Gp x = cc.newUInt32("x");
+    X86Gp k = cc.newUInt32("k");
+    cc.mov(x, a);
+    cc.mov(k, 40);
+    cc.imul(x, k);
+    cc.mov(x86::dword_ptr(p32, o++ * 4), x);
+
+    X86Gp y = cc.newUInt32("y");
+    cc.mov(y, a);
+    cc.imul(y, y, 8);
+    cc.mov(x86::dword_ptr(p32, o++ * 4), y);
+
+    X86Gp z = cc.newUInt32("z");
+    cc.mov(z, 9);
+    cc.imul(z, a);
+    cc.mov(x86::dword_ptr(p32, o++ * 4), z);
+
+    // Shift by a known zero is removed.
+    X86Gp s = cc.newUInt32("s");
+    X86Gp c = cc.newUInt8("c");
+    cc.mov(s, a);
+    cc.mov(c, 0);
+    cc.shl(s, c);
+    cc.mov(x86::dword_ptr(p32, o++ * 4), s);
+
+    // Arithmetic of known values is folded into MOV.
+    X86Gp t = cc.newUInt32("t");
+    X86Gp u = cc.newUInt32("u");
+    cc.mov(t, 100);
+    cc.mov(u, 7);
+    cc.sub(t, u);
+    cc.shl(t, 2);
+    cc.lea(t, x86::ptr(t, u, 3, 5));
+    cc.mov(x86::dword_ptr(p32, o++ * 4), t);
+
+    // ADD with flags read by ADC must be kept.
+    X86Gp v = cc.newUInt32("v");
+    X86Gp w = cc.newUInt32("w");
+    cc.mov(v, 0xFFFFFFFFU);
+    cc.mov(w, a);
+    cc.add(v, 1);
+    cc.adc(w, 0);
+    cc.mov(x86::dword_ptr(p32, o++ * 4), w);
+
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef void (*Func)(uint32_t*, uintptr_t*, uint32_t, uintptr_t);
+    Func func = ptr_as_func<Func>(_func);
+
+    static const uint32_t values32[] = { 0, 1, 2, 6, 7, 99, 640, 641, 1000, 0x7FFFFFFFU, 0x80000000U, 0xFFFFFFFEU, 0xFFFFFFFFU };
+    static const uint64_t valuesZ[] = { 0, 1, 3, 7, 1000000006, 1000000007, 0xFFFFFFFFU, uint64_t(0x7FFFFFFFFFFFFFFF), ~uint64_t(0) };
+
+    for (uint32_t n = 0; n < ASMJIT_ARRAY_SIZE(values32); n++) {
+      uint32_t a = values32[n];
+      uintptr_t b = uintptr_t(valuesZ[n % ASMJIT_ARRAY_SIZE(valuesZ)]);
+
+      uint32_t out32[kNumOut32];
+      uintptr_t outZ[kNumOutZ];
+      func(out32, outZ, a, b);
+
+      uint32_t i, o = 0;
+      for (i = 0; i < kNumDiv32; i++) {
+        result.appendFormat("%u/%u=%u,%u ", a, div32[i], out32[o], out32[o + 1]);
+        expect.appendFormat("%u/%u=%u,%u ", a, div32[i], a / div32[i], a % div32[i]);
+        o += 2;
+      }
+
+      for (i = 0; i < kNumDivZ; i++) {
+        uintptr_t d = uintptr_t(divZ[i]);
+        result.appendFormat("%llu/%llu=%llu,%llu ", (unsigned long long)b, (unsigned long long)d, (unsigned long long)outZ[i * 2], (unsigned long long)outZ[i * 2 + 1]);
+        expect.appendFormat("%llu/%llu=%llu,%llu ", (unsigned long long)b, (unsigned long long)d, (unsigned long long)(b / d), (unsigned long long)(b % d));
+      }
+
+      result.appendFormat("%u %u %u %u %u %u\n", out32[o], out32[o + 1], out32[o + 2], out32[o + 3], out32[o + 4], out32[o + 5]);
+      expect.appendFormat("%u %u %u %u %u %u\n", a * 40, a * 8, a * 9, a, uint32_t((100 - 7) * 4 + 7 * 8 + 5), a + 1);
+    }
+
+    return result == expect;
+  }
+};
+
+const uint32_t X86Test_MiscConstFold::div32[] = { 1, 3, 7, 10, 16, 641, 0x7FFFFFFFU, 0x80000000U };
+const uint64_t X86Test_MiscConstFold::divZ[] = { 3, 7, 16, 1000000007, 0x7FFFFFFFU };
+
+// ============================================================================
+// [X86Test_MiscCse]
+// ============================================================================
+
+class X86Test_MiscCse : public X86Test {
+public:
+  X86Test_MiscCse() : X86Test("[Misc] Common subexpressions") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscCse());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.insertPass(0, cc.newPassT<X86CsePass>());
+    cc.addFunc(FuncSignature3<void, int32_t*, int32_t*, int32_t*>(CallConv::kIdHost));
+
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp q = cc.newIntPtr("q");
+    X86Gp out = cc.newIntPtr("out");
+
+    cc.setArg(0, p);
+    cc.setArg(1, q);
+    cc.setArg(2, out);
+
+    // The second load of the same field is eliminated.
+    X86Gp a = cc.newInt32("a");
+    X86Gp b = cc.newInt32("b");
+    cc.mov(a, x86::dword_ptr(p, 0));
+    cc.mov(b, x86::dword_ptr(p, 0));
+
+    // The same sum is only computed once.
+    X86Gp x = cc.newInt32("x");
+    X86Gp y = cc.newInt32("y");
+    cc.mov(x, a);
+    cc.add(x, b);
+    cc.mov(y, b);
+    cc.add(y, a);
+    cc.mov(x86::dword_ptr(out, 0), x);
+    cc.mov(x86::dword_ptr(out, 4), y);
+
+    // A store to another field of the same base doesn't alias.
+    X86Gp c = cc.newInt32("c");
+    cc.mov(x86::dword_ptr(p, 4), 7);
+    cc.mov(c, x86::dword_ptr(p, 0));
+    cc.mov(x86::dword_ptr(out, 8), c);
+
+    // A store is forwarded to a load of the same field.
+    X86Gp d = cc.newInt32("d");
+    cc.mov(x86::dword_ptr(p, 8), x);
+    cc.mov(d, x86::dword_ptr(p, 8));
+    cc.mov(x86::dword_ptr(out, 12), d);
+
+    // A store through another pointer may alias, the field is loaded again.
+    X86Gp e = cc.newInt32("e");
+    cc.mov(x86::dword_ptr(q, 0), 100);
+    cc.mov(e, x86::dword_ptr(p, 0));
+    cc.mov(x86::dword_ptr(out, 16), e);
+
+    // The same applies to SSE loads.
+    X86Xmm v0 = cc.newXmm("v0");
+    X86Xmm v1 = cc.newXmm("v1");
+    cc.movdqu(v0, x86::ptr(p, 16));
+    cc.movdqu(v1, x86::ptr(p, 16));
+    cc.paddd(v0, v1);
+    cc.movdqu(x86::ptr(out, 20), v0);
+
+    cc.endFunc();
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef void (*Func)(int32_t*, int32_t*, int32_t*);
+    Func func = ptr_as_func<Func>(_func);
+
+    for (uint32_t n = 0; n < 2; n++) {
+      int32_t p[8] = { 3, 0, 0, 0, 1, 2, 3, 4 };
+      int32_t other = 0;
+      int32_t out[9] = { 0 };
+
+      // The second run passes the same pointer twice.
+      func(p, n == 0 ? &other : p, out);
+
+      result.appendFormat("%d %d %d %d %d %d %d %d %d\n",
+        out[0], out[1], out[2], out[3], out[4], out[5], out[6], out[7], out[8]);
+      expect.appendFormat("%d %d %d %d %d %d %d %d %d\n",
+        6, 6, 3, 6, n == 0 ? 3 : 100, 2, 4, 6, 8);
+    }
+
+    return result == expect;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscLicm]
+// ============================================================================
+
+class X86Test_MiscLicm : public X86Test {
+public:
+  X86Test_MiscLicm() : X86Test("[Misc] Loop-invariant code motion") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscLicm());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.insertPass(0, cc.newPassT<X86LicmPass>());
+    cc.addFunc(FuncSignature3<int, int32_t*, uintptr_t, int32_t*>(CallConv::kIdHost));
+
+    X86Gp arr = cc.newIntPtr("arr");
+    X86Gp n = cc.newUIntPtr("n");
+    X86Gp params = cc.newIntPtr("params");
+
+    X86Gp i = cc.newUIntPtr("i");
+    X86Gp sum = cc.newInt32("sum");
+    X86Gp acc = cc.newInt32("acc");
+    X86Gp k = cc.newInt32("k");
+    X86Gp c = cc.newInt32("c");
+    X86Gp x = cc.newInt32("x");
+    X86Gp p0 = cc.newInt32("p0");
+    X86Gp big = cc.newInt32("big");
+
+    Label L_Loop1 = cc.newLabel();
+    Label L_Done1 = cc.newLabel();
+    Label L_Head2 = cc.newLabel();
+    Label L_Done2 = cc.newLabel();
+
+    cc.setArg(0, arr);
+    cc.setArg(1, n);
+    cc.setArg(2, params);
+
+    // Loop #1 - The load of `params[1]` doesn't alias the store to `params[2]`
+    // and is hoisted together with the constant computed by MOV+ADD.
+    cc.xor_(sum, sum);
+    cc.xor_(i, i);
+    cc.test(n, n);
+    cc.jz(L_Done1);
+
+    cc.bind(L_Loop1);
+    cc.mov(k, x86::dword_ptr(params, 4));
+    cc.mov(x, x86::dword_ptr(arr, i, 2));
+    cc.imul(x, k);
+    cc.mov(c, 1);
+    cc.add(c, 2);
+    cc.add(x, c);
+    cc.add(sum, x);
+    cc.mov(x86::dword_ptr(params, 8), sum);
+    cc.inc(i);
+    cc.cmp(i, n);
+    cc.jb(L_Loop1);
+    cc.bind(L_Done1);
+
+    // Loop #2 - The load of `params[0]` may alias the store to `arr[i]` and
+    // stays in the loop, the constant is hoisted speculatively.
+    cc.xor_(i, i);
+    cc.xor_(acc, acc);
+
+    cc.bind(L_Head2);
+    cc.cmp(i, n);
+    cc.jae(L_Done2);
+    cc.mov(big, 1000);
+    cc.mov(p0, x86::dword_ptr(params));
+    cc.mov(x, x86::dword_ptr(arr, i, 2));
+    cc.add(x, p0);
+    cc.mov(x86::dword_ptr(arr, i, 2), x);
+    cc.add(acc, big);
+    cc.inc(i);
+    cc.jmp(L_Head2);
+    cc.bind(L_Done2);
+
+    cc.add(sum, acc);
+    cc.ret(sum);
+    cc.endFunc();
+  }
+
+  static int reference(int32_t* arr, uintptr_t n, int32_t* params) {
+    int32_t sum = 0;
+    int32_t acc = 0;
+    uintptr_t i;
+
+    for (i = 0; i < n; i++) {
+      sum += arr[i] * params[1] + 3;
+      params[2] = sum;
+    }
+
+    for (i = 0; i < n; i++) {
+      arr[i] += params[0];
+      acc += 1000;
+    }
+
+    return sum + acc;
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int32_t*, uintptr_t, int32_t*);
+    Func func = ptr_as_func<Func>(_func);
+
+    // The second run passes `arr` as `params`, the third one has no iteration.
+    static const uintptr_t counts[] = { 8, 8, 0 };
+
+    for (uint32_t r = 0; r < ASMJIT_ARRAY_SIZE(counts); r++) {
+      int32_t arrA[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+      int32_t arrB[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+      int32_t paramsA[4] = { 5, 2, 0, 0 };
+      int32_t paramsB[4] = { 5, 2, 0, 0 };
+
+      int32_t* pA = r == 1 ? arrA : paramsA;
+      int32_t* pB = r == 1 ? arrB : paramsB;
+
+      int resultRet = func(arrA, counts[r], pA);
+      int expectRet = reference(arrB, counts[r], pB);
+
+      result.appendFormat("ret=%d arr={%d %d %d %d %d %d %d %d} params={%d %d %d}\n", resultRet,
+        arrA[0], arrA[1], arrA[2], arrA[3], arrA[4], arrA[5], arrA[6], arrA[7], pA[0], pA[1], pA[2]);
+      expect.appendFormat("ret=%d arr={%d %d %d %d %d %d %d %d} params={%d %d %d}\n", expectRet,
+        arrB[0], arrB[1], arrB[2], arrB[3], arrB[4], arrB[5], arrB[6], arrB[7], pB[0], pB[1], pB[2]);
+    }
+
+    return result == expect;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscTemplate]
+// ============================================================================
+
+class X86Test_MiscTemplate : public X86Test {
+public:
+  X86Test_MiscTemplate() : X86Test("[Misc] Template") {}
+
+  static void add(X86TestManager& mgr) {
+    mgr.add(new X86Test_MiscTemplate());
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    // Record the kernel in a scratch compiler, the template is independent
+    // of it and of its CodeHolder.
+    CodeHolder scratch;
+    scratch.init(cc.getCodeInfo());
+
+    X86Compiler tc(&scratch);
+    CBTemplate tmpl;
+
+    X86Gp tAcc = tc.newInt32("acc");
+    X86Gp tP = tc.newIntPtr("p");
+    X86Gp tI = tc.newUIntPtr("i");
+    X86Gp tT = tc.newInt32("t");
+    Label tExit = tc.newLabel();
+    Label tLoop = tc.newLabel();
+
+    tc.mov(tI, 0);
+    CBNode* first = tc.getCursor();
+    tc.bind(tLoop);
+    tc.mov(tT, x86::dword_ptr(tP, tI, 2, -4));
+    tc.imul(tT, tT, 0);
+    CBNode* mul = tc.getCursor();
+    tc.add(tAcc, tT);
+    tc.dec(tI);
+    tc.jnz(tLoop);
+    tc.cmp(tAcc, 0);
+    CBNode* limit = tc.getCursor();
+    tc.jg(tExit);
+    CBNode* last = tc.getCursor();
+
+    tmpl.addRegParam(tAcc);
+    tmpl.addRegParam(tP);
+    tmpl.addLabelParam(tExit);
+    tmpl.addImmParam(first, 1);
+    tmpl.addImmParam(mul, 2);
+    tmpl.addImmParam(limit, 1);
+    tmpl.record(&tc, first, last);
+
+    cc.addFunc(FuncSignature1<int, const int32_t*>(CallConv::kIdHost));
+
+    X86Gp p = cc.newIntPtr("p");
+    X86Gp acc = cc.newInt32("acc");
+    Label L_Exit = cc.newLabel();
+
+    cc.setArg(0, p);
+    cc.xor_(acc, acc);
+
+    Reg regs[2] = { acc, p };
+    Label labels[1] = { L_Exit };
+    int64_t imms0[3] = { 4, 3, 1000 };
+    int64_t imms1[3] = { 8, 10, 300 };
+
+    tmpl.instantiate(&cc, regs, labels, imms0);
+    tmpl.instantiate(&cc, regs, labels, imms1);
+    cc.ret(acc);
+
+    cc.bind(L_Exit);
+    cc.mov(acc, -1);
+    cc.ret(acc);
+    cc.endFunc();
+  }
+
+  static int reference(const int32_t* p) {
+    static const int32_t params[2][3] = { { 4, 3, 1000 }, { 8, 10, 300 } };
+    int32_t acc = 0;
+
+    for (uint32_t k = 0; k < 2; k++) {
+      for (int32_t i = params[k][0]; i != 0; i--)
+        acc += p[i - 1] * params[k][1];
+      if (acc > params[k][2])
+        return -1;
+    }
+
+    return acc;
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(const int32_t*);
+    Func func = ptr_as_func<Func>(_func);
+
+    static const int32_t arr[2][8] = {
+      { 1, 2, 3, 4, 5, 6, 7, 8 },
+      { 1, 1, 1, 1, 1, 1, 1, 1 }
+    };
+
+    for (uint32_t r = 0; r < 2; r++) {
+      result.appendFormat("ret=%d\n", func(arr[r]));
+      expect.appendFormat("ret=%d\n", reference(arr[r]));
+    }
+
+    return result == expect;
+  }
+};
+
+// ============================================================================
+// [X86Test_MiscConcurrent]
+// ============================================================================
+
+//! Executor that claims to be concurrent, but runs tasks in reverse order on
+//! the calling thread, so the result must not depend on the order of tasks.
+class X86TestReverseExecutor : public CCExecutor {
+public:
+  virtual uint32_t getConcurrency() const noexcept { return 4; }
+
+  virtual void run(TaskFunc func, void* data, uint32_t count) noexcept {
+    while (count)
+      func(data, --count);
+  }
+};
+
+//! Executor that runs each task in its own thread (the first one on the
+//! calling thread), so shared state of the compiler is used concurrently.
+class X86TestThreadExecutor : public CCExecutor {
+public:
+  enum { kMaxThreads = 4 };
+
+  virtual uint32_t getConcurrency() const noexcept { return kMaxThreads; }
+
+  virtual void run(TaskFunc func, void* data, uint32_t count) noexcept {
+#if ASMJIT_OS_POSIX
+    pthread_t threads[kMaxThreads];
+    Task tasks[kMaxThreads];
+    bool started[kMaxThreads];
+
+    if (count > kMaxThreads) count = kMaxThreads;
+    for (uint32_t i = 1; i < count; i++) {
+      tasks[i].func = func;
+      tasks[i].data = data;
+      tasks[i].index = i;
+      started[i] = pthread_create(&threads[i], nullptr, threadEntry, &tasks[i]) == 0;
+      if (!started[i]) func(data, i);
+    }
+
+    if (count) func(data, 0);
+
+    for (uint32_t i = 1; i < count; i++)
+      if (started[i]) pthread_join(threads[i], nullptr);
+#else
+    for (uint32_t i = 0; i < count; i++)
+      func(data, i);
+#endif // ASMJIT_OS_POSIX
+  }
+
+#if ASMJIT_OS_POSIX
+  struct Task {
+    TaskFunc func;
+    void* data;
+    uint32_t index;
+  };
+
+  static void* threadEntry(void* arg) {
+    Task* task = static_cast<Task*>(arg);
+    task->func(task->data, task->index);
+    return nullptr;
+  }
+#endif // ASMJIT_OS_POSIX
+};
+
+class X86Test_MiscConcurrent : public X86Test {
+public:
+  X86Test_MiscConcurrent(const char* name, CCExecutor* executor)
+    : X86Test(name),
+      _executor(executor) {}
+
+  enum { kNumFuncs = 16 };
+
+  static void add(X86TestManager& mgr) {
+    static X86TestReverseExecutor reverseExecutor;
+    static X86TestThreadExecutor threadExecutor;
+
+    mgr.add(new X86Test_MiscConcurrent("[Misc] Concurrent functions", &reverseExecutor));
+    mgr.add(new X86Test_MiscConcurrent("[Misc] Concurrent functions (threads)", &threadExecutor));
+  }
+
+  virtual void compile(X86Compiler& cc) {
+    cc.setExecutor(_executor);
+
+    CCFunc* funcs[kNumFuncs];
+    uint32_t i;
+
+    for (i = 0; i < kNumFuncs; i++)
+      funcs[i] = cc.newFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    // Entry function, calls all others and sums their results.
+    cc.addFunc(FuncSignature1<int, int>(CallConv::kIdHost));
+
+    X86Gp x = cc.newInt32("x");
+    X86Gp sum = cc.newInt32("sum");
+
+    cc.setArg(0, x);
+    cc.xor_(sum, sum);
+
+    for (i = 0; i < kNumFuncs; i++) {
+      X86Gp ret = cc.newInt32("ret%u", i);
+      CCFuncCall* call = cc.call(funcs[i]->getLabel(), FuncSignature1<int, int>(CallConv::kIdHost));
+      call->setArg(0, x);
+      call->setRet(0, ret);
+      cc.add(sum, ret);
+    }
+
+    cc.ret(sum);
+    cc.endFunc();
+
+    // Called functions, each has its own virtual registers and labels.
+    for (i = 0; i < kNumFuncs; i++) {
+      cc.addFunc(funcs[i]);
+
+      X86Gp n = cc.newInt32("n");
+      X86Gp j = cc.newInt32("j");
+      X86Gp acc = cc.newInt32("acc");
+      X86Gp tmp = cc.newInt32("tmp");
+
+      Label L_Loop = cc.newLabel();
+      Label L_Odd = cc.newLabel();
+      Label L_Next = cc.newLabel();
+
+      cc.setArg(0, n);
+      cc.xor_(j, j);
+      cc.xor_(acc, acc);
+
+      cc.bind(L_Loop);
+      cc.test(j, 1);
+      cc.jnz(L_Odd);
+      cc.sub(acc, static_cast<int>(i + 1));
+      cc.jmp(L_Next);
+
+      cc.bind(L_Odd);
+      cc.imul(tmp, j, static_cast<int>(i + 1));
+      cc.add(acc, tmp);
+
+      cc.bind(L_Next);
+      cc.inc(j);
+      cc.cmp(j, n);
+      cc.jl(L_Loop);
+
+      cc.ret(acc);
+      cc.endFunc();
+    }
+  }
+
+  virtual bool run(void* _func, StringBuilder& result, StringBuilder& expect) {
+    typedef int (*Func)(int);
+    Func func = ptr_as_func<Func>(_func);
+
+    int x = 9;
+    int expectRet = 0;
+
+    for (int i = 0; i < kNumFuncs; i++)
+      for (int j = 0; j < x; j++)
+        expectRet += (j & 1) ? j * (i + 1) : -(i + 1);
+
+    int resultRet = func(x);
+
+    result.setFormat("ret=%d", resultRet);
+    expect.setFormat("ret=%d", expectRet);
+
+    return resultRet == expectRet;
+  }
+
+  CCExecutor* _executor;
+};
+
 // ============================================================================
 // [X86Test_MiscUnfollow]
 // ============================================================================
@@ -3572,6 +4637,15 @@ public:
     return false;
   }
 
+  const char* getValue(const char* key) {
+    size_t keyLen = ::strlen(key);
+    for (int i = 1; i < _argc; i++) {
+      if (::strncmp(_argv[i], key, keyLen) == 0 && _argv[i][keyLen] == '=')
+        return _argv[i] + keyLen + 1;
+    }
+    return NULL;
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -3593,6 +4667,23 @@ int main(int argc, char* argv[]) {
   if (cmd.hasArg("--verbose"))
     testMgr._verbose = true;
 
+  if (cmd.hasArg("--peephole"))
+    testMgr._peephole = true;
+
+  if (cmd.hasArg("--schedule"))
+    testMgr._schedule = true;
+
+  if (cmd.hasArg("--fold"))
+    testMgr._fold = true;
+
+  if (cmd.hasArg("--cse"))
+    testMgr._cse = true;
+
+  if (cmd.hasArg("--licm"))
+    testMgr._licm = true;
+
+  testMgr._passes = cmd.getValue("--passes");
+
   // Align.
   ADD_TEST(X86Test_AlignBase);
   ADD_TEST(X86Test_AlignNone);
@@ -3603,6 +4694,8 @@ int main(int argc, char* argv[]) {
   ADD_TEST(X86Test_JumpMany);
   ADD_TEST(X86Test_JumpUnreachable1);
   ADD_TEST(X86Test_JumpUnreachable2);
+  ADD_TEST(X86Test_JumpJccErratum);
+  ADD_TEST(X86Test_JumpTable);
 
   // Alloc.
   ADD_TEST(X86Test_AllocBase);
@@ -3657,6 +4750,13 @@ int main(int argc, char* argv[]) {
   ADD_TEST(X86Test_MiscMultiRet);
   ADD_TEST(X86Test_MiscMultiFunc);
   ADD_TEST(X86Test_MiscFastEval);
+  ADD_TEST(X86Test_MiscAvxCleanup);
+  ADD_TEST(X86Test_MiscDeadCode);
+  ADD_TEST(X86Test_MiscConstFold);
+  ADD_TEST(X86Test_MiscCse);
+  ADD_TEST(X86Test_MiscLicm);
+  ADD_TEST(X86Test_MiscTemplate);
+  ADD_TEST(X86Test_MiscConcurrent);
   ADD_TEST(X86Test_MiscUnfollow);
 
   // Bugs.